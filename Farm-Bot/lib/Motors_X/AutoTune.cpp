@@ -0,0 +1,262 @@
+/**
+ * AutoTune.cpp
+ *
+ * Implementation of the speed profile auto-tune.
+ */
+
+#include "AutoTune.h"
+#include "Config.h"
+#include "HostSerial.h"
+#include "MotorControl.h"
+#include "PositionManager.h"
+#include "EncoderInterface.h"
+#include "SpeedProfile.h"
+
+// Result of one test stage
+#define STAGE_OK 0
+#define STAGE_LOST 1     // Encoder disagreed with the step count
+#define STAGE_ABORTED 2  // Limit switch or emergency stop
+
+// Constant slow speed for repositioning and measuring the encoder ratio
+static const SpeedProfile SLOW_PROFILE = { MAX_STEP_DELAY, MAX_STEP_DELAY, 1, 1 };
+
+/**
+ * Move to an absolute position at the slow speed
+ *
+ * @return FALSE if stopped by a limit switch or emergency stop
+ */
+static bool moveToPosition(long target) {
+  long steps = target - getCurrentPosition();
+  if (steps == 0) return true;
+  return moveStepsWithProfile(labs(steps), steps > 0, SLOW_PROFILE);
+}
+
+/**
+ * Run one test move and compare the encoder with the steps sent
+ * After lost steps the step counter is corrected from the encoder, so
+ * later moves stay within the axis.
+ *
+ * @param direction Direction of the move (TRUE = CCW)
+ * @param profile Profile under test
+ * @param countsPerStepX256 Encoder counts per step, times 256
+ * @param lostSteps Receives the mismatch in steps
+ * @return FALSE if stopped by a limit switch or emergency stop
+ */
+static bool testMove(bool direction, const SpeedProfile &profile, int countsPerStepX256,
+                     long &lostSteps) {
+  long startPosition = getCurrentPosition();
+  long startEncoder = getEncoderPosition();
+  if (!moveStepsWithProfile(AUTOTUNE_TEST_STEPS, direction, profile)) return false;
+  delay(20);  // Let the carriage settle before reading the encoder
+
+  long moved = getCurrentPosition() - startPosition;
+  long counted = getEncoderPosition() - startEncoder;
+  long expected = moved * countsPerStepX256 / 256;
+  lostSteps = labs(counted - expected) * 256 / abs(countsPerStepX256);
+  if (lostSteps > AUTOTUNE_SYNC_TOLERANCE_STEPS) {
+    setCurrentPosition(startPosition + counted * 256 / countsPerStepX256);
+  }
+  return true;
+}
+
+/**
+ * Run a test move out and back from the start position
+ *
+ * @return STAGE_OK, STAGE_LOST or STAGE_ABORTED
+ */
+static uint8_t testStage(const SpeedProfile &profile, int countsPerStepX256, long start,
+                         long &lostSteps) {
+  lostSteps = 0;
+  if (!moveToPosition(start)) return STAGE_ABORTED;
+  if (!testMove(CCW, profile, countsPerStepX256, lostSteps)) return STAGE_ABORTED;
+  if (lostSteps > AUTOTUNE_SYNC_TOLERANCE_STEPS) return STAGE_LOST;
+  if (!testMove(CW, profile, countsPerStepX256, lostSteps)) return STAGE_ABORTED;
+  return lostSteps > AUTOTUNE_SYNC_TOLERANCE_STEPS ? STAGE_LOST : STAGE_OK;
+}
+
+static void printStageResult(uint8_t result, long lostSteps) {
+  if (result == STAGE_OK) {
+    HostSerial.println(F(": ok"));
+  } else if (result == STAGE_LOST) {
+    HostSerial.print(F(": lost "));
+    HostSerial.print(lostSteps);
+    HostSerial.println(F(" steps"));
+  } else {
+    HostSerial.println(F(": stopped"));
+  }
+}
+
+/**
+ * Measure encoder counts per step with a slow move out and back
+ *
+ * @return Counts per step times 256, or 0 if stopped by a limit switch
+ */
+static int measureCountsPerStep() {
+  long startEncoder = getEncoderPosition();
+  if (!moveStepsWithProfile(AUTOTUNE_TEST_STEPS, CCW, SLOW_PROFILE)) return 0;
+  delay(20);
+  long counted = getEncoderPosition() - startEncoder;
+  if (!moveStepsWithProfile(AUTOTUNE_TEST_STEPS, CW, SLOW_PROFILE)) return 0;
+  long ratio = counted * 256 / AUTOTUNE_TEST_STEPS;
+  if (ratio == 0) ratio = 1;  // Reported as "not responding" by the caller
+  return (int)constrain(ratio, -32767L, 32767L);
+}
+
+static void printCountsPerStep(int countsPerStepX256) {
+  long hundredths = (long)abs(countsPerStepX256) * 100 / 256;
+  HostSerial.print(F("Encoder counts per step: "));
+  if (countsPerStepX256 < 0) HostSerial.print(F("-"));
+  HostSerial.print(hundredths / 100);
+  HostSerial.print(F("."));
+  if (hundredths % 100 < 10) HostSerial.print(F("0"));
+  HostSerial.println(hundredths % 100);
+}
+
+static void endAutoTune(const __FlashStringHelper *result, const __FlashStringHelper *reason) {
+  disableMotor();
+  HostSerial.print(result);
+  HostSerial.println(reason);
+}
+
+/**
+ * Run the auto-tune sequence and store the result
+ * Ends with "Auto-tune complete", "Auto-tune aborted" or "Auto-tune failed".
+ */
+void runAutoTune() {
+  HostSerial.println(F("\n===== AUTO-TUNE ====="));
+  if (getMaxPosition() >= MAX_TRAVEL) {
+    HostSerial.println(F("Auto-tune failed: run homing (H) first"));
+    return;
+  }
+  if (getMaxPosition() - 2 * BACKOFF_STEPS < AUTOTUNE_TEST_STEPS) {
+    HostSerial.println(F("Auto-tune failed: axis shorter than AUTOTUNE_TEST_STEPS"));
+    return;
+  }
+
+  long start = getMaxPosition() / 2 - AUTOTUNE_TEST_STEPS / 2;
+  enableMotor();
+  if (!moveToPosition(start)) {
+    endAutoTune(F("Auto-tune aborted: "), F("limit switch or emergency stop"));
+    return;
+  }
+
+  // Encoder ratio
+  int countsPerStepX256 = ENCODER_COUNTS_PER_STEP_X256;
+  if (countsPerStepX256 == 0) {
+    HostSerial.println(F("Measuring encoder counts per step..."));
+    countsPerStepX256 = measureCountsPerStep();
+    if (countsPerStepX256 == 0) {
+      endAutoTune(F("Auto-tune aborted: "), F("limit switch or emergency stop"));
+      return;
+    }
+  }
+  printCountsPerStep(countsPerStepX256);
+  if (abs(countsPerStepX256) < 16) {
+    endAutoTune(F("Auto-tune failed: "), F("encoder not responding"));
+    return;
+  }
+
+  // Sweep 1: cruise speed at the Config.h acceleration
+  SpeedProfile trial = getDefaultSpeedProfile();
+  int bestDelay = 0;
+  long lostSteps;
+  for (int stepDelay = AUTOTUNE_START_STEP_DELAY; ; ) {
+    trial.minStepDelay = stepDelay;
+    uint8_t result = testStage(trial, countsPerStepX256, start, lostSteps);
+    HostSerial.print(F("Speed stage "));
+    HostSerial.print(stepDelay);
+    HostSerial.print(F(" us"));
+    printStageResult(result, lostSteps);
+    if (result == STAGE_ABORTED) {
+      endAutoTune(F("Auto-tune aborted: "), F("limit switch or emergency stop"));
+      return;
+    }
+    if (result == STAGE_LOST) break;
+    bestDelay = stepDelay;
+    if (stepDelay <= AUTOTUNE_FLOOR_STEP_DELAY) break;
+    int shorter = stepDelay * AUTOTUNE_SPEED_STEP_PERCENT / 100;
+    stepDelay -= shorter > 0 ? shorter : 1;
+    if (stepDelay < AUTOTUNE_FLOOR_STEP_DELAY) stepDelay = AUTOTUNE_FLOOR_STEP_DELAY;
+  }
+  if (bestDelay == 0) {
+    endAutoTune(F("Auto-tune failed: "), F("lost sync at the slowest test speed"));
+    return;
+  }
+
+  // Sweep 2: acceleration at the fastest speed that kept sync
+  trial.minStepDelay = bestDelay;
+  int bestAccel = ACCEL_RATE;  // Already proven by sweep 1
+  while (bestAccel < AUTOTUNE_MAX_ACCEL_RATE) {
+    int accel = bestAccel * 3 / 2 + 1;
+    if (accel > AUTOTUNE_MAX_ACCEL_RATE) accel = AUTOTUNE_MAX_ACCEL_RATE;
+    trial.accelRate = accel;
+    trial.decelRate = (long)accel * DECEL_RATE / ACCEL_RATE;
+    uint8_t result = testStage(trial, countsPerStepX256, start, lostSteps);
+    HostSerial.print(F("Acceleration stage "));
+    HostSerial.print(trial.accelRate);
+    HostSerial.print(F("/"));
+    HostSerial.print(trial.decelRate);
+    printStageResult(result, lostSteps);
+    if (result == STAGE_ABORTED) {
+      endAutoTune(F("Auto-tune aborted: "), F("limit switch or emergency stop"));
+      return;
+    }
+    if (result == STAGE_LOST) break;
+    bestAccel = accel;
+  }
+  if (!moveToPosition(start)) {
+    endAutoTune(F("Auto-tune aborted: "), F("limit switch or emergency stop"));
+    return;
+  }
+
+  // Back off from the limits found by the margin; speed is 1/delay, so the
+  // delay grows by 100 / (100 - margin) for the speed to drop by the margin
+  SpeedProfile tuned = getDefaultSpeedProfile();
+  long safeDelay = (long)bestDelay * 100 / (100 - AUTOTUNE_SAFETY_MARGIN_PERCENT);
+  tuned.minStepDelay = safeDelay > MAX_STEP_DELAY ? MAX_STEP_DELAY : (int)safeDelay;
+  int bestDecel = (long)bestAccel * DECEL_RATE / ACCEL_RATE;
+  tuned.accelRate = bestAccel - bestAccel * AUTOTUNE_SAFETY_MARGIN_PERCENT / 100;
+  tuned.decelRate = bestDecel - bestDecel * AUTOTUNE_SAFETY_MARGIN_PERCENT / 100;
+  if (tuned.accelRate < 1) tuned.accelRate = 1;
+  if (tuned.decelRate < 1) tuned.decelRate = 1;
+  if (!isValidSpeedProfile(tuned)) {
+    endAutoTune(F("Auto-tune failed: "), F("result out of range, profile not saved"));
+    return;
+  }
+
+  saveSpeedProfile(tuned, countsPerStepX256);
+  disableMotor();
+  HostSerial.print(F("Fastest stage that kept sync: "));
+  HostSerial.print(bestDelay);
+  HostSerial.print(F(" us, acceleration "));
+  HostSerial.println(bestAccel);
+  HostSerial.print(F("New speed profile: "));
+  printSpeedProfile();
+  HostSerial.println(F("Auto-tune complete: profile saved to EEPROM"));
+}
+
+/**
+ * Handle an auto-tune command (the text after the leading A)
+ * AP and AR reply with one line starting "Speed profile".
+ *
+ * @param args "", "P" or "R"
+ */
+void processAutoTuneCommand(const char *args) {
+  switch (args[0]) {
+    case '\0':
+      runAutoTune();
+      break;
+    case 'P':
+      HostSerial.print(F("Speed profile: "));
+      printSpeedProfile();
+      break;
+    case 'R':
+      resetSpeedProfile();
+      HostSerial.print(F("Speed profile reset: "));
+      printSpeedProfile();
+      break;
+    default:
+      HostSerial.println(F("Auto-tune commands: A, AP, AR"));
+      break;
+  }
+}
@@ -0,0 +1,37 @@
+/**
+ * AutoTune.h
+ *
+ * Header file for the speed profile auto-tune of the FarmBot X-Axis controller.
+ *
+ * Auto-tune runs test moves back and forth around the middle of the axis,
+ * first with a shorter cruise delay each stage, then with steeper
+ * acceleration. After every test move the encoder count is compared with the
+ * steps sent; a mismatch larger than AUTOTUNE_SYNC_TOLERANCE_STEPS means the
+ * motor lost synchronization and ends that sweep. The last stage that kept
+ * sync, less AUTOTUNE_SAFETY_MARGIN_PERCENT, is stored in EEPROM.
+ *
+ * Commands:
+ *   A   run auto-tune (needs a homed axis and a connected encoder)
+ *   AP  print the active speed profile
+ *   AR  return to the Config.h profile
+ */
+
+#ifndef AUTO_TUNE_H
+#define AUTO_TUNE_H
+
+#include <Arduino.h>
+
+/**
+ * Run the auto-tune sequence and store the result
+ * Ends with "Auto-tune complete", "Auto-tune aborted" or "Auto-tune failed".
+ */
+void runAutoTune();
+
+/**
+ * Handle an auto-tune command (the text after the leading A)
+ *
+ * @param args "", "P" or "R"
+ */
+void processAutoTuneCommand(const char *args);
+
+#endif // AUTO_TUNE_H
@@ -3,51 +3,143 @@
  * 
  * Implementation of serial command processing for the simplified FarmBot X-Axis controller.
  * Added encoder position to the status report.
+ * Commands are received into a static buffer; no String or heap use.
  */
 
 #include "CommandProcessor.h"
 #include "Config.h"
+#include "HostSerial.h"
 #include "MotorControl.h"
 #include "PositionManager.h"
 #include "EncoderInterface.h"
+#include "VelocityEstimator.h"
 #include "SystemOperations.h"
+#include "MemoryMonitor.h"
+#include "MotionTrace.h"
+#include "AutoTune.h"
+#include "SpeedProfile.h"
+#include "Gantry.h"
+#include "MotionState.h"
+#include "RealtimeControl.h"
+#include "SensorLog.h"
+
+// Command line being received (no String, no heap)
+static char commandBuffer[COMMAND_BUFFER_SIZE];
+static uint8_t commandLength = 0;
+static bool commandOverflow = false;
+
+/**
+ * Collect serial bytes into the static command buffer
+ * Handles one complete line per call, like the old readStringUntil() loop
+ */
+void pollSerialCommands() {
+  // A stop byte received while idle is reported here
+  if (isEmergencyStopTriggered()) handleStopRequest();
+
+  while (HostSerial.available()) {
+    char c = HostSerial.read();
+
+    if (c == '\n' || c == '\r') {
+      bool complete = commandLength > 0 && !commandOverflow;
+      if (commandOverflow) {
+        HostSerial.print(F("ERROR: Command longer than "));
+        HostSerial.print(COMMAND_MAX_LENGTH);
+        HostSerial.println(F(" characters ignored"));
+      }
+      // Trim trailing whitespace
+      while (commandLength > 0 && (commandBuffer[commandLength - 1] == ' ' || commandBuffer[commandLength - 1] == '\t')) commandLength--;
+      commandBuffer[commandLength] = '\0';
+      commandLength = 0;
+      commandOverflow = false;
+      if (complete) {
+        processCommand(commandBuffer);
+        return;
+      }
+      continue;
+    }
+
+    // Skip leading whitespace
+    if (commandLength == 0 && (c == ' ' || c == '\t')) continue;
+
+    if (commandLength < COMMAND_MAX_LENGTH) {
+      commandBuffer[commandLength++] = c;
+    } else {
+      commandOverflow = true;
+    }
+  }
+}
+
+/**
+ * Refuse to start motion while the emergency stop is latched
+ *
+ * @return TRUE if the command must not run
+ */
+static bool motionBlocked() {
+  if (!isEmergencyStopTriggered()) return false;
+  HostSerial.println(F("ERROR: Emergency stop active, send C to clear"));
+  return true;
+}
 
 /**
  * Process a command string received from serial
  * Parses the command and calls the appropriate function
  * 
- * @param command The command string to process
+ * @param command The command line to process, trimmed and NUL-terminated
  */
-void processCommand(String command) {
+void processCommand(const char *command) {
   // Log the received command
-  Serial.print("Command received: ");
-  Serial.println(command);
+  HostSerial.print(F("Command received: "));
+  HostSerial.println(command);
   
   // Process different command types
-  if (command.startsWith("X")) {
+  if (command[0] == 'X') {
     // Relative movement command
-    long steps = command.substring(1).toInt();
+    if (motionBlocked()) return;
+    long steps = atol(command + 1);
     processRelativeMove(steps);
   }
-  else if (command.startsWith("H")) {
+  else if (command[0] == 'H') {
     // Homing command
+    if (motionBlocked()) return;
     runHoming();
   }
-  else if (command.startsWith("R")) {
+  else if (command[0] == 'R') {
     // Report status
     reportStatus();
   }
-  else if (command.startsWith("S")) {
+  else if (command[0] == 'S') {
     // Emergency stop
     emergencyStop();
   }
+  else if (command[0] == 'C') {
+    // Clear a latched emergency stop
+    clearEmergencyStop();
+  }
+  else if (command[0] == 'A') {
+    // Speed profile auto-tune (AP and AR do not move)
+    if (command[1] == '\0' && motionBlocked()) return;
+    processAutoTuneCommand(command + 1);
+  }
+  else if (command[0] == 'T') {
+    // Motion trace control and dump
+    processTraceCommand(command + 1);
+  }
+  else if (command[0] == 'D') {
+    // Sensor log dump and control
+    processSensorLogCommand(command + 1);
+  }
   else {
     // Unknown command
-    Serial.println("Unknown command. Available commands:");
-    Serial.println("  X#### or X-#### - Move relative steps");
-    Serial.println("  H - Run homing sequence");
-    Serial.println("  R - Report current position");
-    Serial.println("  S - Stop movement immediately");
+    HostSerial.println(F("Unknown command. Available commands:"));
+    HostSerial.println(F("  X#### or X-#### - Move relative steps"));
+    HostSerial.println(F("  H - Run homing sequence"));
+    HostSerial.println(F("  R - Report current position"));
+    HostSerial.println(F("  A - Auto-tune speed profile (A, AP, AR)"));
+    HostSerial.println(F("  T - Motion trace (T, TF, TD, TO, TN#, TS)"));
+    HostSerial.println(F("  D - Sensor log (D, DS, DR, DC, DI#)"));
+    HostSerial.println(F("  C - Clear emergency stop"));
+    HostSerial.println(F("  Ctrl-X / ! / ~ - Stop / feed hold / resume, also during moves"));
+    HostSerial.println(F("  S - Stop movement immediately"));
   }
 }
 
@@ -56,24 +148,41 @@ void processCommand(String command) {
  * Prints position and other important information
  */
 void reportStatus() {
-  Serial.println("\n----- SYSTEM STATUS -----");
-  Serial.print("Current position: ");
-  Serial.println(getCurrentPosition());
-  Serial.print("Maximum position: ");
-  Serial.println(getMaxPosition());
+  HostSerial.println(F("\n----- SYSTEM STATUS -----"));
+  HostSerial.print(F("Current position: "));
+  HostSerial.println(getCurrentPosition());
+  HostSerial.print(F("Maximum position: "));
+  HostSerial.println(getMaxPosition());
   
   // Calculate percentage of travel
   int percentPosition = getPositionPercentage();
-  Serial.print("Position from home: ");
-  Serial.print(percentPosition);
-  Serial.println("%");
+  HostSerial.print(F("Position from home: "));
+  HostSerial.print(percentPosition);
+  HostSerial.println(F("%"));
   
   // Added encoder position to the status report
-  Serial.print("Encoder position: ");
-  Serial.println(getEncoderPosition());
+  HostSerial.print(F("Encoder position: "));
+  HostSerial.println(getEncoderPosition());
+  printVelocityReport();
+  
+  HostSerial.print(F("Limit switch state: "));
+  HostSerial.println(digitalRead(LIMIT_X_PIN) == LOW ? F("TRIGGERED") : F("Not triggered"));
+  
+#if GANGED_X_AXIS
+  // Second side of the ganged axis
+  HostSerial.print(F("Encoder 2 position: "));
+  HostSerial.println(getEncoder2Position());
+  HostSerial.print(F("Limit switch 2 state: "));
+  HostSerial.println(digitalRead(LIMIT_X2_PIN) == LOW ? F("TRIGGERED") : F("Not triggered"));
+  HostSerial.print(F("Racking (encoder 1 - encoder 2): "));
+  HostSerial.println(getRacking());
+#endif
+  
+  HostSerial.print(F("Speed profile: "));
+  printSpeedProfile();
   
-  Serial.print("Limit switch state: ");
-  Serial.println(digitalRead(LIMIT_X_PIN) == LOW ? "TRIGGERED" : "Not triggered");
+  // Static RAM and stack high-water mark
+  printMemoryReport();
   
-  Serial.println("------------------------\n");
+  HostSerial.println(F("------------------------\n"));
 }
\ No newline at end of file
@@ -13,9 +13,16 @@
  * Process a command string received from serial
  * Parses the command and calls the appropriate function
  * 
- * @param command The command string to process
+ * @param command The command line to process, trimmed and NUL-terminated
  */
-void processCommand(String command);
+void processCommand(const char *command);
+
+/**
+ * Collect serial bytes into the static command buffer
+ * Calls processCommand() when a complete line has arrived. Lines longer
+ * than COMMAND_MAX_LENGTH are discarded with an error message.
+ */
+void pollSerialCommands();
 
 /**
  * Report the current system status
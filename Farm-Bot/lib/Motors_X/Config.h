@@ -22,6 +22,24 @@
 // Limit Switch Pin
 #define LIMIT_X_PIN 7    // X-axis limit switch (LOW when triggered)
 
+// -------------------- GANGED X AXIS --------------------
+// A gantry driven by one motor on each rail. Motor 2 has its own driver,
+// limit switch and encoder; the enable pin is shared. Both step pulses are
+// set in one write to the PORT register, so PUL2_PIN should be on the same
+// port as PUL_PIN (pin 4 = PG5, pin 41 = PG0 on the Mega 2560). Pins on
+// different ports still work, but the two pulses start about 1 us apart.
+#define GANGED_X_AXIS 0        // 1 = two motors on the X axis
+#define PUL2_PIN 41            // Pulse (step) pin of motor 2
+#define DIR2_PIN 40            // Direction pin of motor 2
+#define DIR2_INVERTED false    // true if motor 2 is mounted mirrored (also flips its encoder)
+#define LIMIT_X2_PIN 8         // Home/far limit switch on the motor 2 rail (LOW when triggered)
+#define ENCODER2_A_PIN 18      // Motor 2 encoder channel A (must be interrupt-capable pin)
+#define ENCODER2_B_PIN 19      // Motor 2 encoder channel B (must be interrupt-capable pin)
+#define SQUARING_MAX_STEPS 800      // Most steps one side may trail the other at the home switch
+#define RACKING_LIMIT_COUNTS 40     // Encoder difference between the sides that stops a move
+                                    // (0 = no racking check, e.g. without encoders)
+#define RACKING_CHECK_INTERVAL 16   // Steps between racking checks
+
 // -------------------- MOTOR CONSTANTS --------------------
 
 // Direction definitions
@@ -34,17 +52,99 @@
 #define HOME_DIRECTION CW  // Direction to move during homing (typically CW)
 
 // Speed control (microseconds between steps)
+// Defaults; a profile measured with the auto-tune command (A) and stored in
+// EEPROM replaces MIN_STEP_DELAY, ACCEL_RATE and DECEL_RATE at startup.
+// Homing and backing off always run at MAX_STEP_DELAY.
 #define MIN_STEP_DELAY 200   // Fastest speed (smaller delay = faster speed)
 #define MAX_STEP_DELAY 1000  // Slowest speed
 #define ACCEL_RATE 5        // How quickly to accelerate (microseconds to subtract per step)
 #define DECEL_RATE 10        // How quickly to decelerate (microseconds to add per step)
+#define STEP_PULSE_US 10     // Step pulse width, part of each step's delay (most drivers need at least 2-5us)
 
 // Safety and Recovery
 #define BACKOFF_STEPS 1600    // Steps to back away from limit switch when triggered
 #define MAX_TRAVEL 10000000     // Default maximum travel (gets updated if far limit is hit)
 #define HOMING_TIMEOUT 100000000 // Maximum steps to attempt during homing before timeout
 
+// -------------------- ENCODER --------------------
+// Encoder counts per motor step, times 256 (e.g. 384 = 1.5 counts per step).
+// 0 measures it with a slow move at the start of every auto-tune run.
+#define ENCODER_COUNTS_PER_STEP_X256 0
+
+// -------------------- ENCODER VELOCITY --------------------
+// Speed from Timer 4 input capture (see VelocityEstimator.h). Encoder
+// channel A must also be wired to ENCODER_CAPTURE_PIN.
+#define ENCODER_CAPTURE_PIN 49          // ICP4 (PL0) on the Mega 2560
+#define VELOCITY_TICK_US 2000           // Control tick period during moves
+#define VELOCITY_COUNTING_MIN_EDGES 4   // Edges per tick from which counting replaces 1/T
+#define VELOCITY_STOPPED_US 32000       // Longer edge periods count as standing still
+#define VELOCITY_TICK_BUDGET_CYCLES 640 // Most CPU cycles one tick may take (40 us)
+#define VELOCITY_PI_ENABLED 0           // 1 = trim the cruise step interval to hold speed
+#define VELOCITY_PI_KP_X256 64          // Trim per microsecond of speed error, times 256
+#define VELOCITY_PI_KI_X256 16          // Integral gain per tick, times 256
+#define VELOCITY_TRIM_LIMIT_US 40       // Largest trim either way
+
+// -------------------- AUTO-TUNE --------------------
+#define AUTOTUNE_TEST_STEPS 6000            // Length of each test move (the axis must be longer)
+#define AUTOTUNE_START_STEP_DELAY 500       // Cruise delay of the first speed stage
+#define AUTOTUNE_FLOOR_STEP_DELAY 60        // Fastest delay tried (the step loop itself takes ~40 us)
+#define AUTOTUNE_SPEED_STEP_PERCENT 10      // Each speed stage shortens the delay by 10%
+#define AUTOTUNE_MAX_ACCEL_RATE 100         // Steepest acceleration tried
+#define AUTOTUNE_SYNC_TOLERANCE_STEPS 4     // Allowed step/encoder mismatch after a test move
+#define AUTOTUNE_SAFETY_MARGIN_PERCENT 20   // Stored speed and acceleration stay 20% below the
+                                            // last stage that kept sync
+
+// -------------------- SENSORS --------------------
+// Soil probes of Moisture_Sensor.ino and Ph_Sensor.ino, wired to this board
+#define SENSOR_MOISTURE_PIN A0     // Resistive moisture probe (dry soil reads high)
+#define SENSOR_TDS_PIN A1          // TDS probe
+#define SENSOR_TDS_SAMPLES 30      // Median filter length, as in Ph_Sensor.ino
+#define SENSOR_TDS_SAMPLE_MS 40    // Time between TDS samples
+
+// -------------------- SENSOR LOG --------------------
+// History of sensor readings in delta-encoded 64-byte blocks (see SensorLog.h).
+// A block holds about 13 readings of each probe, so at the default interval
+// the 79 blocks cover almost 3 hours.
+#define SENSOR_LOG_INTERVAL_S 10     // Default time between logged readings (DI command)
+#define SENSOR_LOG_RAM_BLOCKS 16     // Newest blocks, in SRAM
+#define SENSOR_LOG_EEPROM_BLOCKS 63  // Older blocks spilled to EEPROM when SRAM is full
+                                     // (0 = no spill). At the default interval each
+                                     // EEPROM cell is rewritten about every 2 hours.
+
+// -------------------- EEPROM LAYOUT --------------------
+#define EEPROM_PROFILE_ADDRESS 0  // Stored speed profile (see SpeedProfile.h), 14 bytes
+#define EEPROM_SENSOR_LOG_ADDRESS 16  // Spilled sensor log blocks, SENSOR_LOG_EEPROM_BLOCKS x 64 bytes
+
 // -------------------- SERIAL COMMUNICATION --------------------
 #define SERIAL_BAUD_RATE 115200  // Baud rate for communication with Raspberry Pi
 
+// HostSerial ring buffers (see HostSerial.h), powers of two up to 256
+#define HOST_SERIAL_RX_BUFFER_SIZE 64
+#define HOST_SERIAL_TX_BUFFER_SIZE 64
+
+// Realtime bytes, acted on by the receive interrupt as soon as they arrive
+// (also during moves). They never reach the command line buffer.
+#define REALTIME_STOP 0x18    // Ctrl-X: hard stop, latched until the C command
+#define REALTIME_HOLD '!'     // Feed hold: decelerate to rest, keep the rest of the move
+#define REALTIME_RESUME '~'   // Continue a held move
+
+// Longest command line accepted; longer lines are discarded with an error
+#define COMMAND_MAX_LENGTH 32
+#define COMMAND_BUFFER_SIZE (COMMAND_MAX_LENGTH + 1)  // Including the terminator
+
+// -------------------- MOTION TRACE --------------------
+// Ring buffer of motion samples, 7 bytes each (see MotionTrace.h)
+#define TRACE_BUFFER_SAMPLES 160
+#define TRACE_DEFAULT_DECIMATION 8      // Record every 8th step
+#define TRACE_POST_TRIGGER_SAMPLES 48   // Samples kept after a fault in fault mode
+
+// -------------------- MEMORY BUDGET --------------------
+// The firmware never uses the heap: all text is printed from flash with F()
+// and every buffer is a fixed-size static array sized in this header.
+// scripts/check_sram.py fails the build if static RAM (.data + .bss + .noinit,
+// which includes the HostSerial RX and TX buffers) plus the stack
+// reserve exceeds the budget, or if malloc or String is linked in.
+#define SRAM_BUDGET_BYTES 8192    // ATmega2560 internal SRAM
+#define STACK_RESERVE_BYTES 1024  // Deepest expected call chain plus interrupt frames
+
 #endif // CONFIG_H
\ No newline at end of file
@@ -7,12 +7,18 @@
 
 #include "EncoderInterface.h"
 #include "Config.h"
+#include "HostSerial.h"
 #include "PositionManager.h"
+#include "MotionState.h"
+#include "MotionTrace.h"
 
-// Encoder state variables
-volatile long encoderPosition = 0;
+// Encoder state variables (the count itself lives in MotionState)
 volatile bool lastA = LOW;
 volatile bool lastB = LOW;
+#if GANGED_X_AXIS
+volatile bool lastA2 = LOW;
+volatile bool lastB2 = LOW;
+#endif
 unsigned long lastPrintTime = 0;
 
 // Define encoder pins (these would be in Config.h, but adding here for compatibility)
@@ -36,6 +42,16 @@ void initializeEncoder() {
   // Initialize last states
   lastA = digitalRead(ENCODER_A_PIN);
   lastB = digitalRead(ENCODER_B_PIN);
+
+#if GANGED_X_AXIS
+  // Motor 2 encoder on its own interrupt pins
+  pinMode(ENCODER2_A_PIN, INPUT_PULLUP);
+  pinMode(ENCODER2_B_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(ENCODER2_A_PIN), readEncoder2, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(ENCODER2_B_PIN), readEncoder2, CHANGE);
+  lastA2 = digitalRead(ENCODER2_A_PIN);
+  lastB2 = digitalRead(ENCODER2_B_PIN);
+#endif
 }
 
 /**
@@ -57,10 +73,10 @@ void readEncoder() {
   // Quadrature decoding logic
   if (currentA != lastA) {
     // A changed
-    encoderPosition += (currentA == currentB) ? 1 : -1;
+    motionAddEncoderFromIsr((currentA == currentB) ? 1 : -1);
   } else if (currentB != lastB) {
     // B changed
-    encoderPosition += (currentA != currentB) ? 1 : -1;
+    motionAddEncoderFromIsr((currentA != currentB) ? 1 : -1);
   }
   
   // Save current states for next comparison
@@ -68,21 +84,58 @@ void readEncoder() {
   lastB = currentB;
 }
 
+#if GANGED_X_AXIS
+/**
+ * Read the motor 2 encoder signals and update its count
+ * Same decoding as readEncoder(); a mirrored motor 2 (DIR2_INVERTED) counts
+ * the other way, so both counts grow in the CCW direction.
+ */
+void readEncoder2() {
+  bool currentA = digitalRead(ENCODER2_A_PIN);
+  bool currentB = digitalRead(ENCODER2_B_PIN);
+  if (currentA == lastA2 && currentB == lastB2) return;
+
+  int8_t delta;
+  if (currentA != lastA2) {
+    delta = (currentA == currentB) ? 1 : -1;
+  } else {
+    delta = (currentA != currentB) ? 1 : -1;
+  }
+  motionAddEncoder2FromIsr(DIR2_INVERTED ? -delta : delta);
+
+  lastA2 = currentA;
+  lastB2 = currentB;
+}
+#endif
+
 /**
  * Get the current encoder position count
  * 
  * @return Current encoder position
  */
 long getEncoderPosition() {
-  return encoderPosition;
+  return readEncoderPosition();
+}
+
+/**
+ * Get the motor 2 encoder count
+ *
+ * @return Motor 2 encoder position (always 0 without GANGED_X_AXIS)
+ */
+long getEncoder2Position() {
+  MotionSnapshot state;
+  readMotionState(state);
+  return state.encoderPosition2;
 }
 
 /**
- * Reset encoder position to zero
+ * Reset encoder position to zero (both encoders on a ganged axis)
  * Useful when homing
  */
 void resetEncoderPosition() {
-  encoderPosition = 0;
+  motionSetEncoder(0);
+  motionSetEncoder2(0);
+  traceRebase();
 }
 
 /**
@@ -97,10 +150,16 @@ void printEncoderPosition() {
   
   // Only print every 100ms to avoid serial flooding
   if (now - lastPrintTime >= 100) {
-    Serial.print("Encoder: ");
-    Serial.print(encoderPosition);
-    Serial.print(" | Position: ");
-    Serial.println(getCurrentPosition());
+    MotionSnapshot state;
+    readMotionState(state);
+    HostSerial.print(F("Encoder: "));
+    HostSerial.print(state.encoderPosition);
+#if GANGED_X_AXIS
+    HostSerial.print(F(" | Encoder 2: "));
+    HostSerial.print(state.encoderPosition2);
+#endif
+    HostSerial.print(F(" | Position: "));
+    HostSerial.println(state.currentPosition);
     lastPrintTime = now;
   }
 }
\ No newline at end of file
@@ -22,6 +22,12 @@ void initializeEncoder();
  */
 void readEncoder();
 
+/**
+ * Read the motor 2 encoder signals and update its count
+ * Called by interrupt on a ganged X axis (GANGED_X_AXIS)
+ */
+void readEncoder2();
+
 /**
  * Get the current encoder position count
  * 
@@ -30,7 +36,14 @@ void readEncoder();
 long getEncoderPosition();
 
 /**
- * Reset encoder position to zero
+ * Get the motor 2 encoder count
+ *
+ * @return Motor 2 encoder position (always 0 without GANGED_X_AXIS)
+ */
+long getEncoder2Position();
+
+/**
+ * Reset encoder position to zero (both encoders on a ganged axis)
  * Useful when homing
  */
 void resetEncoderPosition();
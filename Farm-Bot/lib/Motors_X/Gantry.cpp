@@ -0,0 +1,94 @@
+/**
+ * Gantry.cpp
+ *
+ * Implementation of squaring and racking detection for a ganged X axis.
+ */
+
+#include "Gantry.h"
+
+#if GANGED_X_AXIS
+
+#include "HostSerial.h"
+#include "MotorControl.h"
+#include "LimitSwitch.h"
+#include "MotionState.h"
+#include "MotionTrace.h"
+#include "RealtimeControl.h"
+
+static uint8_t rackingCountdown = RACKING_CHECK_INTERVAL;
+
+/**
+ * Drive the trailing side onto its limit switch after the first switch closed
+ * The direction pins are left as the homing loop set them. The step counter
+ * is not updated; homing zeroes it once the gantry is square.
+ *
+ * @return FALSE if squaring failed or was stopped by an emergency stop
+ */
+bool squareGantry() {
+  uint8_t trailing = openLimitSides();
+  uint8_t firstTrailing = trailing;
+  int steps = 0;
+
+  while (trailing != 0) {
+    if (isEmergencyStopTriggered()) {
+      handleStopRequest();
+      HostSerial.println(F("Homing aborted by emergency stop"));
+      return false;
+    }
+    if (steps >= SQUARING_MAX_STEPS) {
+      HostSerial.println(F("ERROR: Gantry could not be squared"));
+      HostSerial.println(F("Check limit switch wiring or adjust SQUARING_MAX_STEPS"));
+      return false;
+    }
+
+    pulseMotors(trailing);
+    delayMicroseconds(MAX_STEP_DELAY - STEP_PULSE_US);
+    steps++;
+    trailing = openLimitSides();
+  }
+
+  HostSerial.print(F("Gantry squared: "));
+  if (firstTrailing == 0) {
+    HostSerial.println(F("both switches closed together"));
+  } else {
+    HostSerial.print(firstTrailing == MOTOR_1 ? F("side 1") : F("side 2"));
+    HostSerial.print(F(" trailed by "));
+    HostSerial.print(steps);
+    HostSerial.println(F(" steps"));
+  }
+  return true;
+}
+
+/**
+ * Encoder difference between the two sides
+ *
+ * @return Motor 1 encoder count minus motor 2 encoder count
+ */
+long getRacking() {
+  MotionSnapshot state;
+  readMotionState(state);
+  return state.encoderPosition - state.encoderPosition2;
+}
+
+/**
+ * Compare the two encoders every RACKING_CHECK_INTERVAL calls
+ * Between checks this costs one decrement, so the step rate of a ganged
+ * axis is the same as with a single motor.
+ *
+ * @return TRUE if the sides differ by more than RACKING_LIMIT_COUNTS
+ */
+bool checkRacking() {
+  if (RACKING_LIMIT_COUNTS == 0 || --rackingCountdown != 0) return false;
+  rackingCountdown = RACKING_CHECK_INTERVAL;
+
+  long racking = getRacking();
+  if (labs(racking) <= RACKING_LIMIT_COUNTS) return false;
+
+  HostSerial.print(F("RACKING DETECTED: sides differ by "));
+  HostSerial.print(racking);
+  HostSerial.println(F(" encoder counts, run homing (H) to square the gantry"));
+  traceFault(TRACE_TRIGGER_RACKING);
+  return true;
+}
+
+#endif // GANGED_X_AXIS
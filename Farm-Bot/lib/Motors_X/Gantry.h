@@ -0,0 +1,57 @@
+/**
+ * Gantry.h
+ *
+ * Header file for the ganged (dual-motor) X axis of the FarmBot X-Axis controller.
+ *
+ * With GANGED_X_AXIS set, the gantry is driven by one motor on each rail.
+ * Both motors receive every step pulse together (see pulseMotors()), so the
+ * gantry stays square as long as neither motor loses steps. Homing squares
+ * it first: once either home switch closes, only the side whose switch is
+ * still open keeps stepping until both are closed. During moves the two
+ * encoder counts are compared every RACKING_CHECK_INTERVAL steps; a
+ * difference above RACKING_LIMIT_COUNTS stops the move like a limit switch.
+ *
+ * Without GANGED_X_AXIS these functions do nothing and cost nothing.
+ */
+
+#ifndef GANTRY_H
+#define GANTRY_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+#if GANGED_X_AXIS
+
+/**
+ * Drive the trailing side onto its limit switch after the first switch closed
+ * Prints "Gantry squared" on success, or an error ending with
+ * "Check limit switch wiring" if the sides are more than SQUARING_MAX_STEPS apart.
+ *
+ * @return FALSE if squaring failed or was stopped by an emergency stop
+ */
+bool squareGantry();
+
+/**
+ * Compare the two encoders every RACKING_CHECK_INTERVAL calls
+ * Called once per step from the move loops.
+ *
+ * @return TRUE if the sides differ by more than RACKING_LIMIT_COUNTS
+ */
+bool checkRacking();
+
+/**
+ * Encoder difference between the two sides
+ *
+ * @return Motor 1 encoder count minus motor 2 encoder count
+ */
+long getRacking();
+
+#else
+
+inline bool squareGantry() { return true; }
+inline bool checkRacking() { return false; }
+inline long getRacking() { return 0; }
+
+#endif // GANGED_X_AXIS
+
+#endif // GANTRY_H
@@ -0,0 +1,131 @@
+/**
+ * HostSerial.cpp
+ *
+ * Implementation of the interrupt-driven USART0 driver.
+ */
+
+#include "HostSerial.h"
+#include "Config.h"
+#include "RealtimeControl.h"
+#include <util/atomic.h>
+
+#define RX_MASK (HOST_SERIAL_RX_BUFFER_SIZE - 1)
+#define TX_MASK (HOST_SERIAL_TX_BUFFER_SIZE - 1)
+
+static_assert(HOST_SERIAL_RX_BUFFER_SIZE <= 256 && (HOST_SERIAL_RX_BUFFER_SIZE & RX_MASK) == 0,
+              "HOST_SERIAL_RX_BUFFER_SIZE must be a power of two up to 256");
+static_assert(HOST_SERIAL_TX_BUFFER_SIZE <= 256 && (HOST_SERIAL_TX_BUFFER_SIZE & TX_MASK) == 0,
+              "HOST_SERIAL_TX_BUFFER_SIZE must be a power of two up to 256");
+
+// Ring buffers: head is written by the producer, tail by the consumer
+static uint8_t rxBuffer[HOST_SERIAL_RX_BUFFER_SIZE];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+static uint8_t txBuffer[HOST_SERIAL_TX_BUFFER_SIZE];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+
+HostSerialPort HostSerial;
+
+/**
+ * Move the next queued byte into the data register
+ * Called by the interrupt, or by write() when interrupts are disabled.
+ */
+static void sendNextByte() {
+  uint8_t tail = txTail;
+  UDR0 = txBuffer[tail];
+  tail = (tail + 1) & TX_MASK;
+  txTail = tail;
+  if (tail == txHead) UCSR0B &= ~(1 << UDRIE0);  // Nothing left to send
+}
+
+/**
+ * Byte received
+ * Realtime bytes are handled here and never buffered; other bytes are
+ * dropped when the buffer is full, like HardwareSerial.
+ */
+ISR(USART0_RX_vect) {
+  uint8_t status = UCSR0A;
+  uint8_t byte = UDR0;
+  if (status & (1 << UPE0)) return;  // Parity error
+
+  if (isRealtimeByte(byte)) {
+    realtimeByteReceived(byte);
+    return;
+  }
+
+  uint8_t head = rxHead;
+  uint8_t next = (head + 1) & RX_MASK;
+  if (next != rxTail) {
+    rxBuffer[head] = byte;
+    rxHead = next;
+  }
+}
+
+/**
+ * Data register empty
+ */
+ISR(USART0_UDRE_vect) {
+  sendNextByte();
+}
+
+/**
+ * Set up USART0 for 8N1 at the given rate and enable its interrupts
+ *
+ * @param baud Baud rate (double speed mode, like HardwareSerial)
+ */
+void HostSerialPort::begin(unsigned long baud) {
+  uint16_t setting = (F_CPU / 4 / baud - 1) / 2;
+  UCSR0A = 1 << U2X0;
+  UBRR0 = setting;
+  UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+  UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+}
+
+/**
+ * Number of received bytes waiting to be read
+ */
+int HostSerialPort::available() {
+  return (uint8_t)(rxHead - rxTail) & RX_MASK;
+}
+
+/**
+ * Take the next received byte
+ *
+ * @return Byte value, or -1 if nothing was received
+ */
+int HostSerialPort::read() {
+  uint8_t tail = rxTail;
+  if (tail == rxHead) return -1;
+  uint8_t byte = rxBuffer[tail];
+  rxTail = (tail + 1) & RX_MASK;
+  return byte;
+}
+
+/**
+ * Queue one byte for sending
+ * Waits while the transmit buffer is full. With interrupts disabled the
+ * buffer is drained by polling, so printing never deadlocks.
+ *
+ * @param byte Byte to send
+ * @return 1
+ */
+size_t HostSerialPort::write(uint8_t byte) {
+  // Nothing queued and the data register is free: send directly
+  if (txHead == txTail && (UCSR0A & (1 << UDRE0))) {
+    UDR0 = byte;
+    return 1;
+  }
+
+  uint8_t next = (txHead + 1) & TX_MASK;
+  while (next == txTail) {
+    if (!(SREG & (1 << SREG_I)) && (UCSR0A & (1 << UDRE0))) sendNextByte();
+  }
+
+  txBuffer[txHead] = byte;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    txHead = next;
+    UCSR0B |= (1 << UDRIE0);
+  }
+  return 1;
+}
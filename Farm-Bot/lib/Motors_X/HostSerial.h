@@ -0,0 +1,56 @@
+/**
+ * HostSerial.h
+ *
+ * Header file for the USART0 driver of the FarmBot X-Axis controller.
+ *
+ * Replaces the Arduino Serial object so the receive interrupt can act on
+ * realtime bytes (REALTIME_STOP, REALTIME_HOLD, REALTIME_RESUME in Config.h)
+ * the moment they arrive, even while moveSteps() keeps the main loop busy.
+ * All other bytes go into a ring buffer and are read by the command parser
+ * as before. Output is buffered and sent by the data-register-empty interrupt.
+ *
+ * Printing works like Serial (print, println, F() strings) because the class
+ * derives from Print. Nothing may use Serial at the same time: referencing it
+ * links the core's own USART0 interrupt handlers.
+ */
+
+#ifndef HOST_SERIAL_H
+#define HOST_SERIAL_H
+
+#include <Arduino.h>
+
+class HostSerialPort : public Print {
+public:
+  /**
+   * Set up USART0 for 8N1 at the given rate and enable its interrupts
+   *
+   * @param baud Baud rate (double speed mode, like HardwareSerial)
+   */
+  void begin(unsigned long baud);
+
+  /**
+   * Number of received bytes waiting to be read
+   */
+  int available();
+
+  /**
+   * Take the next received byte
+   *
+   * @return Byte value, or -1 if nothing was received
+   */
+  int read();
+
+  /**
+   * Queue one byte for sending
+   * Waits while the transmit buffer is full.
+   *
+   * @param byte Byte to send
+   * @return 1
+   */
+  virtual size_t write(uint8_t byte);
+  using Print::write;
+};
+
+extern HostSerialPort HostSerial;
+
+#endif // HOST_SERIAL_H
@@ -6,8 +6,10 @@
 
 #include "LimitSwitch.h"
 #include "Config.h"
+#include "HostSerial.h"
 #include "MotorControl.h"
 #include "PositionManager.h"
+#include "MotionTrace.h"
 
 /**
  * Initialize the limit switch pin
@@ -15,6 +17,33 @@
 void initializeLimitSwitch() {
   // Set up limit switch pin with pull-up resistor
   pinMode(LIMIT_X_PIN, INPUT_PULLUP);
+#if GANGED_X_AXIS
+  pinMode(LIMIT_X2_PIN, INPUT_PULLUP);
+#endif
+}
+
+/**
+ * Read the limit switch (LOW when triggered)
+ * On a ganged X axis either side's switch counts.
+ *
+ * @return TRUE if a limit switch is pressed
+ */
+bool isLimitPressed() {
+  return openLimitSides() != MOTORS_ALL;
+}
+
+/**
+ * Find the motors whose own limit switch is not pressed
+ *
+ * @return MOTOR_1 and/or MOTOR_2 bits (MOTOR_1 only without GANGED_X_AXIS)
+ */
+uint8_t openLimitSides() {
+  uint8_t open = 0;
+  if (digitalRead(LIMIT_X_PIN) == HIGH) open |= MOTOR_1;
+#if GANGED_X_AXIS
+  if (digitalRead(LIMIT_X2_PIN) == HIGH) open |= MOTOR_2;
+#endif
+  return open;
 }
 
 /**
@@ -25,19 +54,20 @@ void initializeLimitSwitch() {
  */
 bool checkLimitSwitch(bool direction) {
   // Check if limit switch is pressed (LOW when triggered)
-  if (digitalRead(LIMIT_X_PIN) == LOW) {
-    Serial.println("LIMIT SWITCH PRESSED!");
+  if (isLimitPressed()) {
+    HostSerial.println(F("LIMIT SWITCH PRESSED!"));
+    traceFault(TRACE_TRIGGER_LIMIT);
     
     // Handle differently depending on direction
     if (!direction) { // CW direction (HOME_DIRECTION) -> hitting home position
       // Set home position
       setCurrentPosition(0);
-      Serial.println("Home position (0) set");
+      HostSerial.println(F("Home position (0) set"));
     } else { // CCW direction (opposite of HOME_DIRECTION) -> hitting far limit
       // Update maximum position
       setMaxPosition(getCurrentPosition());
-      Serial.print("Maximum position updated to: ");
-      Serial.println(getMaxPosition());
+      HostSerial.print(F("Maximum position updated to: "));
+      HostSerial.println(getMaxPosition());
     }
     
     // Back off from the limit switch
@@ -54,10 +84,11 @@ bool checkLimitSwitch(bool direction) {
  * @param direction Direction to back off (opposite of trigger direction)
  */
 void backOffFromLimit(bool direction) {
-  Serial.println("Backing off from limit...");
+  HostSerial.println(F("Backing off from limit..."));
   
   // Set direction to move away from the limit
   setDirection(direction);
+  traceSetPhase(TRACE_PHASE_NONE);
   
   // Disable acceleration for backing off
   for (int i = 0; i < BACKOFF_STEPS; i++) {
@@ -65,5 +96,5 @@ void backOffFromLimit(bool direction) {
     stepMotor(MAX_STEP_DELAY, direction);
   }
   
-  Serial.println("Backed off from limit");
+  HostSerial.println(F("Backed off from limit"));
 }
\ No newline at end of file
@@ -14,6 +14,22 @@
  */
 void initializeLimitSwitch();
 
+/**
+ * Read the limit switch (LOW when triggered)
+ * On a ganged X axis either side's switch counts.
+ *
+ * @return TRUE if a limit switch is pressed
+ */
+bool isLimitPressed();
+
+/**
+ * Find the motors whose own limit switch is not pressed
+ * Used to square a ganged axis against its switches.
+ *
+ * @return MOTOR_1 and/or MOTOR_2 bits (MOTOR_1 only without GANGED_X_AXIS)
+ */
+uint8_t openLimitSides();
+
 /**
  * Check if the limit switch is currently triggered
  * 
@@ -0,0 +1,85 @@
+/**
+ * MemoryMonitor.cpp
+ *
+ * Implementation of stack painting and SRAM usage reporting
+ * for the FarmBot X-Axis controller.
+ */
+
+#include "MemoryMonitor.h"
+#include "Config.h"
+#include "HostSerial.h"
+
+#define STACK_PAINT 0xC5  // Unlikely to be written by real stack frames
+
+// Linker symbols: end of static data (start of the unused heap) and top of SRAM
+extern uint8_t __heap_start;
+extern uint8_t __stack;
+
+/**
+ * Fill all free SRAM with STACK_PAINT
+ * Placed in .init3 so it runs after the zero register is set up and before
+ * static data is initialized; nothing is on the stack yet at that point.
+ * Naked: it is not called, the startup code falls through it.
+ */
+void paintStack() __attribute__((naked, used, section(".init3")));
+
+void paintStack() {
+  uint8_t *p = &__heap_start;
+  while (p <= &__stack) {
+    *p = STACK_PAINT;
+    p++;
+  }
+}
+
+/**
+ * Get the size of static data (.data + .bss + .noinit)
+ *
+ * @return Bytes of SRAM used by global and static variables
+ */
+unsigned int getStaticRamBytes() {
+  return (unsigned int)(&__heap_start - (uint8_t *)RAMSTART);
+}
+
+/**
+ * Get the SRAM that has never been touched since reset
+ *
+ * @return Bytes between static data and the stack high-water mark
+ */
+unsigned int getUntouchedRamBytes() {
+  const uint8_t *p = &__heap_start;
+  while (p <= &__stack && *p == STACK_PAINT) p++;
+  return (unsigned int)(p - &__heap_start);
+}
+
+/**
+ * Get the deepest stack use since reset
+ *
+ * @return Bytes of stack used at the high-water mark
+ */
+unsigned int getStackHighWater() {
+  return (unsigned int)(&__stack - &__heap_start + 1) - getUntouchedRamBytes();
+}
+
+/**
+ * Print static RAM, stack high-water mark and remaining margin
+ * Warns when the stack has grown past STACK_RESERVE_BYTES.
+ */
+void printMemoryReport() {
+  unsigned int stackUsed = getStackHighWater();
+  HostSerial.print(F("Static RAM: "));
+  HostSerial.print(getStaticRamBytes());
+  HostSerial.print(F(" of "));
+  HostSerial.print(SRAM_BUDGET_BYTES);
+  HostSerial.println(F(" bytes"));
+  HostSerial.print(F("Stack high-water: "));
+  HostSerial.print(stackUsed);
+  HostSerial.print(F(" of "));
+  HostSerial.print(STACK_RESERVE_BYTES);
+  HostSerial.println(F(" bytes reserved"));
+  HostSerial.print(F("Never used RAM: "));
+  HostSerial.print(getUntouchedRamBytes());
+  HostSerial.println(F(" bytes"));
+  if (stackUsed > STACK_RESERVE_BYTES) {
+    HostSerial.println(F("WARNING: Stack exceeded its reserve, raise STACK_RESERVE_BYTES"));
+  }
+}
@@ -0,0 +1,42 @@
+/**
+ * MemoryMonitor.h
+ *
+ * Header file for SRAM usage reporting in the FarmBot X-Axis controller.
+ * The free RAM between static data and the stack is painted with a known
+ * byte before setup() runs; the deepest the stack has ever reached is found
+ * later by looking for the first overwritten byte.
+ */
+
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+#include <Arduino.h>
+
+/**
+ * Get the size of static data (.data + .bss + .noinit)
+ *
+ * @return Bytes of SRAM used by global and static variables
+ */
+unsigned int getStaticRamBytes();
+
+/**
+ * Get the deepest stack use since reset
+ *
+ * @return Bytes of stack used at the high-water mark
+ */
+unsigned int getStackHighWater();
+
+/**
+ * Get the SRAM that has never been touched since reset
+ *
+ * @return Bytes between static data and the stack high-water mark
+ */
+unsigned int getUntouchedRamBytes();
+
+/**
+ * Print static RAM, stack high-water mark and remaining margin
+ * Warns when the stack has grown past STACK_RESERVE_BYTES.
+ */
+void printMemoryReport();
+
+#endif // MEMORY_MONITOR_H
@@ -0,0 +1,123 @@
+/**
+ * MotionState.cpp
+ *
+ * Implementation of the sequence-locked motion state.
+ */
+
+#include "MotionState.h"
+
+// Shared motion state, starts at position 0 with no flags
+MotionStateShared motionState = { 0, 0, 0, 0, 0 };
+
+/**
+ * Set the step counter
+ *
+ * @param position New position value
+ */
+void motionSetPosition(long position) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    motionState.sequence++;
+    motionState.currentPosition = position;
+    motionState.sequence++;
+  }
+}
+
+/**
+ * Set the encoder count
+ *
+ * @param count New encoder value
+ */
+void motionSetEncoder(long count) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    motionState.sequence++;
+    motionState.encoderPosition = count;
+    motionState.sequence++;
+  }
+}
+
+/**
+ * Set the motor 2 encoder count
+ *
+ * @param count New encoder value
+ */
+void motionSetEncoder2(long count) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    motionState.sequence++;
+    motionState.encoderPosition2 = count;
+    motionState.sequence++;
+  }
+}
+
+/**
+ * Set flag bits
+ *
+ * @param bits MOTION_FLAG_* bits to set
+ */
+void motionSetFlags(uint8_t bits) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    motionState.sequence++;
+    motionState.flags |= bits;
+    motionState.sequence++;
+  }
+}
+
+/**
+ * Clear flag bits
+ *
+ * @param bits MOTION_FLAG_* bits to clear
+ */
+void motionClearFlags(uint8_t bits) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    motionState.sequence++;
+    motionState.flags &= ~bits;
+    motionState.sequence++;
+  }
+}
+
+/**
+ * Copy the whole motion state consistently
+ * Retries while an interrupt updated the state during the copy.
+ *
+ * @param snapshot Receives the state
+ */
+void readMotionState(MotionSnapshot &snapshot) {
+  uint8_t start;
+  do {
+    start = motionState.sequence;
+    snapshot.encoderPosition = motionState.encoderPosition;
+    snapshot.encoderPosition2 = motionState.encoderPosition2;
+    snapshot.currentPosition = motionState.currentPosition;
+    snapshot.flags = motionState.flags;
+  } while ((start & 1) || motionState.sequence != start);
+  snapshot.generation = start;
+}
+
+/**
+ * Read the encoder count without tearing
+ *
+ * @return Current encoder count
+ */
+long readEncoderPosition() {
+  uint8_t start;
+  long value;
+  do {
+    start = motionState.sequence;
+    value = motionState.encoderPosition;
+  } while ((start & 1) || motionState.sequence != start);
+  return value;
+}
+
+/**
+ * Read the step counter without tearing
+ *
+ * @return Current step position
+ */
+long readCurrentPosition() {
+  uint8_t start;
+  long value;
+  do {
+    start = motionState.sequence;
+    value = motionState.currentPosition;
+  } while ((start & 1) || motionState.sequence != start);
+  return value;
+}
@@ -0,0 +1,193 @@
+/**
+ * MotionState.h
+ *
+ * Header file for the motion state shared between interrupts and the main loop.
+ *
+ * Encoder counts, step position and motion flags are published through one
+ * sequence lock. A long is four bytes on the AVR, so a plain read can see
+ * half of an update made by an interrupt. Writers make the sequence odd,
+ * change the fields and make it even again; readers copy the fields and try
+ * again if the sequence was odd or changed during the copy. Readers never
+ * disable interrupts.
+ *
+ * Writers never overlap: interrupt handlers run with interrupts disabled,
+ * and main-loop writers use a short ATOMIC_BLOCK of a few instructions.
+ * Because of that, an interrupt handler never sees a write in progress and
+ * may call the read functions as well.
+ */
+
+#ifndef MOTION_STATE_H
+#define MOTION_STATE_H
+
+#include <Arduino.h>
+#include <util/atomic.h>
+
+// Bits in MotionSnapshot::flags
+#define MOTION_FLAG_ESTOP 0x01   // Emergency stop requested, motion must end
+#define MOTION_FLAG_MOVING 0x02  // A move or homing sequence is running
+#define MOTION_FLAG_HOLD 0x04    // Feed hold requested, the move decelerates and waits
+
+/**
+ * Consistent copy of the shared motion state
+ */
+struct MotionSnapshot {
+  long encoderPosition;   // Quadrature count from the encoder interrupt
+  long encoderPosition2;  // Motor 2 encoder count (ganged X axis only)
+  long currentPosition;   // Step counter
+  uint8_t flags;          // MOTION_FLAG_* bits
+  uint8_t generation;     // Advances with every update (wraps after 128 updates)
+};
+
+/**
+ * Storage behind the sequence lock; use the functions below, not the fields
+ */
+struct MotionStateShared {
+  volatile uint8_t sequence;  // Odd while a write is in progress
+  volatile long encoderPosition;
+  volatile long encoderPosition2;
+  volatile long currentPosition;
+  volatile uint8_t flags;
+};
+
+extern MotionStateShared motionState;
+
+// -------------------- WRITERS: INTERRUPT HANDLERS --------------------
+
+/**
+ * Add to the encoder count (interrupts are already disabled)
+ *
+ * @param delta Counts to add
+ */
+inline void motionAddEncoderFromIsr(int8_t delta) {
+  motionState.sequence++;
+  motionState.encoderPosition += delta;
+  motionState.sequence++;
+}
+
+/**
+ * Add to the motor 2 encoder count (interrupts are already disabled)
+ *
+ * @param delta Counts to add
+ */
+inline void motionAddEncoder2FromIsr(int8_t delta) {
+  motionState.sequence++;
+  motionState.encoderPosition2 += delta;
+  motionState.sequence++;
+}
+
+/**
+ * Set flag bits (interrupts are already disabled)
+ *
+ * @param bits MOTION_FLAG_* bits to set
+ */
+inline void motionSetFlagsFromIsr(uint8_t bits) {
+  motionState.sequence++;
+  motionState.flags |= bits;
+  motionState.sequence++;
+}
+
+/**
+ * Clear flag bits (interrupts are already disabled)
+ *
+ * @param bits MOTION_FLAG_* bits to clear
+ */
+inline void motionClearFlagsFromIsr(uint8_t bits) {
+  motionState.sequence++;
+  motionState.flags &= ~bits;
+  motionState.sequence++;
+}
+
+// -------------------- WRITERS: MAIN LOOP --------------------
+
+/**
+ * Add to the step counter
+ *
+ * @param steps Steps to add (positive or negative)
+ */
+inline void motionAddPosition(long steps) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    motionState.sequence++;
+    motionState.currentPosition += steps;
+    motionState.sequence++;
+  }
+}
+
+/**
+ * Set the step counter
+ *
+ * @param position New position value
+ */
+void motionSetPosition(long position);
+
+/**
+ * Set the encoder count
+ *
+ * @param count New encoder value
+ */
+void motionSetEncoder(long count);
+
+/**
+ * Set the motor 2 encoder count
+ *
+ * @param count New encoder value
+ */
+void motionSetEncoder2(long count);
+
+/**
+ * Set flag bits
+ *
+ * @param bits MOTION_FLAG_* bits to set
+ */
+void motionSetFlags(uint8_t bits);
+
+/**
+ * Clear flag bits
+ *
+ * @param bits MOTION_FLAG_* bits to clear
+ */
+void motionClearFlags(uint8_t bits);
+
+// -------------------- READERS --------------------
+
+/**
+ * Copy the whole motion state consistently
+ *
+ * @param snapshot Receives the state
+ */
+void readMotionState(MotionSnapshot &snapshot);
+
+/**
+ * Read the encoder count without tearing
+ *
+ * @return Current encoder count
+ */
+long readEncoderPosition();
+
+/**
+ * Read the step counter without tearing
+ *
+ * @return Current step position
+ */
+long readCurrentPosition();
+
+/**
+ * Check whether an emergency stop was requested
+ * A single byte read, cheap enough for every step.
+ *
+ * @return TRUE if MOTION_FLAG_ESTOP is set
+ */
+inline bool isEmergencyStopTriggered() {
+  return (motionState.flags & MOTION_FLAG_ESTOP) != 0;
+}
+
+/**
+ * Check whether a feed hold was requested
+ * A single byte read, cheap enough for every step.
+ *
+ * @return TRUE if MOTION_FLAG_HOLD is set
+ */
+inline bool isFeedHoldRequested() {
+  return (motionState.flags & MOTION_FLAG_HOLD) != 0;
+}
+
+#endif // MOTION_STATE_H
@@ -0,0 +1,295 @@
+/**
+ * MotionTrace.cpp
+ *
+ * Implementation of the motion trace ring buffer and its serial dump.
+ */
+
+#include "MotionTrace.h"
+#include "Config.h"
+#include "HostSerial.h"
+#include "MotionState.h"
+#include "SpeedProfile.h"
+#include "LimitSwitch.h"
+
+// Recorder states
+#define TRACE_OFF 0
+#define TRACE_ARMED 1      // Waiting for the next move
+#define TRACE_RECORDING 2
+#define TRACE_DONE 3       // Frozen until re-armed or dumped
+
+static TraceSample traceSamples[TRACE_BUFFER_SAMPLES];
+static uint8_t traceHead = 0;     // Next slot to write
+static uint8_t traceCount = 0;
+static uint8_t traceState = TRACE_OFF;
+static bool traceFaultMode = false;
+static uint16_t traceDecimation = TRACE_DEFAULT_DECIMATION;
+
+static uint8_t traceTrigger = TRACE_TRIGGER_NONE;
+static uint16_t traceRecorded = 0;      // Samples recorded since arming (wraps)
+static uint16_t traceTriggerRecord = 0; // Value of traceRecorded at the fault
+static uint8_t tracePostRemaining = 0;
+
+static uint8_t traceMoveFlags = 0;      // Direction and phase bits of the current move
+static uint8_t tracePendingFlags = 0;   // Added to the next sample
+static unsigned long traceLastTime = 0;
+static long traceLastPosition = 0;
+static long traceLastEncoder = 0;
+static long traceBasePosition = 0;
+static long traceBaseEncoder = 0;
+
+uint16_t traceCountdown = 0;
+
+static int16_t clampDelta(long delta) {
+  if (delta > 32767) return 32767;
+  if (delta < -32768) return -32768;
+  return (int16_t)delta;
+}
+
+/**
+ * Start a fresh recording
+ */
+static void traceReset(bool faultMode) {
+  traceHead = 0;
+  traceCount = 0;
+  traceFaultMode = faultMode;
+  traceTrigger = faultMode ? TRACE_TRIGGER_NONE : TRACE_TRIGGER_COMMAND;
+  traceRecorded = 0;
+  tracePostRemaining = 0;
+  traceCountdown = 0;
+}
+
+/**
+ * Record a sample (called when traceCountdown reaches zero)
+ *
+ * @param extraFlags TRACE_FLAG_* bits to add to this sample
+ */
+void traceRecord(uint8_t extraFlags) {
+  if (traceState != TRACE_RECORDING) {
+    traceCountdown = 0;
+    return;
+  }
+
+  MotionSnapshot state;
+  readMotionState(state);
+  unsigned long units = (micros() - traceLastTime) / TRACE_TIME_UNIT_US;
+  traceLastTime += units * TRACE_TIME_UNIT_US;  // Keep the remainder for the next sample
+
+  // A full ring drops its oldest sample (fault mode only)
+  if (traceCount == TRACE_BUFFER_SAMPLES) {
+    const TraceSample &oldest = traceSamples[traceHead];
+    traceBasePosition += oldest.stepDelta;
+    traceBaseEncoder += oldest.encoderDelta;
+    traceCount--;
+  }
+
+  TraceSample &sample = traceSamples[traceHead];
+  sample.dt = units > 0xFFFF ? 0xFFFF : (uint16_t)units;
+  sample.stepDelta = clampDelta(state.currentPosition - traceLastPosition);
+  sample.encoderDelta = clampDelta(state.encoderPosition - traceLastEncoder);
+  sample.flags = (state.flags & (MOTION_FLAG_ESTOP | MOTION_FLAG_MOVING)) | traceMoveFlags |
+                 tracePendingFlags | extraFlags;
+  if (isLimitPressed()) sample.flags |= TRACE_FLAG_LIMIT;
+  tracePendingFlags = 0;
+  traceLastPosition = state.currentPosition;
+  traceLastEncoder = state.encoderPosition;
+
+  traceHead = (traceHead + 1) % TRACE_BUFFER_SAMPLES;
+  traceCount++;
+  traceRecorded++;
+  traceCountdown = traceDecimation;
+
+  if (tracePostRemaining && --tracePostRemaining == 0) {
+    traceState = TRACE_DONE;
+    traceCountdown = 0;
+  } else if (!traceFaultMode && traceCount == TRACE_BUFFER_SAMPLES) {
+    traceState = TRACE_DONE;
+    traceCountdown = 0;
+  }
+}
+
+/**
+ * Mark the start of a move (records its first sample if armed)
+ *
+ * @param direction Direction of the move (TRUE = CCW)
+ */
+void traceMoveStart(bool direction) {
+  if (traceState == TRACE_ARMED) {
+    MotionSnapshot state;
+    readMotionState(state);
+    traceBasePosition = traceLastPosition = state.currentPosition;
+    traceBaseEncoder = traceLastEncoder = state.encoderPosition;
+    traceState = TRACE_RECORDING;
+  } else if (traceState != TRACE_RECORDING) {
+    return;
+  }
+  traceLastTime = micros();
+  traceMoveFlags = direction ? TRACE_FLAG_FORWARD : 0;
+  traceRecord(TRACE_FLAG_MOVE_START);
+}
+
+/**
+ * Mark the end of a move (records its last sample)
+ */
+void traceMoveEnd() {
+  if (traceState != TRACE_RECORDING) return;
+  traceRecord(0);
+  traceCountdown = 0;  // Nothing to sample between moves
+  if (!traceFaultMode) traceState = TRACE_DONE;
+}
+
+/**
+ * Set the speed profile phase stored in the following samples
+ *
+ * @param phase TracePhase value
+ */
+void traceSetPhase(uint8_t phase) {
+  traceMoveFlags = (traceMoveFlags & ~TRACE_FLAG_PHASE_MASK) |
+                   ((phase << TRACE_FLAG_PHASE_SHIFT) & TRACE_FLAG_PHASE_MASK);
+}
+
+/**
+ * Report a fault that interrupted a move
+ *
+ * @param trigger TRACE_TRIGGER_LIMIT, TRACE_TRIGGER_ESTOP or TRACE_TRIGGER_RACKING
+ */
+void traceFault(uint8_t trigger) {
+  if (traceState != TRACE_RECORDING || tracePostRemaining) return;
+  if (traceTrigger != TRACE_TRIGGER_NONE && traceTrigger != TRACE_TRIGGER_COMMAND) return;
+  traceTrigger = trigger;
+  traceTriggerRecord = traceRecorded;
+  traceRecord(0);
+  if (traceFaultMode && traceState == TRACE_RECORDING) tracePostRemaining = TRACE_POST_TRIGGER_SAMPLES;
+}
+
+/**
+ * Note that the step position or encoder count was re-zeroed
+ * Keeps the jump out of the sample deltas.
+ */
+void traceRebase() {
+  if (traceState != TRACE_RECORDING) return;
+  MotionSnapshot state;
+  readMotionState(state);
+  traceLastPosition = state.currentPosition;
+  traceLastEncoder = state.encoderPosition;
+  tracePendingFlags |= TRACE_FLAG_REBASE;
+}
+
+static const __FlashStringHelper *traceStateName() {
+  switch (traceState) {
+    case TRACE_ARMED: return F("armed");
+    case TRACE_RECORDING: return F("recording");
+    case TRACE_DONE: return F("done");
+    default: return F("off");
+  }
+}
+
+/**
+ * Write the trace in the binary format described in MotionTrace.h
+ */
+static void dumpTrace() {
+  TraceHeader header;
+  memcpy(header.magic, "MTRC", 4);
+  header.version = 1;
+  header.timeUnitMicros = TRACE_TIME_UNIT_US;
+  header.decimation = traceDecimation;
+  header.count = traceCount;
+  header.trigger = traceTrigger;
+  header.faultMode = traceFaultMode ? 1 : 0;
+  uint16_t firstRecord = traceRecorded - traceCount;
+  bool triggered = traceTrigger >= TRACE_TRIGGER_LIMIT;
+  uint16_t triggerIndex = traceTriggerRecord - firstRecord;
+  header.triggerIndex = (triggered && triggerIndex < traceCount) ? triggerIndex : 0xFFFF;
+  header.basePosition = traceBasePosition;
+  header.baseEncoder = traceBaseEncoder;
+  const SpeedProfile &profile = getSpeedProfile();
+  header.minStepDelay = profile.minStepDelay;
+  header.maxStepDelay = profile.maxStepDelay;
+  header.accelRate = profile.accelRate;
+  header.decelRate = profile.decelRate;
+
+  uint16_t total = sizeof(TraceHeader) + traceCount * sizeof(TraceSample);
+  HostSerial.print(F("TRACE BEGIN "));
+  HostSerial.println(total + 2);
+
+  uint16_t sum = 0;
+  const uint8_t *bytes = (const uint8_t *)&header;
+  for (uint8_t i = 0; i < sizeof(TraceHeader); i++) {
+    sum += bytes[i];
+    HostSerial.write(bytes[i]);
+  }
+  uint8_t index = (traceHead + TRACE_BUFFER_SAMPLES - traceCount) % TRACE_BUFFER_SAMPLES;
+  for (uint8_t n = 0; n < traceCount; n++) {
+    bytes = (const uint8_t *)&traceSamples[index];
+    for (uint8_t i = 0; i < sizeof(TraceSample); i++) {
+      sum += bytes[i];
+      HostSerial.write(bytes[i]);
+    }
+    index = (index + 1) % TRACE_BUFFER_SAMPLES;
+  }
+  HostSerial.write((uint8_t)(sum & 0xFF));
+  HostSerial.write((uint8_t)(sum >> 8));
+  HostSerial.println();
+  HostSerial.println(F("TRACE END"));
+}
+
+static void printArmed() {
+  HostSerial.print(F(" (every "));
+  HostSerial.print(traceDecimation);
+  HostSerial.print(F(" steps, "));
+  HostSerial.print(TRACE_BUFFER_SAMPLES);
+  HostSerial.println(F(" samples)"));
+}
+
+/**
+ * Handle a trace command (the text after the leading T)
+ * Every reply ends with a line starting "Trace " or with "TRACE END".
+ *
+ * @param args "", "F", "O", "N<steps>", "S" or "D"
+ */
+void processTraceCommand(const char *args) {
+  switch (args[0]) {
+    case '\0':
+      traceReset(false);
+      traceState = TRACE_ARMED;
+      HostSerial.print(F("Trace armed for next move"));
+      printArmed();
+      break;
+    case 'F':
+      traceReset(true);
+      traceState = TRACE_ARMED;
+      HostSerial.print(F("Trace armed for faults"));
+      printArmed();
+      break;
+    case 'O':
+      traceState = TRACE_OFF;
+      traceCountdown = 0;
+      HostSerial.println(F("Trace off"));
+      break;
+    case 'N': {
+      long steps = atol(args + 1);
+      if (steps < 1) steps = 1;
+      if (steps > 1000) steps = 1000;
+      traceDecimation = (uint16_t)steps;
+      HostSerial.print(F("Trace decimation: "));
+      HostSerial.println(traceDecimation);
+      break;
+    }
+    case 'S':
+      HostSerial.print(F("Trace state: "));
+      HostSerial.print(traceStateName());
+      HostSerial.print(F(", "));
+      HostSerial.print(traceCount);
+      HostSerial.println(F(" samples"));
+      break;
+    case 'D':
+      if (traceCount == 0) {
+        HostSerial.println(F("Trace empty"));
+      } else {
+        dumpTrace();
+      }
+      break;
+    default:
+      HostSerial.println(F("Trace commands: T, TF, TO, TN<steps>, TS, TD"));
+      break;
+  }
+}
@@ -0,0 +1,141 @@
+/**
+ * MotionTrace.h
+ *
+ * Header file for the motion trace recorder of the FarmBot X-Axis controller.
+ *
+ * While armed, every TRACE decimation-th step stores a 7-byte sample (time
+ * since the previous sample, step and encoder change, flags) in a RAM ring
+ * buffer. Recording costs one counter decrement per step and a few
+ * microseconds per sample, so it can stay armed during normal operation.
+ *
+ * Trigger modes:
+ *   T   record the next move from its start until it ends or the buffer is full
+ *   TF  record continuously; when a limit switch, emergency stop or racking
+ *       check interrupts a move, keep TRACE_POST_TRIGGER_SAMPLES more samples and freeze
+ *
+ * TD dumps the trace as "TRACE BEGIN <bytes>", the raw bytes, then "TRACE END".
+ * Binary layout (little-endian, as stored on the AVR):
+ *   TraceHeader, then count x TraceSample oldest first,
+ *   then a uint16 sum of all preceding bytes
+ */
+
+#ifndef MOTION_TRACE_H
+#define MOTION_TRACE_H
+
+#include <Arduino.h>
+
+#define TRACE_TIME_UNIT_US 4  // micros() resolution at 16 MHz
+
+// Bits in TraceSample::flags. Bits 0-1 are MOTION_FLAG_ESTOP and MOTION_FLAG_MOVING.
+#define TRACE_FLAG_FORWARD 0x04     // Moving in the CCW (positive) direction
+#define TRACE_FLAG_LIMIT 0x08       // Limit switch pressed (either side on a ganged axis)
+#define TRACE_FLAG_PHASE_SHIFT 4    // Bits 4-5: TracePhase
+#define TRACE_FLAG_PHASE_MASK 0x30
+#define TRACE_FLAG_MOVE_START 0x40  // First sample of a move
+#define TRACE_FLAG_REBASE 0x80      // Position or encoder was re-zeroed before this sample
+
+// Part of the speed profile a sample was taken in
+enum TracePhase {
+  TRACE_PHASE_NONE = 0,    // Homing and backing off (constant speed)
+  TRACE_PHASE_ACCEL = 1,
+  TRACE_PHASE_CRUISE = 2,
+  TRACE_PHASE_DECEL = 3
+};
+
+// Why a trace stopped or what it captured
+enum TraceTrigger {
+  TRACE_TRIGGER_NONE = 0,
+  TRACE_TRIGGER_COMMAND = 1,  // Single move requested with T
+  TRACE_TRIGGER_LIMIT = 2,
+  TRACE_TRIGGER_ESTOP = 3,
+  TRACE_TRIGGER_RACKING = 4   // Ganged axis sides drifted apart
+};
+
+/**
+ * Dump header
+ */
+struct TraceHeader {
+  char magic[4];            // "MTRC"
+  uint8_t version;          // 1
+  uint8_t timeUnitMicros;   // TRACE_TIME_UNIT_US
+  uint16_t decimation;      // Steps per sample
+  uint16_t count;           // Samples that follow
+  uint8_t trigger;          // TraceTrigger
+  uint8_t faultMode;        // 1 if armed with TF
+  uint16_t triggerIndex;    // Sample at which the fault was seen, 0xFFFF if none
+  int32_t basePosition;     // Step position before the first sample's delta
+  int32_t baseEncoder;      // Encoder count before the first sample's delta
+  uint16_t minStepDelay;    // Speed profile used for the trace
+  uint16_t maxStepDelay;
+  uint16_t accelRate;
+  uint16_t decelRate;
+} __attribute__((packed));
+
+/**
+ * One recorded sample
+ */
+struct TraceSample {
+  uint16_t dt;            // Time since the previous sample in TRACE_TIME_UNIT_US, saturating
+  int16_t stepDelta;      // Change of the commanded step position
+  int16_t encoderDelta;   // Change of the encoder count
+  uint8_t flags;          // TRACE_FLAG_* and MOTION_FLAG_* bits
+} __attribute__((packed));
+
+// Steps left until the next sample; 0 while not recording
+extern uint16_t traceCountdown;
+
+/**
+ * Record a sample (called when traceCountdown reaches zero)
+ *
+ * @param extraFlags TRACE_FLAG_* bits to add to this sample
+ */
+void traceRecord(uint8_t extraFlags);
+
+/**
+ * Count one step; records a sample every decimation steps
+ * Called by stepMotor() after the position update.
+ */
+inline void traceStep() {
+  if (traceCountdown && --traceCountdown == 0) traceRecord(0);
+}
+
+/**
+ * Mark the start of a move (records its first sample if armed)
+ *
+ * @param direction Direction of the move (TRUE = CCW)
+ */
+void traceMoveStart(bool direction);
+
+/**
+ * Mark the end of a move (records its last sample)
+ */
+void traceMoveEnd();
+
+/**
+ * Set the speed profile phase stored in the following samples
+ *
+ * @param phase TracePhase value
+ */
+void traceSetPhase(uint8_t phase);
+
+/**
+ * Report a fault that interrupted a move
+ *
+ * @param trigger TRACE_TRIGGER_LIMIT or TRACE_TRIGGER_ESTOP
+ */
+void traceFault(uint8_t trigger);
+
+/**
+ * Note that the step position or encoder count was re-zeroed
+ * Keeps the jump out of the sample deltas.
+ */
+void traceRebase();
+
+/**
+ * Handle a trace command (the text after the leading T)
+ *
+ * @param args "", "F", "O", "N<steps>", "S" or "D"
+ */
+void processTraceCommand(const char *args);
+
+#endif // MOTION_TRACE_H
@@ -6,11 +6,51 @@
 
 #include "MotorControl.h"
 #include "Config.h"
+#include "HostSerial.h"
 #include "PositionManager.h"
 #include "LimitSwitch.h"
+#include "MotionState.h"
+#include "MotionTrace.h"
+#include "SpeedProfile.h"
+#include "Gantry.h"
+#include "RealtimeControl.h"
+#include "VelocityEstimator.h"
 
-// Flag to track if emergency stop has been triggered
-volatile bool emergencyStopTriggered = false;
+// Step pin bits for each MOTOR_* combination. stepBits are on stepPort
+// (the PUL_PIN port); stepBits2 is only used when PUL2_PIN is on another port.
+static volatile uint8_t *stepPort;
+static volatile uint8_t *stepPort2;
+static uint8_t stepBits[MOTORS_ALL + 1];
+static uint8_t stepBits2[MOTORS_ALL + 1];
+static unsigned long lastPulseMicros = 0;  // Rising edge of the last pulse
+
+/**
+ * Look up the PORT registers and bits behind the pulse pins
+ */
+static void initializeStepPorts() {
+  uint8_t port = digitalPinToPort(PUL_PIN);
+  stepPort = stepPort2 = portOutputRegister(port);
+  for (uint8_t motors = 0; motors <= MOTORS_ALL; motors++) {
+    stepBits[motors] = (motors & MOTOR_1) ? digitalPinToBitMask(PUL_PIN) : 0;
+    stepBits2[motors] = 0;
+  }
+
+#if GANGED_X_AXIS
+  uint8_t port2 = digitalPinToPort(PUL2_PIN);
+  uint8_t bit2 = digitalPinToBitMask(PUL2_PIN);
+  if (port2 != port) {
+    stepPort2 = portOutputRegister(port2);
+    HostSerial.println(F("WARNING: PUL2_PIN is not on the PUL_PIN port, motor pulses are not simultaneous"));
+  }
+  for (uint8_t motors = MOTOR_2; motors <= MOTORS_ALL; motors++) {
+    if (port2 == port) {
+      stepBits[motors] |= bit2;
+    } else {
+      stepBits2[motors] = bit2;
+    }
+  }
+#endif
+}
 
 /**
  * Initialize motor control pins
@@ -20,6 +60,11 @@ void initializeMotor() {
   pinMode(DIR_PIN, OUTPUT);
   pinMode(PUL_PIN, OUTPUT);
   pinMode(ENA_PIN, OUTPUT);
+#if GANGED_X_AXIS
+  pinMode(DIR2_PIN, OUTPUT);
+  pinMode(PUL2_PIN, OUTPUT);
+#endif
+  initializeStepPorts();
   
   // Start with motor disabled (save power)
   disableMotor();
@@ -30,6 +75,7 @@ void initializeMotor() {
  */
 void enableMotor() {
   digitalWrite(ENA_PIN, LOW);  // LOW = enabled for most drivers
+  motionSetFlags(MOTION_FLAG_MOVING);  // The motor is only enabled while moving
 }
 
 /**
@@ -37,6 +83,8 @@ void enableMotor() {
  */
 void disableMotor() {
   digitalWrite(ENA_PIN, HIGH); // HIGH = disabled for most drivers
+  motionClearFlags(MOTION_FLAG_MOVING | MOTION_FLAG_HOLD);
+  traceMoveEnd();  // A traced move lasts until the motor is released
 }
 
 /**
@@ -48,6 +96,9 @@ void disableMotor() {
 void setDirection(bool direction) {
   // Set direction pin
   digitalWrite(DIR_PIN, direction ? HIGH : LOW);
+#if GANGED_X_AXIS
+  digitalWrite(DIR2_PIN, (direction != DIR2_INVERTED) ? HIGH : LOW);
+#endif
   
   // Small delay to ensure direction signal is stable before stepping
   delayMicroseconds(5);
@@ -60,17 +111,79 @@ void setDirection(bool direction) {
  * @param stepsToMove Number of steps to move
  * @param direction TRUE for Counter-Clockwise (CCW), FALSE for Clockwise (CW)
  * @return TRUE if completed successfully, FALSE if stopped by limit switch
+ *         or emergency stop
  */
 bool moveSteps(long stepsToMove, bool direction) {
-  // Reset emergency stop flag
-  emergencyStopTriggered = false;
+  return moveStepsWithProfile(stepsToMove, direction, getSpeedProfile());
+}
+
+// Outcome of checking for interruptions or of one pass through the profile
+#define MOVE_CONTINUE 0  // Nothing happened, keep stepping
+#define MOVE_DONE 1      // All steps taken
+#define MOVE_STOPPED 2   // Limit switch, emergency stop or racking
+#define MOVE_HELD 3      // Feed hold requested, or at rest after one
+
+/**
+ * Check everything that can interrupt a move, once per step
+ *
+ * @param direction Direction of movement
+ * @return MOVE_CONTINUE, MOVE_STOPPED or MOVE_HELD
+ */
+static uint8_t checkMoveInterrupts(bool direction) {
+  // Check for emergency stop (set by the receive interrupt)
+  if (isEmergencyStopTriggered()) {
+    traceFault(TRACE_TRIGGER_ESTOP);
+    handleStopRequest();
+    return MOVE_STOPPED;
+  }
   
-  // Set direction pin state
-  setDirection(direction);
+  // Check if limit switch was triggered
+  if (checkLimitSwitch(direction)) {
+    return MOVE_STOPPED;
+  }
+  if (checkRacking()) {
+    return MOVE_STOPPED;
+  }
   
+  return isFeedHoldRequested() ? MOVE_HELD : MOVE_CONTINUE;
+}
+
+/**
+ * Decelerate to rest for a feed hold
+ * Ramps down from the current delay at the profile's decelRate. A move that
+ * runs out of steps on the way finishes normally.
+ *
+ * @param stepDelay Delay of the last step taken
+ * @param remaining Steps left in the move, counted down
+ * @return MOVE_HELD at rest, MOVE_DONE or MOVE_STOPPED
+ */
+static uint8_t decelerateToHold(int stepDelay, long &remaining, bool direction,
+                                const SpeedProfile &profile) {
+  traceSetPhase(TRACE_PHASE_DECEL);
+  while (remaining > 0 && stepDelay < profile.maxStepDelay) {
+    if (checkMoveInterrupts(direction) == MOVE_STOPPED) return MOVE_STOPPED;
+    
+    stepDelay += profile.decelRate;
+    if (stepDelay > profile.maxStepDelay) stepDelay = profile.maxStepDelay;
+    stepMotor(stepDelay, direction);
+    remaining--;
+  }
+  return remaining > 0 ? MOVE_HELD : MOVE_DONE;
+}
+
+/**
+ * Run the speed profile over the remaining steps of a move
+ * Stops early, with remaining counted down, for interruptions and holds.
+ *
+ * @param remaining Steps left in the move, counted down
+ * @param direction TRUE for Counter-Clockwise (CCW), FALSE for Clockwise (CW)
+ * @param profile Step delays to use
+ * @return MOVE_DONE, MOVE_STOPPED or MOVE_HELD
+ */
+static uint8_t runProfile(long &remaining, bool direction, const SpeedProfile &profile) {
   // Calculate acceleration and deceleration phases
-  int stepDelay = MAX_STEP_DELAY;  // Start at slowest speed
-  long totalSteps = stepsToMove;
+  int stepDelay = profile.maxStepDelay;  // Start at slowest speed
+  long totalSteps = remaining;
   
   // Calculate steps for each phase (acceleration, constant speed, deceleration)
   long accelerationSteps = totalSteps / 4;  // Use 1/4 of total steps for acceleration
@@ -88,67 +201,111 @@ bool moveSteps(long stepsToMove, bool direction) {
     constantSteps = 0;
   }
 
+  uint8_t event;
+
   // Acceleration phase
+  traceSetPhase(TRACE_PHASE_ACCEL);
   for (long i = 0; i < accelerationSteps; i++) {
-    // Check for emergency stop
-    if (emergencyStopTriggered) {
-      return false;
-    }
-    
-    // Check if limit switch was triggered
-    if (checkLimitSwitch(direction)) {
-      return false;
-    }
+    event = checkMoveInterrupts(direction);
+    if (event == MOVE_HELD) return decelerateToHold(stepDelay, remaining, direction, profile);
+    if (event != MOVE_CONTINUE) return event;
     
     // Generate step pulse
     stepMotor(stepDelay, direction);
+    remaining--;
     
     // Increase speed (decrease delay)
-    if (stepDelay > MIN_STEP_DELAY) {
-      stepDelay -= ACCEL_RATE;
-      if (stepDelay < MIN_STEP_DELAY) stepDelay = MIN_STEP_DELAY;
+    if (stepDelay > profile.minStepDelay) {
+      stepDelay -= profile.accelRate;
+      if (stepDelay < profile.minStepDelay) stepDelay = profile.minStepDelay;
     }
   }
 
   // Constant speed phase
+  traceSetPhase(TRACE_PHASE_CRUISE);
+  velocitySetCruise(true);  // Speed trim, if enabled, only while the delay is constant
   for (long i = 0; i < constantSteps; i++) {
-    // Check for emergency stop
-    if (emergencyStopTriggered) {
-      return false;
-    }
-    
-    // Check if limit switch was triggered
-    if (checkLimitSwitch(direction)) {
-      return false;
-    }
+    event = checkMoveInterrupts(direction);
+    if (event != MOVE_CONTINUE) velocitySetCruise(false);
+    if (event == MOVE_HELD) return decelerateToHold(stepDelay, remaining, direction, profile);
+    if (event != MOVE_CONTINUE) return event;
     
     // Generate step pulse at constant speed
     stepMotor(stepDelay, direction);
+    remaining--;
   }
+  velocitySetCruise(false);
 
   // Deceleration phase
+  traceSetPhase(TRACE_PHASE_DECEL);
   for (long i = 0; i < decelerationSteps; i++) {
-    // Check for emergency stop
-    if (emergencyStopTriggered) {
-      return false;
-    }
-    
-    // Check if limit switch was triggered
-    if (checkLimitSwitch(direction)) {
-      return false;
-    }
+    event = checkMoveInterrupts(direction);
+    if (event == MOVE_HELD) return decelerateToHold(stepDelay, remaining, direction, profile);
+    if (event != MOVE_CONTINUE) return event;
     
     // Generate step pulse
     stepMotor(stepDelay, direction);
+    remaining--;
     
     // Decrease speed (increase delay)
-    if (stepDelay < MAX_STEP_DELAY) {
-      stepDelay += DECEL_RATE;
-      if (stepDelay > MAX_STEP_DELAY) stepDelay = MAX_STEP_DELAY;
+    if (stepDelay < profile.maxStepDelay) {
+      stepDelay += profile.decelRate;
+      if (stepDelay > profile.maxStepDelay) stepDelay = profile.maxStepDelay;
     }
   }
   
-  return true; // Movement completed successfully
+  return MOVE_DONE; // Movement completed successfully
+}
+
+/**
+ * Wait at rest until a feed hold is released
+ * The motor stays enabled, so the carriage keeps its position.
+ *
+ * @param remaining Steps left in the move
+ * @return FALSE if an emergency stop ended the hold
+ */
+static bool waitForResume(long remaining) {
+  printHoldAtRest(remaining);
+  while (isFeedHoldRequested() && !isEmergencyStopTriggered()) {
+    // Holding torque only; the receive interrupt ends the wait
+  }
+  if (isEmergencyStopTriggered()) {
+    handleStopRequest();
+    return false;
+  }
+  HostSerial.print(F("Feed hold released: resuming "));
+  HostSerial.print(remaining);
+  HostSerial.println(F(" steps"));
+  return true;
+}
+
+/**
+ * Move like moveSteps() with an explicit speed profile
+ * Used by auto-tune to run test moves at candidate speeds. A feed hold
+ * brings the move to rest and continues it with a new ramp on resume.
+ *
+ * @param stepsToMove Number of steps to move
+ * @param direction TRUE for Counter-Clockwise (CCW), FALSE for Clockwise (CW)
+ * @param profile Step delays to use
+ * @return TRUE if completed successfully, FALSE if stopped by limit switch
+ *         or emergency stop
+ */
+bool moveStepsWithProfile(long stepsToMove, bool direction, const SpeedProfile &profile) {
+  // The emergency stop flag is latched until the C command; never clear it here
+  if (isEmergencyStopTriggered()) return false;
+  
+  // Set direction pin state
+  setDirection(direction);
+
+  traceMoveStart(direction);
+  velocityMoveStart();
+
+  long remaining = stepsToMove;
+  for (;;) {
+    uint8_t result = runProfile(remaining, direction, profile);
+    if (result != MOVE_HELD) return result == MOVE_DONE;
+    if (!waitForResume(remaining)) return false;
+  }
 }
 
 /**
@@ -159,25 +316,60 @@ bool moveSteps(long stepsToMove, bool direction) {
  * @param direction Direction of movement (used to update position counter)
  */
 void stepMotor(int delayTime, bool direction) {
-  // Generate step pulse
-  digitalWrite(PUL_PIN, HIGH);
-  delayMicroseconds(10);  // Pulse width (most drivers need at least 2-5µs)
-  digitalWrite(PUL_PIN, LOW);
+  // Generate step pulse (both motors of a ganged axis)
+  pulseMotors(MOTORS_ALL);
   
-  // Delay to control speed (minus the pulse width)
-  delayMicroseconds(delayTime - 10);
+  // Delay to control speed, with the speed trim, minus the pulse width and
+  // the time of a velocity control tick run for this step
+  int wait = velocityStepDelay(delayTime) - STEP_PULSE_US;
+  if (wait > 0) delayMicroseconds(wait);
 
   // Update position based on direction
   updatePosition(direction ? 1 : -1);
+  traceStep();
+}
+
+/**
+ * Pulse the step pins of the selected motors together
+ * The read-modify-write of the PORT register runs with interrupts disabled,
+ * like digitalWrite(), so an interrupt cannot change other bits of the port
+ * in between.
+ *
+ * @param motors MOTOR_1 and/or MOTOR_2 bits
+ */
+void pulseMotors(uint8_t motors) {
+  uint8_t bits = stepBits[motors];
+  uint8_t bits2 = stepBits2[motors];
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *stepPort |= bits;
+    if (bits2) *stepPort2 |= bits2;
+  }
+  lastPulseMicros = micros();
+  delayMicroseconds(STEP_PULSE_US);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *stepPort &= ~bits;
+    if (bits2) *stepPort2 &= ~bits2;
+  }
+}
+
+/**
+ * Time of the last step pulse
+ *
+ * @return micros() at the rising edge of the last pulseMotors() call
+ */
+unsigned long getLastPulseMicros() {
+  return lastPulseMicros;
 }
 
 /**
  * Emergency stop - immediately stop any movement
+ * Latched: moves are refused until clearEmergencyStop() (C command).
  */
 void emergencyStop() {
-  emergencyStopTriggered = true;
+  motionSetFlags(MOTION_FLAG_ESTOP);
   disableMotor();
-  Serial.println("EMERGENCY STOP TRIGGERED");
+  HostSerial.println(F("EMERGENCY STOP TRIGGERED"));
 }
 
 /**
@@ -187,12 +379,12 @@ void emergencyStop() {
  */
 void processRelativeMove(long steps) {
   if (steps == 0) {
-    Serial.println("Zero steps requested - no movement needed");
+    HostSerial.println(F("Zero steps requested - no movement needed"));
     return;
   }
   
-  Serial.print("Relative move requested: ");
-  Serial.println(steps);
+  HostSerial.print(F("Relative move requested: "));
+  HostSerial.println(steps);
   
   // Calculate target position
   long currentPos = getCurrentPosition();
@@ -200,36 +392,36 @@ void processRelativeMove(long steps) {
   
   // Safety check to prevent moving beyond limits with margin
   if (targetPosition < BACKOFF_STEPS) {
-    Serial.println("WARNING: Would move too close to home position limit!");
-    Serial.print("Movement limited to safe distance (");
-    Serial.print(BACKOFF_STEPS);
-    Serial.println(" steps from home)");
+    HostSerial.println(F("WARNING: Would move too close to home position limit!"));
+    HostSerial.print(F("Movement limited to safe distance ("));
+    HostSerial.print(BACKOFF_STEPS);
+    HostSerial.println(F(" steps from home)"));
     targetPosition = BACKOFF_STEPS;
     steps = targetPosition - currentPos;
   } 
   else if (targetPosition > (getMaxPosition() - BACKOFF_STEPS)) {
-    Serial.println("WARNING: Would move too close to maximum position limit!");
-    Serial.print("Movement limited to safe distance (");
-    Serial.print(BACKOFF_STEPS);
-    Serial.println(" steps from maximum)");
+    HostSerial.println(F("WARNING: Would move too close to maximum position limit!"));
+    HostSerial.print(F("Movement limited to safe distance ("));
+    HostSerial.print(BACKOFF_STEPS);
+    HostSerial.println(F(" steps from maximum)"));
     targetPosition = getMaxPosition() - BACKOFF_STEPS;
     steps = targetPosition - currentPos;
   }
   
   // If steps changed to 0 after constraint, exit
   if (steps == 0) {
-    Serial.println("Already at safe limit - no movement possible");
+    HostSerial.println(F("Already at safe limit - no movement possible"));
     return;
   }
   
   // Determine direction
   bool direction = (steps > 0);  // TRUE = CCW (HIGH), FALSE = CW (LOW)
-  Serial.print("Direction: ");
-  Serial.println(direction ? "CCW (forward)" : "CW (backward)");
-  Serial.print("Moving from position ");
-  Serial.print(currentPos);
-  Serial.print(" to position ");
-  Serial.println(targetPosition);
+  HostSerial.print(F("Direction: "));
+  HostSerial.println(direction ? F("CCW (forward)") : F("CW (backward)"));
+  HostSerial.print(F("Moving from position "));
+  HostSerial.print(currentPos);
+  HostSerial.print(F(" to position "));
+  HostSerial.println(targetPosition);
   
   // Enable motor, move, then disable
   enableMotor();
@@ -237,16 +429,16 @@ void processRelativeMove(long steps) {
   disableMotor();
   
   if (success) {
-    Serial.print("Move complete. Current position: ");
-    Serial.println(getCurrentPosition());
-    Serial.print("Distance from home: ");
-    Serial.print(getPositionPercentage());
-    Serial.println("%");
+    HostSerial.print(F("Move complete. Current position: "));
+    HostSerial.println(getCurrentPosition());
+    HostSerial.print(F("Distance from home: "));
+    HostSerial.print(getPositionPercentage());
+    HostSerial.println(F("%"));
   } else {
-    Serial.println("Move interrupted by limit switch or emergency stop");
+    HostSerial.println(F("Move interrupted by limit switch or emergency stop"));
     
     // Double check current position after interruption
-    Serial.print("Current position after interruption: ");
-    Serial.println(getCurrentPosition());
+    HostSerial.print(F("Current position after interruption: "));
+    HostSerial.println(getCurrentPosition());
   }
 }
\ No newline at end of file
@@ -8,6 +8,17 @@
 #define MOTOR_CONTROL_H
 
 #include <Arduino.h>
+#include "SpeedProfile.h"
+#include "Config.h"
+
+// Motor selection for pulseMotors()
+#define MOTOR_1 0x01  // PUL_PIN
+#define MOTOR_2 0x02  // PUL2_PIN (ganged X axis only)
+#if GANGED_X_AXIS
+#define MOTORS_ALL (MOTOR_1 | MOTOR_2)
+#else
+#define MOTORS_ALL MOTOR_1
+#endif
 
 /**
  * Initialize motor control pins
@@ -39,9 +50,23 @@ void setDirection(bool direction);
  * @param stepsToMove Number of steps to move
  * @param direction TRUE for Counter-Clockwise (CCW), FALSE for Clockwise (CW)
  * @return TRUE if completed successfully, FALSE if stopped by limit switch
+ *         or emergency stop
  */
 bool moveSteps(long stepsToMove, bool direction);
 
+/**
+ * Move like moveSteps() with an explicit speed profile
+ * Used by auto-tune to run test moves at candidate speeds. A feed hold
+ * brings the move to rest and continues it with a new ramp on resume.
+ *
+ * @param stepsToMove Number of steps to move
+ * @param direction TRUE for Counter-Clockwise (CCW), FALSE for Clockwise (CW)
+ * @param profile Step delays to use
+ * @return TRUE if completed successfully, FALSE if stopped by limit switch
+ *         or emergency stop
+ */
+bool moveStepsWithProfile(long stepsToMove, bool direction, const SpeedProfile &profile);
+
 /**
  * Generate a single step pulse
  * This advances the motor by one step in the current direction
@@ -51,8 +76,26 @@ bool moveSteps(long stepsToMove, bool direction);
  */
 void stepMotor(int delayTime, bool direction);
 
+/**
+ * Pulse the step pins of the selected motors together
+ * Sets and clears all pulse bits with one PORT register write each, so the
+ * motors of a ganged axis step at the same instant. Does not delay after the
+ * pulse or update the position counter.
+ *
+ * @param motors MOTOR_1 and/or MOTOR_2 bits
+ */
+void pulseMotors(uint8_t motors);
+
+/**
+ * Time of the last step pulse
+ *
+ * @return micros() at the rising edge of the last pulseMotors() call
+ */
+unsigned long getLastPulseMicros();
+
 /**
  * Emergency stop - immediately stop any movement
+ * Latched: moves are refused until clearEmergencyStop() (C command).
  */
 void emergencyStop();
 
@@ -6,9 +6,10 @@
 
 #include "PositionManager.h"
 #include "Config.h"
+#include "MotionState.h"
+#include "MotionTrace.h"
 
-// Position variables
-long currentPosition = 0;    // Current absolute position in steps
+// Position variables (the step counter itself lives in MotionState)
 long maxPosition = MAX_TRAVEL;  // Maximum position (default, updated if far limit is hit)
 
 /**
@@ -17,7 +18,7 @@ long maxPosition = MAX_TRAVEL;  // Maximum position (default, updated if far lim
  * @param steps Number of steps to add (positive or negative)
  */
 void updatePosition(long steps) {
-  currentPosition += steps;
+  motionAddPosition(steps);
 }
 
 /**
@@ -26,7 +27,7 @@ void updatePosition(long steps) {
  * @return Current position in steps
  */
 long getCurrentPosition() {
-  return currentPosition;
+  return readCurrentPosition();
 }
 
 /**
@@ -36,7 +37,8 @@ long getCurrentPosition() {
  * @param position New position value
  */
 void setCurrentPosition(long position) {
-  currentPosition = position;
+  motionSetPosition(position);
+  traceRebase();
 }
 
 /**
@@ -69,7 +71,7 @@ int getPositionPercentage() {
   }
   
   // Calculate and constrain to 0-100 range
-  int percent = (currentPosition * 100) / maxPosition;
+  int percent = (readCurrentPosition() * 100) / maxPosition;
   
   // Constrain to 0-100 range in case of slight overrun
   if (percent < 0) percent = 0;
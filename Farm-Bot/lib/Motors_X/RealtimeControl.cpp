@@ -0,0 +1,108 @@
+/**
+ * RealtimeControl.cpp
+ *
+ * Implementation of the realtime stop and feed hold.
+ */
+
+#include "RealtimeControl.h"
+#include "HostSerial.h"
+#include "MotionState.h"
+#include "MotorControl.h"
+#include "PositionManager.h"
+#include <util/atomic.h>
+
+// Written by the receive interrupt
+static volatile bool stopPending = false;       // Stop byte not yet handled by the main loop
+static volatile bool stopDuringMove = false;
+static volatile unsigned long stopReceivedMicros = 0;
+static volatile unsigned long holdReceivedMicros = 0;
+
+/**
+ * Act on a realtime byte (called by the receive interrupt)
+ * A hold or resume outside a move is ignored.
+ *
+ * @param byte REALTIME_STOP, REALTIME_HOLD or REALTIME_RESUME
+ */
+void realtimeByteReceived(uint8_t byte) {
+  uint8_t flags = motionState.flags;
+  if (byte == REALTIME_STOP) {
+    if (!stopPending) {
+      stopReceivedMicros = micros();
+      stopDuringMove = (flags & MOTION_FLAG_MOVING) != 0;
+      stopPending = true;
+    }
+    motionSetFlagsFromIsr(MOTION_FLAG_ESTOP);
+  } else if (byte == REALTIME_HOLD) {
+    if ((flags & (MOTION_FLAG_MOVING | MOTION_FLAG_ESTOP | MOTION_FLAG_HOLD)) == MOTION_FLAG_MOVING) {
+      holdReceivedMicros = micros();
+      motionSetFlagsFromIsr(MOTION_FLAG_HOLD);
+    }
+  } else if (byte == REALTIME_RESUME) {
+    if (flags & MOTION_FLAG_HOLD) motionClearFlagsFromIsr(MOTION_FLAG_HOLD);
+  }
+}
+
+/**
+ * Time from a realtime byte to the last step pulse
+ *
+ * @param received micros() when the byte arrived
+ * @return Microseconds, 0 if no pulse started after the byte
+ */
+static unsigned long microsToLastPulse(unsigned long received) {
+  long elapsed = (long)(getLastPulseMicros() - received);
+  return elapsed > 0 ? (unsigned long)elapsed : 0;
+}
+
+/**
+ * Finish a stop requested by REALTIME_STOP
+ */
+void handleStopRequest() {
+  bool pending;
+  bool duringMove;
+  unsigned long received;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    pending = stopPending;
+    duringMove = stopDuringMove;
+    received = stopReceivedMicros;
+    stopPending = false;
+  }
+  if (!pending) return;  // Stopped by the S command, already reported
+
+  emergencyStop();
+  if (duringMove) {
+    HostSerial.print(F("Stop latency: "));
+    HostSerial.print(microsToLastPulse(received));
+    HostSerial.println(F(" us from stop byte to last step"));
+  }
+}
+
+/**
+ * Print where a held move came to rest
+ *
+ * @param remainingSteps Steps left in the move
+ */
+void printHoldAtRest(long remainingSteps) {
+  unsigned long received;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    received = holdReceivedMicros;
+  }
+  HostSerial.print(F("Feed hold: at rest "));
+  HostSerial.print(microsToLastPulse(received));
+  HostSerial.print(F(" us after hold byte, position "));
+  HostSerial.print(getCurrentPosition());
+  HostSerial.print(F(", "));
+  HostSerial.print(remainingSteps);
+  HostSerial.println(F(" steps remaining"));
+}
+
+/**
+ * Clear a latched emergency stop and any feed hold (C command)
+ */
+void clearEmergencyStop() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    stopPending = false;
+  }
+  bool wasActive = isEmergencyStopTriggered();
+  motionClearFlags(MOTION_FLAG_ESTOP | MOTION_FLAG_HOLD);
+  HostSerial.println(wasActive ? F("Emergency stop cleared") : F("Emergency stop not active"));
+}
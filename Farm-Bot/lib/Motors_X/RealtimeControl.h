@@ -0,0 +1,66 @@
+/**
+ * RealtimeControl.h
+ *
+ * Header file for the realtime stop and feed hold of the FarmBot X-Axis controller.
+ *
+ * The HostSerial receive interrupt passes three reserved bytes here instead
+ * of buffering them, so they take effect within one step even during a move:
+ *   REALTIME_STOP    hard stop: the step loop halts before its next pulse and
+ *                    the motor is disabled. The emergency stop stays latched;
+ *                    moves are refused until the C command clears it.
+ *   REALTIME_HOLD    feed hold: the move decelerates at the profile's
+ *                    decelRate to rest, keeps holding torque and waits with
+ *                    its remaining steps. Position stays exact.
+ *   REALTIME_RESUME  continue a held move from rest with a new ramp
+ *
+ * After a stop during a move the firmware prints
+ * "Stop latency: <us> us from stop byte to last step", measured from the
+ * receive interrupt to the rising edge of the last step pulse (0 when no
+ * pulse started after the byte). A feed hold reports the time to the last
+ * pulse of its deceleration the same way.
+ */
+
+#ifndef REALTIME_CONTROL_H
+#define REALTIME_CONTROL_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * Check whether a received byte is handled by realtimeByteReceived()
+ *
+ * @param byte Received byte
+ * @return TRUE for REALTIME_STOP, REALTIME_HOLD and REALTIME_RESUME
+ */
+inline bool isRealtimeByte(uint8_t byte) {
+  return byte == REALTIME_STOP || byte == REALTIME_HOLD || byte == REALTIME_RESUME;
+}
+
+/**
+ * Act on a realtime byte (called by the receive interrupt)
+ *
+ * @param byte REALTIME_STOP, REALTIME_HOLD or REALTIME_RESUME
+ */
+void realtimeByteReceived(uint8_t byte);
+
+/**
+ * Finish a stop requested by REALTIME_STOP
+ * Disables the motor through emergencyStop() and, if the stop arrived during
+ * a move, prints the stop latency. Does nothing if no stop byte is pending,
+ * so it can be called wherever MOTION_FLAG_ESTOP is noticed.
+ */
+void handleStopRequest();
+
+/**
+ * Print where a held move came to rest
+ *
+ * @param remainingSteps Steps left in the move
+ */
+void printHoldAtRest(long remainingSteps);
+
+/**
+ * Clear a latched emergency stop and any feed hold (C command)
+ */
+void clearEmergencyStop();
+
+#endif // REALTIME_CONTROL_H
@@ -0,0 +1,66 @@
+/**
+ * SensorInput.cpp
+ *
+ * Implementation of the soil sensor readings.
+ */
+
+#include "SensorInput.h"
+#include "Config.h"
+
+static uint16_t tdsSamples[SENSOR_TDS_SAMPLES];
+static uint8_t tdsIndex = 0;
+static uint8_t tdsCount = 0;
+static unsigned long tdsLastSample = 0;
+
+/**
+ * Set up the sensor pins
+ */
+void initializeSensors() {
+  pinMode(SENSOR_MOISTURE_PIN, INPUT);
+  pinMode(SENSOR_TDS_PIN, INPUT);
+}
+
+/**
+ * Take a TDS sample when one is due
+ */
+void sampleSensors() {
+  if (tdsCount > 0 && millis() - tdsLastSample < SENSOR_TDS_SAMPLE_MS) return;
+  tdsLastSample = millis();
+  tdsSamples[tdsIndex] = analogRead(SENSOR_TDS_PIN);
+  tdsIndex = (tdsIndex + 1) % SENSOR_TDS_SAMPLES;
+  if (tdsCount < SENSOR_TDS_SAMPLES) tdsCount++;
+}
+
+/**
+ * Median of the TDS samples taken so far
+ * Same result as getMedianNum() in Ph_Sensor.ino, sorted by insertion on a
+ * copy so sampling can continue into the original.
+ */
+static uint16_t tdsMedian() {
+  if (tdsCount == 0) sampleSensors();
+
+  uint16_t sorted[SENSOR_TDS_SAMPLES];
+  for (uint8_t i = 0; i < tdsCount; i++) {
+    uint16_t value = tdsSamples[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+
+  if (tdsCount & 1) return sorted[tdsCount / 2];
+  return (sorted[tdsCount / 2] + sorted[tdsCount / 2 - 1]) / 2;
+}
+
+/**
+ * Read a sensor
+ *
+ * @param channel SensorChannel
+ * @return Raw ADC value (median filtered for SENSOR_TDS)
+ */
+uint16_t readSensor(uint8_t channel) {
+  if (channel == SENSOR_TDS) return tdsMedian();
+  return analogRead(SENSOR_MOISTURE_PIN);
+}
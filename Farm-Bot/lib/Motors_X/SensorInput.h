@@ -0,0 +1,45 @@
+/**
+ * SensorInput.h
+ *
+ * Header file for the soil sensors of the FarmBot X-Axis controller.
+ *
+ * The moisture and TDS probes that Moisture_Sensor.ino and Ph_Sensor.ino read
+ * on their own boards are wired to this controller's analog pins. Readings
+ * are raw 10-bit ADC values; the host converts them (see
+ * Host_Tools/lib/SensorLog). The TDS probe is noisy, so like Ph_Sensor.ino it
+ * is sampled every SENSOR_TDS_SAMPLE_MS and read as the median of the last
+ * SENSOR_TDS_SAMPLES samples.
+ */
+
+#ifndef SENSOR_INPUT_H
+#define SENSOR_INPUT_H
+
+#include <Arduino.h>
+
+// Channel ids, also stored with every logged reading
+enum SensorChannel {
+  SENSOR_MOISTURE = 0,
+  SENSOR_TDS = 1,
+  SENSOR_CHANNELS = 2
+};
+
+/**
+ * Set up the sensor pins
+ */
+void initializeSensors();
+
+/**
+ * Take a TDS sample when one is due
+ * Called from the main loop; samples are missed while a move runs.
+ */
+void sampleSensors();
+
+/**
+ * Read a sensor
+ *
+ * @param channel SensorChannel
+ * @return Raw ADC value (median filtered for SENSOR_TDS)
+ */
+uint16_t readSensor(uint8_t channel);
+
+#endif // SENSOR_INPUT_H
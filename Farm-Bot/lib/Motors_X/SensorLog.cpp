@@ -0,0 +1,345 @@
+/**
+ * SensorLog.cpp
+ *
+ * Implementation of the sensor history blocks, their EEPROM spill and the
+ * binary dump.
+ */
+
+#include "SensorLog.h"
+#include "Config.h"
+#include "HostSerial.h"
+#include "SensorInput.h"
+#include <EEPROM.h>
+#include <avr/eeprom.h>
+#include <stddef.h>
+#include <util/crc16.h>
+
+#define SENSOR_LOG_VERSION 2
+#define VARINT_MAX_BYTES 5
+#define EEPROM_SLOTS (SENSOR_LOG_EEPROM_BLOCKS > 0 ? SENSOR_LOG_EEPROM_BLOCKS : 1)  // For ring arithmetic
+
+static_assert(sizeof(SensorLogBlock) == SENSOR_LOG_BLOCK_BYTES, "SensorLogBlock must fill a block");
+static_assert(SENSOR_CHANNELS <= (1 << SENSOR_LOG_CHANNEL_BITS), "Too many sensor channels for the log");
+static_assert(SENSOR_LOG_RAM_BLOCKS >= 2, "The sensor log needs at least two RAM blocks");
+static_assert(EEPROM_SENSOR_LOG_ADDRESS + (long)SENSOR_LOG_EEPROM_BLOCKS * SENSOR_LOG_BLOCK_BYTES <= E2END + 1,
+              "SENSOR_LOG_EEPROM_BLOCKS do not fit in EEPROM");
+
+// RAM ring: the newest block is open for appending
+static SensorLogBlock ramBlocks[SENSOR_LOG_RAM_BLOCKS];
+static uint8_t ramOldest = 0;
+static uint8_t ramCount = 0;
+static uint16_t nextSequence = 0;
+static uint16_t bootSequence = 0;
+static bool bootBlock = true;   // The next block is the first since reset
+
+// Predictors of the open block
+static uint32_t previousTick = 0;
+static uint16_t previousValue[SENSOR_CHANNELS];
+
+// Log clock: seconds since reset, kept across millis() wrapping
+static uint32_t logTick = 0;
+static unsigned long logTickMillis = 0;
+static uint32_t lastLogTick = 0;
+static uint16_t intervalTicks = SENSOR_LOG_INTERVAL_S;
+
+// EEPROM ring: the oldest RAM block is copied to eepromNext byte by byte
+static uint8_t eepromNext = 0;
+static uint8_t eepromCount = 0;
+static bool spilling = false;
+static uint8_t spillOffset = 0;
+
+static uint8_t blockCrc(const SensorLogBlock &block) {
+  const uint8_t *bytes = (const uint8_t *)&block;
+  uint8_t crc = SENSOR_LOG_CRC_SEED;
+  for (uint8_t i = 0; i < offsetof(SensorLogBlock, crc); i++) crc = _crc8_ccitt_update(crc, bytes[i]);
+  for (uint8_t i = 0; i < block.length; i++) crc = _crc8_ccitt_update(crc, block.data[i]);
+  return crc;
+}
+
+static bool isValidBlock(const SensorLogBlock &block) {
+  return block.length <= SENSOR_LOG_DATA_BYTES && block.crc == blockCrc(block);
+}
+
+static int eepromAddress(uint8_t slot) {
+  return EEPROM_SENSOR_LOG_ADDRESS + slot * SENSOR_LOG_BLOCK_BYTES;
+}
+
+/**
+ * Read a spilled block
+ *
+ * @return FALSE if the slot is empty, damaged or still being written
+ */
+static bool readEepromBlock(uint8_t slot, SensorLogBlock &block) {
+  if (spilling && slot == eepromNext) return false;
+  EEPROM.get(eepromAddress(slot), block);
+  return isValidBlock(block);
+}
+
+static uint8_t putVarint(uint8_t *out, uint32_t value) {
+  uint8_t count = 0;
+  while (value >= 0x80) {
+    out[count++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  out[count++] = (uint8_t)value;
+  return count;
+}
+
+/**
+ * Encode a reading against the open block's predictors
+ *
+ * @return Number of bytes written to out (at most 2 x VARINT_MAX_BYTES)
+ */
+static uint8_t encodeReading(uint8_t *out, uint8_t channel, uint16_t value, uint32_t tick) {
+  int32_t delta = (int32_t)value - previousValue[channel];
+  uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+  uint8_t count = putVarint(out, ((tick - previousTick) << SENSOR_LOG_CHANNEL_BITS) | channel);
+  return count + putVarint(out + count, zigzag);
+}
+
+/**
+ * Start copying the oldest RAM block to EEPROM
+ */
+static void startSpill() {
+  ramBlocks[ramOldest].crc = blockCrc(ramBlocks[ramOldest]);
+  spilling = true;
+  spillOffset = 0;
+}
+
+/**
+ * Write the next byte(s) of the block being spilled
+ * EEPROM.update() skips bytes that are unchanged.
+ *
+ * @param wait TRUE to finish the whole block, waiting for each write
+ */
+static void continueSpill(bool wait) {
+  const uint8_t *bytes = (const uint8_t *)&ramBlocks[ramOldest];
+  while (spilling && (wait || eeprom_is_ready())) {
+    EEPROM.update(eepromAddress(eepromNext) + spillOffset, bytes[spillOffset]);
+    if (++spillOffset < SENSOR_LOG_BLOCK_BYTES) continue;
+
+    // Block copied: it now lives in EEPROM only
+    spilling = false;
+    eepromNext = (eepromNext + 1) % EEPROM_SLOTS;
+    if (eepromCount < SENSOR_LOG_EEPROM_BLOCKS) eepromCount++;
+    ramOldest = (ramOldest + 1) % SENSOR_LOG_RAM_BLOCKS;
+    ramCount--;
+  }
+}
+
+/**
+ * Start a new keyframe block, making room in the RAM ring if needed
+ */
+static SensorLogBlock &openBlock(uint32_t tick) {
+  if (ramCount == SENSOR_LOG_RAM_BLOCKS) {
+    if (SENSOR_LOG_EEPROM_BLOCKS > 0) {
+      // Normally long finished by the main loop
+      if (!spilling) startSpill();
+      continueSpill(true);
+    } else {
+      ramOldest = (ramOldest + 1) % SENSOR_LOG_RAM_BLOCKS;
+      ramCount--;
+    }
+  }
+
+  SensorLogBlock &block = ramBlocks[(ramOldest + ramCount) % SENSOR_LOG_RAM_BLOCKS];
+  ramCount++;
+  block.sequence = nextSequence++;
+  block.startTick = tick;
+  block.flags = bootBlock ? SENSOR_BLOCK_BOOT : 0;
+  block.length = 0;
+  bootBlock = false;
+
+  previousTick = tick;
+  for (uint8_t i = 0; i < SENSOR_CHANNELS; i++) previousValue[i] = 0;
+  return block;
+}
+
+/**
+ * Append a reading, opening a new block when the current one is full
+ */
+static void logReading(uint8_t channel, uint16_t value, uint32_t tick) {
+  uint8_t encoded[2 * VARINT_MAX_BYTES];
+  uint8_t length = 0;
+  SensorLogBlock *block = NULL;
+  if (ramCount > 0) {
+    block = &ramBlocks[(ramOldest + ramCount - 1) % SENSOR_LOG_RAM_BLOCKS];
+    length = encodeReading(encoded, channel, value, tick);
+  }
+  if (block == NULL || block->length + length > SENSOR_LOG_DATA_BYTES) {
+    block = &openBlock(tick);
+    length = encodeReading(encoded, channel, value, tick);
+  }
+
+  memcpy(block->data + block->length, encoded, length);
+  block->length += length;
+  previousTick = tick;
+  previousValue[channel] = value;
+}
+
+/**
+ * Find the blocks spilled to EEPROM before the last reset
+ * The newest block is the one not followed by its successor in the ring;
+ * logging continues after it with the next sequence number.
+ */
+void initializeSensorLog() {
+  if (SENSOR_LOG_EEPROM_BLOCKS == 0) return;
+
+  SensorLogBlock current;
+  SensorLogBlock next;
+  bool currentValid = readEepromBlock(0, current);
+  bool found = false;
+  uint16_t newestSequence = 0;
+  for (uint8_t slot = 0; slot < SENSOR_LOG_EEPROM_BLOCKS; slot++) {
+    uint8_t nextSlot = (slot + 1) % EEPROM_SLOTS;
+    bool nextValid = readEepromBlock(nextSlot, next);
+    if (currentValid) {
+      eepromCount++;
+      bool followed = nextValid && next.sequence == (uint16_t)(current.sequence + 1);
+      if (!followed && (!found || (int16_t)(current.sequence - newestSequence) > 0)) {
+        found = true;
+        newestSequence = current.sequence;
+        eepromNext = nextSlot;
+      }
+    }
+    current = next;
+    currentValid = nextValid;
+  }
+  if (found) nextSequence = newestSequence + 1;
+  bootSequence = nextSequence;
+}
+
+/**
+ * Sample the sensors, log a reading when one is due and continue the
+ * EEPROM spill
+ */
+void pollSensorLog() {
+  sampleSensors();
+
+  while (millis() - logTickMillis >= SENSOR_LOG_TICK_MS) {
+    logTickMillis += SENSOR_LOG_TICK_MS;
+    logTick++;
+  }
+  if (logTick - lastLogTick >= intervalTicks) {
+    lastLogTick = logTick;
+    for (uint8_t channel = 0; channel < SENSOR_CHANNELS; channel++) {
+      logReading(channel, readSensor(channel), logTick);
+    }
+  }
+
+  if (SENSOR_LOG_EEPROM_BLOCKS == 0) return;
+  // Copy the oldest block out while the newest one fills
+  if (!spilling && ramCount == SENSOR_LOG_RAM_BLOCKS) startSpill();
+  continueSpill(false);
+}
+
+static void sendBytes(const void *data, uint8_t length, uint16_t &sum) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (uint8_t i = 0; i < length; i++) {
+    sum += bytes[i];
+    HostSerial.write(bytes[i]);
+  }
+}
+
+/**
+ * Send the whole log, EEPROM blocks first, as "LOG BEGIN <bytes>", the raw
+ * bytes and "LOG END"
+ */
+static void dumpSensorLog() {
+  SensorLogBlock block;
+  uint16_t count = ramCount;
+  for (uint8_t slot = 0; slot < SENSOR_LOG_EEPROM_BLOCKS; slot++) {
+    if (readEepromBlock(slot, block)) count++;
+  }
+
+  SensorLogHeader header;
+  memcpy(header.magic, "SLOG", 4);
+  header.version = SENSOR_LOG_VERSION;
+  header.channels = SENSOR_CHANNELS;
+  header.tickMillis = SENSOR_LOG_TICK_MS;
+  header.intervalTicks = intervalTicks;
+  header.nowTick = logTick;
+  header.bootSequence = bootSequence;
+  header.blockBytes = SENSOR_LOG_BLOCK_BYTES;
+  header.count = count;
+
+  HostSerial.print(F("LOG BEGIN "));
+  HostSerial.println(sizeof(SensorLogHeader) + (unsigned long)count * SENSOR_LOG_BLOCK_BYTES + 2);
+  uint16_t sum = 0;
+  sendBytes(&header, sizeof(header), sum);
+
+  // EEPROM ring from its oldest slot
+  for (uint8_t n = 0; n < SENSOR_LOG_EEPROM_BLOCKS; n++) {
+    uint8_t slot = (eepromNext + n) % EEPROM_SLOTS;
+    if (readEepromBlock(slot, block)) sendBytes(&block, sizeof(block), sum);
+  }
+  for (uint8_t n = 0; n < ramCount; n++) {
+    SensorLogBlock &ramBlock = ramBlocks[(ramOldest + n) % SENSOR_LOG_RAM_BLOCKS];
+    ramBlock.crc = blockCrc(ramBlock);
+    sendBytes(&ramBlock, sizeof(ramBlock), sum);
+  }
+
+  HostSerial.write((uint8_t)(sum & 0xFF));
+  HostSerial.write((uint8_t)(sum >> 8));
+  HostSerial.println();
+  HostSerial.println(F("LOG END"));
+}
+
+/**
+ * Drop every block, invalidating the EEPROM copies
+ */
+static void clearSensorLog() {
+  spilling = false;
+  ramCount = 0;
+  for (uint8_t slot = 0; slot < SENSOR_LOG_EEPROM_BLOCKS; slot++) {
+    EEPROM.update(eepromAddress(slot) + offsetof(SensorLogBlock, length), 0xFF);
+  }
+  eepromCount = 0;
+  eepromNext = 0;
+}
+
+/**
+ * Handle a sensor log command (the text after the leading D)
+ * Every reply ends with a line starting "Sensor " or with "LOG END".
+ *
+ * @param args "", "S", "R", "C" or "I<seconds>"
+ */
+void processSensorLogCommand(const char *args) {
+  switch (args[0]) {
+    case '\0':
+      dumpSensorLog();
+      break;
+    case 'S':
+      HostSerial.print(F("Sensor log: "));
+      HostSerial.print(ramCount + eepromCount);
+      HostSerial.print(F(" blocks ("));
+      HostSerial.print(ramCount);
+      HostSerial.print(F(" in RAM, "));
+      HostSerial.print(eepromCount);
+      HostSerial.print(F(" in EEPROM), every "));
+      HostSerial.print(intervalTicks);
+      HostSerial.println(F(" s"));
+      break;
+    case 'R':
+      HostSerial.print(F("Sensor reading: moisture "));
+      HostSerial.print(readSensor(SENSOR_MOISTURE));
+      HostSerial.print(F(", TDS "));
+      HostSerial.println(readSensor(SENSOR_TDS));
+      break;
+    case 'C':
+      clearSensorLog();
+      HostSerial.println(F("Sensor log cleared"));
+      break;
+    case 'I': {
+      long seconds = atol(args + 1);
+      intervalTicks = seconds < 1 ? 1 : (seconds > 3600 ? 3600 : seconds);
+      HostSerial.print(F("Sensor log interval: "));
+      HostSerial.print(intervalTicks);
+      HostSerial.println(F(" s"));
+      break;
+    }
+    default:
+      HostSerial.println(F("Sensor log commands: D, DS, DR, DC, DI<seconds>"));
+      break;
+  }
+}
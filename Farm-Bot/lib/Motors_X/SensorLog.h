@@ -0,0 +1,99 @@
+/**
+ * SensorLog.h
+ *
+ * Header file for the sensor history of the FarmBot X-Axis controller.
+ *
+ * Every SENSOR_LOG_INTERVAL_S the main loop logs one reading per sensor
+ * channel, so history keeps accumulating while the host is busy or
+ * disconnected and is collected later in one binary transfer. Readings are
+ * packed into 64-byte blocks:
+ *   - each reading is a varint of (seconds since the previous reading << 2 |
+ *     channel) followed by a zigzag varint of the change from the previous
+ *     value of that channel, usually 2 bytes in total
+ *   - every block is a keyframe: its header holds the absolute start time
+ *     and the value predictors restart at 0, so any block decodes on its own
+ *     and the oldest block can be dropped without touching the others
+ * The newest SENSOR_LOG_RAM_BLOCKS blocks live in SRAM. When SRAM is full the
+ * oldest block is copied to an EEPROM ring one byte per main loop pass (the
+ * loop never waits for an EEPROM write), so the spilled part of the history
+ * also survives a reset. Readings are not taken while a move keeps the main
+ * loop busy; the timestamps show the gap.
+ *
+ * Commands:
+ *   D            dump as "LOG BEGIN <bytes>", the raw bytes, then "LOG END"
+ *   DS           block counts and interval
+ *   DR           read the sensors now (not logged)
+ *   DC           clear the log, including the EEPROM blocks
+ *   DI<seconds>  set the logging interval (1-3600, until reset)
+ *
+ * Dump layout (little-endian, as stored on the AVR):
+ *   SensorLogHeader, then count x SensorLogBlock oldest first,
+ *   then a uint16 sum of all preceding bytes.
+ * Block times count seconds since the reset that started them; a block
+ * flagged SENSOR_BLOCK_BOOT starts a new time base. The header's nowTick is
+ * the current time on that scale; blocks from bootSequence on were written
+ * since the last reset and can be dated with it.
+ */
+
+#ifndef SENSOR_LOG_H
+#define SENSOR_LOG_H
+
+#include <Arduino.h>
+
+#define SENSOR_LOG_TICK_MS 1000       // Time unit of the log
+#define SENSOR_LOG_BLOCK_BYTES 64
+#define SENSOR_LOG_DATA_BYTES (SENSOR_LOG_BLOCK_BYTES - 9)
+#define SENSOR_LOG_CHANNEL_BITS 2     // Low bits of a reading's first varint
+#define SENSOR_LOG_CRC_SEED 0x5A      // Nonzero, so a blank all-zero slot fails the CRC
+
+// Bits in SensorLogBlock::flags
+#define SENSOR_BLOCK_BOOT 0x01        // First block after a reset
+
+/**
+ * A block of readings, also the EEPROM record
+ */
+struct SensorLogBlock {
+  uint16_t sequence;    // One more than the previous block (wraps)
+  uint32_t startTick;   // Time of the first reading, seconds since reset
+  uint8_t flags;        // SENSOR_BLOCK_* bits
+  uint8_t length;       // Bytes of data in use
+  uint8_t crc;          // CRC-8 from SENSOR_LOG_CRC_SEED of the bytes above and data[0..length)
+  uint8_t data[SENSOR_LOG_DATA_BYTES];
+} __attribute__((packed));
+
+/**
+ * Dump header
+ */
+struct SensorLogHeader {
+  char magic[4];          // "SLOG"
+  uint8_t version;        // 2 (1: block CRCs started from 0)
+  uint8_t channels;       // SENSOR_CHANNELS
+  uint16_t tickMillis;    // SENSOR_LOG_TICK_MS
+  uint16_t intervalTicks; // Current logging interval
+  uint32_t nowTick;       // Time of the dump, seconds since reset
+  uint16_t bootSequence;  // Sequence of the first block since reset
+  uint16_t blockBytes;    // SENSOR_LOG_BLOCK_BYTES
+  uint16_t count;         // Blocks that follow
+} __attribute__((packed));
+
+/**
+ * Find the blocks spilled to EEPROM before the last reset
+ * Called once from setup().
+ */
+void initializeSensorLog();
+
+/**
+ * Sample the sensors, log a reading when one is due and continue the
+ * EEPROM spill
+ * Called from the main loop.
+ */
+void pollSensorLog();
+
+/**
+ * Handle a sensor log command (the text after the leading D)
+ *
+ * @param args "", "S", "R", "C" or "I<seconds>"
+ */
+void processSensorLogCommand(const char *args);
+
+#endif // SENSOR_LOG_H
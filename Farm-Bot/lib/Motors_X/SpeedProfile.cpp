@@ -0,0 +1,168 @@
+/**
+ * SpeedProfile.cpp
+ *
+ * Implementation of the runtime speed profile and its EEPROM record.
+ */
+
+#include "SpeedProfile.h"
+#include "Config.h"
+#include "HostSerial.h"
+#include <EEPROM.h>
+#include <util/crc16.h>
+
+#define PROFILE_MAGIC 0x5053  // "SP"
+#define PROFILE_VERSION 1
+
+/**
+ * EEPROM record at EEPROM_PROFILE_ADDRESS
+ */
+struct StoredSpeedProfile {
+  uint16_t magic;
+  uint8_t version;
+  uint16_t minStepDelay;
+  uint16_t maxStepDelay;
+  uint16_t accelRate;
+  uint16_t decelRate;
+  int16_t countsPerStepX256;
+  uint8_t crc;  // CRC-8 of all bytes before it
+} __attribute__((packed));
+
+static SpeedProfile activeProfile = { MIN_STEP_DELAY, MAX_STEP_DELAY, ACCEL_RATE, DECEL_RATE };
+static bool profileStored = false;
+static int storedCountsPerStep = 0;
+
+static uint8_t recordCrc(const StoredSpeedProfile &record) {
+  const uint8_t *bytes = (const uint8_t *)&record;
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < sizeof(StoredSpeedProfile) - 1; i++) {
+    crc = _crc8_ccitt_update(crc, bytes[i]);
+  }
+  return crc;
+}
+
+/**
+ * Get the Config.h profile
+ *
+ * @return Profile built from MIN_STEP_DELAY, MAX_STEP_DELAY, ACCEL_RATE and DECEL_RATE
+ */
+SpeedProfile getDefaultSpeedProfile() {
+  SpeedProfile profile = { MIN_STEP_DELAY, MAX_STEP_DELAY, ACCEL_RATE, DECEL_RATE };
+  return profile;
+}
+
+/**
+ * Check that a profile can be run safely
+ * Rejects delays below the auto-tune floor and rates that could not
+ * accelerate or decelerate at all.
+ *
+ * @param profile Profile to check
+ * @return TRUE if all values are in range
+ */
+bool isValidSpeedProfile(const SpeedProfile &profile) {
+  return profile.minStepDelay >= AUTOTUNE_FLOOR_STEP_DELAY &&
+         profile.minStepDelay <= profile.maxStepDelay &&
+         profile.maxStepDelay == MAX_STEP_DELAY &&
+         profile.accelRate >= 1 && profile.accelRate <= profile.maxStepDelay &&
+         profile.decelRate >= 1 && profile.decelRate <= profile.maxStepDelay;
+}
+
+/**
+ * Load the stored profile, or the Config.h defaults if none is stored
+ * A record whose magic, version, CRC or values do not check out is ignored.
+ */
+void initializeSpeedProfile() {
+  StoredSpeedProfile record;
+  EEPROM.get(EEPROM_PROFILE_ADDRESS, record);
+
+  activeProfile = getDefaultSpeedProfile();
+  profileStored = false;
+  storedCountsPerStep = 0;
+  if (record.magic != PROFILE_MAGIC || record.version != PROFILE_VERSION ||
+      record.crc != recordCrc(record)) {
+    return;
+  }
+
+  SpeedProfile stored = { (int)record.minStepDelay, (int)record.maxStepDelay,
+                          (int)record.accelRate, (int)record.decelRate };
+  if (!isValidSpeedProfile(stored)) return;
+  activeProfile = stored;
+  profileStored = true;
+  storedCountsPerStep = record.countsPerStepX256;
+}
+
+/**
+ * Get the profile used by moveSteps()
+ *
+ * @return Active profile
+ */
+const SpeedProfile &getSpeedProfile() {
+  return activeProfile;
+}
+
+/**
+ * Make a profile active and store it in EEPROM
+ * EEPROM.put() only rewrites bytes that changed, so repeating a run with
+ * the same result costs no EEPROM wear.
+ *
+ * @param profile Profile to store
+ * @param countsPerStepX256 Measured encoder counts per step, times 256
+ */
+void saveSpeedProfile(const SpeedProfile &profile, int countsPerStepX256) {
+  StoredSpeedProfile record;
+  record.magic = PROFILE_MAGIC;
+  record.version = PROFILE_VERSION;
+  record.minStepDelay = profile.minStepDelay;
+  record.maxStepDelay = profile.maxStepDelay;
+  record.accelRate = profile.accelRate;
+  record.decelRate = profile.decelRate;
+  record.countsPerStepX256 = countsPerStepX256;
+  record.crc = recordCrc(record);
+  EEPROM.put(EEPROM_PROFILE_ADDRESS, record);
+
+  activeProfile = profile;
+  profileStored = true;
+  storedCountsPerStep = countsPerStepX256;
+}
+
+/**
+ * Return to the Config.h profile and invalidate the stored record
+ */
+void resetSpeedProfile() {
+  if (profileStored) EEPROM.update(EEPROM_PROFILE_ADDRESS, 0xFF);  // Breaks the magic
+  activeProfile = getDefaultSpeedProfile();
+  profileStored = false;
+  storedCountsPerStep = 0;
+}
+
+/**
+ * TRUE if the active profile was loaded from or saved to EEPROM
+ */
+bool isSpeedProfileStored() {
+  return profileStored;
+}
+
+/**
+ * Encoder counts per step stored with the profile, times 256
+ *
+ * @return ENCODER_COUNTS_PER_STEP_X256 when set in Config.h, else the stored
+ *         value, or 0 if unknown
+ */
+int getCountsPerStepX256() {
+  if (ENCODER_COUNTS_PER_STEP_X256 != 0) return ENCODER_COUNTS_PER_STEP_X256;
+  return storedCountsPerStep;
+}
+
+/**
+ * Print the active profile as "min,max,accel,decel" followed by its source
+ * The format matches plan_visits --profile.
+ */
+void printSpeedProfile() {
+  HostSerial.print(activeProfile.minStepDelay);
+  HostSerial.print(F(","));
+  HostSerial.print(activeProfile.maxStepDelay);
+  HostSerial.print(F(","));
+  HostSerial.print(activeProfile.accelRate);
+  HostSerial.print(F(","));
+  HostSerial.print(activeProfile.decelRate);
+  HostSerial.println(profileStored ? F(" (auto-tuned, EEPROM)") : F(" (Config.h defaults)"));
+}
@@ -0,0 +1,87 @@
+/**
+ * SpeedProfile.h
+ *
+ * Header file for the runtime speed profile of the FarmBot X-Axis controller.
+ *
+ * moveSteps() takes its step delays from the active profile instead of the
+ * Config.h constants, so each machine can run with the profile the auto-tune
+ * command measured for it. The profile is kept in EEPROM with a magic number,
+ * a version and a CRC; a missing or damaged record falls back to Config.h.
+ */
+
+#ifndef SPEED_PROFILE_H
+#define SPEED_PROFILE_H
+
+#include <Arduino.h>
+
+/**
+ * Step timing used by moveSteps(), in microseconds
+ */
+struct SpeedProfile {
+  int minStepDelay;  // Cruise delay (fastest speed)
+  int maxStepDelay;  // Start and stop delay (slowest speed)
+  int accelRate;     // Delay removed per step while accelerating
+  int decelRate;     // Delay added per step while decelerating
+};
+
+/**
+ * Load the stored profile, or the Config.h defaults if none is stored
+ * Called once from setup().
+ */
+void initializeSpeedProfile();
+
+/**
+ * Get the profile used by moveSteps()
+ *
+ * @return Active profile
+ */
+const SpeedProfile &getSpeedProfile();
+
+/**
+ * Get the Config.h profile
+ *
+ * @return Profile built from MIN_STEP_DELAY, MAX_STEP_DELAY, ACCEL_RATE and DECEL_RATE
+ */
+SpeedProfile getDefaultSpeedProfile();
+
+/**
+ * Check that a profile can be run safely
+ *
+ * @param profile Profile to check
+ * @return TRUE if all values are in range
+ */
+bool isValidSpeedProfile(const SpeedProfile &profile);
+
+/**
+ * Make a profile active and store it in EEPROM
+ *
+ * @param profile Profile to store
+ * @param countsPerStepX256 Measured encoder counts per step, times 256
+ */
+void saveSpeedProfile(const SpeedProfile &profile, int countsPerStepX256);
+
+/**
+ * Return to the Config.h profile and invalidate the stored record
+ */
+void resetSpeedProfile();
+
+/**
+ * TRUE if the active profile was loaded from or saved to EEPROM
+ */
+bool isSpeedProfileStored();
+
+/**
+ * Encoder counts per step stored with the profile, times 256
+ *
+ * @return ENCODER_COUNTS_PER_STEP_X256 when set in Config.h, else the stored
+ *         value, or 0 if unknown
+ */
+int getCountsPerStepX256();
+
+/**
+ * Print the active profile as "min,max,accel,decel" followed by its source
+ * The format matches plan_visits --profile.
+ */
+void printSpeedProfile();
+
+#endif // SPEED_PROFILE_H
@@ -0,0 +1,292 @@
+/**
+ * VelocityEstimator.cpp
+ *
+ * Implementation of the input capture speed estimate and speed trim.
+ */
+
+#include "VelocityEstimator.h"
+#include "HostSerial.h"
+#include "MotionState.h"
+#include "SpeedProfile.h"
+#include <util/atomic.h>
+
+#define TIMER_TICKS_PER_US 2     // Timer 4 at F_CPU / 8
+#define CYCLES_PER_TIMER_TICK 8
+#define TICK_TIMER_TICKS ((uint16_t)(VELOCITY_TICK_US * TIMER_TICKS_PER_US))
+#define STOPPED_TIMER_TICKS ((uint32_t)VELOCITY_STOPPED_US * TIMER_TICKS_PER_US)
+#define COUNTS_PER_EDGE 4        // One rising edge of channel A per quadrature cycle
+
+// Overflows counted since the last edge that prove it is older than
+// STOPPED_TIMER_TICKS. One more than the whole 16-bit periods it spans, as an
+// overflow pending at a capture is counted after it (the capture interrupt
+// has priority).
+#define STOPPED_OVERFLOWS ((STOPPED_TIMER_TICKS >> 16) + 2)
+
+static_assert(VELOCITY_TICK_US * TIMER_TICKS_PER_US < 65536L,
+              "VELOCITY_TICK_US must fit the 16-bit timer (at most 32767)");
+static_assert(VELOCITY_STOPPED_US * TIMER_TICKS_PER_US < 65536L,
+              "VELOCITY_STOPPED_US must fit the 16-bit timer (at most 32767)");
+static_assert(VELOCITY_COUNTING_MIN_EDGES >= 2, "Counting needs at least two edges");
+
+// Written by the interrupts. Timestamps are Timer 4 ticks extended to
+// 32 bits with the overflow count.
+static volatile uint16_t timerOverflows = 0;
+static volatile uint32_t captureStamp = 0;   // Last rising edge of channel A
+static volatile uint32_t capturePeriod = 0;  // Time between the last two edges
+static volatile uint8_t captureEdges = 0;    // Edges seen, wraps
+static volatile uint8_t overflowsSinceEdge = 255;  // Saturates; the 32-bit stamps wrap every 35.8 min
+
+// Estimator state, main loop only
+static uint8_t tickEdges = 0;       // captureEdges at the last estimate
+static uint32_t tickStamp = 0;      // captureStamp at the last estimate
+static bool spanValid = false;      // tickStamp was taken during this move
+static uint16_t edgePeriod = 0;     // Timer ticks per edge of the last estimate, 0 = stopped
+static uint8_t lastMethod = VELOCITY_METHOD_NONE;
+static long lastEncoder = 0;
+static bool reverse = false;        // Encoder count was falling at the last change
+
+// Cost of the control tick
+static uint16_t lastTickCycles = 0;
+static uint16_t worstTickCycles = 0;
+static unsigned int ticksOverBudget = 0;
+
+int velocityTrimUs = 0;
+#if VELOCITY_PI_ENABLED
+static bool trimActive = false;
+static long trimIntegral = 0;       // In 1/16 us
+static int countsPerStepX256 = 0;   // Absolute value, 0 = unknown (no trim)
+#endif
+
+/**
+ * Rising edge on the capture pin
+ * An overflow that is still pending happened before the capture if the
+ * captured value is small, and must be counted with it. The first edge after
+ * a stop has no usable period (the stamps may have wrapped since).
+ */
+ISR(TIMER4_CAPT_vect) {
+  uint16_t capture = ICR4;
+  uint16_t high = timerOverflows;
+  if ((TIFR4 & (1 << TOV4)) && capture < 0x8000) high++;
+  uint32_t stamp = ((uint32_t)high << 16) | capture;
+  capturePeriod = overflowsSinceEdge > STOPPED_OVERFLOWS ? 0xFFFFFFFFUL : stamp - captureStamp;
+  captureStamp = stamp;
+  captureEdges++;
+  overflowsSinceEdge = 0;
+}
+
+/**
+ * Timer 4 wrapped (every 32.8 ms)
+ */
+ISR(TIMER4_OVF_vect) {
+  timerOverflows++;
+  if (overflowsSinceEdge != 255) overflowsSinceEdge++;
+}
+
+/**
+ * Read the extended timer (interrupts must be disabled)
+ *
+ * @return Timer 4 ticks, 32 bits
+ */
+static uint32_t readTimer() {
+  uint16_t low = TCNT4;
+  uint16_t high = timerOverflows;
+  if ((TIFR4 & (1 << TOV4)) && low < 0x8000) high++;
+  return ((uint32_t)high << 16) | low;
+}
+
+/**
+ * Set up Timer 4 for input capture and the capture pin
+ * Called once from setup(), after initializeEncoder().
+ */
+void initializeVelocityEstimator() {
+  pinMode(ENCODER_CAPTURE_PIN, INPUT_PULLUP);
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    // Normal mode, outputs disconnected, clk/8, noise canceler, rising edges
+    TCCR4A = 0;
+    TCCR4B = (1 << ICNC4) | (1 << ICES4) | (1 << CS41);
+    TCCR4C = 0;
+    TCNT4 = 0;
+    OCR4A = TICK_TIMER_TICKS;  // Polled by velocityStepDelay(), no interrupt
+    TIFR4 = (1 << ICF4) | (1 << OCF4A) | (1 << TOV4);
+    TIMSK4 = (1 << ICIE4) | (1 << TOIE4);
+  }
+}
+
+/**
+ * Start a new move: clear the trim and the edge history
+ * Takes the encoder counts per step for the trim from getCountsPerStepX256().
+ */
+void velocityMoveStart() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    tickEdges = captureEdges;
+    tickStamp = captureStamp;
+    OCR4A = TCNT4 + TICK_TIMER_TICKS;
+    TIFR4 = 1 << OCF4A;
+  }
+  spanValid = false;
+  lastEncoder = readEncoderPosition();
+#if VELOCITY_PI_ENABLED
+  countsPerStepX256 = abs(getCountsPerStepX256());
+#endif
+  velocitySetCruise(false);
+}
+
+/**
+ * Enable or disable the speed trim
+ * Called when a move enters and leaves its cruise phase; the trim and its
+ * integral restart at zero each time. Does nothing without VELOCITY_PI_ENABLED.
+ *
+ * @param cruising TRUE while the commanded delay is constant
+ */
+void velocitySetCruise(bool cruising) {
+#if VELOCITY_PI_ENABLED
+  trimActive = cruising;
+  trimIntegral = 0;
+  velocityTrimUs = 0;
+#else
+  (void)cruising;
+#endif
+}
+
+/**
+ * Update the estimate from the edges captured since the last call
+ * Picks counting when enough edges arrived, else 1/T.
+ */
+static void updateEstimate() {
+  uint32_t stamp, period, now;
+  uint8_t edges, overflows;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    stamp = captureStamp;
+    period = capturePeriod;
+    edges = captureEdges;
+    overflows = overflowsSinceEdge;
+    now = readTimer();
+  }
+
+  uint8_t newEdges = edges - tickEdges;
+  uint32_t span = stamp - tickStamp;
+  tickEdges = edges;
+  tickStamp = stamp;
+
+  if (spanValid && newEdges >= VELOCITY_COUNTING_MIN_EDGES && span <= 0xFFFF) {
+    // Counting: newEdges whole periods between the last edges of two ticks
+    edgePeriod = (uint16_t)span / newEdges;
+    lastMethod = VELOCITY_METHOD_COUNTING;
+  } else if (overflows > STOPPED_OVERFLOWS) {
+    // The last edge is too old for now - stamp, which wraps
+    edgePeriod = 0;
+    lastMethod = VELOCITY_METHOD_PERIOD;
+  } else {
+    // 1/T: once the time since the last edge is longer than the last
+    // period, the motor is slowing down and that time is the better bound
+    uint32_t sinceEdge = now - stamp;
+    if (sinceEdge > period) period = sinceEdge;
+    edgePeriod = period > STOPPED_TIMER_TICKS ? 0 : (uint16_t)period;
+    lastMethod = VELOCITY_METHOD_PERIOD;
+  }
+  if (newEdges > 0) spanValid = true;
+
+  long encoder = readEncoderPosition();
+  if (encoder != lastEncoder) reverse = encoder < lastEncoder;
+  lastEncoder = encoder;
+}
+
+#if VELOCITY_PI_ENABLED
+#define TRIM_LIMIT_X16 ((long)VELOCITY_TRIM_LIMIT_US * 16)
+#define ERROR_LIMIT_X16 2048L  // Larger errors (128 us) are clipped
+
+/**
+ * PI step: trim the delay so the interval seen by the encoder matches it
+ * Skipped while stopped, so a stalled motor does not wind the trim up.
+ *
+ * @param stepDelay Commanded delay in microseconds
+ */
+static void updateTrim(int stepDelay) {
+  if (!trimActive || countsPerStepX256 == 0 || edgePeriod == 0) return;
+
+  // Step interval seen by the encoder in 1/16 us: edgePeriod / 2 us per
+  // 4 counts, times counts per step
+  long measured = ((uint32_t)edgePeriod * countsPerStepX256) >> 7;
+  long error = constrain(((long)stepDelay << 4) - measured, -ERROR_LIMIT_X16, ERROR_LIMIT_X16);
+
+  trimIntegral = constrain(trimIntegral + VELOCITY_PI_KI_X256 * error / 256,
+                           -TRIM_LIMIT_X16, TRIM_LIMIT_X16);
+  long trim = constrain(trimIntegral + VELOCITY_PI_KP_X256 * error / 256,
+                        -TRIM_LIMIT_X16, TRIM_LIMIT_X16);
+  velocityTrimUs = trim / 16;
+}
+#endif
+
+/**
+ * Run the control tick that is due and get the delay for the current step
+ * Called by velocityStepDelay() when the Timer 4 compare flag is set.
+ *
+ * @param stepDelay Commanded delay of this step in microseconds
+ * @return stepDelay plus the trim, minus the time the tick took
+ */
+int velocityRunTick(int stepDelay) {
+  uint16_t start, end;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    start = TCNT4;
+    OCR4A = start + TICK_TIMER_TICKS;
+    TIFR4 = 1 << OCF4A;
+  }
+
+  updateEstimate();
+#if VELOCITY_PI_ENABLED
+  updateTrim(stepDelay);
+#endif
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    end = TCNT4;
+  }
+  uint16_t spent = end - start;
+  lastTickCycles = spent * CYCLES_PER_TIMER_TICK;
+  if (lastTickCycles > worstTickCycles) worstTickCycles = lastTickCycles;
+  if (lastTickCycles > VELOCITY_TICK_BUDGET_CYCLES) ticksOverBudget++;
+
+  return stepDelay + velocityTrimUs - spent / TIMER_TICKS_PER_US;
+}
+
+/**
+ * Get the current speed from the encoder
+ *
+ * @return Encoder counts per second, signed like the encoder count (0 when stopped)
+ */
+long getEncoderVelocity() {
+  updateEstimate();
+  if (edgePeriod == 0) return 0;
+  long speed = (long)COUNTS_PER_EDGE * TIMER_TICKS_PER_US * 1000000L / edgePeriod;
+  return reverse ? -speed : speed;
+}
+
+/**
+ * Print the speed, the method used, the speed trim and the tick cost
+ * For the status report (R).
+ */
+void printVelocityReport() {
+  HostSerial.print(F("Encoder velocity: "));
+  HostSerial.print(getEncoderVelocity());
+  HostSerial.print(F(" counts/s ("));
+  HostSerial.print(lastMethod == VELOCITY_METHOD_COUNTING ? F("counting") : F("1/T"));
+  HostSerial.println(F(")"));
+
+  HostSerial.print(F("Velocity tick: "));
+  HostSerial.print(lastTickCycles);
+  HostSerial.print(F(" cycles last, "));
+  HostSerial.print(worstTickCycles);
+  HostSerial.print(F(" worst of "));
+  HostSerial.print(VELOCITY_TICK_BUDGET_CYCLES);
+  HostSerial.print(F(" budget ("));
+  HostSerial.print(ticksOverBudget);
+  HostSerial.println(F(" over)"));
+
+#if VELOCITY_PI_ENABLED
+  HostSerial.print(F("Speed trim: "));
+  HostSerial.print(velocityTrimUs);
+  HostSerial.println(F(" us"));
+#else
+  HostSerial.println(F("Speed trim: off"));
+#endif
+}
@@ -0,0 +1,100 @@
+/**
+ * VelocityEstimator.h
+ *
+ * Header file for the encoder velocity estimate of the FarmBot X-Axis controller.
+ *
+ * Encoder channel A is also wired to the Timer 4 input capture pin (ICP4,
+ * ENCODER_CAPTURE_PIN). Timer 4 runs freely at 0.5 us per tick and latches
+ * the time of every rising edge of A, one edge per 4 encoder counts, without
+ * interrupt latency in the timestamp. The capture interrupt only stores the
+ * timestamp and the period since the previous edge.
+ *
+ * Every VELOCITY_TICK_US during a move the step loop runs one control tick:
+ *   - at low speed (fewer than VELOCITY_COUNTING_MIN_EDGES edges since the
+ *     last tick) the speed is 1/T of the last edge period, or of the time
+ *     since the last edge once that is longer (the motor is slowing down);
+ *   - at high speed the edges of the tick are counted and divided by the
+ *     time between the first and last of them, which averages out the
+ *     0.5 us timestamp quantization that limits 1/T at short periods.
+ * With VELOCITY_PI_ENABLED an integer PI loop then trims the cruise step
+ * interval so the speed seen by the encoder matches the commanded delay
+ * (the step loop overhead otherwise makes every step a little longer).
+ *
+ * The tick has no loops and at most one 16-bit division. Its cost is
+ * measured with Timer 4 on every tick, taken off the following step delay,
+ * and reported by R against VELOCITY_TICK_BUDGET_CYCLES.
+ *
+ * Timer 4 is no longer available to analogWrite() (pins 6, 7 and 8).
+ */
+
+#ifndef VELOCITY_ESTIMATOR_H
+#define VELOCITY_ESTIMATOR_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+// Estimation method of the last tick
+#define VELOCITY_METHOD_NONE 0      // No tick yet
+#define VELOCITY_METHOD_PERIOD 1    // 1/T of one edge period
+#define VELOCITY_METHOD_COUNTING 2  // Edges counted over the tick
+
+/**
+ * Set up Timer 4 for input capture and the capture pin
+ * Called once from setup(), after initializeEncoder().
+ */
+void initializeVelocityEstimator();
+
+/**
+ * Start a new move: clear the trim and the edge history
+ * Takes the encoder counts per step for the trim from getCountsPerStepX256().
+ */
+void velocityMoveStart();
+
+/**
+ * Enable or disable the speed trim
+ * Called when a move enters and leaves its cruise phase; the trim and its
+ * integral restart at zero each time. Does nothing without VELOCITY_PI_ENABLED.
+ *
+ * @param cruising TRUE while the commanded delay is constant
+ */
+void velocitySetCruise(bool cruising);
+
+// Current trim in microseconds (0 unless trimming a cruise)
+extern int velocityTrimUs;
+
+/**
+ * Run the control tick that is due and get the delay for the current step
+ * Called by velocityStepDelay() when the Timer 4 compare flag is set.
+ *
+ * @param stepDelay Commanded delay of this step in microseconds
+ * @return stepDelay plus the trim, minus the time the tick took
+ */
+int velocityRunTick(int stepDelay);
+
+/**
+ * Get the delay to wait after the current step
+ * Called once per step by stepMotor(). Testing the compare flag that marks a
+ * due tick is a single register read, cheap enough for every step.
+ *
+ * @param stepDelay Commanded delay of this step in microseconds
+ * @return Delay to wait in microseconds
+ */
+inline int velocityStepDelay(int stepDelay) {
+  if (TIFR4 & (1 << OCF4A)) return velocityRunTick(stepDelay);
+  return stepDelay + velocityTrimUs;
+}
+
+/**
+ * Get the current speed from the encoder
+ *
+ * @return Encoder counts per second, signed like the encoder count (0 when stopped)
+ */
+long getEncoderVelocity();
+
+/**
+ * Print the speed, the method used, the speed trim and the tick cost
+ * For the status report (R).
+ */
+void printVelocityReport();
+
+#endif // VELOCITY_ESTIMATOR_H
@@ -0,0 +1,85 @@
+"""
+check_sram.py
+
+PlatformIO post-build check for the static-memory firmware.
+
+Fails the build when
+  - static RAM (.data + .bss + .noinit) plus STACK_RESERVE_BYTES exceeds
+    SRAM_BUDGET_BYTES, both read from lib/Motors_X/Config.h
+  - the heap allocator or the Arduino String class is linked in
+
+Registered in platformio.ini with: extra_scripts = post:scripts/check_sram.py
+"""
+
+import os
+import re
+import subprocess
+
+Import("env")  # noqa: F821 (provided by PlatformIO)
+
+CONFIG_HEADER = os.path.join("lib", "Motors_X", "Config.h")
+RAM_SECTIONS = (".data", ".bss", ".noinit")
+# Symbols that mean something allocates from the heap
+HEAP_SYMBOLS = ("malloc", "free", "realloc", "calloc", "_Znwj", "_Znaj")
+STRING_PREFIX = "_ZN6String"
+
+
+def read_define(name):
+    path = os.path.join(env.subst("$PROJECT_DIR"), CONFIG_HEADER)  # noqa: F821
+    with open(path) as header:
+        match = re.search(r"^\s*#define\s+%s\s+(\d+)" % name, header.read(), re.MULTILINE)
+    if not match:
+        raise ValueError("%s not defined in %s" % (name, CONFIG_HEADER))
+    return int(match.group(1))
+
+
+def tool(name):
+    # avr-size is configured as SIZETOOL; avr-nm sits next to it
+    size_tool = env.subst("$SIZETOOL")  # noqa: F821
+    return size_tool[: -len("size")] + name if size_tool.endswith("size") else "avr-" + name
+
+
+def static_ram_bytes(elf):
+    output = subprocess.check_output([tool("size"), "-A", elf], universal_newlines=True)
+    total = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0] in RAM_SECTIONS:
+            total += int(fields[1])
+    return total
+
+
+def heap_users(elf):
+    output = subprocess.check_output([tool("nm"), elf], universal_newlines=True)
+    found = []
+    for line in output.splitlines():
+        fields = line.split()
+        if not fields:
+            continue
+        symbol = fields[-1].split("@")[0]  # Drop version suffixes (malloc@GLIBC_2.2.5)
+        if symbol in HEAP_SYMBOLS or symbol.startswith(STRING_PREFIX):
+            found.append(symbol)
+    return sorted(set(found))
+
+
+def check_sram(source, target, env):
+    elf = str(source[0])
+    budget = read_define("SRAM_BUDGET_BYTES")
+    reserve = read_define("STACK_RESERVE_BYTES")
+    used = static_ram_bytes(elf)
+
+    print("SRAM: %d static + %d stack reserve = %d of %d bytes"
+          % (used, reserve, used + reserve, budget))
+    failed = False
+    if used + reserve > budget:
+        print("ERROR: static RAM leaves less than STACK_RESERVE_BYTES for the stack")
+        failed = True
+    users = heap_users(elf)
+    if users:
+        print("ERROR: heap allocation linked in: %s" % ", ".join(users))
+        failed = True
+    if failed:
+        env.Exit(1)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_sram)  # noqa: F821
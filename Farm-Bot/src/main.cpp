@@ -7,25 +7,35 @@
 
 // Include all module headers
 #include "Config.h"
+#include "HostSerial.h"
 #include "MotorControl.h"
 #include "PositionManager.h"
 #include "EncoderInterface.h"
+#include "VelocityEstimator.h"
 #include "LimitSwitch.h"
 #include "CommandProcessor.h"
 #include "SystemOperations.h"
+#include "SpeedProfile.h"
+#include "SensorInput.h"
+#include "SensorLog.h"
 
 /**
  * Print welcome message with available commands
  */
 void printWelcomeMessage() {
-  Serial.println("\n----- FarmBot X-Axis Controller (Simple) -----");
-  Serial.println("System Ready. Available commands:");
-  Serial.println("  X#### or X-#### - Move relative steps (e.g., X1000)");
-  Serial.println("  H - Run homing sequence");
-  Serial.println("  R - Report current position");
-  Serial.println("  S - Stop movement immediately");
-  Serial.println("-------------------------------------");
-  Serial.println("IMPORTANT: Please run homing (H) after power-up to establish position reference.");
+  HostSerial.println(F("\n----- FarmBot X-Axis Controller (Simple) -----"));
+  HostSerial.println(F("System Ready. Available commands:"));
+  HostSerial.println(F("  X#### or X-#### - Move relative steps (e.g., X1000)"));
+  HostSerial.println(F("  H - Run homing sequence"));
+  HostSerial.println(F("  R - Report current position"));
+  HostSerial.println(F("  A - Auto-tune speed profile (A, AP, AR)"));
+  HostSerial.println(F("  T - Motion trace (T, TF, TD, TO, TN#, TS)"));
+  HostSerial.println(F("  D - Sensor log (D, DS, DR, DC, DI#)"));
+  HostSerial.println(F("  C - Clear emergency stop"));
+  HostSerial.println(F("  Ctrl-X / ! / ~ - Stop / feed hold / resume, also during moves"));
+  HostSerial.println(F("  S - Stop movement immediately"));
+  HostSerial.println(F("-------------------------------------"));
+  HostSerial.println(F("IMPORTANT: Please run homing (H) after power-up to establish position reference."));
 }
 
 /**
@@ -33,17 +43,25 @@ void printWelcomeMessage() {
  * Runs once when the Arduino powers on or resets
  */
 void setup() {
-  // Initialize serial communication
-  Serial.begin(SERIAL_BAUD_RATE);
+  // Initialize serial communication (realtime bytes are handled in its receive interrupt)
+  HostSerial.begin(SERIAL_BAUD_RATE);
+  
+  // Load the auto-tuned speed profile from EEPROM (Config.h defaults if none)
+  initializeSpeedProfile();
   
   // Initialize motor control pins
   initializeMotor();
   
   // Initialize encoder interface
   initializeEncoder();
+  initializeVelocityEstimator();
   
   // Initialize limit switch
   initializeLimitSwitch();
+
+  // Initialize soil sensors and find the sensor log blocks kept in EEPROM
+  initializeSensors();
+  initializeSensorLog();
   
   // Print welcome message and available commands
   printWelcomeMessage();
@@ -55,11 +73,8 @@ void setup() {
  */
 void loop() {
   // Check for and process serial commands
-  if (Serial.available()) {
-    String input = Serial.readStringUntil('\n');
-    input.trim();
-    
-    // Process the command
-    processCommand(input);
-  }
+  pollSerialCommands();
+
+  // Sample the soil sensors and log a reading when one is due
+  pollSensorLog();
 }
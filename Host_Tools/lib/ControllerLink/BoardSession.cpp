@@ -0,0 +1,238 @@
+/**
+ * BoardSession.cpp
+ *
+ * Implementation of the per-board command pipeline.
+ */
+
+#include "BoardSession.h"
+#include "SerialPort.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+// Last banner line printed by printWelcomeMessage() after a reset
+#define BANNER_LAST_LINE "IMPORTANT: Please run homing"
+
+static long microsBetween(BoardTime from, BoardTime to) {
+  return (long)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+BoardSession::BoardSession(const std::string &name, const std::string &path, int window)
+  : name_(name), path_(path), fd_(-1), window_(window < 1 ? 1 : window), ready_(false),
+    echoesSeen_(0), echoedInFlight_(0), held_(false), positionKnown_(false), position_(0), completedCount_(0) {}
+
+BoardSession::~BoardSession() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool BoardSession::open(long baud, std::string &error) {
+  fd_ = openSerialPort(path_.c_str(), baud, error);
+  if (fd_ < 0) return false;
+  ready_ = false;
+  openedAt_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+/**
+ * Time budget per command letter
+ * Homing crosses the whole axis twice at the slowest speed; moves are bounded
+ * by the axis length. Everything else answers immediately.
+ */
+long BoardSession::timeoutMillis(const std::string &command) {
+  char letter = command.empty() ? 0 : command[0];
+  switch (letter) {
+    case 'A': return 900000;  // Auto-tune runs dozens of test moves
+    case 'H': return 600000;
+    case 'X': return 300000;
+    default: return 5000;
+  }
+}
+
+void BoardSession::submit(const BoardCommand &command, bool urgent) {
+  if (urgent) {
+    queue_.push_front(command);
+    queue_.front().urgent = true;
+  } else {
+    queue_.push_back(command);
+    queue_.back().urgent = false;
+  }
+}
+
+void BoardSession::sendRealtime(char byte) {
+  realtime_ += byte;
+  if (byte == BOARD_REALTIME_HOLD) {
+    held_ = !inFlight_.empty();
+  } else if (held_) {
+    // Resumed or stopped: the running command gets its full time budget again
+    held_ = false;
+    frontSince_ = std::chrono::steady_clock::now();
+  }
+}
+
+size_t BoardSession::unechoedBytes() const {
+  size_t bytes = 0;
+  for (size_t i = echoedInFlight_; i < inFlight_.size(); i++) {
+    bytes += inFlight_[i].text.size() + 1;
+  }
+  return bytes;
+}
+
+void BoardSession::send(BoardCommand &command, BoardTime now) {
+  command.sentAt = now;
+  output_ += command.text;
+  output_ += '\n';
+  if (inFlight_.empty()) frontSince_ = now;
+  inFlight_.push_back(command);
+}
+
+void BoardSession::complete(const CommandReply &reply, BoardTime now,
+                            std::vector<BoardCompletion> &completions) {
+  if (reply.hasPosition) {
+    positionKnown_ = true;
+    position_ = reply.position;
+  }
+  if (inFlight_.empty()) return;  // Reply to a command sent by someone else
+
+  BoardCompletion done;
+  done.command = inFlight_.front();
+  done.reply = reply;
+  done.latencyMicros = microsBetween(done.command.sentAt, now);
+  done.queueMicros = microsBetween(done.command.queuedAt, done.command.sentAt);
+  inFlight_.pop_front();
+  if (echoedInFlight_ > 0) echoedInFlight_--;
+  frontSince_ = now;
+  held_ = false;
+  completedCount_++;
+  completions.push_back(done);
+}
+
+bool BoardSession::readAvailable(std::vector<BoardCompletion> &completions,
+                                 std::vector<std::string> &events) {
+  char buffer[4096];
+  BoardTime now = std::chrono::steady_clock::now();
+  for (;;) {
+    ssize_t count = read(fd_, buffer, sizeof(buffer));
+    if (count == 0) return false;
+    if (count < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if (errno == EINTR) continue;
+      return false;
+    }
+
+    std::vector<CommandReply> replies;
+    std::vector<std::string> lines;
+    parser_.feed(buffer, (size_t)count, replies, lines);
+
+    // Every echo means one more command left the firmware's receive buffer
+    long echoes = parser_.echoCount();
+    echoedInFlight_ += (size_t)(echoes - echoesSeen_);
+    if (echoedInFlight_ > inFlight_.size()) echoedInFlight_ = inFlight_.size();
+    echoesSeen_ = echoes;
+
+    for (size_t i = 0; i < replies.size(); i++) complete(replies[i], now, completions);
+
+    for (size_t i = 0; i < lines.size(); i++) {
+      if (lines[i].compare(0, strlen(BANNER_LAST_LINE), BANNER_LAST_LINE) == 0) {
+        // The board (re)started: whatever was in flight is lost
+        if (ready_) failInFlight(REPLY_ERROR, completions);
+        ready_ = true;
+        positionKnown_ = false;
+      }
+      events.push_back(lines[i]);
+    }
+  }
+  return true;
+}
+
+void BoardSession::pump(BoardTime now, std::vector<BoardCompletion> &completions) {
+  if (!ready_ && microsBetween(openedAt_, now) > BOARD_READY_TIMEOUT_MS * 1000L) {
+    // No banner: the board did not reset on open and is already running
+    ready_ = true;
+  }
+
+  // Time out the command the firmware is working on. Its clock starts when
+  // the previous command finished, not when it was sent.
+  if (!inFlight_.empty() && !held_) {
+    const BoardCommand &front = inFlight_.front();
+    if (microsBetween(frontSince_, now) > timeoutMillis(front.text) * 1000L) {
+      std::vector<CommandReply> partial;
+      parser_.abandon(REPLY_TIMEOUT, partial);
+      if (partial.empty()) {
+        CommandReply reply;
+        reply.command = front.text;
+        reply.status = REPLY_TIMEOUT;
+        reply.hasPosition = false;
+        reply.position = 0;
+        partial.push_back(reply);
+      }
+      complete(partial[0], now, completions);
+    }
+  }
+
+  if (!ready_) return;
+  while (!queue_.empty()) {
+    BoardCommand &next = queue_.front();
+    if (!next.urgent) {
+      if ((int)inFlight_.size() >= window_) break;
+      if (unechoedBytes() + next.text.size() + 1 > BOARD_RX_BYTE_BUDGET) break;
+    }
+    send(next, now);
+    queue_.pop_front();
+  }
+}
+
+bool BoardSession::flush() {
+  while (!realtime_.empty() || !output_.empty()) {
+    std::string &pending = realtime_.empty() ? output_ : realtime_;
+    ssize_t count = write(fd_, pending.data(), pending.size());
+    if (count < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+      if (errno == EINTR) continue;
+      return false;
+    }
+    pending.erase(0, (size_t)count);
+  }
+  return true;
+}
+
+void BoardSession::failInFlight(int status, std::vector<BoardCompletion> &completions) {
+  BoardTime now = std::chrono::steady_clock::now();
+  std::vector<CommandReply> partial;
+  parser_.abandon(status, partial);
+
+  CommandReply empty;
+  empty.status = status;
+  empty.hasPosition = false;
+  empty.position = 0;
+  while (!inFlight_.empty()) {
+    if (!partial.empty()) {
+      complete(partial[0], now, completions);
+      partial.clear();
+    } else {
+      empty.command = inFlight_.front().text;
+      complete(empty, now, completions);
+    }
+  }
+  echoedInFlight_ = 0;
+}
+
+void BoardSession::failAll(int status, std::vector<BoardCompletion> &completions) {
+  failInFlight(status, completions);
+
+  BoardTime now = std::chrono::steady_clock::now();
+  CommandReply empty;
+  empty.status = status;
+  empty.hasPosition = false;
+  empty.position = 0;
+  while (!queue_.empty()) {
+    BoardCommand &command = queue_.front();
+    command.sentAt = now;
+    inFlight_.push_back(command);
+    queue_.pop_front();
+    empty.command = command.text;
+    complete(empty, now, completions);
+  }
+  output_.clear();
+  realtime_.clear();
+}
@@ -0,0 +1,165 @@
+/**
+ * BoardSession.h
+ *
+ * Command pipeline for one controller board.
+ *
+ * Commands are queued per board and sent ahead of time (pipelined) so the
+ * firmware can start the next command as soon as the previous one finishes.
+ * Two limits keep the pipeline safe:
+ *   - window: commands sent but not finished
+ *   - byte budget: bytes sent but not yet echoed, so the AVR's 64-byte
+ *     receive buffer never overflows while the firmware is busy
+ * Urgent commands (emergency stop) skip the queue and the window.
+ *
+ * Realtime bytes (stop, feed hold, resume) are not commands: the firmware
+ * takes them out of the stream in its receive interrupt, even in the middle
+ * of a move. They are written ahead of any pending output and take no room
+ * in the window or the byte budget. A held move does not time out.
+ */
+
+#ifndef BOARD_SESSION_H
+#define BOARD_SESSION_H
+
+#include "ReplyParser.h"
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define BOARD_RX_BYTE_BUDGET 48   // Stay below the 64-byte firmware receive buffer
+#define BOARD_READY_TIMEOUT_MS 3000
+
+// Realtime bytes, must match REALTIME_* in Farm-Bot/lib/Motors_X/Config.h
+#define BOARD_REALTIME_STOP 0x18  // Ctrl-X
+#define BOARD_REALTIME_HOLD '!'
+#define BOARD_REALTIME_RESUME '~'
+
+typedef std::chrono::steady_clock::time_point BoardTime;
+
+/**
+ * A command submitted by a client
+ */
+struct BoardCommand {
+  long id;
+  int client;          // Client handle the reply is routed to
+  std::string text;    // Command without the newline
+  bool urgent;         // Bypasses the window and byte budget
+  BoardTime queuedAt;
+  BoardTime sentAt;
+};
+
+/**
+ * A finished command with its reply
+ */
+struct BoardCompletion {
+  BoardCommand command;
+  CommandReply reply;
+  long latencyMicros;  // From send to final line
+  long queueMicros;    // From submit to send
+};
+
+class BoardSession {
+public:
+  BoardSession(const std::string &name, const std::string &path, int window);
+  ~BoardSession();
+
+  /**
+   * Open the serial port
+   * The board resets on open; commands are held until its banner is seen.
+   *
+   * @return TRUE on success
+   */
+  bool open(long baud, std::string &error);
+
+  /**
+   * Queue a command
+   *
+   * @param command Command to send
+   * @param urgent Send ahead of everything else (emergency stop)
+   */
+  void submit(const BoardCommand &command, bool urgent);
+
+  /**
+   * Send a realtime byte ahead of everything else
+   *
+   * @param byte BOARD_REALTIME_STOP, BOARD_REALTIME_HOLD or BOARD_REALTIME_RESUME
+   */
+  void sendRealtime(char byte);
+
+  /**
+   * Read everything available from the port
+   *
+   * @param completions Receives finished commands
+   * @param events Receives lines printed outside of commands
+   * @return FALSE if the port failed or closed
+   */
+  bool readAvailable(std::vector<BoardCompletion> &completions, std::vector<std::string> &events);
+
+  /**
+   * Move queued commands into the output buffer as the window allows,
+   * and time out commands that have run too long
+   *
+   * @param now Current time
+   * @param completions Receives timed-out commands
+   */
+  void pump(BoardTime now, std::vector<BoardCompletion> &completions);
+
+  /**
+   * Write as much of the output buffer as the port accepts
+   *
+   * @return FALSE if the port failed
+   */
+  bool flush();
+
+  /**
+   * Drop every queued and in-flight command (e.g. when the port closes)
+   *
+   * @param status Status to report for them
+   * @param completions Receives the dropped commands
+   */
+  void failAll(int status, std::vector<BoardCompletion> &completions);
+
+  int fd() const { return fd_; }
+  const std::string &name() const { return name_; }
+  const std::string &path() const { return path_; }
+  int window() const { return window_; }
+  bool ready() const { return ready_; }
+  bool held() const { return held_; }
+  bool wantsWrite() const { return !realtime_.empty() || !output_.empty(); }
+  size_t queued() const { return queue_.size(); }
+  size_t inFlight() const { return inFlight_.size(); }
+  bool positionKnown() const { return positionKnown_; }
+  long position() const { return position_; }
+  long completedCount() const { return completedCount_; }
+
+private:
+  void complete(const CommandReply &reply, BoardTime now, std::vector<BoardCompletion> &completions);
+  void send(BoardCommand &command, BoardTime now);
+  void failInFlight(int status, std::vector<BoardCompletion> &completions);
+  size_t unechoedBytes() const;
+  static long timeoutMillis(const std::string &command);
+
+  std::string name_;
+  std::string path_;
+  int fd_;
+  int window_;
+  bool ready_;
+  BoardTime openedAt_;
+  ReplyParser parser_;
+  long echoesSeen_;
+
+  std::deque<BoardCommand> queue_;     // Waiting to be sent
+  std::deque<BoardCommand> inFlight_;  // Sent, oldest first
+  size_t echoedInFlight_;              // How many of inFlight_ the firmware has echoed
+  BoardTime frontSince_;               // When inFlight_.front() became the running command
+  std::string output_;
+  std::string realtime_;               // Realtime bytes, written before output_
+  bool held_;                          // Feed hold sent and not yet resumed or stopped
+
+  bool positionKnown_;
+  long position_;
+  long completedCount_;
+};
+
+#endif // BOARD_SESSION_H
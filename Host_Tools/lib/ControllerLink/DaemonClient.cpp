@@ -0,0 +1,113 @@
+/**
+ * DaemonClient.cpp
+ *
+ * Implementation of the blocking farmbotd client.
+ */
+
+#include "DaemonClient.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+DaemonClient::DaemonClient() : fd_(-1) {
+}
+
+DaemonClient::~DaemonClient() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool DaemonClient::connect(const char *path, std::string &error) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    error = std::string(path) + ": path too long";
+    return false;
+  }
+  strcpy(address.sun_path, path);
+
+  fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0 || ::connect(fd_, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    error = std::string(path) + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool DaemonClient::readLine(std::string &line) {
+  for (;;) {
+    size_t newline = input_.find('\n');
+    if (newline != std::string::npos) {
+      line = input_.substr(0, newline);
+      input_.erase(0, newline + 1);
+      return true;
+    }
+    char buffer[4096];
+    ssize_t count = read(fd_, buffer, sizeof(buffer));
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    input_.append(buffer, (size_t)count);
+  }
+}
+
+bool DaemonClient::run(const std::string &board, const std::string &command, DaemonReply &reply,
+                       std::string &error) {
+  std::string request = board + " " + command + "\n";
+  if (write(fd_, request.data(), request.size()) != (ssize_t)request.size()) {
+    error = std::string("write failed: ") + strerror(errno);
+    return false;
+  }
+
+  reply.lines.clear();
+  reply.binary.clear();
+  reply.status.clear();
+  reply.latencyMicros = 0;
+
+  // Lines of other commands on this connection cannot occur: requests are sent one at a time
+  std::string prefix;
+  std::string line;
+  while (readLine(line)) {
+    if (line.compare(0, 6, "ERROR ") == 0) {
+      error = line.substr(6);
+      return false;
+    }
+    if (prefix.empty()) {
+      // "<board> <id> QUEUED"
+      size_t queued = line.rfind(" QUEUED");
+      if (queued == std::string::npos || line.compare(0, board.size() + 1, board + " ") != 0) continue;
+      prefix = line.substr(0, queued) + " ";
+      continue;
+    }
+    if (line.compare(0, prefix.size(), prefix) != 0) continue;
+    std::string rest = line.substr(prefix.size());
+    if (rest.compare(0, 2, "> ") == 0) {
+      reply.lines.push_back(rest.substr(2));
+    } else if (rest.compare(0, 5, "DATA ") == 0) {
+      for (size_t i = 5; i + 1 < rest.size(); i += 2) {
+        int high = hexValue(rest[i]);
+        int low = hexValue(rest[i + 1]);
+        if (high < 0 || low < 0) break;
+        reply.binary.push_back((char)(high << 4 | low));
+      }
+    } else if (rest.compare(0, 5, "DONE ") == 0) {
+      // "DONE <status> <latency_us> [position]"
+      size_t space = rest.find(' ', 5);
+      reply.status = rest.substr(5, space == std::string::npos ? std::string::npos : space - 5);
+      if (space != std::string::npos) reply.latencyMicros = atol(rest.c_str() + space + 1);
+      return true;
+    }
+  }
+  error = "connection to farmbotd closed";
+  return false;
+}
@@ -0,0 +1,60 @@
+/**
+ * DaemonClient.h
+ *
+ * Blocking client for the farmbotd Unix socket, for command line tools that
+ * send a command to a board and wait for its reply (see farmbotd.cpp for the
+ * line protocol).
+ */
+
+#ifndef DAEMON_CLIENT_H
+#define DAEMON_CLIENT_H
+
+#include <string>
+#include <vector>
+
+#define DEFAULT_DAEMON_SOCKET "/tmp/farmbotd.sock"
+
+/**
+ * Reply to one command as relayed by farmbotd
+ */
+struct DaemonReply {
+  std::string status;              // "ok", "interrupted", "error", "unknown-command", "timeout"
+  long latencyMicros;
+  std::vector<std::string> lines;  // Firmware lines
+  std::string binary;              // Raw bytes from DATA lines
+};
+
+class DaemonClient {
+public:
+  DaemonClient();
+  ~DaemonClient();
+
+  /**
+   * Connect to the daemon
+   *
+   * @param path Socket path
+   * @param error Receives a description on failure
+   * @return TRUE on success
+   */
+  bool connect(const char *path, std::string &error);
+
+  /**
+   * Send a command to a board and wait until it is DONE
+   *
+   * @param board Board name as given to farmbotd --board
+   * @param command Firmware command, e.g. "TD"
+   * @param reply Receives the reply
+   * @param error Receives a description on failure
+   * @return FALSE if the daemon rejected the request or the connection closed
+   */
+  bool run(const std::string &board, const std::string &command, DaemonReply &reply,
+           std::string &error);
+
+private:
+  bool readLine(std::string &line);
+
+  int fd_;
+  std::string input_;
+};
+
+#endif // DAEMON_CLIENT_H
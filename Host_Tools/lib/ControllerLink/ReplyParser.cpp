@@ -0,0 +1,179 @@
+/**
+ * ReplyParser.cpp
+ *
+ * Implementation of the incremental firmware reply parser.
+ */
+
+#include "ReplyParser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ECHO_PREFIX "Command received: "
+#define BANNER_PREFIX "----- FarmBot X-Axis Controller"  // printWelcomeMessage() after a reset
+#define BINARY_MAX_BYTES 65536
+
+// Lines that announce raw bytes, followed by the byte count
+static const char *const BINARY_PREFIXES[] = {
+  "TRACE BEGIN ",  // dumpTrace()
+  "LOG BEGIN ",    // dumpSensorLog()
+};
+
+/**
+ * Last line the firmware prints for a command
+ * command 0 matches any command. Prefixes must stay in sync with the
+ * HostSerial.print texts in Farm-Bot/lib/Motors_X.
+ */
+struct TerminalRule {
+  char command;
+  const char *prefix;
+  int status;
+};
+
+static const TerminalRule TERMINAL_RULES[] = {
+  // processRelativeMove()
+  { 'X', "Distance from home:", REPLY_OK },
+  { 'X', "Current position after interruption:", REPLY_INTERRUPTED },
+  { 'X', "Zero steps requested", REPLY_OK },
+  { 'X', "Already at safe limit", REPLY_OK },
+  // runHoming()
+  { 'H', "Axis is now positioned at center", REPLY_OK },
+  { 'H', "Homing aborted", REPLY_INTERRUPTED },
+  { 'H', "Check limit switch wiring", REPLY_ERROR },
+  // reportStatus() closes with a line of 24 dashes
+  { 'R', "------------------------", REPLY_OK },
+  // emergencyStop()
+  { 'S', "EMERGENCY STOP TRIGGERED", REPLY_OK },
+  // clearEmergencyStop()
+  { 'C', "Emergency stop", REPLY_OK },
+  // processAutoTuneCommand(): AP and AR print one "Speed profile" line
+  { 'A', "Auto-tune complete", REPLY_OK },
+  { 'A', "Auto-tune aborted", REPLY_INTERRUPTED },
+  { 'A', "Auto-tune failed", REPLY_ERROR },
+  { 'A', "Auto-tune commands", REPLY_OK },
+  { 'A', "Speed profile", REPLY_OK },
+  // processTraceCommand(): every reply but the dump is one "Trace ..." line
+  { 'T', "Trace ", REPLY_OK },
+  { 'T', "TRACE END", REPLY_OK },
+  // processSensorLogCommand(): every reply but the dump is one "Sensor ..." line
+  { 'D', "Sensor ", REPLY_OK },
+  { 'D', "LOG END", REPLY_OK },
+  // motionBlocked(): X, H and A are refused while the emergency stop is latched
+  { 0, "ERROR: Emergency stop active", REPLY_ERROR },
+  // processCommand() help text for unknown commands
+  { 0, "  S - Stop movement immediately", REPLY_UNKNOWN_COMMAND },
+};
+
+static bool startsWith(const std::string &text, const char *prefix) {
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+ReplyParser::ReplyParser() : binaryRemaining_(0), inReply_(false), echoes_(0) {
+  current_.status = REPLY_OK;
+  current_.hasPosition = false;
+  current_.position = 0;
+}
+
+const char *ReplyParser::statusName(int status) {
+  switch (status) {
+    case REPLY_OK: return "ok";
+    case REPLY_INTERRUPTED: return "interrupted";
+    case REPLY_ERROR: return "error";
+    case REPLY_UNKNOWN_COMMAND: return "unknown-command";
+    case REPLY_TIMEOUT: return "timeout";
+    default: return "?";
+  }
+}
+
+void ReplyParser::feed(const char *data, size_t length, std::vector<CommandReply> &completed,
+                       std::vector<std::string> &events) {
+  for (size_t i = 0; i < length; i++) {
+    if (binaryRemaining_ > 0) {
+      size_t take = length - i < binaryRemaining_ ? length - i : binaryRemaining_;
+      current_.binary.append(data + i, take);
+      binaryRemaining_ -= take;
+      i += take - 1;
+      continue;
+    }
+    char c = data[i];
+    if (c == '\n') {
+      handleLine(partial_, completed, events);
+      partial_.clear();
+    } else if (c != '\r') {
+      partial_.push_back(c);
+    }
+  }
+}
+
+void ReplyParser::finish(int status, std::vector<CommandReply> &completed) {
+  current_.status = status;
+  completed.push_back(current_);
+  current_.lines.clear();
+  current_.command.clear();
+  current_.hasPosition = false;
+  current_.binary.clear();
+  binaryRemaining_ = 0;
+  inReply_ = false;
+}
+
+void ReplyParser::abandon(int status, std::vector<CommandReply> &completed) {
+  if (inReply_) finish(status, completed);
+}
+
+void ReplyParser::handleLine(const std::string &line, std::vector<CommandReply> &completed,
+                             std::vector<std::string> &events) {
+  if (startsWith(line, ECHO_PREFIX)) {
+    // A new echo also ends a command whose final line we did not recognize
+    if (inReply_) finish(REPLY_OK, completed);
+    inReply_ = true;
+    echoes_++;
+    current_.command = line.substr(strlen(ECHO_PREFIX));
+    current_.status = REPLY_OK;
+    return;
+  }
+
+  if (startsWith(line, BANNER_PREFIX)) {
+    // The board reset in the middle of a command
+    if (inReply_) finish(REPLY_ERROR, completed);
+    events.push_back(line);
+    return;
+  }
+
+  if (!inReply_) {
+    if (!line.empty()) events.push_back(line);
+    return;
+  }
+  if (line.empty()) return;
+  current_.lines.push_back(line);
+
+  for (size_t i = 0; i < sizeof(BINARY_PREFIXES) / sizeof(BINARY_PREFIXES[0]); i++) {
+    if (!startsWith(line, BINARY_PREFIXES[i])) continue;
+    long count = strtol(line.c_str() + strlen(BINARY_PREFIXES[i]), NULL, 10);
+    if (count > 0 && count <= BINARY_MAX_BYTES) binaryRemaining_ = (size_t)count;
+    return;
+  }
+
+  // Keep the last reported step position
+  size_t marker = line.find("urrent position");
+  if (marker != std::string::npos) {
+    size_t colon = line.find(':', marker);
+    if (colon != std::string::npos) {
+      const char *digits = line.c_str() + colon + 1;
+      char *end;
+      long value = strtol(digits, &end, 10);
+      if (end != digits) {
+        current_.hasPosition = true;
+        current_.position = value;
+      }
+    }
+  }
+
+  char letter = current_.command.empty() ? 0 : current_.command[0];
+  for (size_t i = 0; i < sizeof(TERMINAL_RULES) / sizeof(TERMINAL_RULES[0]); i++) {
+    const TerminalRule &rule = TERMINAL_RULES[i];
+    if ((rule.command == 0 || rule.command == letter) && startsWith(line, rule.prefix)) {
+      finish(rule.status, completed);
+      return;
+    }
+  }
+}
@@ -0,0 +1,94 @@
+/**
+ * ReplyParser.h
+ *
+ * Incremental parser for the text replies of the X-axis controller firmware.
+ *
+ * The firmware echoes every command as "Command received: <command>" and then
+ * prints free-form text until the command is finished. The parser splits the
+ * byte stream into lines, groups them per command and decides when a command
+ * has finished from the last line the firmware prints for it (see the rule
+ * table in ReplyParser.cpp) or, failing that, from the echo of the next command.
+ *
+ * A line "TRACE BEGIN <n>" or "LOG BEGIN <n>" announces n raw bytes (the
+ * motion trace or sensor log dump); they are collected into CommandReply::binary before line parsing resumes.
+ */
+
+#ifndef REPLY_PARSER_H
+#define REPLY_PARSER_H
+
+#include <string>
+#include <vector>
+
+// Outcome of a command as reported by the firmware
+enum ReplyStatus {
+  REPLY_OK = 0,
+  REPLY_INTERRUPTED,      // Stopped by limit switch or emergency stop
+  REPLY_ERROR,            // Firmware reported an error (e.g. homing timeout)
+  REPLY_UNKNOWN_COMMAND,  // Firmware printed its help text
+  REPLY_TIMEOUT           // No final line within the command's time budget
+};
+
+/**
+ * Everything the firmware printed for one command
+ */
+struct CommandReply {
+  std::string command;
+  std::vector<std::string> lines;
+  int status;
+  bool hasPosition;  // A "Current position" value was printed
+  long position;
+  std::string binary;  // Raw bytes announced by "TRACE/LOG BEGIN <n>"
+};
+
+class ReplyParser {
+public:
+  ReplyParser();
+
+  /**
+   * Consume bytes from the serial port
+   *
+   * @param data Received bytes
+   * @param length Number of bytes
+   * @param completed Receives replies of commands that finished
+   * @param events Receives lines printed outside of any command (banner, warnings)
+   */
+  void feed(const char *data, size_t length, std::vector<CommandReply> &completed,
+            std::vector<std::string> &events);
+
+  /**
+   * Give up on the command currently being parsed
+   *
+   * @param status Status to report (usually REPLY_TIMEOUT)
+   * @param completed Receives the partial reply
+   */
+  void abandon(int status, std::vector<CommandReply> &completed);
+
+  /**
+   * Number of "Command received" echoes seen so far
+   * Each echo means the firmware has taken one command out of its receive buffer.
+   */
+  long echoCount() const { return echoes_; }
+
+  /**
+   * TRUE while lines are being collected for a command
+   */
+  bool inReply() const { return inReply_; }
+
+  /**
+   * Name of a status for logs and client replies
+   */
+  static const char *statusName(int status);
+
+private:
+  void handleLine(const std::string &line, std::vector<CommandReply> &completed,
+                  std::vector<std::string> &events);
+  void finish(int status, std::vector<CommandReply> &completed);
+
+  std::string partial_;
+  size_t binaryRemaining_;  // Raw bytes still expected
+  bool inReply_;
+  long echoes_;
+  CommandReply current_;
+};
+
+#endif // REPLY_PARSER_H
@@ -0,0 +1,54 @@
+/**
+ * SerialPort.cpp
+ *
+ * Implementation of raw serial port setup with termios.
+ */
+
+#include "SerialPort.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+static speed_t baudConstant(long baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 230400: return B230400;
+    case 115200:
+    default: return B115200;
+  }
+}
+
+bool makeRawTerminal(int fd, long baud) {
+  struct termios settings;
+  if (tcgetattr(fd, &settings) != 0) return false;
+  cfmakeraw(&settings);
+  settings.c_cflag |= CLOCAL | CREAD;
+  settings.c_cc[VMIN] = 1;  // With O_NONBLOCK: EAGAIN when empty, 0 only on hangup
+  settings.c_cc[VTIME] = 0;
+  if (baud > 0) {
+    cfsetispeed(&settings, baudConstant(baud));
+    cfsetospeed(&settings, baudConstant(baud));
+  }
+  return tcsetattr(fd, TCSANOW, &settings) == 0;
+}
+
+int openSerialPort(const char *path, long baud, std::string &error) {
+  int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    error = std::string(path) + ": " + strerror(errno);
+    return -1;
+  }
+  if (!makeRawTerminal(fd, baud)) {
+    error = std::string(path) + ": cannot configure terminal: " + strerror(errno);
+    close(fd);
+    return -1;
+  }
+  tcflush(fd, TCIOFLUSH);
+  return fd;
+}
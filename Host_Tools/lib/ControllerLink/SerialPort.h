@@ -0,0 +1,32 @@
+/**
+ * SerialPort.h
+ *
+ * Non-blocking raw serial port access for talking to the controller boards.
+ * Works the same for USB serial devices (/dev/ttyACM*) and pseudo terminals.
+ */
+
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <string>
+
+/**
+ * Open a serial port in raw, non-blocking mode
+ *
+ * @param path Device path, e.g. /dev/ttyACM0 or a pty slave
+ * @param baud Baud rate (ignored by ptys)
+ * @param error Receives a description on failure
+ * @return File descriptor, or -1 on failure
+ */
+int openSerialPort(const char *path, long baud, std::string &error);
+
+/**
+ * Put an open terminal descriptor into raw mode (no echo, no line editing)
+ *
+ * @param fd Terminal descriptor
+ * @param baud Baud rate, or 0 to leave it unchanged
+ * @return TRUE on success
+ */
+bool makeRawTerminal(int fd, long baud);
+
+#endif // SERIAL_PORT_H
@@ -0,0 +1,804 @@
+/**
+ * ImageKernels.cpp
+ *
+ * Implementation of the image preprocessing and augmentation kernels.
+ * Bulk per-value work (vertical resize blend, brightness, normalization) has
+ * SSE4.1/AVX2 and NEON versions. The gather kernels (horizontal resize pass,
+ * affine warp) step coordinates in fixed point and handle 4 output pixels
+ * per iteration for 3- and 4-channel images: each pixel's bytes are loaded
+ * as one 32-bit word and blended with all channels in one vector. The flip
+ * reverses pixels with byte shuffles. Vector and scalar paths give identical
+ * results, so augmentation stays deterministic across platforms. That also
+ * needs the float math (warp matrix, row start coordinates) rounded the same
+ * everywhere: library.json builds this file with -ffp-contract=off, otherwise
+ * -march=native fuses multiply-adds into FMA on CPUs that have it.
+ */
+
+#include "ImageKernels.h"
+
+#include <math.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#define KERNELS_USE_SSE4 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define KERNELS_USE_NEON 1
+#endif
+
+#define DEG_TO_RAD 0.017453292519943295f
+
+AugmentConfig defaultAugmentConfig() {
+  AugmentConfig config;
+  config.rotationRange = 40.0f;
+  config.widthShiftRange = 0.2f;
+  config.heightShiftRange = 0.2f;
+  config.shearRange = 0.2f;
+  config.zoomRange = 0.2f;
+  config.horizontalFlip = true;
+  config.brightnessMin = 0.8f;
+  config.brightnessMax = 1.2f;
+  config.rescale = 1.0f / 255.0f;
+  return config;
+}
+
+// -------------------- RESIZE --------------------
+
+/**
+ * Load the bytes of one pixel as a 32-bit word (a 3-channel pixel reads one
+ * byte of the next, which is ignored)
+ */
+static inline uint32_t loadPixel(const uint8_t *p) {
+  uint32_t word;
+  memcpy(&word, p, 4);
+  return word;
+}
+
+#if defined(KERNELS_USE_SSE4)
+/**
+ * Store 4 pixels held as 32-bit words, dropping the 4th byte of each for 3 channels
+ */
+static inline void storePixels(uint8_t *out, __m128i pixels, int channels) {
+  if (channels == 4) {
+    _mm_storeu_si128((__m128i *)out, pixels);
+    return;
+  }
+  const __m128i pack3 = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  __m128i packed = _mm_shuffle_epi8(pixels, pack3);
+  _mm_storel_epi64((__m128i *)out, packed);
+  uint32_t last = (uint32_t)_mm_extract_epi32(packed, 2);
+  memcpy(out + 8, &last, 4);
+}
+
+/**
+ * Store 2 pixels of 4 Q8 values each, dropping the 4th value of each for 3 channels
+ */
+static inline void storePixelsQ8(uint16_t *out, __m128i pixels, int channels) {
+  if (channels == 4) {
+    _mm_storeu_si128((__m128i *)out, pixels);
+    return;
+  }
+  const __m128i pack3 = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+  __m128i packed = _mm_shuffle_epi8(pixels, pack3);
+  _mm_storel_epi64((__m128i *)out, packed);
+  uint32_t last = (uint32_t)_mm_extract_epi32(packed, 2);
+  memcpy(out + 4, &last, 4);
+}
+#endif
+
+/**
+ * Horizontal pass: interpolate one source row to the destination width
+ * Output values are in Q8 (value * 256) so the vertical pass keeps precision.
+ * The first vectorPixels outputs read 4 bytes per source pixel, which the
+ * caller keeps inside the row.
+ */
+static void resizeRowQ8(const uint8_t *srcRow, const int *xOffsets, const uint8_t *xWeights,
+                        int dstWidth, int channels, int vectorPixels, uint16_t *out) {
+  int x = 0;
+
+#if defined(KERNELS_USE_SSE4)
+  const __m128i zero = _mm_setzero_si128();
+  for (; x + 4 <= vectorPixels; x += 4, out += 4 * channels) {
+    const int *o = xOffsets + 2 * x;
+    __m128i p0 = _mm_setr_epi32(loadPixel(srcRow + o[0]), loadPixel(srcRow + o[2]),
+                                loadPixel(srcRow + o[4]), loadPixel(srcRow + o[6]));
+    __m128i p1 = _mm_setr_epi32(loadPixel(srcRow + o[1]), loadPixel(srcRow + o[3]),
+                                loadPixel(srcRow + o[5]), loadPixel(srcRow + o[7]));
+    // (256 - w, w) pairs for _mm_madd_epi16 against (p0, p1) pairs
+    __m128i w = _mm_setr_epi32(xWeights[x], xWeights[x + 1], xWeights[x + 2], xWeights[x + 3]);
+    __m128i weights = _mm_or_si128(_mm_slli_epi32(w, 16), _mm_sub_epi32(_mm_set1_epi32(256), w));
+    __m128i pairs01 = _mm_unpacklo_epi8(p0, p1);
+    __m128i pairs23 = _mm_unpackhi_epi8(p0, p1);
+    __m128i v0 = _mm_madd_epi16(_mm_cvtepu8_epi16(pairs01), _mm_shuffle_epi32(weights, 0x00));
+    __m128i v1 = _mm_madd_epi16(_mm_unpackhi_epi8(pairs01, zero), _mm_shuffle_epi32(weights, 0x55));
+    __m128i v2 = _mm_madd_epi16(_mm_cvtepu8_epi16(pairs23), _mm_shuffle_epi32(weights, 0xAA));
+    __m128i v3 = _mm_madd_epi16(_mm_unpackhi_epi8(pairs23, zero), _mm_shuffle_epi32(weights, 0xFF));
+    storePixelsQ8(out, _mm_packus_epi32(v0, v1), channels);
+    storePixelsQ8(out + 2 * channels, _mm_packus_epi32(v2, v3), channels);
+  }
+#elif defined(KERNELS_USE_NEON)
+  // A 3-channel pixel is stored as 4 values that the next pixel overwrites,
+  // so the last pixel of the row is left to the scalar loop
+  const int limit = channels == 4 ? vectorPixels : (vectorPixels < dstWidth ? vectorPixels : dstWidth - 1);
+  for (; x + 4 <= limit; x += 4, out += 4 * channels) {
+    const int *o = xOffsets + 2 * x;
+    uint32_t words0[4] = {loadPixel(srcRow + o[0]), loadPixel(srcRow + o[2]),
+                          loadPixel(srcRow + o[4]), loadPixel(srcRow + o[6])};
+    uint32_t words1[4] = {loadPixel(srcRow + o[1]), loadPixel(srcRow + o[3]),
+                          loadPixel(srcRow + o[5]), loadPixel(srcRow + o[7])};
+    uint8x16_t p0 = vreinterpretq_u8_u32(vld1q_u32(words0));
+    uint8x16_t p1 = vreinterpretq_u8_u32(vld1q_u32(words1));
+    uint16x8_t w01 = vcombine_u16(vdup_n_u16(xWeights[x]), vdup_n_u16(xWeights[x + 1]));
+    uint16x8_t w23 = vcombine_u16(vdup_n_u16(xWeights[x + 2]), vdup_n_u16(xWeights[x + 3]));
+    const uint16x8_t full = vdupq_n_u16(256);
+    // At most 255 * 256, so the Q8 sums fit in 16 bits
+    uint16x8_t v01 = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(p0)), vsubq_u16(full, w01)),
+                               vmovl_u8(vget_low_u8(p1)), w01);
+    uint16x8_t v23 = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(p0)), vsubq_u16(full, w23)),
+                               vmovl_u8(vget_high_u8(p1)), w23);
+    vst1_u16(out, vget_low_u16(v01));
+    vst1_u16(out + channels, vget_high_u16(v01));
+    vst1_u16(out + 2 * channels, vget_low_u16(v23));
+    vst1_u16(out + 3 * channels, vget_high_u16(v23));
+  }
+#else
+  (void)vectorPixels;
+#endif
+
+  for (; x < dstWidth; x++) {
+    const uint8_t *p0 = srcRow + xOffsets[2 * x];
+    const uint8_t *p1 = srcRow + xOffsets[2 * x + 1];
+    int w1 = xWeights[x];
+    int w0 = 256 - w1;
+    for (int c = 0; c < channels; c++) {
+      *out++ = (uint16_t)(p0[c] * w0 + p1[c] * w1);
+    }
+  }
+}
+
+/**
+ * Vertical pass: blend two Q8 rows and round back to 8 bits
+ */
+static void blendRowsQ8(const uint16_t *row0, const uint16_t *row1, int wy, uint8_t *dst, int count) {
+  const int w0 = 256 - wy;
+  int i = 0;
+
+#if defined(KERNELS_USE_SSE4)
+  const __m128i weight0 = _mm_set1_epi32(w0);
+  const __m128i weight1 = _mm_set1_epi32(wy);
+  const __m128i half = _mm_set1_epi32(1 << 15);
+  for (; i + 8 <= count; i += 8) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(row0 + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(row1 + i));
+    __m128i lo = _mm_add_epi32(_mm_mullo_epi32(_mm_cvtepu16_epi32(a), weight0),
+                               _mm_mullo_epi32(_mm_cvtepu16_epi32(b), weight1));
+    __m128i hi = _mm_add_epi32(_mm_mullo_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(a, 8)), weight0),
+                               _mm_mullo_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(b, 8)), weight1));
+    lo = _mm_srli_epi32(_mm_add_epi32(lo, half), 16);
+    hi = _mm_srli_epi32(_mm_add_epi32(hi, half), 16);
+    __m128i words = _mm_packus_epi32(lo, hi);
+    _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(words, words));
+  }
+#elif defined(KERNELS_USE_NEON)
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t a = vld1q_u16(row0 + i);
+    uint16x8_t b = vld1q_u16(row1 + i);
+    uint32x4_t lo = vmlal_n_u16(vmull_n_u16(vget_low_u16(a), w0), vget_low_u16(b), wy);
+    uint32x4_t hi = vmlal_n_u16(vmull_n_u16(vget_high_u16(a), w0), vget_high_u16(b), wy);
+    uint16x8_t words = vcombine_u16(vrshrn_n_u32(lo, 16), vrshrn_n_u32(hi, 16));
+    vst1_u8(dst + i, vqmovn_u16(words));
+  }
+#endif
+
+  for (; i < count; i++) {
+    dst[i] = (uint8_t)((row0[i] * w0 + row1[i] * wy + (1 << 15)) >> 16);
+  }
+}
+
+/**
+ * Map a destination coordinate to a source pixel pair and Q8 weight
+ */
+static void sourceCoordinate(int dst, float scale, int srcSize, int &i0, int &i1, int &weight) {
+  float f = (dst + 0.5f) * scale - 0.5f;
+  if (f < 0.0f) f = 0.0f;
+  i0 = (int)f;
+  if (i0 > srcSize - 1) i0 = srcSize - 1;
+  i1 = i0 + 1 < srcSize ? i0 + 1 : i0;
+  weight = (int)lrintf((f - i0) * 256.0f);
+  if (weight > 255) weight = 255;
+}
+
+void resizeBilinearU8(const uint8_t *src, int srcWidth, int srcHeight,
+                      uint8_t *dst, int dstWidth, int dstHeight, int channels) {
+  std::vector<int> xOffsets(2 * dstWidth);
+  std::vector<uint8_t> xWeights(dstWidth);
+  const float scaleX = (float)srcWidth / dstWidth;
+  const float scaleY = (float)srcHeight / dstHeight;
+
+  for (int x = 0; x < dstWidth; x++) {
+    int x0, x1, weight;
+    sourceCoordinate(x, scaleX, srcWidth, x0, x1, weight);
+    xOffsets[2 * x] = x0 * channels;
+    xOffsets[2 * x + 1] = x1 * channels;
+    xWeights[x] = (uint8_t)weight;
+  }
+
+  // Outputs whose source pixels can be read as whole 32-bit words without
+  // leaving the row (offsets grow with x)
+  int vectorPixels = 0;
+  if (channels >= 3) {
+    while (vectorPixels < dstWidth && xOffsets[2 * vectorPixels + 1] + 4 <= srcWidth * channels) vectorPixels++;
+  }
+
+  const int rowLength = dstWidth * channels;
+  std::vector<uint16_t> rows(2 * rowLength);
+  uint16_t *row0 = rows.data();
+  uint16_t *row1 = rows.data() + rowLength;
+  int cached0 = -1, cached1 = -1;  // Source rows currently held in row0/row1
+
+  for (int y = 0; y < dstHeight; y++) {
+    int y0, y1, wy;
+    sourceCoordinate(y, scaleY, srcHeight, y0, y1, wy);
+
+    // When upscaling, consecutive output rows share source rows
+    if (y0 == cached1) {
+      uint16_t *swap = row0;
+      row0 = row1;
+      row1 = swap;
+      cached0 = cached1;
+      cached1 = -1;
+    }
+    if (y0 != cached0) {
+      resizeRowQ8(src + (long)y0 * srcWidth * channels, xOffsets.data(), xWeights.data(), dstWidth, channels,
+                  vectorPixels, row0);
+      cached0 = y0;
+    }
+    if (y1 != cached1) {
+      resizeRowQ8(src + (long)y1 * srcWidth * channels, xOffsets.data(), xWeights.data(), dstWidth, channels,
+                  vectorPixels, row1);
+      cached1 = y1;
+    }
+
+    blendRowsQ8(row0, row1, wy, dst + (long)y * rowLength, rowLength);
+  }
+}
+
+// -------------------- FLIP / BRIGHTNESS / NORMALIZE --------------------
+
+void flipHorizontalU8(const uint8_t *src, uint8_t *dst, int width, int height, int channels) {
+  for (int y = 0; y < height; y++) {
+    const uint8_t *in = src + (long)y * width * channels;
+    uint8_t *row = dst + (long)y * width * channels;
+    int x = 0;
+
+#if defined(KERNELS_USE_SSE4)
+    if (channels == 3) {
+      // 5 pixels per 16 bytes. The store starts one byte early, in the pixel
+      // the next block (or the scalar loop) writes, so it needs x + 6 <= width.
+      const __m128i reverse3 = _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+      for (; x + 6 <= width; x += 5, in += 15) {
+        __m128i v = _mm_loadu_si128((const __m128i *)in);
+        _mm_storeu_si128((__m128i *)(row + (width - 5 - x) * 3 - 1), _mm_shuffle_epi8(v, reverse3));
+      }
+    } else if (channels == 4) {
+      for (; x + 4 <= width; x += 4, in += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)in);
+        _mm_storeu_si128((__m128i *)(row + (width - 4 - x) * 4), _mm_shuffle_epi32(v, 0x1B));
+      }
+    } else if (channels == 1) {
+      const __m128i reverse1 = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      for (; x + 16 <= width; x += 16, in += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)in);
+        _mm_storeu_si128((__m128i *)(row + width - 16 - x), _mm_shuffle_epi8(v, reverse1));
+      }
+    }
+#elif defined(KERNELS_USE_NEON)
+    // 16 pixels per iteration, one plane per channel
+    if (channels == 3) {
+      for (; x + 16 <= width; x += 16, in += 48) {
+        uint8x16x3_t v = vld3q_u8(in);
+        for (int c = 0; c < 3; c++) {
+          uint8x16_t r = vrev64q_u8(v.val[c]);
+          v.val[c] = vcombine_u8(vget_high_u8(r), vget_low_u8(r));
+        }
+        vst3q_u8(row + (width - 16 - x) * 3, v);
+      }
+    } else if (channels == 4) {
+      for (; x + 16 <= width; x += 16, in += 64) {
+        uint8x16x4_t v = vld4q_u8(in);
+        for (int c = 0; c < 4; c++) {
+          uint8x16_t r = vrev64q_u8(v.val[c]);
+          v.val[c] = vcombine_u8(vget_high_u8(r), vget_low_u8(r));
+        }
+        vst4q_u8(row + (width - 16 - x) * 4, v);
+      }
+    } else if (channels == 1) {
+      for (; x + 16 <= width; x += 16, in += 16) {
+        uint8x16_t r = vrev64q_u8(vld1q_u8(in));
+        vst1q_u8(row + width - 16 - x, vcombine_u8(vget_high_u8(r), vget_low_u8(r)));
+      }
+    }
+#endif
+
+    uint8_t *out = row + (long)(width - 1 - x) * channels;
+    for (; x < width; x++) {
+      memcpy(out, in, channels);
+      in += channels;
+      out -= channels;
+    }
+  }
+}
+
+void brightnessU8(const uint8_t *src, uint8_t *dst, long count, float factor) {
+  if (factor < 0.0f) factor = 0.0f;
+  long i = 0;
+
+  // Q7 factor keeps value * factor inside 16 bits for factors below 2
+  if (factor < 1.99f) {
+    const int q7 = (int)lrintf(factor * 128.0f);
+#if defined(KERNELS_USE_SSE4)
+    const __m128i scale = _mm_set1_epi16(q7);
+    const __m128i round = _mm_set1_epi16(64);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), scale), round), 7);
+      __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), scale), round), 7);
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(KERNELS_USE_NEON)
+    const uint8x8_t scale = vdup_n_u8((uint8_t)q7);
+    for (; i + 16 <= count; i += 16) {
+      uint8x16_t v = vld1q_u8(src + i);
+      uint16x8_t lo = vrshrq_n_u16(vmull_u8(vget_low_u8(v), scale), 7);
+      uint16x8_t hi = vrshrq_n_u16(vmull_u8(vget_high_u8(v), scale), 7);
+      vst1q_u8(dst + i, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+    }
+#endif
+    for (; i < count; i++) {
+      int value = (src[i] * q7 + 64) >> 7;
+      dst[i] = (uint8_t)(value > 255 ? 255 : value);
+    }
+    return;
+  }
+
+  for (; i < count; i++) {
+    int value = (int)lrintf(src[i] * factor);
+    dst[i] = (uint8_t)(value > 255 ? 255 : value);
+  }
+}
+
+void normalizeU8ToF32(const uint8_t *src, float *dst, long count, float scale) {
+  long i = 0;
+
+#if defined(__AVX2__)
+  const __m256 factor = _mm256_set1_ps(scale);
+  for (; i + 8 <= count; i += 8) {
+    __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), factor));
+  }
+#elif defined(KERNELS_USE_SSE4)
+  const __m128 factor = _mm_set1_ps(scale);
+  for (; i + 4 <= count; i += 4) {
+    int32_t packed;
+    memcpy(&packed, src + i, 4);
+    __m128i v = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), factor));
+  }
+#elif defined(KERNELS_USE_NEON)
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t v = vmovl_u8(vld1_u8(src + i));
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), scale));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), scale));
+  }
+#endif
+
+  for (; i < count; i++) {
+    dst[i] = src[i] * scale;
+  }
+}
+
+// -------------------- AFFINE WARP --------------------
+
+/**
+ * Sample one output pixel. Coordinates are 16.16 fixed point; samples outside
+ * the image replicate the nearest edge pixel.
+ */
+static inline void warpPixel(const uint8_t *src, int width, int height, int channels, long stride,
+                             int32_t sx, int32_t sy, uint8_t *out) {
+  int x0 = sx >> 16;
+  int y0 = sy >> 16;
+  int wx = (sx >> 8) & 255;
+  int wy = (sy >> 8) & 255;
+  int x1 = x0 + 1;
+  int y1 = y0 + 1;
+
+  // fill_mode='nearest': clamp into the image
+  if (x0 < 0) { x0 = 0; if (x1 < 0) x1 = 0; }
+  if (x1 > width - 1) { x1 = width - 1; if (x0 > width - 1) x0 = width - 1; }
+  if (y0 < 0) { y0 = 0; if (y1 < 0) y1 = 0; }
+  if (y1 > height - 1) { y1 = height - 1; if (y0 > height - 1) y0 = height - 1; }
+
+  const uint8_t *p00 = src + y0 * stride + x0 * channels;
+  const uint8_t *p01 = src + y0 * stride + x1 * channels;
+  const uint8_t *p10 = src + y1 * stride + x0 * channels;
+  const uint8_t *p11 = src + y1 * stride + x1 * channels;
+
+  for (int c = 0; c < channels; c++) {
+    int top = p00[c] * (256 - wx) + p01[c] * wx;
+    int bottom = p10[c] * (256 - wx) + p11[c] * wx;
+    out[c] = (uint8_t)((top * (256 - wy) + bottom * wy + (1 << 15)) >> 16);
+  }
+}
+
+#if defined(KERNELS_USE_SSE4)
+/**
+ * Bilinear blend of one pixel's channels
+ *
+ * @param top (p00, p01) byte pairs widened to 16 bits
+ * @param bottom (p10, p11) byte pairs widened to 16 bits
+ * @param wxPair (256 - wx, wx) in every 32-bit lane
+ * @param wy wy in every 32-bit lane
+ */
+static inline __m128i blendPixel(__m128i top, __m128i bottom, __m128i wxPair, __m128i wy) {
+  __m128i t = _mm_madd_epi16(top, wxPair);
+  __m128i b = _mm_madd_epi16(bottom, wxPair);
+  // t * (256 - wy) + b * wy, rounded from Q16
+  __m128i sum = _mm_add_epi32(_mm_slli_epi32(t, 8), _mm_mullo_epi32(_mm_sub_epi32(b, t), wy));
+  return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << 15)), 16);
+}
+
+/**
+ * Load one pixel (as a 32-bit word) at each of four byte offsets
+ */
+static inline __m128i gatherPixels(const uint8_t *src, __m128i offsets) {
+#if defined(__AVX2__)
+  return _mm_i32gather_epi32((const int *)src, offsets, 1);
+#else
+  return _mm_setr_epi32(loadPixel(src + _mm_extract_epi32(offsets, 0)), loadPixel(src + _mm_extract_epi32(offsets, 1)),
+                        loadPixel(src + _mm_extract_epi32(offsets, 2)), loadPixel(src + _mm_extract_epi32(offsets, 3)));
+#endif
+}
+#endif
+
+/**
+ * Warp one output row, 4 pixels per iteration where SIMD is available
+ * The vector path does what warpPixel() does on 4 coordinates at once.
+ */
+static void warpRow(const uint8_t *src, int width, int height, int channels,
+                    int32_t sx, int32_t sy, int32_t stepX, int32_t stepY, uint8_t *out) {
+  const long stride = (long)width * channels;
+  int x = 0;
+
+#if defined(KERNELS_USE_SSE4) || defined(KERNELS_USE_NEON)
+  // Whole-word loads of the last pixel of a 3-channel image would read past
+  // it; blocks that touch it take the scalar path
+  const int32_t lastWord = (int32_t)(height * stride - 4);
+#endif
+
+#if defined(KERNELS_USE_SSE4)
+  if (channels == 3 || channels == 4) {
+    const __m128i laneSteps = _mm_setr_epi32(0, stepX, 2 * stepX, 3 * stepX);
+    const __m128i laneStepsY = _mm_setr_epi32(0, stepY, 2 * stepY, 3 * stepY);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i maxX = _mm_set1_epi32(width - 1);
+    const __m128i maxY = _mm_set1_epi32(height - 1);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i byte = _mm_set1_epi32(255);
+    const __m128i strideV = _mm_set1_epi32((int32_t)stride);
+    const __m128i channelsV = _mm_set1_epi32(channels);
+    const __m128i lastWordV = _mm_set1_epi32(lastWord);
+
+    for (; x + 4 <= width; x += 4, sx += 4 * stepX, sy += 4 * stepY, out += 4 * channels) {
+      __m128i vx = _mm_add_epi32(_mm_set1_epi32(sx), laneSteps);
+      __m128i vy = _mm_add_epi32(_mm_set1_epi32(sy), laneStepsY);
+      __m128i x0 = _mm_srai_epi32(vx, 16);
+      __m128i y0 = _mm_srai_epi32(vy, 16);
+      __m128i wx = _mm_and_si128(_mm_srli_epi32(vx, 8), byte);
+      __m128i wy = _mm_and_si128(_mm_srli_epi32(vy, 8), byte);
+      __m128i x1 = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(x0, one), zero), maxX);
+      __m128i y1 = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(y0, one), zero), maxY);
+      x0 = _mm_min_epi32(_mm_max_epi32(x0, zero), maxX);
+      y0 = _mm_min_epi32(_mm_max_epi32(y0, zero), maxY);
+
+      __m128i row0 = _mm_mullo_epi32(y0, strideV);
+      __m128i row1 = _mm_mullo_epi32(y1, strideV);
+      __m128i col0 = _mm_mullo_epi32(x0, channelsV);
+      __m128i col1 = _mm_mullo_epi32(x1, channelsV);
+      __m128i o11 = _mm_add_epi32(row1, col1);
+      if (channels == 3 && _mm_movemask_epi8(_mm_cmpgt_epi32(o11, lastWordV))) {
+        for (int i = 0; i < 4; i++) {
+          warpPixel(src, width, height, channels, stride, sx + i * stepX, sy + i * stepY, out + i * channels);
+        }
+        continue;
+      }
+
+      __m128i p00 = gatherPixels(src, _mm_add_epi32(row0, col0));
+      __m128i p01 = gatherPixels(src, _mm_add_epi32(row0, col1));
+      __m128i p10 = gatherPixels(src, _mm_add_epi32(row1, col0));
+      __m128i p11 = gatherPixels(src, o11);
+
+      // Horizontal weights as (256 - wx, wx) pairs for _mm_madd_epi16
+      __m128i wxPair = _mm_or_si128(_mm_slli_epi32(wx, 16), _mm_sub_epi32(_mm_set1_epi32(256), wx));
+      __m128i top01 = _mm_unpacklo_epi8(p00, p01);
+      __m128i top23 = _mm_unpackhi_epi8(p00, p01);
+      __m128i bottom01 = _mm_unpacklo_epi8(p10, p11);
+      __m128i bottom23 = _mm_unpackhi_epi8(p10, p11);
+      __m128i v0 = blendPixel(_mm_cvtepu8_epi16(top01), _mm_cvtepu8_epi16(bottom01),
+                              _mm_shuffle_epi32(wxPair, 0x00), _mm_shuffle_epi32(wy, 0x00));
+      __m128i v1 = blendPixel(_mm_unpackhi_epi8(top01, zero), _mm_unpackhi_epi8(bottom01, zero),
+                              _mm_shuffle_epi32(wxPair, 0x55), _mm_shuffle_epi32(wy, 0x55));
+      __m128i v2 = blendPixel(_mm_cvtepu8_epi16(top23), _mm_cvtepu8_epi16(bottom23),
+                              _mm_shuffle_epi32(wxPair, 0xAA), _mm_shuffle_epi32(wy, 0xAA));
+      __m128i v3 = blendPixel(_mm_unpackhi_epi8(top23, zero), _mm_unpackhi_epi8(bottom23, zero),
+                              _mm_shuffle_epi32(wxPair, 0xFF), _mm_shuffle_epi32(wy, 0xFF));
+      __m128i words = _mm_packus_epi32(v0, v1);
+      storePixels(out, _mm_packus_epi16(words, _mm_packus_epi32(v2, v3)), channels);
+    }
+  }
+#elif defined(KERNELS_USE_NEON)
+  if (channels == 3 || channels == 4) {
+    const int32_t laneStepArray[4] = {0, stepX, 2 * stepX, 3 * stepX};
+    const int32_t laneStepArrayY[4] = {0, stepY, 2 * stepY, 3 * stepY};
+    const int32x4_t laneSteps = vld1q_s32(laneStepArray);
+    const int32x4_t laneStepsY = vld1q_s32(laneStepArrayY);
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t maxX = vdupq_n_s32(width - 1);
+    const int32x4_t maxY = vdupq_n_s32(height - 1);
+    const int32x4_t one = vdupq_n_s32(1);
+    const int32x4_t byte = vdupq_n_s32(255);
+    const uint16x8_t full = vdupq_n_u16(256);
+    // A 3-channel pixel is stored as 4 bytes that the next pixel overwrites,
+    // so the last pixel of the row is left to the scalar loop
+    const int limit = channels == 4 ? width : width - 1;
+
+    for (; x + 4 <= limit; x += 4, sx += 4 * stepX, sy += 4 * stepY, out += 4 * channels) {
+      int32x4_t vx = vaddq_s32(vdupq_n_s32(sx), laneSteps);
+      int32x4_t vy = vaddq_s32(vdupq_n_s32(sy), laneStepsY);
+      int32x4_t x0 = vshrq_n_s32(vx, 16);
+      int32x4_t y0 = vshrq_n_s32(vy, 16);
+      int32_t wx[4], wy[4];
+      vst1q_s32(wx, vandq_s32(vshrq_n_s32(vx, 8), byte));
+      vst1q_s32(wy, vandq_s32(vshrq_n_s32(vy, 8), byte));
+      int32x4_t x1 = vminq_s32(vmaxq_s32(vaddq_s32(x0, one), zero), maxX);
+      int32x4_t y1 = vminq_s32(vmaxq_s32(vaddq_s32(y0, one), zero), maxY);
+      x0 = vminq_s32(vmaxq_s32(x0, zero), maxX);
+      y0 = vminq_s32(vmaxq_s32(y0, zero), maxY);
+
+      int32_t o00[4], o01[4], o10[4], o11[4];
+      int32x4_t row0 = vmulq_n_s32(y0, (int32_t)stride);
+      int32x4_t row1 = vmulq_n_s32(y1, (int32_t)stride);
+      vst1q_s32(o00, vmlaq_n_s32(row0, x0, channels));
+      vst1q_s32(o01, vmlaq_n_s32(row0, x1, channels));
+      vst1q_s32(o10, vmlaq_n_s32(row1, x0, channels));
+      vst1q_s32(o11, vmlaq_n_s32(row1, x1, channels));
+      if (channels == 3 && (o11[0] > lastWord || o11[1] > lastWord || o11[2] > lastWord || o11[3] > lastWord)) {
+        for (int i = 0; i < 4; i++) {
+          warpPixel(src, width, height, channels, stride, sx + i * stepX, sy + i * stepY, out + i * channels);
+        }
+        continue;
+      }
+
+      uint32_t words[4][4];
+      for (int i = 0; i < 4; i++) {
+        words[0][i] = loadPixel(src + o00[i]);
+        words[1][i] = loadPixel(src + o01[i]);
+        words[2][i] = loadPixel(src + o10[i]);
+        words[3][i] = loadPixel(src + o11[i]);
+      }
+      uint8x16_t p00 = vreinterpretq_u8_u32(vld1q_u32(words[0]));
+      uint8x16_t p01 = vreinterpretq_u8_u32(vld1q_u32(words[1]));
+      uint8x16_t p10 = vreinterpretq_u8_u32(vld1q_u32(words[2]));
+      uint8x16_t p11 = vreinterpretq_u8_u32(vld1q_u32(words[3]));
+
+      // Horizontal blend in 16 bits (at most 255 * 256), two pixels per vector
+      uint16x8_t wx01 = vcombine_u16(vdup_n_u16((uint16_t)wx[0]), vdup_n_u16((uint16_t)wx[1]));
+      uint16x8_t wx23 = vcombine_u16(vdup_n_u16((uint16_t)wx[2]), vdup_n_u16((uint16_t)wx[3]));
+      uint16x8_t top01 = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(p00)), vsubq_u16(full, wx01)),
+                                   vmovl_u8(vget_low_u8(p01)), wx01);
+      uint16x8_t top23 = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(p00)), vsubq_u16(full, wx23)),
+                                   vmovl_u8(vget_high_u8(p01)), wx23);
+      uint16x8_t bottom01 = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(p10)), vsubq_u16(full, wx01)),
+                                      vmovl_u8(vget_low_u8(p11)), wx01);
+      uint16x8_t bottom23 = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(p10)), vsubq_u16(full, wx23)),
+                                      vmovl_u8(vget_high_u8(p11)), wx23);
+
+      // Vertical blend in 32 bits, rounded from Q16
+      uint16x4_t v0 = vrshrn_n_u32(vmlal_n_u16(vmull_n_u16(vget_low_u16(top01), (uint16_t)(256 - wy[0])),
+                                               vget_low_u16(bottom01), (uint16_t)wy[0]), 16);
+      uint16x4_t v1 = vrshrn_n_u32(vmlal_n_u16(vmull_n_u16(vget_high_u16(top01), (uint16_t)(256 - wy[1])),
+                                               vget_high_u16(bottom01), (uint16_t)wy[1]), 16);
+      uint16x4_t v2 = vrshrn_n_u32(vmlal_n_u16(vmull_n_u16(vget_low_u16(top23), (uint16_t)(256 - wy[2])),
+                                               vget_low_u16(bottom23), (uint16_t)wy[2]), 16);
+      uint16x4_t v3 = vrshrn_n_u32(vmlal_n_u16(vmull_n_u16(vget_high_u16(top23), (uint16_t)(256 - wy[3])),
+                                               vget_high_u16(bottom23), (uint16_t)wy[3]), 16);
+      uint8x16_t pixels = vcombine_u8(vmovn_u16(vcombine_u16(v0, v1)), vmovn_u16(vcombine_u16(v2, v3)));
+      if (channels == 4) {
+        vst1q_u8(out, pixels);
+      } else {
+        uint32_t packed[4];
+        vst1q_u32(packed, vreinterpretq_u32_u8(pixels));
+        for (int i = 0; i < 4; i++) memcpy(out + 3 * i, &packed[i], 4);
+      }
+    }
+  }
+#endif
+
+  for (; x < width; x++, sx += stepX, sy += stepY, out += channels) {
+    warpPixel(src, width, height, channels, stride, sx, sy, out);
+  }
+}
+
+/**
+ * Row start coordinates of the warp in 16.16 fixed point, stepped along each row
+ */
+static void warpRowStart(const float m[6], int y, int32_t &sx, int32_t &sy) {
+  sx = (int32_t)lrintf((m[1] * y + m[2]) * 65536.0f);
+  sy = (int32_t)lrintf((m[4] * y + m[5]) * 65536.0f);
+}
+
+void warpAffineU8(const uint8_t *src, uint8_t *dst, int width, int height, int channels,
+                  const float matrix[6]) {
+  const int32_t stepX = (int32_t)lrintf(matrix[0] * 65536.0f);
+  const int32_t stepY = (int32_t)lrintf(matrix[3] * 65536.0f);
+  const long stride = (long)width * channels;
+  for (int y = 0; y < height; y++) {
+    int32_t sx, sy;
+    warpRowStart(matrix, y, sx, sy);
+    warpRow(src, width, height, channels, sx, sy, stepX, stepY, dst + y * stride);
+  }
+}
+
+/**
+ * Brightness, saturation and rescale to float: min(value * brightness, 255) * rescale
+ */
+static void brightenToF32(const uint8_t *src, float *dst, long count, float brightness, float rescale) {
+  long i = 0;
+
+#if defined(__AVX2__)
+  const __m256 factor = _mm256_set1_ps(brightness);
+  const __m256 ceiling = _mm256_set1_ps(255.0f);
+  const __m256 scale = _mm256_set1_ps(rescale);
+  for (; i + 8 <= count; i += 8) {
+    __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i))));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_min_ps(_mm256_mul_ps(v, factor), ceiling), scale));
+  }
+#elif defined(KERNELS_USE_SSE4)
+  const __m128 factor = _mm_set1_ps(brightness);
+  const __m128 ceiling = _mm_set1_ps(255.0f);
+  const __m128 scale = _mm_set1_ps(rescale);
+  for (; i + 4 <= count; i += 4) {
+    int32_t packed;
+    memcpy(&packed, src + i, 4);
+    __m128 v = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_min_ps(_mm_mul_ps(v, factor), ceiling), scale));
+  }
+#elif defined(KERNELS_USE_NEON)
+  const float32x4_t ceiling = vdupq_n_f32(255.0f);
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t v = vmovl_u8(vld1_u8(src + i));
+    float32x4_t lo = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), brightness);
+    float32x4_t hi = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), brightness);
+    vst1q_f32(dst + i, vmulq_n_f32(vminq_f32(lo, ceiling), rescale));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vminq_f32(hi, ceiling), rescale));
+  }
+#endif
+
+  for (; i < count; i++) {
+    float bright = src[i] * brightness;
+    if (bright > 255.0f) bright = 255.0f;
+    dst[i] = bright * rescale;
+  }
+}
+
+void augmentToF32(const uint8_t *src, float *dst, int width, int height, int channels,
+                  const AugmentParams &params) {
+  const float *m = params.matrix;
+  const int32_t stepX = (int32_t)lrintf(m[0] * 65536.0f);
+  const int32_t stepY = (int32_t)lrintf(m[3] * 65536.0f);
+  const long stride = (long)width * channels;
+
+  // Each row is warped to bytes, then brightened and rescaled while it is in L1
+  std::vector<uint8_t> row(stride);
+  for (int y = 0; y < height; y++) {
+    int32_t sx, sy;
+    warpRowStart(m, y, sx, sy);
+    warpRow(src, width, height, channels, sx, sy, stepX, stepY, row.data());
+    brightenToF32(row.data(), dst + y * stride, stride, params.brightness, params.rescale);
+  }
+}
+
+// -------------------- RANDOM PARAMETERS --------------------
+
+uint64_t mixSeed(uint64_t seed, uint64_t index) {
+  uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (index + 1);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Portable uniform draw, so the same seed gives the same transform on every platform
+static float uniform(uint64_t &state, float low, float high) {
+  state = mixSeed(state, 0);
+  double unit = (state >> 11) * (1.0 / 9007199254740992.0);
+  return low + (float)((high - low) * unit);
+}
+
+AugmentParams randomAugmentParams(const AugmentConfig &config, int width, int height, uint64_t seed) {
+  uint64_t state = seed;
+  float theta = uniform(state, -config.rotationRange, config.rotationRange) * DEG_TO_RAD;
+  float shiftRows = uniform(state, -config.heightShiftRange, config.heightShiftRange) * height;
+  float shiftCols = uniform(state, -config.widthShiftRange, config.widthShiftRange) * width;
+  float shear = uniform(state, -config.shearRange, config.shearRange) * DEG_TO_RAD;
+  float zoomRows = uniform(state, 1.0f - config.zoomRange, 1.0f + config.zoomRange);
+  float zoomCols = uniform(state, 1.0f - config.zoomRange, 1.0f + config.zoomRange);
+  bool flip = config.horizontalFlip && uniform(state, 0.0f, 1.0f) < 0.5f;
+
+  AugmentParams params;
+  params.brightness = uniform(state, config.brightnessMin, config.brightnessMax);
+  params.rescale = config.rescale;
+
+  // Keras composes rotation * shift * shear * zoom in (row, col) order,
+  // mapping centered output coordinates to input coordinates
+  float c = cosf(theta), s = sinf(theta);
+  float a00 = c * zoomRows;
+  float a01 = (-c * sinf(shear) - s * cosf(shear)) * zoomCols;
+  float a10 = s * zoomRows;
+  float a11 = (-s * sinf(shear) + c * cosf(shear)) * zoomCols;
+  float shiftR = c * shiftRows - s * shiftCols;
+  float shiftC = s * shiftRows + c * shiftCols;
+
+  // A horizontal flip of the output mirrors the column coordinate around the center
+  if (flip) {
+    a01 = -a01;
+    a11 = -a11;
+  }
+
+  float centerR = (height - 1) * 0.5f;
+  float centerC = (width - 1) * 0.5f;
+
+  // Rewrite in (x = col, y = row) form: sx = m0*x + m1*y + m2, sy = m3*x + m4*y + m5
+  params.matrix[0] = a11;
+  params.matrix[1] = a10;
+  params.matrix[2] = centerC + shiftC - a11 * centerC - a10 * centerR;
+  params.matrix[3] = a01;
+  params.matrix[4] = a00;
+  params.matrix[5] = centerR + shiftR - a01 * centerC - a00 * centerR;
+  return params;
+}
+
+// -------------------- BATCH --------------------
+
+void augmentBatch(const uint8_t *images, const uint8_t *const *imagePointers, int count,
+                  int width, int height, int channels, float *out,
+                  const AugmentConfig &config, uint64_t seed, int threads) {
+  const long imageSize = (long)width * height * channels;
+
+  auto work = [&](int first, int last) {
+    for (int i = first; i < last; i++) {
+      const uint8_t *src = imagePointers ? imagePointers[i] : images + i * imageSize;
+      AugmentParams params = randomAugmentParams(config, width, height, mixSeed(seed, i));
+      augmentToF32(src, out + i * imageSize, width, height, channels, params);
+    }
+  };
+
+  if (threads <= 1 || count <= 1) {
+    work(0, count);
+    return;
+  }
+  if (threads > count) threads = count;
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    int first = (int)((long)count * t / threads);
+    int last = (int)((long)count * (t + 1) / threads);
+    workers.emplace_back(work, first, last);
+  }
+  for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+}
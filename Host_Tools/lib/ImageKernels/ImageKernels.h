@@ -0,0 +1,159 @@
+/**
+ * ImageKernels.h
+ *
+ * Vectorized image preprocessing and augmentation kernels for the lettuce CV pipeline.
+ * Images are 8-bit, row-major, interleaved channels (HWC).
+ *
+ * The augmentation follows the ImageDataGenerator settings in farmbot_cv.py
+ * (rotation 40 deg, width/height shift 0.2, shear 0.2, zoom 0.2, horizontal flip,
+ * brightness 0.8-1.2, fill_mode 'nearest', rescale 1/255), but applies the whole
+ * geometric transform, flip, brightness and rescale in a single pass per image.
+ */
+
+#ifndef IMAGE_KERNELS_H
+#define IMAGE_KERNELS_H
+
+#include <stdint.h>
+
+/**
+ * Random augmentation ranges (same meaning as the ImageDataGenerator arguments)
+ */
+struct AugmentConfig {
+  float rotationRange;     // Degrees, rotation drawn from [-r, r]
+  float widthShiftRange;   // Fraction of width
+  float heightShiftRange;  // Fraction of height
+  float shearRange;        // Degrees, as in Keras
+  float zoomRange;         // Zoom drawn from [1 - z, 1 + z] per axis
+  bool horizontalFlip;
+  float brightnessMin;
+  float brightnessMax;
+  float rescale;           // Applied last, e.g. 1/255
+};
+
+/**
+ * Concrete transform for one image, drawn from an AugmentConfig
+ */
+struct AugmentParams {
+  float matrix[6];   // Output -> input pixel mapping: sx = m0*x + m1*y + m2, sy = m3*x + m4*y + m5
+  float brightness;
+  float rescale;
+};
+
+/**
+ * Settings used by the training generator in farmbot_cv.py
+ */
+AugmentConfig defaultAugmentConfig();
+
+/**
+ * Bilinear resize with pixel-center alignment (PIL / OpenCV convention)
+ * Runs a fixed-point horizontal pass per row and a vertical blend, both SIMD.
+ *
+ * @param src Source pixels
+ * @param srcWidth Source width
+ * @param srcHeight Source height
+ * @param dst Destination pixels (dstWidth * dstHeight * channels)
+ * @param dstWidth Destination width
+ * @param dstHeight Destination height
+ * @param channels Interleaved channels (1 to 4)
+ */
+void resizeBilinearU8(const uint8_t *src, int srcWidth, int srcHeight,
+                      uint8_t *dst, int dstWidth, int dstHeight, int channels);
+
+/**
+ * Mirror an image left to right
+ *
+ * @param src Source pixels
+ * @param dst Destination pixels (must not alias src)
+ * @param width Image width
+ * @param height Image height
+ * @param channels Interleaved channels
+ */
+void flipHorizontalU8(const uint8_t *src, uint8_t *dst, int width, int height, int channels);
+
+/**
+ * Scale every value by a brightness factor with saturation at 255
+ *
+ * @param src Source values
+ * @param dst Destination values (may alias src)
+ * @param count Number of values
+ * @param factor Brightness factor (e.g. 0.8 to 1.2)
+ */
+void brightnessU8(const uint8_t *src, uint8_t *dst, long count, float factor);
+
+/**
+ * Convert 8-bit values to floats with a scale (uint8 -> float normalization)
+ *
+ * @param src Source values
+ * @param dst Destination floats
+ * @param count Number of values
+ * @param scale Multiplier, 1/255 for the classifier
+ */
+void normalizeU8ToF32(const uint8_t *src, float *dst, long count, float scale);
+
+/**
+ * Apply an affine warp with bilinear sampling and edge replication ('nearest' fill)
+ *
+ * @param src Source pixels
+ * @param dst Destination pixels, same size as src
+ * @param width Image width
+ * @param height Image height
+ * @param channels Interleaved channels
+ * @param matrix Output -> input mapping, see AugmentParams
+ */
+void warpAffineU8(const uint8_t *src, uint8_t *dst, int width, int height, int channels,
+                  const float matrix[6]);
+
+/**
+ * Draw random augmentation parameters for one image
+ *
+ * @param config Ranges to draw from
+ * @param width Image width
+ * @param height Image height
+ * @param seed Per-image seed; equal seeds give equal transforms
+ * @return Transform with flip folded into the matrix
+ */
+AugmentParams randomAugmentParams(const AugmentConfig &config, int width, int height, uint64_t seed);
+
+/**
+ * Fused augmentation: warp + flip + brightness + rescale to float in one pass
+ *
+ * @param src Source pixels
+ * @param dst Destination floats (width * height * channels)
+ * @param width Image width
+ * @param height Image height
+ * @param channels Interleaved channels
+ * @param params Transform from randomAugmentParams()
+ */
+void augmentToF32(const uint8_t *src, float *dst, int width, int height, int channels,
+                  const AugmentParams &params);
+
+/**
+ * Augment a batch of images across worker threads
+ * Image i always uses the seed mixSeed(seed, i), so the output does not depend
+ * on the thread count or scheduling.
+ *
+ * @param images count images of width * height * channels bytes, or NULL to use imagePointers
+ * @param imagePointers Optional per-image source pointers (e.g. into a packed dataset)
+ * @param count Number of images
+ * @param width Image width
+ * @param height Image height
+ * @param channels Interleaved channels
+ * @param out Destination floats, count * width * height * channels
+ * @param config Augmentation ranges
+ * @param seed Batch seed (e.g. derived from epoch and batch number)
+ * @param threads Worker threads (1 runs inline)
+ */
+void augmentBatch(const uint8_t *images, const uint8_t *const *imagePointers, int count,
+                  int width, int height, int channels, float *out,
+                  const AugmentConfig &config, uint64_t seed, int threads);
+
+/**
+ * Derive a well-mixed per-item seed (splitmix64)
+ *
+ * @param seed Base seed
+ * @param index Item index
+ * @return Seed for the item
+ */
+uint64_t mixSeed(uint64_t seed, uint64_t index);
+
+#endif // IMAGE_KERNELS_H
@@ -0,0 +1,394 @@
+/**
+ * CnnKernels.cpp
+ *
+ * Implementation of the SIMD compute kernels for the lettuce health classifier.
+ * x86 builds use AVX2 (with FMA when available) or SSE4.1, ARM builds use NEON,
+ * anything else falls back to plain loops.
+ */
+
+#include "CnnKernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CNN_USE_AVX2 1
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define CNN_USE_SSE4 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CNN_USE_NEON 1
+#endif
+
+// -------------------- FP32 DOT PRODUCTS --------------------
+
+#if defined(CNN_USE_AVX2)
+
+static inline __m256 fmaddPs(__m256 a, __m256 b, __m256 acc) {
+#if defined(__FMA__)
+  return _mm256_fmadd_ps(a, b, acc);
+#else
+  return _mm256_add_ps(_mm256_mul_ps(a, b), acc);
+#endif
+}
+
+static inline float sumPs(__m256 v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  lo = _mm_hadd_ps(lo, lo);
+  lo = _mm_hadd_ps(lo, lo);
+  return _mm_cvtss_f32(lo);
+}
+
+void dot4F32(const float *shared, const float *const rows[4], int k, float out[4]) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  __m256 acc2 = _mm256_setzero_ps();
+  __m256 acc3 = _mm256_setzero_ps();
+  const float *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3];
+
+  for (int i = 0; i < k; i += 8) {
+    __m256 s = _mm256_loadu_ps(shared + i);
+    acc0 = fmaddPs(s, _mm256_loadu_ps(r0 + i), acc0);
+    acc1 = fmaddPs(s, _mm256_loadu_ps(r1 + i), acc1);
+    acc2 = fmaddPs(s, _mm256_loadu_ps(r2 + i), acc2);
+    acc3 = fmaddPs(s, _mm256_loadu_ps(r3 + i), acc3);
+  }
+
+  out[0] = sumPs(acc0);
+  out[1] = sumPs(acc1);
+  out[2] = sumPs(acc2);
+  out[3] = sumPs(acc3);
+}
+
+float dotF32(const float *a, const float *b, int k) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  for (int i = 0; i < k; i += 16) {
+    acc0 = fmaddPs(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc1 = fmaddPs(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+  }
+  return sumPs(_mm256_add_ps(acc0, acc1));
+}
+
+#elif defined(CNN_USE_SSE4)
+
+static inline float sumPs(__m128 v) {
+  v = _mm_hadd_ps(v, v);
+  v = _mm_hadd_ps(v, v);
+  return _mm_cvtss_f32(v);
+}
+
+void dot4F32(const float *shared, const float *const rows[4], int k, float out[4]) {
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  __m128 acc2 = _mm_setzero_ps();
+  __m128 acc3 = _mm_setzero_ps();
+  const float *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3];
+
+  for (int i = 0; i < k; i += 4) {
+    __m128 s = _mm_loadu_ps(shared + i);
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(s, _mm_loadu_ps(r0 + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(s, _mm_loadu_ps(r1 + i)));
+    acc2 = _mm_add_ps(acc2, _mm_mul_ps(s, _mm_loadu_ps(r2 + i)));
+    acc3 = _mm_add_ps(acc3, _mm_mul_ps(s, _mm_loadu_ps(r3 + i)));
+  }
+
+  out[0] = sumPs(acc0);
+  out[1] = sumPs(acc1);
+  out[2] = sumPs(acc2);
+  out[3] = sumPs(acc3);
+}
+
+float dotF32(const float *a, const float *b, int k) {
+  __m128 acc = _mm_setzero_ps();
+  for (int i = 0; i < k; i += 4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  return sumPs(acc);
+}
+
+#elif defined(CNN_USE_NEON)
+
+static inline float32x4_t fmaddF32(float32x4_t acc, float32x4_t a, float32x4_t b) {
+#if defined(__aarch64__)
+  return vfmaq_f32(acc, a, b);
+#else
+  return vmlaq_f32(acc, a, b);
+#endif
+}
+
+static inline float sumF32(float32x4_t v) {
+#if defined(__aarch64__)
+  return vaddvq_f32(v);
+#else
+  float32x2_t pair = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+  return vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+}
+
+void dot4F32(const float *shared, const float *const rows[4], int k, float out[4]) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  float32x4_t acc2 = vdupq_n_f32(0.0f);
+  float32x4_t acc3 = vdupq_n_f32(0.0f);
+  const float *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3];
+
+  for (int i = 0; i < k; i += 4) {
+    float32x4_t s = vld1q_f32(shared + i);
+    acc0 = fmaddF32(acc0, s, vld1q_f32(r0 + i));
+    acc1 = fmaddF32(acc1, s, vld1q_f32(r1 + i));
+    acc2 = fmaddF32(acc2, s, vld1q_f32(r2 + i));
+    acc3 = fmaddF32(acc3, s, vld1q_f32(r3 + i));
+  }
+
+  out[0] = sumF32(acc0);
+  out[1] = sumF32(acc1);
+  out[2] = sumF32(acc2);
+  out[3] = sumF32(acc3);
+}
+
+float dotF32(const float *a, const float *b, int k) {
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  for (int i = 0; i < k; i += 4) {
+    acc = fmaddF32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  return sumF32(acc);
+}
+
+#else
+
+void dot4F32(const float *shared, const float *const rows[4], int k, float out[4]) {
+  float acc0 = 0.0f, acc1 = 0.0f, acc2 = 0.0f, acc3 = 0.0f;
+  for (int i = 0; i < k; i++) {
+    float s = shared[i];
+    acc0 += s * rows[0][i];
+    acc1 += s * rows[1][i];
+    acc2 += s * rows[2][i];
+    acc3 += s * rows[3][i];
+  }
+  out[0] = acc0;
+  out[1] = acc1;
+  out[2] = acc2;
+  out[3] = acc3;
+}
+
+float dotF32(const float *a, const float *b, int k) {
+  float acc = 0.0f;
+  for (int i = 0; i < k; i++) {
+    acc += a[i] * b[i];
+  }
+  return acc;
+}
+
+#endif
+
+// -------------------- INT8 DOT PRODUCTS --------------------
+
+#if defined(CNN_USE_AVX2)
+
+static inline int32_t sumEpi32(__m256i v) {
+  __m128i lo = _mm256_castsi256_si128(v);
+  __m128i hi = _mm256_extracti128_si256(v, 1);
+  lo = _mm_add_epi32(lo, hi);
+  lo = _mm_hadd_epi32(lo, lo);
+  lo = _mm_hadd_epi32(lo, lo);
+  return _mm_cvtsi128_si32(lo);
+}
+
+// Multiply 16 int8 pairs and add the pairwise sums into 8 int32 lanes
+static inline __m256i madd16S8(__m256i s16, const int8_t *row, __m256i acc) {
+  __m256i r16 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)row));
+  return _mm256_add_epi32(acc, _mm256_madd_epi16(s16, r16));
+}
+
+void dot4S8(const int8_t *shared, const int8_t *const rows[4], int k, int32_t out[4]) {
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  __m256i acc2 = _mm256_setzero_si256();
+  __m256i acc3 = _mm256_setzero_si256();
+  const int8_t *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3];
+
+  for (int i = 0; i < k; i += 16) {
+    __m256i s = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(shared + i)));
+    acc0 = madd16S8(s, r0 + i, acc0);
+    acc1 = madd16S8(s, r1 + i, acc1);
+    acc2 = madd16S8(s, r2 + i, acc2);
+    acc3 = madd16S8(s, r3 + i, acc3);
+  }
+
+  out[0] = sumEpi32(acc0);
+  out[1] = sumEpi32(acc1);
+  out[2] = sumEpi32(acc2);
+  out[3] = sumEpi32(acc3);
+}
+
+int32_t dotS8(const int8_t *a, const int8_t *b, int k) {
+  __m256i acc = _mm256_setzero_si256();
+  for (int i = 0; i < k; i += 16) {
+    __m256i a16 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a + i)));
+    acc = madd16S8(a16, b + i, acc);
+  }
+  return sumEpi32(acc);
+}
+
+#elif defined(CNN_USE_SSE4)
+
+static inline int32_t sumEpi32(__m128i v) {
+  v = _mm_hadd_epi32(v, v);
+  v = _mm_hadd_epi32(v, v);
+  return _mm_cvtsi128_si32(v);
+}
+
+// Multiply 8 int8 pairs and add the pairwise sums into 4 int32 lanes
+static inline __m128i madd8S8(__m128i s16, const int8_t *row, __m128i acc) {
+  __m128i r16 = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *)row));
+  return _mm_add_epi32(acc, _mm_madd_epi16(s16, r16));
+}
+
+void dot4S8(const int8_t *shared, const int8_t *const rows[4], int k, int32_t out[4]) {
+  __m128i acc0 = _mm_setzero_si128();
+  __m128i acc1 = _mm_setzero_si128();
+  __m128i acc2 = _mm_setzero_si128();
+  __m128i acc3 = _mm_setzero_si128();
+  const int8_t *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3];
+
+  for (int i = 0; i < k; i += 8) {
+    __m128i s = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *)(shared + i)));
+    acc0 = madd8S8(s, r0 + i, acc0);
+    acc1 = madd8S8(s, r1 + i, acc1);
+    acc2 = madd8S8(s, r2 + i, acc2);
+    acc3 = madd8S8(s, r3 + i, acc3);
+  }
+
+  out[0] = sumEpi32(acc0);
+  out[1] = sumEpi32(acc1);
+  out[2] = sumEpi32(acc2);
+  out[3] = sumEpi32(acc3);
+}
+
+int32_t dotS8(const int8_t *a, const int8_t *b, int k) {
+  __m128i acc = _mm_setzero_si128();
+  for (int i = 0; i < k; i += 8) {
+    __m128i a16 = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *)(a + i)));
+    acc = madd8S8(a16, b + i, acc);
+  }
+  return sumEpi32(acc);
+}
+
+#elif defined(CNN_USE_NEON)
+
+static inline int32_t sumS32(int32x4_t v) {
+#if defined(__aarch64__)
+  return vaddvq_s32(v);
+#else
+  int32x2_t pair = vadd_s32(vget_low_s32(v), vget_high_s32(v));
+  return vget_lane_s32(vpadd_s32(pair, pair), 0);
+#endif
+}
+
+void dot4S8(const int8_t *shared, const int8_t *const rows[4], int k, int32_t out[4]) {
+  int32x4_t acc0 = vdupq_n_s32(0);
+  int32x4_t acc1 = vdupq_n_s32(0);
+  int32x4_t acc2 = vdupq_n_s32(0);
+  int32x4_t acc3 = vdupq_n_s32(0);
+  const int8_t *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3];
+
+  for (int i = 0; i < k; i += 8) {
+    int8x8_t s = vld1_s8(shared + i);
+    acc0 = vpadalq_s16(acc0, vmull_s8(s, vld1_s8(r0 + i)));
+    acc1 = vpadalq_s16(acc1, vmull_s8(s, vld1_s8(r1 + i)));
+    acc2 = vpadalq_s16(acc2, vmull_s8(s, vld1_s8(r2 + i)));
+    acc3 = vpadalq_s16(acc3, vmull_s8(s, vld1_s8(r3 + i)));
+  }
+
+  out[0] = sumS32(acc0);
+  out[1] = sumS32(acc1);
+  out[2] = sumS32(acc2);
+  out[3] = sumS32(acc3);
+}
+
+int32_t dotS8(const int8_t *a, const int8_t *b, int k) {
+  int32x4_t acc = vdupq_n_s32(0);
+  for (int i = 0; i < k; i += 8) {
+    acc = vpadalq_s16(acc, vmull_s8(vld1_s8(a + i), vld1_s8(b + i)));
+  }
+  return sumS32(acc);
+}
+
+#else
+
+void dot4S8(const int8_t *shared, const int8_t *const rows[4], int k, int32_t out[4]) {
+  int32_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+  for (int i = 0; i < k; i++) {
+    int32_t s = shared[i];
+    acc0 += s * rows[0][i];
+    acc1 += s * rows[1][i];
+    acc2 += s * rows[2][i];
+    acc3 += s * rows[3][i];
+  }
+  out[0] = acc0;
+  out[1] = acc1;
+  out[2] = acc2;
+  out[3] = acc3;
+}
+
+int32_t dotS8(const int8_t *a, const int8_t *b, int k) {
+  int32_t acc = 0;
+  for (int i = 0; i < k; i++) {
+    acc += (int32_t)a[i] * b[i];
+  }
+  return acc;
+}
+
+#endif
+
+// -------------------- QUANTIZATION HELPERS --------------------
+
+float maxAbsF32(const float *data, long n) {
+  float result = 0.0f;
+  for (long i = 0; i < n; i++) {
+    float v = fabsf(data[i]);
+    if (v > result) result = v;
+  }
+  return result;
+}
+
+void quantizeS8(const float *src, int8_t *dst, long n, float invScale) {
+  for (long i = 0; i < n; i++) {
+    long q = lrintf(src[i] * invScale);
+    if (q > 127) q = 127;
+    if (q < -127) q = -127;
+    dst[i] = (int8_t)q;
+  }
+}
+
+// -------------------- IM2COL --------------------
+
+template <typename T>
+void im2colTile(const T *input, int width, int channels, int kh, int kw, int outWidth,
+                long firstPixel, int pixelCount, T *rows, int rowStride) {
+  const int patchRowLength = kw * channels;  // One kernel row is contiguous in HWC
+  const int used = kh * patchRowLength;
+
+  for (int r = 0; r < pixelCount; r++) {
+    long pixel = firstPixel + r;
+    int oy = (int)(pixel / outWidth);
+    int ox = (int)(pixel % outWidth);
+    T *row = rows + (long)r * rowStride;
+
+    for (int ky = 0; ky < kh; ky++) {
+      const T *src = input + ((long)(oy + ky) * width + ox) * channels;
+      memcpy(row + ky * patchRowLength, src, patchRowLength * sizeof(T));
+    }
+    if (rowStride > used) {
+      memset(row + used, 0, (rowStride - used) * sizeof(T));
+    }
+  }
+}
+
+template void im2colTile<float>(const float *, int, int, int, int, int, long, int, float *, int);
+template void im2colTile<int8_t>(const int8_t *, int, int, int, int, int, long, int, int8_t *, int);
@@ -0,0 +1,113 @@
+/**
+ * CnnKernels.h
+ *
+ * Low-level compute kernels for the lettuce health classifier.
+ * Each kernel has an AVX2/SSE4.1 (x86), NEON (ARM) and plain C++ version;
+ * the one matching the compiler target flags is selected at build time.
+ */
+
+#ifndef CNN_KERNELS_H
+#define CNN_KERNELS_H
+
+#include <stdint.h>
+
+// Inner dimensions are padded to this many elements so the SIMD loops
+// never need a remainder loop (32 int8 values = one AVX2 register pair)
+#define CNN_K_ALIGN 32
+
+// Number of pixels unrolled into one im2col tile (keeps the tile in L2)
+#define CNN_PIXEL_TILE 64
+
+/**
+ * Round a length up to the kernel padding
+ *
+ * @param n Length in elements
+ * @return n rounded up to a multiple of CNN_K_ALIGN
+ */
+inline int cnnPaddedLength(int n) {
+  return (n + CNN_K_ALIGN - 1) / CNN_K_ALIGN * CNN_K_ALIGN;
+}
+
+/**
+ * Compute four fp32 dot products that share one operand
+ * out[i] = dot(shared, rows[i]) for i = 0..3
+ *
+ * @param shared Vector reused by all four products (length k)
+ * @param rows Four vectors to multiply with shared (length k each)
+ * @param k Padded length, must be a multiple of CNN_K_ALIGN
+ * @param out Receives the four results
+ */
+void dot4F32(const float *shared, const float *const rows[4], int k, float out[4]);
+
+/**
+ * Compute a single fp32 dot product
+ *
+ * @param a First vector
+ * @param b Second vector
+ * @param k Padded length, must be a multiple of CNN_K_ALIGN
+ * @return Dot product of a and b
+ */
+float dotF32(const float *a, const float *b, int k);
+
+/**
+ * Compute four int8 dot products that share one operand
+ * Accumulates in int32, so k may be up to ~130000 without overflow
+ *
+ * @param shared Vector reused by all four products (length k)
+ * @param rows Four vectors to multiply with shared (length k each)
+ * @param k Padded length, must be a multiple of CNN_K_ALIGN
+ * @param out Receives the four results
+ */
+void dot4S8(const int8_t *shared, const int8_t *const rows[4], int k, int32_t out[4]);
+
+/**
+ * Compute a single int8 dot product
+ *
+ * @param a First vector
+ * @param b Second vector
+ * @param k Padded length, must be a multiple of CNN_K_ALIGN
+ * @return Dot product of a and b
+ */
+int32_t dotS8(const int8_t *a, const int8_t *b, int k);
+
+/**
+ * Find the largest absolute value in a float array
+ * Used to pick the dynamic activation scale for the int8 path
+ *
+ * @param data Values to scan
+ * @param n Number of values
+ * @return max(|data[i]|)
+ */
+float maxAbsF32(const float *data, long n);
+
+/**
+ * Quantize floats to int8 with a single scale (round to nearest, saturating)
+ *
+ * @param src Source values
+ * @param dst Destination int8 values
+ * @param n Number of values
+ * @param invScale 1 / scale, i.e. dst = round(src * invScale)
+ */
+void quantizeS8(const float *src, int8_t *dst, long n, float invScale);
+
+/**
+ * Unroll 3D patches of an HWC image into rows (im2col) for a tile of output pixels
+ * Row r holds the kh*kw*c patch of output pixel (firstPixel + r) in
+ * (ky, kx, channel) order, zero padded to rowStride.
+ *
+ * @param input Input image in HWC layout
+ * @param width Input width
+ * @param channels Input channels
+ * @param kh Kernel height
+ * @param kw Kernel width
+ * @param outWidth Output width (input width - kw + 1)
+ * @param firstPixel Index of the first output pixel in the tile
+ * @param pixelCount Number of output pixels in the tile
+ * @param rows Destination, pixelCount rows of rowStride elements
+ * @param rowStride Padded row length
+ */
+template <typename T>
+void im2colTile(const T *input, int width, int channels, int kh, int kw, int outWidth,
+                long firstPixel, int pixelCount, T *rows, int rowStride);
+
+#endif // CNN_KERNELS_H
@@ -0,0 +1,486 @@
+/**
+ * CnnModel.cpp
+ *
+ * Loading, quantization and forward pass of the lettuce health classifier.
+ */
+
+#include "CnnModel.h"
+#include "CnnKernels.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// -------------------- FILE I/O --------------------
+
+static bool readU32(FILE *file, uint32_t &value) {
+  unsigned char bytes[4];
+  if (fread(bytes, 1, 4, file) != 4) return false;
+  value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+  return true;
+}
+
+static bool writeU32(FILE *file, uint32_t value) {
+  unsigned char bytes[4] = {
+    (unsigned char)value, (unsigned char)(value >> 8),
+    (unsigned char)(value >> 16), (unsigned char)(value >> 24)
+  };
+  return fwrite(bytes, 1, 4, file) == 4;
+}
+
+// Weight payloads are raw little-endian arrays; every supported host is little-endian
+static bool readArray(FILE *file, void *data, size_t bytes) {
+  return fread(data, 1, bytes, file) == bytes;
+}
+
+static bool writeArray(FILE *file, const void *data, size_t bytes) {
+  return fwrite(data, 1, bytes, file) == bytes;
+}
+
+/**
+ * Fill in the derived shape of a layer from the shape of its input
+ *
+ * @return FALSE if the layer cannot be applied to that input
+ */
+static bool resolveLayerShape(CnnLayer &layer, int inH, int inW, int inC, std::string &error) {
+  layer.inH = inH;
+  layer.inW = inW;
+  layer.inC = inC;
+
+  if (layer.type == CNN_LAYER_CONV) {
+    layer.outH = inH - layer.kh + 1;
+    layer.outW = inW - layer.kw + 1;
+    layer.k = layer.kh * layer.kw * inC;
+  } else if (layer.type == CNN_LAYER_MAXPOOL) {
+    layer.outH = inH / layer.kh;
+    layer.outW = inW / layer.kw;
+    layer.outC = inC;
+    layer.k = 0;
+  } else if (layer.type == CNN_LAYER_DENSE) {
+    // Flatten: dense layers see the previous output as one vector
+    layer.inH = 1;
+    layer.inW = 1;
+    layer.inC = inH * inW * inC;
+    layer.outH = 1;
+    layer.outW = 1;
+    layer.k = layer.inC;
+  } else {
+    error = "unknown layer type " + std::to_string(layer.type);
+    return false;
+  }
+
+  if (layer.outH <= 0 || layer.outW <= 0 || layer.outC <= 0) {
+    error = "layer output shape is empty";
+    return false;
+  }
+  layer.kPadded = cnnPaddedLength(layer.k);
+  return true;
+}
+
+bool loadCnnModel(const char *path, CnnModel &model, std::string &error) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    error = std::string("cannot open ") + path;
+    return false;
+  }
+
+  char magic[4];
+  uint32_t version, inputH, inputW, inputC, layerCount;
+  bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, LCNN_MAGIC, 4) == 0;
+  ok = ok && readU32(file, version) && version == LCNN_VERSION;
+  ok = ok && readU32(file, inputH) && readU32(file, inputW) && readU32(file, inputC);
+  ok = ok && readU32(file, layerCount) && layerCount > 0 && layerCount < 64;
+  if (!ok) {
+    error = std::string(path) + " is not an LCNN v" + std::to_string(LCNN_VERSION) + " file";
+    fclose(file);
+    return false;
+  }
+
+  model.inputH = inputH;
+  model.inputW = inputW;
+  model.inputC = inputC;
+  model.layers.clear();
+  model.layers.resize(layerCount);
+  model.hasFp32 = true;
+  model.hasInt8 = true;
+
+  int h = inputH, w = inputW, c = inputC;
+  for (uint32_t i = 0; i < layerCount && ok; i++) {
+    CnnLayer &layer = model.layers[i];
+    uint32_t type, activation, outputs, kh, kw, dtype;
+    ok = readU32(file, type) && readU32(file, activation) && readU32(file, outputs) &&
+         readU32(file, kh) && readU32(file, kw) && readU32(file, dtype);
+    if (!ok) break;
+
+    layer.type = type;
+    layer.activation = activation;
+    layer.outC = outputs;
+    layer.kh = kh;
+    layer.kw = kw;
+    if (!resolveLayerShape(layer, h, w, c, error)) {
+      fclose(file);
+      return false;
+    }
+    h = layer.outH;
+    w = layer.outW;
+    c = layer.outC;
+
+    if (layer.type == CNN_LAYER_MAXPOOL) continue;
+
+    const size_t rowBytes = layer.k;
+    layer.bias.resize(layer.outC);
+    if (dtype == CNN_DTYPE_FP32) {
+      model.hasInt8 = false;
+      layer.weights.assign((size_t)layer.outC * layer.kPadded, 0.0f);
+      for (int o = 0; o < layer.outC && ok; o++) {
+        ok = readArray(file, &layer.weights[(size_t)o * layer.kPadded], rowBytes * sizeof(float));
+      }
+    } else if (dtype == CNN_DTYPE_INT8) {
+      model.hasFp32 = false;
+      layer.weightScales.resize(layer.outC);
+      layer.weightsS8.assign((size_t)layer.outC * layer.kPadded, 0);
+      ok = readArray(file, layer.weightScales.data(), layer.outC * sizeof(float));
+      for (int o = 0; o < layer.outC && ok; o++) {
+        ok = readArray(file, &layer.weightsS8[(size_t)o * layer.kPadded], rowBytes);
+      }
+    } else {
+      error = "unknown weight type " + std::to_string(dtype);
+      fclose(file);
+      return false;
+    }
+    ok = ok && readArray(file, layer.bias.data(), layer.outC * sizeof(float));
+  }
+
+  fclose(file);
+  if (!ok) {
+    error = std::string(path) + " is truncated";
+    return false;
+  }
+  return true;
+}
+
+bool saveCnnModel(const char *path, const CnnModel &model, CnnPrecision precision, std::string &error) {
+  if ((precision == CNN_FP32 && !model.hasFp32) || (precision == CNN_INT8 && !model.hasInt8)) {
+    error = "model has no weights for the requested precision";
+    return false;
+  }
+
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    error = std::string("cannot create ") + path;
+    return false;
+  }
+
+  bool ok = fwrite(LCNN_MAGIC, 1, 4, file) == 4 && writeU32(file, LCNN_VERSION) &&
+            writeU32(file, model.inputH) && writeU32(file, model.inputW) &&
+            writeU32(file, model.inputC) && writeU32(file, model.layers.size());
+
+  for (size_t i = 0; i < model.layers.size() && ok; i++) {
+    const CnnLayer &layer = model.layers[i];
+    uint32_t dtype = precision == CNN_INT8 ? CNN_DTYPE_INT8 : CNN_DTYPE_FP32;
+    uint32_t outputs = layer.type == CNN_LAYER_MAXPOOL ? 0 : layer.outC;
+    ok = writeU32(file, layer.type) && writeU32(file, layer.activation) && writeU32(file, outputs) &&
+         writeU32(file, layer.kh) && writeU32(file, layer.kw) && writeU32(file, dtype);
+    if (layer.type == CNN_LAYER_MAXPOOL) continue;
+
+    if (precision == CNN_FP32) {
+      for (int o = 0; o < layer.outC && ok; o++) {
+        ok = writeArray(file, &layer.weights[(size_t)o * layer.kPadded], layer.k * sizeof(float));
+      }
+    } else {
+      ok = ok && writeArray(file, layer.weightScales.data(), layer.outC * sizeof(float));
+      for (int o = 0; o < layer.outC && ok; o++) {
+        ok = writeArray(file, &layer.weightsS8[(size_t)o * layer.kPadded], layer.k);
+      }
+    }
+    ok = ok && writeArray(file, layer.bias.data(), layer.outC * sizeof(float));
+  }
+
+  if (fclose(file) != 0) ok = false;
+  if (!ok) error = std::string("failed writing ") + path;
+  return ok;
+}
+
+void quantizeCnnModel(CnnModel &model) {
+  for (size_t i = 0; i < model.layers.size(); i++) {
+    CnnLayer &layer = model.layers[i];
+    if (layer.type == CNN_LAYER_MAXPOOL) continue;
+
+    layer.weightScales.resize(layer.outC);
+    layer.weightsS8.assign((size_t)layer.outC * layer.kPadded, 0);
+    for (int o = 0; o < layer.outC; o++) {
+      const float *row = &layer.weights[(size_t)o * layer.kPadded];
+      float maxAbs = maxAbsF32(row, layer.k);
+      float scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+      layer.weightScales[o] = scale;
+      quantizeS8(row, &layer.weightsS8[(size_t)o * layer.kPadded], layer.k, 1.0f / scale);
+    }
+  }
+  model.hasInt8 = true;
+}
+
+// -------------------- FORWARD PASS --------------------
+
+long cnnInputSize(const CnnModel &model) {
+  return (long)model.inputH * model.inputW * model.inputC;
+}
+
+void initCnnWorkspace(const CnnModel &model, CnnWorkspace &workspace, int maxBatch) {
+  long maxActivation = cnnInputSize(model);
+  long maxColRow = 0;
+  long maxDense = 0;
+
+  for (size_t i = 0; i < model.layers.size(); i++) {
+    const CnnLayer &layer = model.layers[i];
+    long outSize = (long)layer.outH * layer.outW * layer.outC;
+    if (layer.type == CNN_LAYER_DENSE) {
+      maxDense = std::max(maxDense, (long)layer.kPadded);
+      maxDense = std::max(maxDense, (long)cnnPaddedLength(layer.outC));
+    } else {
+      maxActivation = std::max(maxActivation, outSize);
+      maxColRow = std::max(maxColRow, (long)layer.kPadded);
+    }
+  }
+
+  workspace.maxBatch = maxBatch;
+  workspace.activationA.assign(maxActivation, 0.0f);
+  workspace.activationB.assign(maxActivation, 0.0f);
+  workspace.activationS8.assign(maxActivation, 0);
+  workspace.colTile.assign(CNN_PIXEL_TILE * maxColRow, 0.0f);
+  workspace.colTileS8.assign(CNN_PIXEL_TILE * maxColRow, 0);
+  workspace.batchA.assign(maxBatch * maxDense, 0.0f);
+  workspace.batchB.assign(maxBatch * maxDense, 0.0f);
+  workspace.batchS8.assign(maxBatch * maxDense, 0);
+  workspace.batchScales.assign(maxBatch, 0.0f);
+}
+
+static inline float activate(float value, int activation) {
+  if (activation == CNN_ACT_RELU) return value > 0.0f ? value : 0.0f;
+  if (activation == CNN_ACT_SIGMOID) return 1.0f / (1.0f + expf(-value));
+  return value;
+}
+
+/**
+ * fp32 convolution: im2col one tile of output pixels, then multiply every
+ * unrolled patch with four filters at a time so each patch load is reused 4x
+ */
+static void convF32(const CnnLayer &layer, const float *input, float *output, CnnWorkspace &ws) {
+  const long pixels = (long)layer.outH * layer.outW;
+  const int outC = layer.outC;
+  float *tile = ws.colTile.data();
+
+  for (long first = 0; first < pixels; first += CNN_PIXEL_TILE) {
+    int count = (int)std::min<long>(CNN_PIXEL_TILE, pixels - first);
+    im2colTile(input, layer.inW, layer.inC, layer.kh, layer.kw, layer.outW, first, count, tile, layer.kPadded);
+
+    for (int r = 0; r < count; r++) {
+      const float *patch = tile + (long)r * layer.kPadded;
+      float *out = output + (first + r) * outC;
+      int o = 0;
+      for (; o + 4 <= outC; o += 4) {
+        const float *rows[4];
+        float sums[4];
+        for (int j = 0; j < 4; j++) rows[j] = &layer.weights[(size_t)(o + j) * layer.kPadded];
+        dot4F32(patch, rows, layer.kPadded, sums);
+        for (int j = 0; j < 4; j++) out[o + j] = activate(sums[j] + layer.bias[o + j], layer.activation);
+      }
+      for (; o < outC; o++) {
+        float sum = dotF32(patch, &layer.weights[(size_t)o * layer.kPadded], layer.kPadded);
+        out[o] = activate(sum + layer.bias[o], layer.activation);
+      }
+    }
+  }
+}
+
+/**
+ * int8 convolution: the input is quantized once with a dynamic per-tensor
+ * scale, then processed like convF32 with int32 accumulation
+ */
+static void convS8(const CnnLayer &layer, const float *input, float *output, CnnWorkspace &ws) {
+  const long pixels = (long)layer.outH * layer.outW;
+  const long inputSize = (long)layer.inH * layer.inW * layer.inC;
+  const int outC = layer.outC;
+  int8_t *quantized = ws.activationS8.data();
+  int8_t *tile = ws.colTileS8.data();
+
+  float maxAbs = maxAbsF32(input, inputSize);
+  float inputScale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+  quantizeS8(input, quantized, inputSize, 1.0f / inputScale);
+
+  for (long first = 0; first < pixels; first += CNN_PIXEL_TILE) {
+    int count = (int)std::min<long>(CNN_PIXEL_TILE, pixels - first);
+    im2colTile(quantized, layer.inW, layer.inC, layer.kh, layer.kw, layer.outW, first, count, tile, layer.kPadded);
+
+    for (int r = 0; r < count; r++) {
+      const int8_t *patch = tile + (long)r * layer.kPadded;
+      float *out = output + (first + r) * outC;
+      int o = 0;
+      for (; o + 4 <= outC; o += 4) {
+        const int8_t *rows[4];
+        int32_t sums[4];
+        for (int j = 0; j < 4; j++) rows[j] = &layer.weightsS8[(size_t)(o + j) * layer.kPadded];
+        dot4S8(patch, rows, layer.kPadded, sums);
+        for (int j = 0; j < 4; j++) {
+          float value = sums[j] * inputScale * layer.weightScales[o + j] + layer.bias[o + j];
+          out[o + j] = activate(value, layer.activation);
+        }
+      }
+      for (; o < outC; o++) {
+        int32_t sum = dotS8(patch, &layer.weightsS8[(size_t)o * layer.kPadded], layer.kPadded);
+        out[o] = activate(sum * inputScale * layer.weightScales[o] + layer.bias[o], layer.activation);
+      }
+    }
+  }
+}
+
+static void maxPool(const CnnLayer &layer, const float *input, float *output) {
+  const int c = layer.inC;
+  for (int oy = 0; oy < layer.outH; oy++) {
+    for (int ox = 0; ox < layer.outW; ox++) {
+      float *out = output + ((long)oy * layer.outW + ox) * c;
+      const float *first = input + ((long)oy * layer.kh * layer.inW + (long)ox * layer.kw) * c;
+      memcpy(out, first, c * sizeof(float));
+
+      for (int py = 0; py < layer.kh; py++) {
+        for (int px = 0; px < layer.kw; px++) {
+          const float *in = input + (((long)oy * layer.kh + py) * layer.inW + (long)ox * layer.kw + px) * c;
+          for (int ch = 0; ch < c; ch++) {
+            if (in[ch] > out[ch]) out[ch] = in[ch];
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * fp32 dense layer over the batch: each weight row is loaded once and
+ * multiplied with four batch vectors at a time
+ */
+static void denseF32(const CnnLayer &layer, const float *input, float *output, int count) {
+  const int inStride = layer.kPadded;
+  const int outStride = cnnPaddedLength(layer.outC);
+
+  for (int o = 0; o < layer.outC; o++) {
+    const float *row = &layer.weights[(size_t)o * layer.kPadded];
+    int b = 0;
+    for (; b + 4 <= count; b += 4) {
+      const float *vectors[4];
+      float sums[4];
+      for (int j = 0; j < 4; j++) vectors[j] = input + (long)(b + j) * inStride;
+      dot4F32(row, vectors, inStride, sums);
+      for (int j = 0; j < 4; j++) {
+        output[(long)(b + j) * outStride + o] = activate(sums[j] + layer.bias[o], layer.activation);
+      }
+    }
+    for (; b < count; b++) {
+      float sum = dotF32(row, input + (long)b * inStride, inStride);
+      output[(long)b * outStride + o] = activate(sum + layer.bias[o], layer.activation);
+    }
+  }
+}
+
+static void denseS8(const CnnLayer &layer, const float *input, float *output, int count, CnnWorkspace &ws) {
+  const int inStride = layer.kPadded;
+  const int outStride = cnnPaddedLength(layer.outC);
+  int8_t *quantized = ws.batchS8.data();
+
+  // Every batch entry gets its own activation scale
+  for (int b = 0; b < count; b++) {
+    const float *vector = input + (long)b * inStride;
+    float maxAbs = maxAbsF32(vector, layer.k);
+    float scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+    ws.batchScales[b] = scale;
+    quantizeS8(vector, quantized + (long)b * inStride, inStride, 1.0f / scale);
+  }
+
+  for (int o = 0; o < layer.outC; o++) {
+    const int8_t *row = &layer.weightsS8[(size_t)o * layer.kPadded];
+    const float weightScale = layer.weightScales[o];
+    int b = 0;
+    for (; b + 4 <= count; b += 4) {
+      const int8_t *vectors[4];
+      int32_t sums[4];
+      for (int j = 0; j < 4; j++) vectors[j] = quantized + (long)(b + j) * inStride;
+      dot4S8(row, vectors, inStride, sums);
+      for (int j = 0; j < 4; j++) {
+        float value = sums[j] * ws.batchScales[b + j] * weightScale + layer.bias[o];
+        output[(long)(b + j) * outStride + o] = activate(value, layer.activation);
+      }
+    }
+    for (; b < count; b++) {
+      int32_t sum = dotS8(row, quantized + (long)b * inStride, inStride);
+      float value = sum * ws.batchScales[b] * weightScale + layer.bias[o];
+      output[(long)b * outStride + o] = activate(value, layer.activation);
+    }
+  }
+}
+
+void runCnnBatch(const CnnModel &model, CnnWorkspace &workspace, const float *images, int count,
+                 CnnPrecision precision, float *scores) {
+  const long inputSize = cnnInputSize(model);
+  const size_t layerCount = model.layers.size();
+
+  // Index of the first dense layer; everything before it runs per image
+  size_t firstDense = 0;
+  while (firstDense < layerCount && model.layers[firstDense].type != CNN_LAYER_DENSE) firstDense++;
+
+  const int featureStride = firstDense < layerCount ? model.layers[firstDense].kPadded : 0;
+
+  for (int start = 0; start < count; start += workspace.maxBatch) {
+    int batch = std::min(workspace.maxBatch, count - start);
+
+    // Convolution stack, one image at a time
+    for (int b = 0; b < batch; b++) {
+      const float *current = images + (long)(start + b) * inputSize;
+      float *buffers[2] = { workspace.activationA.data(), workspace.activationB.data() };
+      int next = 0;
+      long currentSize = inputSize;
+
+      for (size_t i = 0; i < firstDense; i++) {
+        const CnnLayer &layer = model.layers[i];
+        float *output = buffers[next];
+        if (layer.type == CNN_LAYER_CONV) {
+          if (precision == CNN_INT8) convS8(layer, current, output, workspace);
+          else convF32(layer, current, output, workspace);
+        } else {
+          maxPool(layer, current, output);
+        }
+        current = output;
+        currentSize = (long)layer.outH * layer.outW * layer.outC;
+        next ^= 1;
+      }
+
+      // Flatten into the batch matrix (HWC order matches Keras Flatten)
+      float *feature = workspace.batchA.data() + (long)b * featureStride;
+      memcpy(feature, current, currentSize * sizeof(float));
+      memset(feature + currentSize, 0, (featureStride - currentSize) * sizeof(float));
+    }
+
+    // Dense stack on the whole batch
+    float *input = workspace.batchA.data();
+    float *output = workspace.batchB.data();
+    int outStride = featureStride;
+    for (size_t i = firstDense; i < layerCount; i++) {
+      const CnnLayer &layer = model.layers[i];
+      outStride = cnnPaddedLength(layer.outC);
+
+      // Keep the padding lanes zero so the next layer's SIMD loop can read them
+      memset(output, 0, (size_t)batch * outStride * sizeof(float));
+      if (precision == CNN_INT8) denseS8(layer, input, output, batch, workspace);
+      else denseF32(layer, input, output, batch);
+      std::swap(input, output);
+    }
+
+    for (int b = 0; b < batch; b++) {
+      scores[start + b] = input[(long)b * outStride];
+    }
+  }
+}
+
+float runCnn(const CnnModel &model, CnnWorkspace &workspace, const float *image, CnnPrecision precision) {
+  float score = 0.0f;
+  runCnnBatch(model, workspace, image, 1, precision, &score);
+  return score;
+}
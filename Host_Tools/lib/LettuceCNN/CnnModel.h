@@ -0,0 +1,176 @@
+/**
+ * CnnModel.h
+ *
+ * Standalone inference engine for the healthy / non-healthy lettuce classifier
+ * trained in farmbot_cv.py (150x150x3 input, three Conv2D+MaxPool blocks,
+ * Dense 512, sigmoid output).
+ *
+ * Weights are exported from healthy_vs_non_healthy_classifier.h5 with
+ * scripts/export_lettuce_model.py into the binary LCNN format described below.
+ * Inference runs either in fp32 or with int8 weights and activations.
+ *
+ * LCNN file layout (all values little-endian):
+ *   char[4] "LCNN", u32 version, u32 inputH, u32 inputW, u32 inputC, u32 layerCount
+ *   per layer: u32 type, u32 activation, u32 outputs, u32 kh, u32 kw, u32 dtype
+ *     conv/dense, fp32:  f32 weights[outputs][K], f32 bias[outputs]
+ *     conv/dense, int8:  f32 scales[outputs], i8 weights[outputs][K], f32 bias[outputs]
+ *     maxpool:           no payload (kh x kw is the pool size)
+ *   Conv weights are ordered [filter][ky][kx][channel], dense weights [unit][input],
+ *   K being kh*kw*channels or the flattened input length.
+ */
+
+#ifndef CNN_MODEL_H
+#define CNN_MODEL_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define LCNN_MAGIC "LCNN"
+#define LCNN_VERSION 1
+
+// Layer types as stored in the LCNN file
+enum CnnLayerType {
+  CNN_LAYER_CONV = 1,     // Valid 2D convolution, stride 1
+  CNN_LAYER_MAXPOOL = 2,  // Max pooling, stride = pool size
+  CNN_LAYER_DENSE = 3     // Fully connected layer on the flattened input
+};
+
+// Activation applied after conv/dense layers
+enum CnnActivation {
+  CNN_ACT_NONE = 0,
+  CNN_ACT_RELU = 1,
+  CNN_ACT_SIGMOID = 2
+};
+
+// Weight storage type in the LCNN file
+enum CnnDataType {
+  CNN_DTYPE_FP32 = 0,
+  CNN_DTYPE_INT8 = 1
+};
+
+// Arithmetic used for a forward pass
+enum CnnPrecision {
+  CNN_FP32 = 0,
+  CNN_INT8 = 1
+};
+
+/**
+ * One layer of the network with its weights
+ * Weight rows are padded to kPadded elements so SIMD kernels can run without tails.
+ */
+struct CnnLayer {
+  int type;
+  int activation;
+  int inH, inW, inC;     // Input shape (dense layers use inC = flattened length)
+  int outH, outW, outC;  // Output shape (dense layers use outC = units)
+  int kh, kw;            // Kernel or pool size
+  int k;                 // Unpadded inner dimension
+  int kPadded;           // Inner dimension rounded up to CNN_K_ALIGN
+
+  std::vector<float> weights;       // outC rows of kPadded fp32 weights
+  std::vector<int8_t> weightsS8;    // outC rows of kPadded int8 weights
+  std::vector<float> weightScales;  // Per-output int8 scale
+  std::vector<float> bias;
+};
+
+/**
+ * Complete network as loaded from an LCNN file
+ */
+struct CnnModel {
+  int inputH, inputW, inputC;
+  std::vector<CnnLayer> layers;
+  bool hasFp32;  // fp32 weights available
+  bool hasInt8;  // int8 weights available
+};
+
+/**
+ * Scratch buffers for running a model
+ * One workspace per thread; buffers are sized once by initCnnWorkspace().
+ */
+struct CnnWorkspace {
+  int maxBatch;
+  std::vector<float> activationA;   // Ping-pong buffers for one image
+  std::vector<float> activationB;
+  std::vector<int8_t> activationS8;
+  std::vector<float> colTile;       // im2col tile
+  std::vector<int8_t> colTileS8;
+  std::vector<float> batchA;        // Ping-pong buffers for the dense layers
+  std::vector<float> batchB;
+  std::vector<int8_t> batchS8;
+  std::vector<float> batchScales;
+};
+
+/**
+ * Load a model from an LCNN file
+ *
+ * @param path File to read
+ * @param model Receives the model
+ * @param error Receives a description on failure
+ * @return TRUE if the model was loaded
+ */
+bool loadCnnModel(const char *path, CnnModel &model, std::string &error);
+
+/**
+ * Save a model to an LCNN file
+ * Saving with CNN_INT8 produces a file about 4x smaller than fp32.
+ *
+ * @param path File to write
+ * @param model Model to save
+ * @param precision Which weight set to store
+ * @param error Receives a description on failure
+ * @return TRUE if the file was written
+ */
+bool saveCnnModel(const char *path, const CnnModel &model, CnnPrecision precision, std::string &error);
+
+/**
+ * Derive int8 weights (symmetric, per output channel) from the fp32 weights
+ *
+ * @param model Model with fp32 weights; hasInt8 is set on return
+ */
+void quantizeCnnModel(CnnModel &model);
+
+/**
+ * Size a workspace for a model
+ *
+ * @param model Model the workspace will be used with
+ * @param workspace Workspace to initialize
+ * @param maxBatch Largest batch passed to runCnnBatch()
+ */
+void initCnnWorkspace(const CnnModel &model, CnnWorkspace &workspace, int maxBatch);
+
+/**
+ * Run the network on a batch of images
+ * Convolution layers run image by image, dense layers run on the whole batch
+ * so every weight row is streamed from memory once per batch.
+ *
+ * @param model Model to run
+ * @param workspace Workspace sized for at least count images
+ * @param images count images in HWC layout, values normalized to [0, 1]
+ * @param count Number of images
+ * @param precision CNN_FP32 or CNN_INT8 (the matching weights must be present)
+ * @param scores Receives one output per image (non-healthy probability)
+ */
+void runCnnBatch(const CnnModel &model, CnnWorkspace &workspace, const float *images, int count,
+                 CnnPrecision precision, float *scores);
+
+/**
+ * Run the network on a single image
+ *
+ * @param model Model to run
+ * @param workspace Workspace for the model
+ * @param image Image in HWC layout, values normalized to [0, 1]
+ * @param precision CNN_FP32 or CNN_INT8
+ * @return Non-healthy probability (> 0.5 means Non-Healthy)
+ */
+float runCnn(const CnnModel &model, CnnWorkspace &workspace, const float *image, CnnPrecision precision);
+
+/**
+ * Number of floats in one input image
+ *
+ * @param model Loaded model
+ * @return inputH * inputW * inputC
+ */
+long cnnInputSize(const CnnModel &model);
+
+#endif // CNN_MODEL_H
@@ -0,0 +1,165 @@
+/**
+ * MoveTimeModel.cpp
+ *
+ * Closed-form move duration for the moveSteps() speed profile.
+ */
+
+#include "MoveTimeModel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAMP_MIN_STEPS 10  // moveSteps() never ramps over fewer steps
+
+// Per-step work of runProfile() and stepMotor() that the step delay does not
+// cover, in CPU cycles at 16 MHz. The pulse width is subtracted from the wait
+// and so is a velocity control tick, so neither adds to the step time. A
+// ganged X axis reads a second limit pin, about 4 us more per step.
+#define CYCLES_INTERRUPT_CHECKS 85  // digitalRead of the limit pin, stop/hold flags, racking countdown
+#define CYCLES_PULSE 85             // Two atomic port read-modify-writes, micros() for the stop latency
+#define CYCLES_POSITION 55          // Sequence-locked position update, trace countdown, tick flag test
+#define CYCLES_LOOP 45              // Calls, loop counters, delay ramp
+#define STEP_OVERHEAD_CYCLES \
+  (CYCLES_INTERRUPT_CHECKS + CYCLES_PULSE + CYCLES_POSITION + CYCLES_LOOP)
+
+MotionProfile defaultMotionProfile() {
+  MotionProfile profile;
+  profile.minStepDelay = 200;
+  profile.maxStepDelay = 1000;
+  profile.accelRate = 5;
+  profile.decelRate = 10;
+  profile.stepOverheadMicros = (STEP_OVERHEAD_CYCLES + 15) / 16;  // 17 us; encoder interrupts not included
+  profile.commandOverheadMicros = 20000; // ~200 characters of status text at 115200 baud
+  return profile;
+}
+
+bool loadProfileFromConfig(const char *path, MotionProfile &profile, std::string &error) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    error = std::string("cannot read ") + path;
+    return false;
+  }
+
+  struct { const char *name; long *value; } fields[] = {
+    { "MIN_STEP_DELAY", &profile.minStepDelay },
+    { "MAX_STEP_DELAY", &profile.maxStepDelay },
+    { "ACCEL_RATE", &profile.accelRate },
+    { "DECEL_RATE", &profile.decelRate },
+  };
+  int found = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    char name[64];
+    long value;
+    if (sscanf(line, " #define %63s %ld", name, &value) != 2) continue;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+      if (!strcmp(name, fields[i].name)) {
+        *fields[i].value = value;
+        found++;
+      }
+    }
+  }
+  fclose(file);
+
+  if (found == 0) {
+    error = std::string(path) + ": no step timing #defines found";
+    return false;
+  }
+  return true;
+}
+
+bool parseProfile(const char *text, MotionProfile &profile) {
+  long minDelay, maxDelay, accel, decel;
+  if (sscanf(text, "%ld,%ld,%ld,%ld", &minDelay, &maxDelay, &accel, &decel) != 4) return false;
+  if (minDelay <= 0 || maxDelay < minDelay || accel < 0 || decel < 0) return false;
+  profile.minStepDelay = minDelay;
+  profile.maxStepDelay = maxDelay;
+  profile.accelRate = accel;
+  profile.decelRate = decel;
+  return true;
+}
+
+/**
+ * Split a move into ramp and cruise step counts exactly like moveSteps()
+ */
+static void splitPhases(long total, long &acceleration, long &constant, long &deceleration) {
+  acceleration = total / 4;
+  deceleration = total / 4;
+  constant = total - acceleration - deceleration;
+  if (acceleration < RAMP_MIN_STEPS) acceleration = RAMP_MIN_STEPS;
+  if (deceleration < RAMP_MIN_STEPS) deceleration = RAMP_MIN_STEPS;
+  if (acceleration + deceleration > total) {
+    acceleration = total / 2;
+    deceleration = total - acceleration;
+    constant = 0;
+  }
+}
+
+/**
+ * Sum of n delays that start at first and move by step towards limit,
+ * stopping there: first, first+step, ..., limit, limit, ...
+ * step is negative while accelerating.
+ *
+ * @param last Receives the delay after the n-th update
+ */
+static long long rampMicros(long n, long first, long step, long limit, long &last) {
+  long gap = step < 0 ? first - limit : limit - first;
+  if (n <= 0) {
+    last = first;
+    return 0;
+  }
+  if (gap <= 0 || step == 0) {
+    last = first;
+    return (long long)n * first;
+  }
+  long magnitude = labs(step);
+  long moving = (gap + magnitude - 1) / magnitude;  // Steps taken before the limit
+  long m = n < moving ? n : moving;
+  long long sum = (long long)m * first + (long long)step * m * (m - 1) / 2 + (long long)(n - m) * limit;
+  last = n < moving ? first + step * n : limit;
+  return sum;
+}
+
+long long moveMicros(const MotionProfile &profile, long steps) {
+  long total = labs(steps);
+  if (total == 0) return 0;
+
+  long acceleration, constant, deceleration;
+  splitPhases(total, acceleration, constant, deceleration);
+
+  long cruise;
+  long long micros = rampMicros(acceleration, profile.maxStepDelay, -profile.accelRate,
+                                profile.minStepDelay, cruise);
+  micros += (long long)constant * cruise;
+  long unused;
+  micros += rampMicros(deceleration, cruise, profile.decelRate, profile.maxStepDelay, unused);
+  return micros + (long long)total * profile.stepOverheadMicros + profile.commandOverheadMicros;
+}
+
+long long moveMicrosReference(const MotionProfile &profile, long steps) {
+  long total = labs(steps);
+  if (total == 0) return 0;
+
+  long acceleration, constant, deceleration;
+  splitPhases(total, acceleration, constant, deceleration);
+
+  long long micros = 0;
+  long delay = profile.maxStepDelay;
+  for (long i = 0; i < acceleration; i++) {
+    micros += delay;
+    if (delay > profile.minStepDelay) {
+      delay -= profile.accelRate;
+      if (delay < profile.minStepDelay) delay = profile.minStepDelay;
+    }
+  }
+  for (long i = 0; i < constant; i++) micros += delay;
+  for (long i = 0; i < deceleration; i++) {
+    micros += delay;
+    if (delay < profile.maxStepDelay) {
+      delay += profile.decelRate;
+      if (delay > profile.maxStepDelay) delay = profile.maxStepDelay;
+    }
+  }
+  return micros + (long long)total * profile.stepOverheadMicros + profile.commandOverheadMicros;
+}
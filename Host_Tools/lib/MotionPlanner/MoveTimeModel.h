@@ -0,0 +1,65 @@
+/**
+ * MoveTimeModel.h
+ *
+ * Predicts how long the controller takes for a relative move.
+ *
+ * moveSteps() in Farm-Bot/lib/Motors_X spends 1/4 of the steps accelerating
+ * (delay shrinks by ACCEL_RATE per step down to MIN_STEP_DELAY), 1/2 cruising
+ * and 1/4 decelerating (delay grows by DECEL_RATE per step up to MAX_STEP_DELAY),
+ * with at least 10 steps for each ramp. Short hops therefore never reach full
+ * speed and cost more per step than long moves. The model sums the step delays
+ * of each phase in closed form, so a prediction is O(1) regardless of distance.
+ */
+
+#ifndef MOVE_TIME_MODEL_H
+#define MOVE_TIME_MODEL_H
+
+#include <string>
+
+/**
+ * Step timing parameters, in microseconds
+ */
+struct MotionProfile {
+  long minStepDelay;           // MIN_STEP_DELAY
+  long maxStepDelay;           // MAX_STEP_DELAY
+  long accelRate;              // ACCEL_RATE
+  long decelRate;              // DECEL_RATE
+  long stepOverheadMicros;     // Loop, pulse and bookkeeping cost per step on top of the delay
+  long commandOverheadMicros;  // Serial round trip and status prints per move
+};
+
+/**
+ * Profile with the values shipped in Config.h
+ */
+MotionProfile defaultMotionProfile();
+
+/**
+ * Read MIN_STEP_DELAY, MAX_STEP_DELAY, ACCEL_RATE and DECEL_RATE from a Config.h
+ * Values missing from the file keep what profile already holds.
+ *
+ * @return FALSE if the file cannot be read or contains none of the values
+ */
+bool loadProfileFromConfig(const char *path, MotionProfile &profile, std::string &error);
+
+/**
+ * Parse "min,max,accel,decel" (e.g. as read from the controller's live profile)
+ *
+ * @return FALSE if the text is malformed
+ */
+bool parseProfile(const char *text, MotionProfile &profile);
+
+/**
+ * Predicted duration of a relative move, including overheads
+ *
+ * @param steps Step count (sign is ignored); 0 costs nothing
+ * @return Duration in microseconds
+ */
+long long moveMicros(const MotionProfile &profile, long steps);
+
+/**
+ * Same prediction computed step by step like moveSteps() itself
+ * Slow; used to check the closed form.
+ */
+long long moveMicrosReference(const MotionProfile &profile, long steps);
+
+#endif // MOVE_TIME_MODEL_H
@@ -0,0 +1,476 @@
+/**
+ * VisitPlanner.cpp
+ *
+ * Nearest neighbour + 2-opt/Or-opt route search over predicted move times.
+ *
+ * Internally the route is a cycle of nodes: node 0 is the start position,
+ * nodes 1..n are the waypoints. An open route (no return) adds a free "end"
+ * node that costs nothing to reach or leave, and every real edge at the start
+ * node carries a large penalty so the cycle keeps start and end adjacent;
+ * cutting the cycle there gives a path that begins at the start position.
+ */
+
+#include "VisitPlanner.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <deque>
+#include <math.h>
+#include <queue>
+
+#define START_PENALTY 1000000000000000LL  // Larger than any real route
+
+// Ramp length is irrelevant to the order: the model is monotonic in distance,
+// so the time of a hop is the time of its longer axis move.
+static long chebyshev(long x1, long y1, long x2, long y2) {
+  long dx = labs(x1 - x2);
+  long dy = labs(y1 - y2);
+  return dx > dy ? dx : dy;
+}
+
+/**
+ * Hop time, or a key that orders hops like it, for nearest-neighbour searches
+ * With the axes moving together the Chebyshev distance is enough; one after
+ * the other, the key is the hop time itself.
+ */
+static long long hopKey(const MotionProfile &profile, bool sequentialAxes,
+                        long x1, long y1, long x2, long y2) {
+  if (!sequentialAxes) return chebyshev(x1, y1, x2, y2);
+  return moveMicros(profile, x1 - x2) + moveMicros(profile, y1 - y2);
+}
+
+/**
+ * Smallest key of a hop whose Chebyshev distance is at least bound
+ * A hop that long has one axis move of at least bound steps, and the other
+ * costs nothing at best.
+ */
+static long long boundKey(const MotionProfile &profile, bool sequentialAxes, long bound) {
+  return sequentialAxes ? moveMicros(profile, bound) : bound;
+}
+
+PlanOptions defaultPlanOptions() {
+  PlanOptions options;
+  options.startX = 0;
+  options.startY = 0;
+  options.returnToStart = false;
+  options.candidates = 8;
+  options.dwellMicros = 0;
+  options.sequentialAxes = false;
+  return options;
+}
+
+long long hopMicros(const MotionProfile &profile, long fromX, long fromY, long toX, long toY,
+                    bool sequentialAxes) {
+  if (sequentialAxes) return moveMicros(profile, toX - fromX) + moveMicros(profile, toY - fromY);
+  return moveMicros(profile, chebyshev(fromX, fromY, toX, toY));
+}
+
+long long routeMicros(const MotionProfile &profile, const std::vector<Waypoint> &waypoints,
+                      const std::vector<int> &order, const PlanOptions &options) {
+  long long total = 0;
+  long x = options.startX;
+  long y = options.startY;
+  for (size_t i = 0; i < order.size(); i++) {
+    const Waypoint &next = waypoints[order[i]];
+    total += hopMicros(profile, x, y, next.x, next.y, options.sequentialAxes) + options.dwellMicros;
+    x = next.x;
+    y = next.y;
+  }
+  if (options.returnToStart) {
+    total += hopMicros(profile, x, y, options.startX, options.startY, options.sequentialAxes);
+  }
+  return total;
+}
+
+/**
+ * Uniform grid over the waypoint nodes for nearest-neighbour queries
+ * Cells are square so that ring r around a cell bounds the Chebyshev
+ * distance of its points from below by (r - 1) cell sizes.
+ */
+class NodeGrid {
+public:
+  NodeGrid(const std::vector<long> &xs, const std::vector<long> &ys, int first, int last) {
+    minX_ = minY_ = 0;
+    long maxX = 0, maxY = 0;
+    for (int i = first; i <= last; i++) {
+      if (i == first || xs[i] < minX_) minX_ = xs[i];
+      if (i == first || ys[i] < minY_) minY_ = ys[i];
+      if (i == first || xs[i] > maxX) maxX = xs[i];
+      if (i == first || ys[i] > maxY) maxY = ys[i];
+    }
+    long count = last - first + 1;
+    long span = std::max(maxX - minX_, maxY - minY_) + 1;
+    // About two nodes per cell on a square bed
+    long perSide = std::max(1L, (long)sqrt((double)count / 2.0));
+    cell_ = std::max(1L, span / perSide + 1);
+    columns_ = (int)((maxX - minX_) / cell_ + 1);
+    rows_ = (int)((maxY - minY_) / cell_ + 1);
+    cells_.resize((size_t)columns_ * rows_);
+    slot_.resize(xs.size());
+    for (int i = first; i <= last; i++) insert(i, xs[i], ys[i]);
+  }
+
+  void insert(int node, long x, long y) {
+    std::vector<int> &cell = cells_[cellIndex(x, y)];
+    slot_[node] = (int)cell.size();
+    cell.push_back(node);
+  }
+
+  void remove(int node, long x, long y) {
+    std::vector<int> &cell = cells_[cellIndex(x, y)];
+    int slot = slot_[node];
+    cell[slot] = cell.back();
+    slot_[cell[slot]] = slot;
+    cell.pop_back();
+  }
+
+  /**
+   * Visit nodes ring by ring around (x, y)
+   * visit(node) is called for every node in the ring; after each ring,
+   * done(bound) is asked whether to stop, where bound is the smallest
+   * Chebyshev distance any node in a further ring can have.
+   */
+  template <typename Visit, typename Done>
+  void search(long x, long y, Visit visit, Done done) const {
+    int cx = clampColumn((x - minX_) / cell_);
+    int cy = clampRow((y - minY_) / cell_);
+    int maxRing = std::max(columns_, rows_);
+    for (int r = 0; r <= maxRing; r++) {
+      for (int gy = cy - r; gy <= cy + r; gy++) {
+        if (gy < 0 || gy >= rows_) continue;
+        bool edgeRow = gy == cy - r || gy == cy + r;
+        for (int gx = cx - r; gx <= cx + r; gx += edgeRow ? 1 : 2 * r) {
+          if (gx >= 0 && gx < columns_) {
+            const std::vector<int> &cell = cells_[(size_t)gy * columns_ + gx];
+            for (size_t k = 0; k < cell.size(); k++) visit(cell[k]);
+          }
+          if (r == 0) break;
+        }
+      }
+      if (done((long)r * cell_)) return;
+    }
+  }
+
+private:
+  size_t cellIndex(long x, long y) const {
+    return (size_t)clampRow((y - minY_) / cell_) * columns_ + clampColumn((x - minX_) / cell_);
+  }
+  int clampColumn(long c) const { return (int)std::min(std::max(c, 0L), (long)columns_ - 1); }
+  int clampRow(long r) const { return (int)std::min(std::max(r, 0L), (long)rows_ - 1); }
+
+  long minX_, minY_, cell_;
+  int columns_, rows_;
+  std::vector<std::vector<int> > cells_;
+  std::vector<int> slot_;
+};
+
+class RouteSearch {
+public:
+  RouteSearch(const MotionProfile &profile, const std::vector<Waypoint> &waypoints,
+              const PlanOptions &options)
+    : profile_(profile), open_(!options.returnToStart), sequential_(options.sequentialAxes),
+      count_((int)waypoints.size()) {
+    xs_.push_back(options.startX);
+    ys_.push_back(options.startY);
+    for (int i = 0; i < count_; i++) {
+      xs_.push_back(waypoints[i].x);
+      ys_.push_back(waypoints[i].y);
+    }
+    end_ = open_ ? count_ + 1 : -1;
+    nodes_ = count_ + 1 + (open_ ? 1 : 0);
+  }
+
+  long long cost(int a, int b) const {
+    if (a == end_ || b == end_) return 0;
+    long long micros = hopMicros(profile_, xs_[a], ys_[a], xs_[b], ys_[b], sequential_);
+    if (open_ && (a == 0 || b == 0)) micros += START_PENALTY;
+    return micros;
+  }
+
+  /**
+   * Nearest candidates of every node, sorted by hop time
+   * The start node is left out of the waypoints' lists: its edges carry the
+   * penalty and would end the sorted scans early.
+   */
+  void buildCandidates(const NodeGrid &grid, int k) {
+    candidates_.assign(nodes_, std::vector<int>());
+    for (int node = 0; node <= count_; node++) {
+      typedef std::pair<long long, int> Entry;
+      std::priority_queue<Entry> best;
+      grid.search(xs_[node], ys_[node],
+        [&](int other) {
+          if (other == node) return;
+          Entry entry(hopKey(profile_, sequential_, xs_[node], ys_[node], xs_[other], ys_[other]), other);
+          if ((int)best.size() < k) {
+            best.push(entry);
+          } else if (entry < best.top()) {
+            best.pop();
+            best.push(entry);
+          }
+        },
+        [&](long bound) {
+          return (int)best.size() == k && best.top().first <= boundKey(profile_, sequential_, bound);
+        });
+      std::vector<int> &list = candidates_[node];
+      while (!best.empty()) {
+        list.push_back(best.top().second);
+        best.pop();
+      }
+      std::reverse(list.begin(), list.end());
+    }
+  }
+
+  /**
+   * Greedy route: always drive to the closest unvisited waypoint
+   */
+  void nearestNeighbour(NodeGrid &grid) {
+    tour_.clear();
+    tour_.push_back(0);
+    int current = 0;
+    for (int step = 0; step < count_; step++) {
+      long long bestDistance = -1;
+      int bestNode = -1;
+      grid.search(xs_[current], ys_[current],
+        [&](int other) {
+          long long d = hopKey(profile_, sequential_, xs_[current], ys_[current], xs_[other], ys_[other]);
+          if (bestNode < 0 || d < bestDistance || (d == bestDistance && other < bestNode)) {
+            bestDistance = d;
+            bestNode = other;
+          }
+        },
+        [&](long bound) {
+          return bestNode >= 0 && bestDistance <= boundKey(profile_, sequential_, bound);
+        });
+      grid.remove(bestNode, xs_[bestNode], ys_[bestNode]);
+      tour_.push_back(bestNode);
+      current = bestNode;
+    }
+    if (open_) tour_.push_back(end_);
+    rebuildPositions();
+  }
+
+  /**
+   * 2-opt and Or-opt until no candidate move improves the route
+   */
+  void improve(long &twoOptMoves, long &orOptMoves) {
+    std::deque<int> work;
+    std::vector<char> queued(nodes_, 1);
+    for (int i = 0; i < nodes_; i++) work.push_back(tour_[i]);
+
+    while (!work.empty()) {
+      int a = work.front();
+      work.pop_front();
+      queued[a] = 0;
+
+      std::vector<int> touched;
+      if (twoOpt(a, touched)) {
+        twoOptMoves++;
+      } else if (orOpt(a, touched)) {
+        orOptMoves++;
+      } else {
+        continue;
+      }
+      touched.push_back(a);
+      for (size_t i = 0; i < touched.size(); i++) {
+        int node = touched[i];
+        if (node >= 0 && !queued[node]) {
+          queued[node] = 1;
+          work.push_back(node);
+        }
+      }
+    }
+  }
+
+  /**
+   * Waypoint indices in driving order, starting after the start node
+   */
+  void route(std::vector<int> &order) const {
+    order.clear();
+    int at = pos_[0];
+    // Walk away from the end node (open) or in the stored direction (closed)
+    int direction = (open_ && tour_[(at + 1) % nodes_] == end_) ? -1 : 1;
+    for (int i = 1; i < nodes_; i++) {
+      int node = tour_[((at + direction * i) % nodes_ + nodes_) % nodes_];
+      if (node != end_) order.push_back(node - 1);
+    }
+  }
+
+private:
+  int succ(int node) const { return tour_[(pos_[node] + 1) % nodes_]; }
+  int pred(int node) const { return tour_[(pos_[node] + nodes_ - 1) % nodes_]; }
+
+  void rebuildPositions() {
+    pos_.resize(nodes_);
+    for (int i = 0; i < nodes_; i++) pos_[tour_[i]] = i;
+  }
+
+  /**
+   * Reverse the route between tour positions from and to (inclusive, going
+   * forward), or the complementary part if that is shorter; both give the
+   * same cycle.
+   */
+  void reverseSegment(int from, int to) {
+    int length = (to - from + nodes_) % nodes_ + 1;
+    if (2 * length > nodes_) {
+      int next = (to + 1) % nodes_;
+      to = (from + nodes_ - 1) % nodes_;
+      from = next;
+      length = nodes_ - length;
+    }
+    for (int i = 0; i < length / 2; i++) {
+      int left = (from + i) % nodes_;
+      int right = (to - i + nodes_) % nodes_;
+      std::swap(tour_[left], tour_[right]);
+      pos_[tour_[left]] = left;
+      pos_[tour_[right]] = right;
+    }
+  }
+
+  bool twoOpt(int a, std::vector<int> &touched) {
+    if (a == end_) return false;
+    const std::vector<int> &list = candidates_[a];
+    for (int side = 0; side < 2; side++) {
+      int b = side == 0 ? succ(a) : pred(a);
+      long long removed = cost(a, b);
+      for (size_t i = 0; i < list.size(); i++) {
+        int c = list[i];
+        long long g1 = removed - cost(a, c);
+        if (g1 <= 0) break;
+        int d = side == 0 ? succ(c) : pred(c);
+        if (c == b || d == a) continue;
+        long long gain = g1 + cost(c, d) - cost(b, d);
+        if (gain <= 0) continue;
+        // Forward: a b ... c d -> a c ... b d. Backward: d c ... b a -> d b ... c a.
+        if (side == 0) {
+          reverseSegment(pos_[b], pos_[c]);
+        } else {
+          reverseSegment(pos_[a], pos_[d]);
+        }
+        touched.push_back(b);
+        touched.push_back(c);
+        touched.push_back(d);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool orOpt(int first, std::vector<int> &touched) {
+    if (first == 0 || first == end_) return false;
+    for (int length = 1; length <= 3; length++) {
+      // Chain first .. last going forward
+      int chain[3];
+      chain[0] = first;
+      bool valid = true;
+      for (int i = 1; i < length; i++) {
+        chain[i] = succ(chain[i - 1]);
+        if (chain[i] == 0 || chain[i] == end_) valid = false;
+      }
+      if (!valid || length >= nodes_ - 2) return false;
+      int last = chain[length - 1];
+      int p = pred(first);
+      int n = succ(last);
+      long long removeGain = cost(p, first) + cost(last, n) - cost(p, n);
+      if (removeGain <= 0) continue;
+
+      for (int end = 0; end < 2; end++) {
+        const std::vector<int> &list = candidates_[end == 0 ? first : last];
+        for (size_t i = 0; i < list.size(); i++) {
+          int c = list[i];
+          if (inChain(c, chain, length)) continue;
+          for (int side = 0; side < 2; side++) {
+            // Insert between c and its successor or predecessor
+            int d = side == 0 ? succ(c) : pred(c);
+            if (inChain(d, chain, length)) continue;
+            int left = side == 0 ? c : d;
+            int right = side == 0 ? d : c;
+            long long keep = cost(left, first) + cost(last, right);
+            long long flip = cost(left, last) + cost(first, right);
+            long long added = std::min(keep, flip) - cost(left, right);
+            if (removeGain - added <= 0) continue;
+            moveChain(chain, length, left, flip < keep);
+            touched.push_back(p);
+            touched.push_back(n);
+            touched.push_back(left);
+            touched.push_back(right);
+            for (int k = 0; k < length; k++) touched.push_back(chain[k]);
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  static bool inChain(int node, const int *chain, int length) {
+    for (int i = 0; i < length; i++) {
+      if (chain[i] == node) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Cut the chain out and put it back right after node left
+   */
+  void moveChain(const int *chain, int length, int left, bool reversed) {
+    std::vector<int> next;
+    next.reserve(nodes_);
+    for (int i = 0; i < nodes_; i++) {
+      int node = tour_[i];
+      if (inChain(node, chain, length)) continue;
+      next.push_back(node);
+      if (node == left) {
+        for (int k = 0; k < length; k++) next.push_back(chain[reversed ? length - 1 - k : k]);
+      }
+    }
+    tour_.swap(next);
+    rebuildPositions();
+  }
+
+  const MotionProfile &profile_;
+  bool open_;
+  bool sequential_;  // PlanOptions::sequentialAxes
+  int count_;
+  int end_;    // Free end node of an open route, -1 when closed
+  int nodes_;
+  std::vector<long> xs_, ys_;
+  std::vector<std::vector<int> > candidates_;
+  std::vector<int> tour_;
+  std::vector<int> pos_;
+};
+
+void planVisits(const MotionProfile &profile, const std::vector<Waypoint> &waypoints,
+                const PlanOptions &options, PlanResult &result) {
+  result.order.clear();
+  result.twoOptMoves = 0;
+  result.orOptMoves = 0;
+
+  std::vector<int> given(waypoints.size());
+  for (size_t i = 0; i < given.size(); i++) given[i] = (int)i;
+  result.inputMicros = routeMicros(profile, waypoints, given, options);
+  if (waypoints.empty()) {
+    result.nearestMicros = result.plannedMicros = result.inputMicros;
+    return;
+  }
+
+  RouteSearch search(profile, waypoints, options);
+  std::vector<long> xs(waypoints.size() + 1), ys(waypoints.size() + 1);
+  xs[0] = options.startX;
+  ys[0] = options.startY;
+  for (size_t i = 0; i < waypoints.size(); i++) {
+    xs[i + 1] = waypoints[i].x;
+    ys[i + 1] = waypoints[i].y;
+  }
+
+  NodeGrid candidateGrid(xs, ys, 1, (int)waypoints.size());
+  search.buildCandidates(candidateGrid, std::max(1, options.candidates));
+
+  NodeGrid remaining(xs, ys, 1, (int)waypoints.size());
+  search.nearestNeighbour(remaining);
+  search.route(result.order);
+  result.nearestMicros = routeMicros(profile, waypoints, result.order, options);
+
+  search.improve(result.twoOptMoves, result.orOptMoves);
+  search.route(result.order);
+  result.plannedMicros = routeMicros(profile, waypoints, result.order, options);
+}
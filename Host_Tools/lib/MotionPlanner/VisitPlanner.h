@@ -0,0 +1,87 @@
+/**
+ * VisitPlanner.h
+ *
+ * Orders plant waypoints to minimize predicted job time.
+ *
+ * The cost of a hop is the MoveTimeModel duration, so the planner prefers
+ * several short hops or one long fast move exactly as the controller would.
+ * How the two axis moves of a hop combine depends on the machine, and the
+ * firmware does not decide it: the X controller only knows its own axis. By
+ * default the planner assumes X and Y have separate controllers that are
+ * commanded together, so a hop takes as long as the slower of its two axis
+ * moves. With sequentialAxes, one axis moves after the other (one controller
+ * switching axes, or a host that waits for X before sending Y), so a hop costs
+ * the sum of both moves.
+ *
+ * Heuristic: nearest neighbour construction, then 2-opt and Or-opt (moving
+ * chains of 1-3 waypoints) restricted to each waypoint's nearest candidates,
+ * found with a uniform grid. Runs in milliseconds for thousands of waypoints.
+ */
+
+#ifndef VISIT_PLANNER_H
+#define VISIT_PLANNER_H
+
+#include "MoveTimeModel.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * A position to visit, in steps
+ */
+struct Waypoint {
+  std::string name;
+  long x;
+  long y;
+};
+
+struct PlanOptions {
+  long startX;           // Where the gantry is when the job starts
+  long startY;
+  bool returnToStart;    // Close the route back at the start position
+  int candidates;        // Nearest neighbours considered per waypoint
+  long dwellMicros;      // Time spent at each waypoint (photo, sensor read)
+  bool sequentialAxes;   // Hop time is the sum of the X and Y moves, not the larger one
+};
+
+struct PlanResult {
+  std::vector<int> order;        // Indices into the waypoint list
+  long long inputMicros;         // Job time in the given order
+  long long nearestMicros;       // After nearest neighbour construction
+  long long plannedMicros;       // After local search
+  long twoOptMoves;
+  long orOptMoves;
+};
+
+/**
+ * Default options: start at home, open route, 8 candidates, no dwell, axes
+ * moving together
+ */
+PlanOptions defaultPlanOptions();
+
+/**
+ * Predicted job time for visiting waypoints in a given order
+ */
+long long routeMicros(const MotionProfile &profile, const std::vector<Waypoint> &waypoints,
+                      const std::vector<int> &order, const PlanOptions &options);
+
+/**
+ * Predicted time of one hop between two positions
+ *
+ * @param sequentialAxes TRUE if Y moves after X (see PlanOptions)
+ */
+long long hopMicros(const MotionProfile &profile, long fromX, long fromY, long toX, long toY,
+                    bool sequentialAxes);
+
+/**
+ * Plan a visit order
+ *
+ * @param profile Controller timing
+ * @param waypoints Positions to visit
+ * @param options Start position, route shape and search size
+ * @param result Receives the order and predicted times
+ */
+void planVisits(const MotionProfile &profile, const std::vector<Waypoint> &waypoints,
+                const PlanOptions &options, PlanResult &result);
+
+#endif // VISIT_PLANNER_H
@@ -0,0 +1,108 @@
+/**
+ * TraceFormat.cpp
+ *
+ * Implementation of the motion trace decoder.
+ */
+
+#include "TraceFormat.h"
+
+#define TRACE_MAGIC "MTRC"
+#define TRACE_VERSION 1
+
+static unsigned readU16(const std::string &data, size_t offset) {
+  return (unsigned char)data[offset] | ((unsigned char)data[offset + 1] << 8);
+}
+
+static int16_t readI16(const std::string &data, size_t offset) {
+  return (int16_t)readU16(data, offset);
+}
+
+static int32_t readI32(const std::string &data, size_t offset) {
+  return (int32_t)(readU16(data, offset) | ((uint32_t)readU16(data, offset + 2) << 16));
+}
+
+const char *traceTriggerName(int trigger) {
+  switch (trigger) {
+    case 0: return "none";
+    case 1: return "command";
+    case 2: return "limit";
+    case 3: return "estop";
+    case 4: return "racking";
+    default: return "?";
+  }
+}
+
+const char *tracePhaseName(uint8_t flags) {
+  switch ((flags & TRACE_FLAG_PHASE_MASK) >> TRACE_FLAG_PHASE_SHIFT) {
+    case 1: return "accel";
+    case 2: return "cruise";
+    case 3: return "decel";
+    default: return "const";
+  }
+}
+
+bool decodeTrace(const std::string &data, MotionTrace &trace, std::string &error) {
+  if (data.size() < TRACE_HEADER_BYTES + 2 || data.compare(0, 4, TRACE_MAGIC) != 0) {
+    error = "not a trace dump";
+    return false;
+  }
+  trace.version = (unsigned char)data[4];
+  if (trace.version != TRACE_VERSION) {
+    error = "unsupported trace version " + std::to_string(trace.version);
+    return false;
+  }
+  trace.timeUnitMicros = (unsigned char)data[5];
+  trace.decimation = readU16(data, 6);
+  size_t count = readU16(data, 8);
+  trace.trigger = (unsigned char)data[10];
+  trace.faultMode = data[11] != 0;
+  unsigned triggerIndex = readU16(data, 12);
+  trace.triggerIndex = triggerIndex == 0xFFFF ? -1 : (int)triggerIndex;
+  trace.basePosition = readI32(data, 14);
+  trace.baseEncoder = readI32(data, 18);
+  trace.minStepDelay = readU16(data, 22);
+  trace.maxStepDelay = readU16(data, 24);
+  trace.accelRate = readU16(data, 26);
+  trace.decelRate = readU16(data, 28);
+
+  size_t end = TRACE_HEADER_BYTES + count * TRACE_SAMPLE_BYTES;
+  if (data.size() < end + 2) {
+    error = "truncated trace: " + std::to_string(count) + " samples announced";
+    return false;
+  }
+  unsigned sum = 0;
+  for (size_t i = 0; i < end; i++) sum += (unsigned char)data[i];
+  if ((sum & 0xFFFF) != readU16(data, end)) {
+    error = "trace checksum mismatch";
+    return false;
+  }
+
+  trace.points.clear();
+  trace.points.reserve(count);
+  double time = 0;
+  long position = trace.basePosition;
+  long encoder = trace.baseEncoder;
+  for (size_t i = 0; i < count; i++) {
+    size_t offset = TRACE_HEADER_BYTES + i * TRACE_SAMPLE_BYTES;
+    TracePoint point;
+    point.dtMicros = (double)readU16(data, offset) * trace.timeUnitMicros;
+    position += readI16(data, offset + 2);
+    encoder += readI16(data, offset + 4);
+    point.flags = (uint8_t)data[offset + 6];
+    time += i == 0 ? 0 : point.dtMicros;
+    point.timeMicros = time;
+    point.position = position;
+    point.encoder = encoder;
+    trace.points.push_back(point);
+  }
+  return true;
+}
+
+bool findTrace(const std::string &capture, MotionTrace &trace, std::string &error) {
+  error = "no trace dump found";
+  for (size_t at = capture.find(TRACE_MAGIC); at != std::string::npos;
+       at = capture.find(TRACE_MAGIC, at + 1)) {
+    if (decodeTrace(capture.substr(at), trace, error)) return true;
+  }
+  return false;
+}
@@ -0,0 +1,89 @@
+/**
+ * TraceFormat.h
+ *
+ * Decoder for the motion trace dump of the X-axis controller (command TD).
+ *
+ * The firmware (Farm-Bot/lib/Motors_X/MotionTrace.h) sends a packed header,
+ * count samples of 7 bytes each and a 16-bit byte sum, all little-endian.
+ * Samples hold deltas, so decoding accumulates them from the header's base
+ * position and encoder count into absolute values. The firmware leaves the
+ * jump of a re-zeroed counter out of the deltas, so decoded values stay
+ * continuous across a sample flagged TRACE_FLAG_REBASE; from there on they
+ * differ from the controller's counters by a constant offset.
+ */
+
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define TRACE_HEADER_BYTES 30
+#define TRACE_SAMPLE_BYTES 7
+
+// Sample flags, as in MotionTrace.h and MotionState.h
+#define TRACE_FLAG_ESTOP 0x01
+#define TRACE_FLAG_MOVING 0x02
+#define TRACE_FLAG_FORWARD 0x04
+#define TRACE_FLAG_LIMIT 0x08
+#define TRACE_FLAG_PHASE_SHIFT 4
+#define TRACE_FLAG_PHASE_MASK 0x30
+#define TRACE_FLAG_MOVE_START 0x40
+#define TRACE_FLAG_REBASE 0x80
+
+/**
+ * Decoded sample with absolute values
+ */
+struct TracePoint {
+  double timeMicros;   // Since the first sample
+  double dtMicros;     // Since the previous sample
+  long position;       // Commanded step position
+  long encoder;        // Encoder count
+  uint8_t flags;
+};
+
+/**
+ * A decoded trace
+ */
+struct MotionTrace {
+  int version;
+  int timeUnitMicros;
+  int decimation;
+  int trigger;          // 0 none, 1 command, 2 limit, 3 emergency stop, 4 racking
+  bool faultMode;
+  int triggerIndex;     // -1 if no fault was captured
+  long basePosition;
+  long baseEncoder;
+  int minStepDelay, maxStepDelay, accelRate, decelRate;
+  std::vector<TracePoint> points;
+};
+
+/**
+ * Decode a dump (header, samples, checksum)
+ *
+ * @param data Dump bytes, starting at the "MTRC" magic
+ * @param trace Receives the decoded trace
+ * @param error Receives a message when decoding fails
+ * @return FALSE if the data is truncated, has a bad magic or a bad checksum
+ */
+bool decodeTrace(const std::string &data, MotionTrace &trace, std::string &error);
+
+/**
+ * Find a dump inside a larger capture (e.g. a serial log) and decode it
+ *
+ * @return FALSE if no valid dump is found
+ */
+bool findTrace(const std::string &capture, MotionTrace &trace, std::string &error);
+
+/**
+ * Name of a trigger reason for reports
+ */
+const char *traceTriggerName(int trigger);
+
+/**
+ * Name of the speed profile phase stored in a sample's flags
+ */
+const char *tracePhaseName(uint8_t flags);
+
+#endif // TRACE_FORMAT_H
@@ -0,0 +1,90 @@
+/**
+ * PackedDataset.cpp
+ *
+ * Layout computation and memory-mapped reader for packed datasets.
+ */
+
+#include "PackedDataset.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t alignUp(uint64_t value) {
+  return (value + PACKED_ALIGNMENT - 1) / PACKED_ALIGNMENT * PACKED_ALIGNMENT;
+}
+
+uint64_t layoutPackedDataset(PackedHeader &header) {
+  memcpy(header.magic, PACKED_MAGIC, sizeof(header.magic));
+  uint64_t imageBytes = (uint64_t)header.height * header.width * header.channels;
+  header.tensorOffset = alignUp(sizeof(PackedHeader));
+  header.labelOffset = alignUp(header.tensorOffset + imageBytes * header.count);
+  header.splitOffset = alignUp(header.labelOffset + header.count);
+  header.nameOffset = alignUp(header.splitOffset + header.count);
+  return header.nameOffset + header.nameBytes;
+}
+
+bool openPackedDataset(const char *path, PackedDataset &dataset, std::string &error) {
+  dataset.fd = open(path, O_RDONLY);
+  dataset.base = NULL;
+  if (dataset.fd < 0) {
+    error = std::string("cannot open ") + path;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(dataset.fd, &info) != 0 || (size_t)info.st_size < sizeof(PackedHeader)) {
+    error = std::string(path) + " is too small to be a packed dataset";
+    close(dataset.fd);
+    return false;
+  }
+
+  dataset.size = info.st_size;
+  void *mapping = mmap(NULL, dataset.size, PROT_READ, MAP_SHARED, dataset.fd, 0);
+  if (mapping == MAP_FAILED) {
+    error = std::string("cannot map ") + path;
+    close(dataset.fd);
+    return false;
+  }
+  dataset.base = (const uint8_t *)mapping;
+  memcpy(&dataset.header, dataset.base, sizeof(PackedHeader));
+
+  // Validate against a freshly computed layout so a corrupt header can't point outside the file
+  PackedHeader expected = dataset.header;
+  uint64_t expectedSize = layoutPackedDataset(expected);
+  if (memcmp(dataset.header.magic, PACKED_MAGIC, sizeof(dataset.header.magic)) != 0 ||
+      expected.tensorOffset != dataset.header.tensorOffset ||
+      expected.labelOffset != dataset.header.labelOffset ||
+      expected.splitOffset != dataset.header.splitOffset ||
+      expected.nameOffset != dataset.header.nameOffset || expectedSize > dataset.size) {
+    error = std::string(path) + " is not a valid packed dataset";
+    closePackedDataset(dataset);
+    return false;
+  }
+  return true;
+}
+
+void closePackedDataset(PackedDataset &dataset) {
+  if (dataset.base) munmap((void *)dataset.base, dataset.size);
+  if (dataset.fd >= 0) close(dataset.fd);
+  dataset.base = NULL;
+  dataset.fd = -1;
+}
+
+void packedSplitIndices(const PackedDataset &dataset, int split, std::vector<long> &indices) {
+  indices.clear();
+  for (long i = 0; i < (long)dataset.header.count; i++) {
+    if (packedSplit(dataset, i) == split) indices.push_back(i);
+  }
+}
+
+std::string packedSourceName(const PackedDataset &dataset, long index) {
+  const char *name = (const char *)dataset.base + dataset.header.nameOffset;
+  const char *end = name + dataset.header.nameBytes;
+  for (long i = 0; i < index && name < end; i++) {
+    name += strlen(name) + 1;
+  }
+  return name < end ? std::string(name) : std::string();
+}
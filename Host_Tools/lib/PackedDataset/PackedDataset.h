@@ -0,0 +1,128 @@
+/**
+ * PackedDataset.h
+ *
+ * Single-file, memory-mapped dataset of preprocessed training images.
+ * Every image is decoded and resized once by pack_dataset; training then reads
+ * uint8 tensors straight from the page cache without JPEG decoding or copies.
+ *
+ * File layout (little-endian), chosen so numpy.memmap can map each array directly:
+ *   0      PackedHeader (see below), zero padded to PACKED_ALIGNMENT
+ *   tensorOffset  u8 images[count][height][width][channels]
+ *   labelOffset   u8 labels[count]   (0 = healthy, 1 = non_healthy)
+ *   splitOffset   u8 splits[count]   (PackedSplit values)
+ *   nameOffset    NUL-terminated source paths, one per image
+ * All offsets are multiples of PACKED_ALIGNMENT.
+ */
+
+#ifndef PACKED_DATASET_H
+#define PACKED_DATASET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define PACKED_MAGIC "LPACK01"   // 8 bytes including the terminator
+#define PACKED_ALIGNMENT 4096
+
+// Dataset split of each image, same 80/10/10 scheme as farmbot_cv.py
+enum PackedSplit {
+  PACKED_TRAIN = 0,
+  PACKED_VALIDATION = 1,
+  PACKED_TEST = 2,
+  PACKED_SKIPPED = 255  // Source image could not be decoded
+};
+
+/**
+ * On-disk header at offset 0
+ */
+struct PackedHeader {
+  char magic[8];
+  uint32_t count;
+  uint32_t height;
+  uint32_t width;
+  uint32_t channels;
+  uint64_t tensorOffset;
+  uint64_t labelOffset;
+  uint64_t splitOffset;
+  uint64_t nameOffset;
+  uint64_t nameBytes;
+};
+
+/**
+ * Read-only view of a packed dataset file
+ */
+struct PackedDataset {
+  int fd;
+  const uint8_t *base;  // Start of the mapping
+  size_t size;          // Mapped length
+  PackedHeader header;
+};
+
+/**
+ * Compute the layout of a dataset file
+ *
+ * @param header Header with count/height/width/channels/nameBytes set; offsets are filled in
+ * @return Total file size in bytes
+ */
+uint64_t layoutPackedDataset(PackedHeader &header);
+
+/**
+ * Map a packed dataset file read-only
+ *
+ * @param path Dataset file
+ * @param dataset Receives the mapping
+ * @param error Receives a description on failure
+ * @return TRUE if the file was mapped
+ */
+bool openPackedDataset(const char *path, PackedDataset &dataset, std::string &error);
+
+/**
+ * Unmap a dataset opened with openPackedDataset()
+ */
+void closePackedDataset(PackedDataset &dataset);
+
+/**
+ * Bytes in one image tensor
+ */
+inline size_t packedImageSize(const PackedDataset &dataset) {
+  return (size_t)dataset.header.height * dataset.header.width * dataset.header.channels;
+}
+
+/**
+ * Zero-copy pointer to one image (HWC uint8)
+ */
+inline const uint8_t *packedImage(const PackedDataset &dataset, long index) {
+  return dataset.base + dataset.header.tensorOffset + index * packedImageSize(dataset);
+}
+
+/**
+ * Label of one image (0 = healthy, 1 = non_healthy)
+ */
+inline int packedLabel(const PackedDataset &dataset, long index) {
+  return dataset.base[dataset.header.labelOffset + index];
+}
+
+/**
+ * Split of one image (PackedSplit)
+ */
+inline int packedSplit(const PackedDataset &dataset, long index) {
+  return dataset.base[dataset.header.splitOffset + index];
+}
+
+/**
+ * Collect the indices of all images in one split
+ *
+ * @param dataset Open dataset
+ * @param split PackedSplit value
+ * @param indices Receives the indices in file order
+ */
+void packedSplitIndices(const PackedDataset &dataset, int split, std::vector<long> &indices);
+
+/**
+ * Source path of one image, as recorded when packing
+ * Walks the name table, so use it for reporting rather than in training loops.
+ */
+std::string packedSourceName(const PackedDataset &dataset, long index);
+
+#endif // PACKED_DATASET_H
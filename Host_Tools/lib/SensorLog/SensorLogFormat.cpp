@@ -0,0 +1,157 @@
+/**
+ * SensorLogFormat.cpp
+ *
+ * Implementation of the sensor log decoder.
+ */
+
+#include "SensorLogFormat.h"
+
+#define SENSOR_LOG_MAGIC "SLOG"
+#define SENSOR_LOG_VERSION 2
+#define SENSOR_LOG_CRC_SEED 0x5A  // Block CRC start value; version 1 dumps started from 0
+#define SENSOR_BLOCK_BOOT 0x01
+#define CHANNEL_BITS 2
+#define TDS_VREF 5.0
+
+static unsigned readU16(const std::string &data, size_t offset) {
+  return (unsigned char)data[offset] | ((unsigned char)data[offset + 1] << 8);
+}
+
+static uint32_t readU32(const std::string &data, size_t offset) {
+  return readU16(data, offset) | ((uint32_t)readU16(data, offset + 2) << 16);
+}
+
+/**
+ * _crc8_ccitt_update() of avr-libc
+ */
+static uint8_t crc8Update(uint8_t crc, uint8_t data) {
+  crc ^= data;
+  for (int i = 0; i < 8; i++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+  return crc;
+}
+
+static bool readVarint(const std::string &data, size_t &offset, size_t end, uint32_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (offset >= end) return false;
+    unsigned char byte = (unsigned char)data[offset++];
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+const char *sensorChannelName(int channel) {
+  switch (channel) {
+    case SENSOR_MOISTURE: return "moisture";
+    case SENSOR_TDS: return "tds";
+    default: return "?";
+  }
+}
+
+double sensorValue(int channel, long raw) {
+  if (channel == SENSOR_MOISTURE) return 255 - raw * 255 / 1023;  // map(raw, 0, 1023, 255, 0)
+  if (channel == SENSOR_TDS) {
+    double volts = raw * TDS_VREF / 1024.0;
+    return (133.42 * volts * volts * volts - 255.86 * volts * volts + 857.39 * volts) * 0.5;
+  }
+  return raw;
+}
+
+/**
+ * Decode one block into readings
+ *
+ * @return FALSE if the CRC or the encoding is bad (nothing is added)
+ */
+static bool decodeBlock(const std::string &data, size_t offset, SensorLog &log, int boot, bool current) {
+  size_t length = (unsigned char)data[offset + 7];
+  if (length > (size_t)log.blockBytes - SENSOR_LOG_BLOCK_HEADER_BYTES) return false;
+  uint8_t crc = log.version >= 2 ? SENSOR_LOG_CRC_SEED : 0;
+  for (size_t i = 0; i < 8; i++) crc = crc8Update(crc, (uint8_t)data[offset + i]);  // Header up to crc
+  size_t begin = offset + SENSOR_LOG_BLOCK_HEADER_BYTES;
+  for (size_t i = 0; i < length; i++) crc = crc8Update(crc, (uint8_t)data[begin + i]);
+  if (crc != (uint8_t)data[offset + 8]) return false;
+
+  std::vector<SensorReading> readings;
+  std::vector<long> previous(log.channels, 0);
+  long tick = (long)readU32(data, offset + 2);
+  size_t at = begin;
+  size_t end = begin + length;
+  while (at < end) {
+    uint32_t header, zigzag;
+    if (!readVarint(data, at, end, header) || !readVarint(data, at, end, zigzag)) return false;
+    SensorReading reading;
+    reading.channel = (int)(header & ((1 << CHANNEL_BITS) - 1));
+    if (reading.channel >= log.channels) return false;
+    tick += (long)(header >> CHANNEL_BITS);
+    long delta = (long)(zigzag >> 1) ^ -(long)(zigzag & 1);
+    previous[reading.channel] += delta;
+    reading.boot = boot;
+    reading.tick = tick;
+    reading.ageTicks = current ? log.nowTick - tick : -1;
+    reading.raw = previous[reading.channel];
+    readings.push_back(reading);
+  }
+  log.readings.insert(log.readings.end(), readings.begin(), readings.end());
+  log.dataBytes += length;
+  return true;
+}
+
+bool decodeSensorLog(const std::string &data, SensorLog &log, std::string &error) {
+  if (data.size() < SENSOR_LOG_HEADER_BYTES + 2 || data.compare(0, 4, SENSOR_LOG_MAGIC) != 0) {
+    error = "not a sensor log dump";
+    return false;
+  }
+  log.version = (unsigned char)data[4];
+  if (log.version < 1 || log.version > SENSOR_LOG_VERSION) {
+    error = "unsupported sensor log version " + std::to_string(log.version);
+    return false;
+  }
+  log.channels = (unsigned char)data[5];
+  log.tickMillis = readU16(data, 6);
+  log.intervalTicks = readU16(data, 8);
+  log.nowTick = (long)readU32(data, 10);
+  unsigned bootSequence = readU16(data, 14);
+  log.blockBytes = readU16(data, 16);
+  log.blocks = readU16(data, 18);
+  if (log.channels < 1 || log.channels > (1 << CHANNEL_BITS) || log.blockBytes <= SENSOR_LOG_BLOCK_HEADER_BYTES) {
+    error = "bad sensor log header";
+    return false;
+  }
+
+  size_t end = SENSOR_LOG_HEADER_BYTES + (size_t)log.blocks * log.blockBytes;
+  if (data.size() < end + 2) {
+    error = "truncated sensor log: " + std::to_string(log.blocks) + " blocks announced";
+    return false;
+  }
+  unsigned sum = 0;
+  for (size_t i = 0; i < end; i++) sum += (unsigned char)data[i];
+  if ((sum & 0xFFFF) != readU16(data, end)) {
+    error = "sensor log checksum mismatch";
+    return false;
+  }
+
+  log.readings.clear();
+  log.damagedBlocks = 0;
+  log.dataBytes = 0;
+  int boot = 0;
+  for (int i = 0; i < log.blocks; i++) {
+    size_t offset = SENSOR_LOG_HEADER_BYTES + (size_t)i * log.blockBytes;
+    unsigned sequence = readU16(data, offset);
+    uint8_t flags = (uint8_t)data[offset + 6];
+    if ((flags & SENSOR_BLOCK_BOOT) && i > 0) boot++;
+    // Sequence numbers wrap; blocks from bootSequence on were written since the last reset
+    bool current = (int16_t)(uint16_t)(sequence - bootSequence) >= 0;
+    if (!decodeBlock(data, offset, log, boot, current)) log.damagedBlocks++;
+  }
+  return true;
+}
+
+bool findSensorLog(const std::string &capture, SensorLog &log, std::string &error) {
+  error = "no sensor log dump found";
+  for (size_t at = capture.find(SENSOR_LOG_MAGIC); at != std::string::npos;
+       at = capture.find(SENSOR_LOG_MAGIC, at + 1)) {
+    if (decodeSensorLog(capture.substr(at), log, error)) return true;
+  }
+  return false;
+}
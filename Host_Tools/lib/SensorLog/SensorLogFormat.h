@@ -0,0 +1,88 @@
+/**
+ * SensorLogFormat.h
+ *
+ * Decoder for the sensor log dump of the X-axis controller (command D).
+ *
+ * The firmware (Farm-Bot/lib/Motors_X/SensorLog.h) sends a packed header,
+ * count blocks of 64 bytes and a 16-bit byte sum, all little-endian. Each
+ * block starts with its own absolute time and holds readings as varint time
+ * deltas with the channel id in the low bits, followed by zigzag varint value
+ * deltas. Blocks with a bad CRC are skipped and counted, so one damaged
+ * EEPROM block costs only its own readings.
+ *
+ * Block times count seconds since the reset that wrote them. Readings are
+ * numbered by boot (0 = oldest in the dump); those written since the last
+ * reset also get their age at the time of the dump.
+ */
+
+#ifndef SENSOR_LOG_FORMAT_H
+#define SENSOR_LOG_FORMAT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define SENSOR_LOG_HEADER_BYTES 20
+#define SENSOR_LOG_BLOCK_HEADER_BYTES 9
+
+// Channel ids, as in SensorInput.h
+#define SENSOR_MOISTURE 0
+#define SENSOR_TDS 1
+
+/**
+ * One decoded reading
+ */
+struct SensorReading {
+  int boot;         // Time base, counted from the oldest block in the dump
+  long tick;        // Seconds since that reset
+  long ageTicks;    // Seconds before the dump, -1 if written before the last reset
+  int channel;
+  long raw;         // ADC value as logged
+};
+
+/**
+ * A decoded dump
+ */
+struct SensorLog {
+  int version;
+  int channels;
+  int tickMillis;
+  int intervalTicks;
+  long nowTick;
+  int blockBytes;
+  int blocks;          // Blocks in the dump
+  int damagedBlocks;   // Skipped for a bad CRC or bad encoding
+  size_t dataBytes;    // Encoded reading bytes in the good blocks
+  std::vector<SensorReading> readings;  // Oldest first
+};
+
+/**
+ * Decode a dump (header, blocks, checksum)
+ *
+ * @param data Dump bytes, starting at the "SLOG" magic
+ * @param log Receives the decoded readings
+ * @param error Receives a message when decoding fails
+ * @return FALSE if the data is truncated, has a bad magic or a bad checksum
+ */
+bool decodeSensorLog(const std::string &data, SensorLog &log, std::string &error);
+
+/**
+ * Find a dump inside a larger capture (e.g. a serial log) and decode it
+ *
+ * @return FALSE if no valid dump is found
+ */
+bool findSensorLog(const std::string &capture, SensorLog &log, std::string &error);
+
+/**
+ * Name of a channel for reports ("moisture", "tds")
+ */
+const char *sensorChannelName(int channel);
+
+/**
+ * Convert a raw reading like the stand-alone sensor sketches
+ * Moisture becomes the inverted 8-bit "Analog OUTPUT" of Moisture_Sensor.ino
+ * (255 = wet), TDS the ppm of Ph_Sensor.ino at 25 degrees C.
+ */
+double sensorValue(int channel, long raw);
+
+#endif // SENSOR_LOG_FORMAT_H
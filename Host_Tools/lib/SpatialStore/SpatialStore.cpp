@@ -0,0 +1,315 @@
+/**
+ * SpatialStore.cpp
+ *
+ * Implementation of the observation grid, its queries and its file format.
+ */
+
+#include "SpatialStore.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+#define SPATIAL_MAX_CELLS (1L << 22)  // Cell size is doubled until the grid fits
+
+static const char *const KIND_NAMES[OBS_KINDS] = { "moisture", "tds", "health" };
+
+const char *observationKindName(int kind) {
+  return kind >= 0 && kind < OBS_KINDS ? KIND_NAMES[kind] : "?";
+}
+
+int parseObservationKind(const std::string &name) {
+  for (int kind = 0; kind < OBS_KINDS; kind++) {
+    if (name == KIND_NAMES[kind]) return kind;
+  }
+  return -1;
+}
+
+/**
+ * Round down to a multiple of step, also for negative values
+ */
+static long floorTo(long value, long step) {
+  long quotient = value / step;
+  if (value % step < 0) quotient--;
+  return quotient * step;
+}
+
+SpatialStore::SpatialStore()
+    : originX_(0), originY_(0), cellSize_(1), columns_(0), rows_(0), bucketStart_(1, 0) {}
+
+int SpatialStore::columnOf(long x) const {
+  long column = x < originX_ ? 0 : (x - originX_) / cellSize_;
+  return (int)std::min(column, (long)columns_ - 1);
+}
+
+int SpatialStore::rowOf(long y) const {
+  long row = y < originY_ ? 0 : (y - originY_) / cellSize_;
+  return (int)std::min(row, (long)rows_ - 1);
+}
+
+void SpatialStore::build(const std::vector<Observation> &observations, long cellSize) {
+  long minX = LONG_MAX, minY = LONG_MAX, maxX = LONG_MIN, maxY = LONG_MIN;
+  for (size_t i = 0; i < observations.size(); i++) {
+    const Observation &observation = observations[i];
+    if (observation.kind >= OBS_KINDS) continue;
+    minX = std::min(minX, (long)observation.x);
+    minY = std::min(minY, (long)observation.y);
+    maxX = std::max(maxX, (long)observation.x);
+    maxY = std::max(maxY, (long)observation.y);
+  }
+
+  cellSize_ = std::max(1L, cellSize);
+  if (minX > maxX) {
+    originX_ = originY_ = 0;
+    columns_ = rows_ = 0;
+  } else {
+    // Align cells to multiples of the cell size so stores of the same bed line up
+    while (true) {
+      originX_ = floorTo(minX, cellSize_);
+      originY_ = floorTo(minY, cellSize_);
+      columns_ = (int)((maxX - originX_) / cellSize_ + 1);
+      rows_ = (int)((maxY - originY_) / cellSize_ + 1);
+      if ((long)columns_ * rows_ <= SPATIAL_MAX_CELLS) break;
+      cellSize_ *= 2;
+    }
+  }
+
+  // Counting sort into buckets; visiting the observations in time order keeps
+  // every bucket sorted by time. (time << 32 | index) keys keep ties in input order.
+  std::vector<uint64_t> order(observations.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = (uint64_t)observations[i].time << 32 | i;
+  if (!std::is_sorted(order.begin(), order.end())) std::sort(order.begin(), order.end());
+
+  size_t buckets = (size_t)columns_ * rows_ * OBS_KINDS;
+  std::vector<uint32_t> bucketOf(observations.size());
+  bucketStart_.assign(buckets + 1, 0);
+  for (size_t i = 0; i < observations.size(); i++) {
+    const Observation &observation = observations[i];
+    if (observation.kind >= OBS_KINDS) continue;
+    bucketOf[i] = (uint32_t)bucketIndex(columnOf(observation.x), rowOf(observation.y), observation.kind);
+    bucketStart_[bucketOf[i] + 1]++;
+  }
+  for (size_t b = 0; b < buckets; b++) bucketStart_[b + 1] += bucketStart_[b];
+
+  uint32_t count = bucketStart_[buckets];
+  x_.resize(count);
+  y_.resize(count);
+  time_.resize(count);
+  value_.resize(count);
+  std::vector<uint32_t> next(bucketStart_.begin(), bucketStart_.end() - 1);
+  for (size_t n = 0; n < order.size(); n++) {
+    uint32_t source = (uint32_t)order[n];
+    const Observation &observation = observations[source];
+    if (observation.kind >= OBS_KINDS) continue;
+    uint32_t at = next[bucketOf[source]]++;
+    x_[at] = observation.x;
+    y_[at] = observation.y;
+    time_[at] = observation.time;
+    value_[at] = observation.value;
+  }
+  computeSummaries();
+}
+
+void SpatialStore::exportObservations(std::vector<Observation> &observations) const {
+  observations.reserve(observations.size() + size());
+  for (size_t bucket = 0; bucket + 1 < bucketStart_.size(); bucket++) {
+    for (uint32_t i = bucketStart_[bucket]; i < bucketStart_[bucket + 1]; i++) {
+      Observation observation = { time_[i], x_[i], y_[i], (uint8_t)(bucket % OBS_KINDS), value_[i] };
+      observations.push_back(observation);
+    }
+  }
+}
+
+Observation SpatialStore::observation(uint32_t index) const {
+  // Last bucket starting at or before index; empty buckets before it start there too
+  size_t bucket = std::upper_bound(bucketStart_.begin(), bucketStart_.end(), index) - bucketStart_.begin() - 1;
+  Observation observation = { time_[index], x_[index], y_[index], (uint8_t)(bucket % OBS_KINDS), value_[index] };
+  return observation;
+}
+
+uint32_t SpatialStore::firstSince(size_t bucket, uint32_t since) const {
+  if (since == 0) return bucketStart_[bucket];
+  return (uint32_t)(std::lower_bound(time_.begin() + bucketStart_[bucket], time_.begin() + bucketStart_[bucket + 1],
+                                     since) - time_.begin());
+}
+
+CellSummary SpatialStore::summarizeRun(size_t begin, size_t end) const {
+  CellSummary summary = { 0, 0, 0.0f, 0.0f, 0.0f };
+  if (begin >= end) return summary;
+  summary.count = (uint32_t)(end - begin);
+  summary.latest = value_[end - 1];
+  summary.latestTime = time_[end - 1];
+
+  // Least squares in hours from the first observation
+  double n = (double)summary.count;
+  double sumT = 0, sumV = 0, sumTT = 0, sumTV = 0;
+  for (size_t i = begin; i < end; i++) {
+    double t = (time_[i] - time_[begin]) / 3600.0;
+    double v = value_[i];
+    sumT += t;
+    sumV += v;
+    sumTT += t * t;
+    sumTV += t * v;
+  }
+  summary.mean = (float)(sumV / n);
+  double spread = n * sumTT - sumT * sumT;
+  if (time_[end - 1] != time_[begin] && spread > 0) summary.trendPerHour = (float)((n * sumTV - sumT * sumV) / spread);
+  return summary;
+}
+
+void SpatialStore::computeSummaries() {
+  summaries_.resize(bucketStart_.size() - 1);
+  for (size_t bucket = 0; bucket < summaries_.size(); bucket++) {
+    summaries_[bucket] = summarizeRun(bucketStart_[bucket], bucketStart_[bucket + 1]);
+  }
+}
+
+CellSummary SpatialStore::summarize(int column, int row, int kind, uint32_t since) const {
+  size_t bucket = bucketIndex(column, row, kind);
+  if (since == 0) return summaries_[bucket];
+  return summarizeRun(firstSince(bucket, since), bucketStart_[bucket + 1]);
+}
+
+void SpatialStore::range(long x0, long y0, long x1, long y1, unsigned kinds, uint32_t since,
+                         std::vector<uint32_t> &indices) const {
+  indices.clear();
+  if (size() == 0) return;
+  if (x0 > x1) std::swap(x0, x1);
+  if (y0 > y1) std::swap(y0, y1);
+  if (x1 < originX_ || y1 < originY_ || x0 >= originX_ + columns_ * cellSize_ ||
+      y0 >= originY_ + rows_ * cellSize_) {
+    return;
+  }
+
+  for (int row = rowOf(y0); row <= rowOf(y1); row++) {
+    long cellY = originY_ + row * cellSize_;
+    bool insideY = cellY >= y0 && cellY + cellSize_ - 1 <= y1;
+    for (int column = columnOf(x0); column <= columnOf(x1); column++) {
+      long cellX = originX_ + column * cellSize_;
+      bool inside = insideY && cellX >= x0 && cellX + cellSize_ - 1 <= x1;
+      for (int kind = 0; kind < OBS_KINDS; kind++) {
+        if (!(kinds & (1u << kind))) continue;
+        size_t bucket = bucketIndex(column, row, kind);
+        uint32_t end = bucketStart_[bucket + 1];
+        for (uint32_t i = firstSince(bucket, since); i < end; i++) {
+          if (inside || (x_[i] >= x0 && x_[i] <= x1 && y_[i] >= y0 && y_[i] <= y1)) indices.push_back(i);
+        }
+      }
+    }
+  }
+}
+
+void SpatialStore::nearest(long x, long y, int kind, uint32_t since, size_t count,
+                           std::vector<uint32_t> &indices) const {
+  indices.clear();
+  if (size() == 0 || count == 0 || kind < 0 || kind >= OBS_KINDS) return;
+
+  // Best candidates so far as (squared distance, index), closest first
+  std::vector<std::pair<long long, uint32_t> > best;
+  int cx = columnOf(x);
+  int cy = rowOf(y);
+  for (int r = 0;; r++) {
+    // Cells at Chebyshev distance r from the query cell
+    for (int row = std::max(0, cy - r); row <= std::min(rows_ - 1, cy + r); row++) {
+      bool edgeRow = row == cy - r || row == cy + r;
+      for (int column = std::max(0, cx - r); column <= std::min(columns_ - 1, cx + r); column++) {
+        if (!edgeRow && column != cx - r && column != cx + r) continue;
+        size_t bucket = bucketIndex(column, row, kind);
+        uint32_t end = bucketStart_[bucket + 1];
+        for (uint32_t i = firstSince(bucket, since); i < end; i++) {
+          long long dx = x_[i] - x;
+          long long dy = y_[i] - y;
+          std::pair<long long, uint32_t> candidate(dx * dx + dy * dy, i);
+          if (best.size() == count && candidate >= best.back()) continue;
+          best.insert(std::upper_bound(best.begin(), best.end(), candidate), candidate);
+          if (best.size() > count) best.pop_back();
+        }
+      }
+    }
+
+    // Unvisited cells lie beyond the sides of the searched square that still have cells behind them
+    long bound = LONG_MAX;
+    if (cx - r > 0) bound = std::min(bound, x - (originX_ + (long)(cx - r) * cellSize_));
+    if (cx + r < columns_ - 1) bound = std::min(bound, originX_ + (long)(cx + r + 1) * cellSize_ - x);
+    if (cy - r > 0) bound = std::min(bound, y - (originY_ + (long)(cy - r) * cellSize_));
+    if (cy + r < rows_ - 1) bound = std::min(bound, originY_ + (long)(cy + r + 1) * cellSize_ - y);
+    if (bound == LONG_MAX) break;
+    bound = std::max(0L, bound);
+    if (best.size() == count && best.back().first <= (long long)bound * bound) break;
+  }
+
+  for (size_t i = 0; i < best.size(); i++) indices.push_back(best[i].second);
+}
+
+bool SpatialStore::save(const char *path, std::string &error) const {
+  SpatialHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SPATIAL_MAGIC, sizeof(header.magic));
+  header.count = (uint32_t)size();
+  header.kinds = OBS_KINDS;
+  header.originX = (int32_t)originX_;
+  header.originY = (int32_t)originY_;
+  header.cellSize = (uint32_t)cellSize_;
+  header.columns = columns_;
+  header.rows = rows_;
+
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    error = std::string("cannot create ") + path;
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(bucketStart_.data(), sizeof(uint32_t), bucketStart_.size(), file) == bucketStart_.size() &&
+            fwrite(x_.data(), sizeof(int32_t), x_.size(), file) == x_.size() &&
+            fwrite(y_.data(), sizeof(int32_t), y_.size(), file) == y_.size() &&
+            fwrite(time_.data(), sizeof(uint32_t), time_.size(), file) == time_.size() &&
+            fwrite(value_.data(), sizeof(float), value_.size(), file) == value_.size();
+  if (fclose(file) != 0 || !ok) {
+    error = std::string("cannot write ") + path;
+    return false;
+  }
+  return true;
+}
+
+bool SpatialStore::load(const char *path, std::string &error) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    error = std::string("cannot open ") + path;
+    return false;
+  }
+
+  SpatialHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            memcmp(header.magic, SPATIAL_MAGIC, sizeof(header.magic)) == 0 && header.kinds == OBS_KINDS &&
+            header.cellSize > 0 && (long)header.columns * header.rows <= SPATIAL_MAX_CELLS;
+  if (ok) {
+    originX_ = header.originX;
+    originY_ = header.originY;
+    cellSize_ = header.cellSize;
+    columns_ = (int)header.columns;
+    rows_ = (int)header.rows;
+    bucketStart_.resize((size_t)columns_ * rows_ * OBS_KINDS + 1);
+    x_.resize(header.count);
+    y_.resize(header.count);
+    time_.resize(header.count);
+    value_.resize(header.count);
+    ok = fread(bucketStart_.data(), sizeof(uint32_t), bucketStart_.size(), file) == bucketStart_.size() &&
+         fread(x_.data(), sizeof(int32_t), x_.size(), file) == x_.size() &&
+         fread(y_.data(), sizeof(int32_t), y_.size(), file) == y_.size() &&
+         fread(time_.data(), sizeof(uint32_t), time_.size(), file) == time_.size() &&
+         fread(value_.data(), sizeof(float), value_.size(), file) == value_.size();
+  }
+  fclose(file);
+
+  // Bucket starts must rise from 0 to count so no query can index outside the arrays
+  for (size_t b = 0; ok && b + 1 < bucketStart_.size(); b++) ok = bucketStart_[b] <= bucketStart_[b + 1];
+  if (!ok || bucketStart_.front() != 0 || bucketStart_.back() != header.count) {
+    error = std::string(path) + " is not a valid spatial store";
+    *this = SpatialStore();
+    return false;
+  }
+  computeSummaries();
+  return true;
+}
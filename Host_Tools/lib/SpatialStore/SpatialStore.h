@@ -0,0 +1,189 @@
+/**
+ * SpatialStore.h
+ *
+ * Grid index of time-stamped observations (soil moisture, TDS, plant health)
+ * keyed by the gantry position they were taken at, in steps.
+ *
+ * The bed is split into square cells. Observations are kept as separate x, y,
+ * time and value arrays in a compressed-row layout: a bucket per (cell, kind)
+ * holds its observations contiguously, sorted by time, and bucketStart[]
+ * gives where each bucket begins. A range query touches only the cells it
+ * overlaps and takes whole buckets of the cells it covers; "since" filters
+ * are a binary search. The all-time latest/mean/trend of every bucket is
+ * computed once when the store is built or loaded, so a whole-bed pass reads
+ * one summary per cell.
+ *
+ * The store is immutable; to add observations, export them, append and
+ * build again (a counting sort, linear in the observation count).
+ *
+ * File layout (little-endian):
+ *   SpatialHeader
+ *   u32 bucketStart[columns * rows * kinds + 1]
+ *   i32 x[count], i32 y[count], u32 time[count], f32 value[count]
+ * 16 bytes per observation; the summaries are not stored.
+ */
+
+#ifndef SPATIAL_STORE_H
+#define SPATIAL_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define SPATIAL_MAGIC "SGRID01"   // 8 bytes including the terminator
+
+enum ObservationKind {
+  OBS_MOISTURE = 0,  // Sensor value, 0-255 with 255 = wet (sensor_log value column)
+  OBS_TDS = 1,       // ppm
+  OBS_HEALTH = 2,    // Non-healthy probability from survey_classify
+  OBS_KINDS = 3
+};
+
+/**
+ * One observation
+ */
+struct Observation {
+  uint32_t time;  // Unix seconds
+  int32_t x;      // Gantry position in steps
+  int32_t y;
+  uint8_t kind;   // ObservationKind
+  float value;
+};
+
+/**
+ * Aggregate of one kind in one cell
+ */
+struct CellSummary {
+  uint32_t count;
+  uint32_t latestTime;
+  float latest;       // Value of the newest observation
+  float mean;
+  float trendPerHour; // Least-squares slope; 0 unless two different times
+};
+
+/**
+ * On-disk header at offset 0
+ */
+struct SpatialHeader {
+  char magic[8];
+  uint32_t count;
+  uint32_t kinds;
+  int32_t originX;    // Lower corner of cell (0, 0)
+  int32_t originY;
+  uint32_t cellSize;
+  uint32_t columns;
+  uint32_t rows;
+};
+
+class SpatialStore {
+public:
+  SpatialStore();
+
+  /**
+   * Index a set of observations
+   *
+   * @param observations Observations in any order; kinds >= OBS_KINDS are dropped
+   * @param cellSize Cell edge in steps
+   */
+  void build(const std::vector<Observation> &observations, long cellSize);
+
+  /**
+   * Append every stored observation, grouped by cell and kind
+   */
+  void exportObservations(std::vector<Observation> &observations) const;
+
+  /**
+   * Write the store to a file
+   *
+   * @return FALSE (with error set) if the file cannot be written
+   */
+  bool save(const char *path, std::string &error) const;
+
+  /**
+   * Replace the store with the contents of a file
+   *
+   * @return FALSE (with error set) if the file is missing or not a valid store
+   */
+  bool load(const char *path, std::string &error);
+
+  size_t size() const { return x_.size(); }
+  int columns() const { return columns_; }
+  int rows() const { return rows_; }
+  long cellSize() const { return cellSize_; }
+
+  /**
+   * Centre of a cell in steps
+   */
+  long cellCenterX(int column) const { return originX_ + column * cellSize_ + cellSize_ / 2; }
+  long cellCenterY(int row) const { return originY_ + row * cellSize_ + cellSize_ / 2; }
+
+  /**
+   * All-time aggregate of one kind in one cell
+   */
+  const CellSummary &summary(int column, int row, int kind) const {
+    return summaries_[bucketIndex(column, row, kind)];
+  }
+
+  /**
+   * Aggregate of the observations of one kind in one cell taken at or after since
+   */
+  CellSummary summarize(int column, int row, int kind, uint32_t since) const;
+
+  /**
+   * Find the observations inside a rectangle (edges included)
+   *
+   * @param kinds Bit mask of (1 << ObservationKind)
+   * @param since Oldest time to include (0 = all)
+   * @param indices Receives observation indices, grouped by cell and kind
+   */
+  void range(long x0, long y0, long x1, long y1, unsigned kinds, uint32_t since,
+             std::vector<uint32_t> &indices) const;
+
+  /**
+   * Find the observations of one kind closest to a position
+   *
+   * @param count Number wanted; fewer are returned if the store has fewer
+   * @param indices Receives observation indices, closest first
+   */
+  void nearest(long x, long y, int kind, uint32_t since, size_t count,
+               std::vector<uint32_t> &indices) const;
+
+  /**
+   * One stored observation (the kind is found from its bucket)
+   */
+  Observation observation(uint32_t index) const;
+
+private:
+  size_t bucketIndex(int column, int row, int kind) const {
+    return ((size_t)row * columns_ + column) * OBS_KINDS + kind;
+  }
+  int columnOf(long x) const;
+  int rowOf(long y) const;
+  uint32_t firstSince(size_t bucket, uint32_t since) const;
+  CellSummary summarizeRun(size_t begin, size_t end) const;
+  void computeSummaries();
+
+  long originX_, originY_, cellSize_;
+  int columns_, rows_;
+  std::vector<uint32_t> bucketStart_;  // OBS_KINDS buckets per cell, + 1
+  std::vector<int32_t> x_;
+  std::vector<int32_t> y_;
+  std::vector<uint32_t> time_;
+  std::vector<float> value_;
+  std::vector<CellSummary> summaries_; // One per bucket
+};
+
+/**
+ * Name of a kind for files and reports ("moisture", "tds", "health")
+ */
+const char *observationKindName(int kind);
+
+/**
+ * Parse a kind name
+ *
+ * @return ObservationKind, or -1 if unknown
+ */
+int parseObservationKind(const std::string &name);
+
+#endif // SPATIAL_STORE_H
@@ -0,0 +1,96 @@
+/**
+ * BoundedQueue.h
+ *
+ * Fixed-capacity blocking queue used to connect the stages of the host pipelines.
+ * Producers block while the queue is full, consumers block while it is empty,
+ * so a slow stage applies back-pressure instead of growing memory without bound.
+ */
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity ? capacity : 1), closed_(false) {}
+
+  /**
+   * Add an item, waiting for space if the queue is full
+   *
+   * @param item Item to add (moved into the queue)
+   * @return FALSE if the queue was closed and the item was dropped
+   */
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) return false;
+    items_.push_back(std::move(item));
+    notEmpty_.notify_one();
+    return true;
+  }
+
+  /**
+   * Remove the oldest item, waiting while the queue is empty
+   *
+   * @param item Receives the item
+   * @return FALSE once the queue is closed and drained
+   */
+  bool pop(T &item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) return false;
+    item = std::move(items_.front());
+    items_.pop_front();
+    notFull_.notify_one();
+    return true;
+  }
+
+  /**
+   * Remove the oldest item only if one is available right now
+   *
+   * @param item Receives the item
+   * @return TRUE if an item was removed
+   */
+  bool tryPop(T &item) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.empty()) return false;
+    item = std::move(items_.front());
+    items_.pop_front();
+    notFull_.notify_one();
+    return true;
+  }
+
+  /**
+   * Mark the end of the stream
+   * Pending items can still be popped; pop() returns FALSE once they are gone.
+   */
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+  }
+
+  /**
+   * Current number of queued items (for progress reporting)
+   */
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.size();
+  }
+
+private:
+  size_t capacity_;
+  bool closed_;
+  std::deque<T> items_;
+  std::mutex mutex_;
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+};
+
+#endif // BOUNDED_QUEUE_H
@@ -0,0 +1,94 @@
+/**
+ * FrameList.cpp
+ *
+ * Implementation of frame listing and position lookup.
+ */
+
+#include "FrameList.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+static bool hasJpegExtension(const std::string &name) {
+  size_t dot = name.rfind('.');
+  if (dot == std::string::npos) return false;
+  std::string ext = name.substr(dot + 1);
+  for (size_t i = 0; i < ext.size(); i++) ext[i] = tolower(ext[i]);
+  return ext == "jpg" || ext == "jpeg";
+}
+
+bool listFrames(const char *source, std::vector<std::string> &paths) {
+  DIR *dir = opendir(source);
+  if (dir) {
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+      if (hasJpegExtension(entry->d_name)) paths.push_back(std::string(source) + "/" + entry->d_name);
+    }
+    closedir(dir);
+    std::sort(paths.begin(), paths.end());
+    return true;
+  }
+
+  FILE *list = fopen(source, "r");
+  if (!list) return false;
+  char line[4096];
+  while (fgets(line, sizeof(line), list)) {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0]) paths.push_back(line);
+  }
+  fclose(list);
+  return true;
+}
+
+std::string baseName(const std::string &path) {
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool loadManifest(const char *path, std::map<std::string, std::string> &positions) {
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+  char line[4096];
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\r\n")] = 0;
+    char *comma = strchr(line, ',');
+    if (!comma) continue;
+    *comma = 0;
+    positions[baseName(line)] = comma + 1;
+  }
+  fclose(file);
+  return true;
+}
+
+/**
+ * Read a signed number that follows the given axis letter in a file name
+ * The letter must start a token (beginning of name or after '_', '-' or '.').
+ */
+static bool findAxisToken(const std::string &name, char axis, long &value) {
+  for (size_t i = 0; i + 1 < name.size(); i++) {
+    bool tokenStart = i == 0 || name[i - 1] == '_' || name[i - 1] == '-' || name[i - 1] == '.';
+    if (!tokenStart || tolower(name[i]) != axis) continue;
+    const char *digits = name.c_str() + i + 1;
+    char *end;
+    value = strtol(digits, &end, 10);
+    if (end != digits) return true;
+  }
+  return false;
+}
+
+std::string positionFromName(const std::string &name) {
+  long x, y;
+  if (!findAxisToken(name, 'x', x)) return "";
+  if (!findAxisToken(name, 'y', y)) y = 0;
+  return std::to_string(x) + "," + std::to_string(y);
+}
+
+std::string framePosition(const std::map<std::string, std::string> &manifest, const std::string &path) {
+  std::string name = baseName(path);
+  auto known = manifest.find(name);
+  return known != manifest.end() ? known->second : positionFromName(name);
+}
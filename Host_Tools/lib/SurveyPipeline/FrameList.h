@@ -0,0 +1,51 @@
+/**
+ * FrameList.h
+ *
+ * Survey frame lists and the gantry positions they were taken at.
+ *
+ * Positions come from a manifest (filename,x,y per line) or from
+ * x<steps>/y<steps> tokens in the file name, e.g. bed1_x12000_y3400.jpg.
+ */
+
+#ifndef FRAME_LIST_H
+#define FRAME_LIST_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Collect JPEG frames from a directory (sorted by name) or a list file (one path per line)
+ *
+ * @return FALSE if the source cannot be read
+ */
+bool listFrames(const char *source, std::vector<std::string> &paths);
+
+/**
+ * File name without its directory
+ */
+std::string baseName(const std::string &path);
+
+/**
+ * Load a manifest of "filename,x,y" lines keyed by base file name
+ *
+ * @param positions Receives "x,y" per file name
+ * @return FALSE if the file cannot be read
+ */
+bool loadManifest(const char *path, std::map<std::string, std::string> &positions);
+
+/**
+ * Position encoded in a file name
+ *
+ * @return "x,y", or "" if the name has no x token (y defaults to 0)
+ */
+std::string positionFromName(const std::string &name);
+
+/**
+ * Position of a frame from the manifest or, failing that, its file name
+ *
+ * @return "x,y", or "" if unknown
+ */
+std::string framePosition(const std::map<std::string, std::string> &manifest, const std::string &path);
+
+#endif // FRAME_LIST_H
@@ -0,0 +1,103 @@
+/**
+ * ImageLoader.cpp
+ *
+ * Implementation of JPEG decoding (libjpeg) and model preprocessing.
+ * Resizing and normalization use the SIMD kernels from ImageKernels.
+ */
+
+#include "ImageLoader.h"
+#include "ImageKernels.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <jpeglib.h>
+
+// libjpeg reports fatal errors through a callback; jump back out of the decoder
+struct JpegErrorManager {
+  jpeg_error_mgr base;
+  jmp_buf escape;
+  char message[JMSG_LENGTH_MAX];
+};
+
+static void onJpegError(j_common_ptr info) {
+  JpegErrorManager *manager = (JpegErrorManager *)info->err;
+  (*info->err->format_message)(info, manager->message);
+  longjmp(manager->escape, 1);
+}
+
+bool decodeJpeg(const char *path, RgbImage &image, std::string &error, int minWidth, int minHeight) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    error = std::string("cannot open ") + path;
+    return false;
+  }
+
+  jpeg_decompress_struct info;
+  JpegErrorManager manager;
+  info.err = jpeg_std_error(&manager.base);
+  manager.base.error_exit = onJpegError;
+
+  if (setjmp(manager.escape)) {
+    error = std::string(path) + ": " + manager.message;
+    jpeg_destroy_decompress(&info);
+    fclose(file);
+    return false;
+  }
+
+  jpeg_create_decompress(&info);
+  jpeg_stdio_src(&info, file);
+  jpeg_read_header(&info, TRUE);
+  info.out_color_space = JCS_RGB;
+
+  // Pick the largest DCT reduction (1/2 .. 1/8) that keeps the requested size;
+  // a dimension given as 0 does not limit it
+  if (minWidth > 0 || minHeight > 0) {
+    unsigned int denom = 8;
+    while (denom > 1 && ((minWidth > 0 && info.image_width / denom < (unsigned int)minWidth) ||
+                         (minHeight > 0 && info.image_height / denom < (unsigned int)minHeight))) {
+      denom /= 2;
+    }
+    info.scale_num = 1;
+    info.scale_denom = denom;
+  }
+
+  jpeg_start_decompress(&info);
+  image.width = info.output_width;
+  image.height = info.output_height;
+  image.pixels.resize((size_t)image.width * image.height * 3);
+
+  while (info.output_scanline < info.output_height) {
+    JSAMPROW row = &image.pixels[(size_t)info.output_scanline * image.width * 3];
+    jpeg_read_scanlines(&info, &row, 1);
+  }
+
+  jpeg_finish_decompress(&info);
+  jpeg_destroy_decompress(&info);
+  fclose(file);
+  return true;
+}
+
+void resizeRgb(const RgbImage &src, RgbImage &dst, int width, int height) {
+  dst.width = width;
+  dst.height = height;
+  dst.pixels.resize((size_t)width * height * 3);
+  resizeBilinearU8(src.pixels.data(), src.width, src.height, dst.pixels.data(), width, height, 3);
+}
+
+void normalizePixels(const uint8_t *pixels, long count, float *out) {
+  normalizeU8ToF32(pixels, out, count, 1.0f / 255.0f);
+}
+
+bool loadModelInput(const char *path, int width, int height, float *out, std::string &error) {
+  RgbImage decoded;
+  if (!decodeJpeg(path, decoded, error, width, height)) return false;
+
+  if (decoded.width == width && decoded.height == height) {
+    normalizePixels(decoded.pixels.data(), (long)width * height * 3, out);
+  } else {
+    RgbImage resized;
+    resizeRgb(decoded, resized, width, height);
+    normalizePixels(resized.pixels.data(), (long)width * height * 3, out);
+  }
+  return true;
+}
@@ -0,0 +1,72 @@
+/**
+ * ImageLoader.h
+ *
+ * JPEG decoding and model preprocessing for the host vision tools.
+ * Mirrors classify_uploaded_image() in farmbot_cv.py: decode to RGB,
+ * resize to the model input size, divide by 255.
+ */
+
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * 8-bit RGB image in row-major HWC layout
+ */
+struct RgbImage {
+  int width;
+  int height;
+  std::vector<uint8_t> pixels;  // width * height * 3 bytes
+};
+
+/**
+ * Decode a JPEG file to RGB
+ * When minWidth and/or minHeight are given, libjpeg's DCT scaling is used to
+ * decode at the smallest power-of-two reduction that still covers that size,
+ * which is much faster than decoding full camera frames and resizing
+ * afterwards. Full size when both are 0.
+ *
+ * @param path JPEG file
+ * @param image Receives the decoded image
+ * @param error Receives a description on failure
+ * @param minWidth Smallest acceptable decoded width (0 = any)
+ * @param minHeight Smallest acceptable decoded height (0 = any)
+ * @return TRUE if the file was decoded
+ */
+bool decodeJpeg(const char *path, RgbImage &image, std::string &error, int minWidth = 0, int minHeight = 0);
+
+/**
+ * Resize an RGB image with bilinear interpolation
+ *
+ * @param src Source image
+ * @param dst Receives the resized image
+ * @param width Target width
+ * @param height Target height
+ */
+void resizeRgb(const RgbImage &src, RgbImage &dst, int width, int height);
+
+/**
+ * Convert 8-bit pixels to floats in [0, 1]
+ *
+ * @param pixels Source bytes
+ * @param count Number of bytes
+ * @param out Receives count floats
+ */
+void normalizePixels(const uint8_t *pixels, long count, float *out);
+
+/**
+ * Decode, resize and normalize one image for the classifier
+ *
+ * @param path JPEG file
+ * @param width Model input width
+ * @param height Model input height
+ * @param out Receives width * height * 3 floats
+ * @param error Receives a description on failure
+ * @return TRUE on success
+ */
+bool loadModelInput(const char *path, int width, int height, float *out, std::string &error);
+
+#endif // IMAGE_LOADER_H
@@ -0,0 +1,55 @@
+"""
+bench_keras_augment.py
+
+Times the Keras ImageDataGenerator used for training in farmbot_cv.py on the
+training split of a packed dataset, as the baseline for augment_bench.
+
+Usage:
+    python bench_keras_augment.py lettuce.lpack [--batch 32] [--batches 50]
+"""
+
+import argparse
+import time
+
+import numpy as np
+from tensorflow.keras.preprocessing.image import ImageDataGenerator
+
+from packed_dataset import open_packed
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the Keras augmentation generator")
+    parser.add_argument("dataset", help="packed dataset written by pack_dataset")
+    parser.add_argument("--batch", type=int, default=32)
+    parser.add_argument("--batches", type=int, default=50)
+    args = parser.parse_args()
+
+    ds = open_packed(args.dataset)
+    train = ds.indices("train")
+    images = np.asarray(ds.images[train[:args.batch * 4]], dtype=np.float32)
+    labels = ds.labels[train[:args.batch * 4]]
+
+    # Same settings as train_datagen in farmbot_cv.py
+    datagen = ImageDataGenerator(
+        rescale=1.0 / 255,
+        rotation_range=40,
+        width_shift_range=0.2,
+        height_shift_range=0.2,
+        shear_range=0.2,
+        zoom_range=0.2,
+        horizontal_flip=True,
+        brightness_range=[0.8, 1.2],
+        fill_mode="nearest",
+    )
+    flow = datagen.flow(images, labels, batch_size=args.batch, seed=42)
+
+    next(flow)  # Warm-up
+    start = time.perf_counter()
+    for _ in range(args.batches):
+        next(flow)
+    elapsed = time.perf_counter() - start
+    print(f"Keras ImageDataGenerator: {args.batches * args.batch / elapsed:.0f} images/s")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,103 @@
+"""
+export_lettuce_model.py
+
+Exports the Keras lettuce health classifier (healthy_vs_non_healthy_classifier.h5,
+trained in farmbot_cv.py) into the LCNN binary format read by lib/LettuceCNN.
+
+Optionally also writes a reference file with Keras predictions for a set of
+images, which `lettuce_bench --parity` uses to check the C++ engine against Keras.
+
+Usage:
+    python export_lettuce_model.py healthy_vs_non_healthy_classifier.h5 lettuce.lcnn
+    python export_lettuce_model.py model.h5 lettuce.lcnn --reference parity.lref img1.jpg img2.jpg ...
+"""
+
+import argparse
+import struct
+
+import numpy as np
+import tensorflow as tf
+from PIL import Image
+
+LCNN_MAGIC = b"LCNN"
+LCNN_VERSION = 1
+LREF_MAGIC = b"LREF"
+
+LAYER_CONV = 1
+LAYER_MAXPOOL = 2
+LAYER_DENSE = 3
+
+ACTIVATIONS = {"linear": 0, "relu": 1, "sigmoid": 2}
+
+
+def write_layer_header(out, layer_type, activation, outputs, kh, kw):
+    # dtype is always fp32 here; lettuce_bench --save-int8 writes the int8 variant
+    out.write(struct.pack("<6I", layer_type, activation, outputs, kh, kw, 0))
+
+
+def export_model(model, path):
+    _, height, width, channels = model.input_shape
+    layers = [l for l in model.layers
+              if isinstance(l, (tf.keras.layers.Conv2D, tf.keras.layers.MaxPooling2D, tf.keras.layers.Dense))]
+
+    with open(path, "wb") as out:
+        out.write(LCNN_MAGIC)
+        out.write(struct.pack("<5I", LCNN_VERSION, height, width, channels, len(layers)))
+
+        for layer in layers:
+            if isinstance(layer, tf.keras.layers.Conv2D):
+                kernel, bias = layer.get_weights()       # (kh, kw, cin, cout)
+                kh, kw, _, cout = kernel.shape
+                write_layer_header(out, LAYER_CONV, ACTIVATIONS[layer.activation.__name__], cout, kh, kw)
+                # [filter][ky][kx][channel] matches the im2col patch order
+                out.write(np.ascontiguousarray(kernel.transpose(3, 0, 1, 2), dtype="<f4").tobytes())
+                out.write(bias.astype("<f4").tobytes())
+            elif isinstance(layer, tf.keras.layers.MaxPooling2D):
+                ph, pw = layer.pool_size
+                write_layer_header(out, LAYER_MAXPOOL, 0, 0, ph, pw)
+            else:
+                kernel, bias = layer.get_weights()       # (inputs, units)
+                write_layer_header(out, LAYER_DENSE, ACTIVATIONS[layer.activation.__name__], kernel.shape[1], 1, 1)
+                out.write(np.ascontiguousarray(kernel.T, dtype="<f4").tobytes())
+                out.write(bias.astype("<f4").tobytes())
+
+    print(f"Exported {len(layers)} layers to {path}")
+
+
+def load_image(path, height, width):
+    # Same preprocessing as classify_uploaded_image() in farmbot_cv.py
+    img = Image.open(path).convert("RGB").resize((width, height))
+    return np.asarray(img, dtype=np.float32) / 255.0
+
+
+def export_reference(model, path, image_paths):
+    _, height, width, channels = model.input_shape
+    images = np.stack([load_image(p, height, width) for p in image_paths])
+    scores = model.predict(images, verbose=0).reshape(-1)
+
+    with open(path, "wb") as out:
+        out.write(LREF_MAGIC)
+        out.write(struct.pack("<4I", len(images), height, width, channels))
+        for image, score in zip(images, scores):
+            out.write(image.astype("<f4").tobytes())
+            out.write(struct.pack("<f", float(score)))
+
+    print(f"Wrote {len(images)} reference predictions to {path}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Export the lettuce classifier to LCNN")
+    parser.add_argument("model", help="Keras .h5 model")
+    parser.add_argument("output", help="LCNN file to write")
+    parser.add_argument("--reference", help="also write Keras predictions for IMAGES to this file")
+    parser.add_argument("images", nargs="*", help="images for the reference file")
+    args = parser.parse_args()
+
+    model = tf.keras.models.load_model(args.model)
+    export_model(model, args.output)
+    if args.reference:
+        export_reference(model, args.reference, args.images)
+
+
+if __name__ == "__main__":
+    main()
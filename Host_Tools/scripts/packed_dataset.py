@@ -0,0 +1,73 @@
+"""
+packed_dataset.py
+
+Zero-copy numpy access to datasets written by pack_dataset (see lib/PackedDataset).
+The image tensor is mapped with numpy.memmap, so nothing is decoded or copied
+until a batch is converted to float for training.
+
+Usage in the notebook, replacing the ImageDataGenerator directory flows:
+
+    from packed_dataset import open_packed, batches
+    ds = open_packed("lettuce.lpack")
+    model.fit(batches(ds, "train", 32, shuffle=True),
+              steps_per_epoch=ds.count("train") // 32,
+              validation_data=batches(ds, "validation", 32),
+              validation_steps=ds.count("validation") // 32,
+              epochs=15)
+"""
+
+import struct
+
+import numpy as np
+
+PACKED_MAGIC = b"LPACK01\0"
+HEADER_FORMAT = "<8s4I5Q"
+SPLITS = {"train": 0, "validation": 1, "test": 2}
+
+
+class PackedDataset:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            header = struct.unpack(HEADER_FORMAT, f.read(struct.calcsize(HEADER_FORMAT)))
+        (magic, count, height, width, channels,
+         tensor_offset, label_offset, split_offset, name_offset, name_bytes) = header
+        if magic != PACKED_MAGIC:
+            raise ValueError(f"{path} is not a packed dataset")
+
+        self.images = np.memmap(path, dtype=np.uint8, mode="r", offset=tensor_offset,
+                                shape=(count, height, width, channels))
+        self.labels = np.memmap(path, dtype=np.uint8, mode="r", offset=label_offset, shape=(count,))
+        self.splits = np.memmap(path, dtype=np.uint8, mode="r", offset=split_offset, shape=(count,))
+        self._name_offset = name_offset
+        self._name_bytes = name_bytes
+        self._path = path
+
+    def indices(self, split):
+        return np.flatnonzero(self.splits == SPLITS[split])
+
+    def count(self, split):
+        return int(np.count_nonzero(self.splits == SPLITS[split]))
+
+    def names(self):
+        with open(self._path, "rb") as f:
+            f.seek(self._name_offset)
+            return f.read(self._name_bytes).rstrip(b"\0").decode().split("\0")
+
+
+def open_packed(path):
+    return PackedDataset(path)
+
+
+def batches(ds, split, batch_size, shuffle=False, seed=None, augment=None):
+    """Endless generator of (images / 255, labels) batches for model.fit()."""
+    indices = ds.indices(split)
+    rng = np.random.default_rng(seed)
+    while True:
+        order = rng.permutation(indices) if shuffle else indices
+        for start in range(0, len(order) - batch_size + 1, batch_size):
+            # Sorted fancy indexing reads the memmap in file order
+            chunk = np.sort(order[start:start + batch_size])
+            x = ds.images[chunk]
+            if augment is not None:
+                x = augment(x)
+            yield x.astype(np.float32) * (1.0 / 255.0), ds.labels[chunk].astype(np.float32)
@@ -0,0 +1,417 @@
+/**
+ * bed_map.cpp
+ *
+ * Joins soil readings and classifier results with the gantry position they
+ * were taken at, and decides which parts of the bed need water.
+ *
+ * Usage:
+ *   bed_map [--load store.sgrid] [--observations obs.csv]... [--survey results.csv]...
+ *           [--time UNIX] [--random N] [--cell STEPS] [--save store.sgrid]
+ *           [--output cells.csv] [--days D] [--dry V] [--horizon HOURS]
+ *           [--range x0,y0,x1,y1] [--nearest x,y[,kind]] [--bench]
+ *
+ * Observations are "time,x,y,kind,value" lines (unix seconds, steps, kind
+ * moisture/tds/health; a header line is skipped). --survey reads the output
+ * of survey_classify (filename,x,y,score,...) as health observations taken at
+ * --time (default now); frames without a position are skipped. New
+ * observations are added to a store given with --load, and --save writes the
+ * result (see SpatialStore.h); --cell (default 500 steps) only applies to a
+ * new store.
+ *
+ * The cell report has one line per cell with observations:
+ *   column,row,x,y               cell index and centre in steps
+ *   moisture_n, moisture_latest, moisture_mean, moisture_trend_h
+ *   tds_latest, tds_mean, health_latest, health_mean
+ *   irrigate   1 if the latest moisture plus trend x --horizon hours
+ *              (default 12) falls below --dry (default 100, sensor_log scale
+ *              where 255 = wet)
+ * --days D limits the aggregates to the last D days before the newest
+ * observation.
+ *
+ * --random N adds N synthetic observations spread over 30 days on a
+ * 40000 x 40000 step bed, for timing; --bench times range and nearest
+ * queries and the whole-bed pass.
+ */
+
+#include "SpatialStore.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#define DEFAULT_CELL_STEPS 500
+#define RANDOM_BED_STEPS 40000
+#define RANDOM_SPAN_S (30 * 86400L)
+#define BENCH_QUERIES 10000
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/**
+ * Read time,x,y,kind,value lines; lines that do not parse are skipped
+ */
+static bool loadObservations(const char *path, std::vector<Observation> &observations, long &skipped) {
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+  char line[1024];
+  while (fgets(line, sizeof(line), file)) {
+    unsigned long time;
+    long x, y;
+    char kindName[32];
+    float value;
+    int kind = -1;
+    if (sscanf(line, "%lu,%ld,%ld,%31[^,],%f", &time, &x, &y, kindName, &value) == 5) {
+      kind = parseObservationKind(kindName);
+    }
+    if (kind < 0) {
+      skipped++;
+      continue;
+    }
+    Observation observation = { (uint32_t)time, (int32_t)x, (int32_t)y, (uint8_t)kind, value };
+    observations.push_back(observation);
+  }
+  fclose(file);
+  return true;
+}
+
+/**
+ * Read survey_classify results (filename,x,y,score,label,confidence)
+ */
+static bool loadSurvey(const char *path, uint32_t time, std::vector<Observation> &observations, long &skipped) {
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+  char line[4096];
+  while (fgets(line, sizeof(line), file)) {
+    char *comma = strchr(line, ',');
+    long x, y;
+    float score;
+    if (!comma || sscanf(comma + 1, "%ld,%ld,%f", &x, &y, &score) != 3) {
+      skipped++;  // Header, frames without a position and decode errors
+      continue;
+    }
+    Observation observation = { time, (int32_t)x, (int32_t)y, OBS_HEALTH, score };
+    observations.push_back(observation);
+  }
+  fclose(file);
+  return true;
+}
+
+/**
+ * A bed that dries out over the month, wetter in some patches than others,
+ * with one sick corner
+ */
+static void randomObservations(long count, uint32_t now, std::vector<Observation> &observations) {
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int32_t> coordinate(0, RANDOM_BED_STEPS);
+  std::uniform_int_distribution<long> age(0, RANDOM_SPAN_S);
+  std::normal_distribution<float> noise(0.0f, 4.0f);
+  observations.reserve(observations.size() + count);
+  for (long i = 0; i < count; i++) {
+    Observation observation;
+    observation.time = now - (uint32_t)age(random);
+    observation.x = coordinate(random);
+    observation.y = coordinate(random);
+    observation.kind = (uint8_t)(i % OBS_KINDS);
+    double days = (now - observation.time) / 86400.0;
+    double patch = sin(observation.x / 6000.0) * cos(observation.y / 5000.0);
+    switch (observation.kind) {
+      case OBS_MOISTURE:
+        observation.value = (float)(110 + 50 * patch + 2 * days) + noise(random);
+        break;
+      case OBS_TDS:
+        observation.value = (float)(600 + 80 * patch) + 5 * noise(random);
+        break;
+      default:
+        observation.value = observation.x + observation.y > 64000 ? 0.8f : 0.1f;
+        observation.value = std::min(1.0f, std::max(0.0f, observation.value + noise(random) / 40));
+        break;
+    }
+    observations.push_back(observation);
+  }
+}
+
+static uint32_t newestTime(const SpatialStore &store) {
+  uint32_t newest = 0;
+  for (int row = 0; row < store.rows(); row++) {
+    for (int column = 0; column < store.columns(); column++) {
+      for (int kind = 0; kind < OBS_KINDS; kind++) {
+        newest = std::max(newest, store.summary(column, row, kind).latestTime);
+      }
+    }
+  }
+  return newest;
+}
+
+struct CellDecision {
+  int column;
+  int row;
+  CellSummary summaries[OBS_KINDS];
+  bool irrigate;
+};
+
+/**
+ * Aggregate every cell and decide on irrigation
+ */
+static void decideBed(const SpatialStore &store, uint32_t since, float dry, float horizonHours,
+                      std::vector<CellDecision> &decisions) {
+  decisions.clear();
+  for (int row = 0; row < store.rows(); row++) {
+    for (int column = 0; column < store.columns(); column++) {
+      CellDecision decision;
+      decision.column = column;
+      decision.row = row;
+      uint32_t observed = 0;
+      for (int kind = 0; kind < OBS_KINDS; kind++) {
+        decision.summaries[kind] = store.summarize(column, row, kind, since);
+        observed += decision.summaries[kind].count;
+      }
+      if (observed == 0) continue;
+      const CellSummary &moisture = decision.summaries[OBS_MOISTURE];
+      decision.irrigate = moisture.count > 0 && moisture.latest + moisture.trendPerHour * horizonHours < dry;
+      decisions.push_back(decision);
+    }
+  }
+}
+
+static bool writeDecisions(const char *path, const SpatialStore &store, const std::vector<CellDecision> &decisions) {
+  FILE *output = fopen(path, "w");
+  if (!output) return false;
+  fprintf(output, "column,row,x,y,moisture_n,moisture_latest,moisture_mean,moisture_trend_h,"
+                  "tds_latest,tds_mean,health_latest,health_mean,irrigate\n");
+  for (size_t i = 0; i < decisions.size(); i++) {
+    const CellDecision &decision = decisions[i];
+    const CellSummary &moisture = decision.summaries[OBS_MOISTURE];
+    const CellSummary &tds = decision.summaries[OBS_TDS];
+    const CellSummary &health = decision.summaries[OBS_HEALTH];
+    fprintf(output, "%d,%d,%ld,%ld,%u,", decision.column, decision.row, store.cellCenterX(decision.column),
+            store.cellCenterY(decision.row), moisture.count);
+    if (moisture.count) fprintf(output, "%.1f,%.1f,%.3f,", moisture.latest, moisture.mean, moisture.trendPerHour);
+    else fprintf(output, ",,,");
+    if (tds.count) fprintf(output, "%.0f,%.0f,", tds.latest, tds.mean);
+    else fprintf(output, ",,");
+    if (health.count) fprintf(output, "%.3f,%.3f,", health.latest, health.mean);
+    else fprintf(output, ",,");
+    fprintf(output, "%d\n", decision.irrigate ? 1 : 0);
+  }
+  return fclose(output) == 0;
+}
+
+static void printRange(const SpatialStore &store, long x0, long y0, long x1, long y1, uint32_t since) {
+  std::vector<uint32_t> indices;
+  store.range(x0, y0, x1, y1, (1u << OBS_KINDS) - 1, since, indices);
+  long counts[OBS_KINDS] = { 0 };
+  double sums[OBS_KINDS] = { 0 };
+  for (size_t i = 0; i < indices.size(); i++) {
+    Observation observation = store.observation(indices[i]);
+    counts[observation.kind]++;
+    sums[observation.kind] += observation.value;
+  }
+  printf("Range %ld,%ld-%ld,%ld: %zu observations\n", x0, y0, x1, y1, indices.size());
+  for (int kind = 0; kind < OBS_KINDS; kind++) {
+    if (counts[kind]) printf("  %-8s %8ld, mean %.3f\n", observationKindName(kind), counts[kind], sums[kind] / counts[kind]);
+  }
+}
+
+static void printNearest(const SpatialStore &store, long x, long y, int kind, uint32_t since) {
+  std::vector<uint32_t> indices;
+  store.nearest(x, y, kind, since, 1, indices);
+  if (indices.empty()) {
+    printf("Nearest %s to %ld,%ld: none\n", observationKindName(kind), x, y);
+    return;
+  }
+  Observation observation = store.observation(indices[0]);
+  printf("Nearest %s to %ld,%ld: %.3f at %d,%d (%.0f steps away, time %u)\n", observationKindName(kind), x, y,
+         observation.value, observation.x, observation.y, hypot(observation.x - x, observation.y - y),
+         observation.time);
+}
+
+/**
+ * Time random range and nearest queries and the whole-bed pass
+ */
+static void runBenchmark(const SpatialStore &store, uint32_t since, float dry, float horizonHours) {
+  std::mt19937 random(99);
+  std::uniform_int_distribution<long> coordinate(0, RANDOM_BED_STEPS);
+  std::vector<uint32_t> indices;
+
+  Clock::time_point start = Clock::now();
+  size_t matched = 0;
+  for (int i = 0; i < BENCH_QUERIES; i++) {
+    long x = coordinate(random);
+    long y = coordinate(random);
+    store.range(x, y, x + 2000, y + 2000, (1u << OBS_KINDS) - 1, since, indices);
+    matched += indices.size();
+  }
+  double rangeMs = millisSince(start);
+  printf("Range 2000 x 2000:  %8.2f us/query, %zu observations per query\n", rangeMs * 1000 / BENCH_QUERIES,
+         matched / BENCH_QUERIES);
+
+  for (size_t count = 1; count <= 8; count *= 8) {
+    start = Clock::now();
+    for (int i = 0; i < BENCH_QUERIES; i++) {
+      store.nearest(coordinate(random), coordinate(random), i % OBS_KINDS, since, count, indices);
+    }
+    printf("Nearest %zu:          %8.2f us/query\n", count, millisSince(start) * 1000 / BENCH_QUERIES);
+  }
+
+  std::vector<CellDecision> decisions;
+  start = Clock::now();
+  decideBed(store, since, dry, horizonHours, decisions);
+  printf("Whole-bed pass:     %8.2f ms for %zu cells%s\n", millisSince(start), decisions.size(),
+         since ? " (windowed)" : "");
+}
+
+static void printUsage() {
+  printf("Usage: bed_map [--load store.sgrid] [--observations obs.csv]... [--survey results.csv]...\n");
+  printf("               [--time UNIX] [--random N] [--cell STEPS] [--save store.sgrid]\n");
+  printf("               [--output cells.csv] [--days D] [--dry V] [--horizon HOURS]\n");
+  printf("               [--range x0,y0,x1,y1] [--nearest x,y[,kind]] [--bench]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printUsage();
+    return 1;
+  }
+
+  const char *loadPath = NULL;
+  const char *savePath = NULL;
+  const char *outputPath = NULL;
+  std::vector<const char *> observationPaths;
+  std::vector<const char *> surveyPaths;
+  uint32_t surveyTime = (uint32_t)time(NULL);
+  long randomCount = 0;
+  long cellSize = DEFAULT_CELL_STEPS;
+  double days = 0;
+  float dry = 100;
+  float horizonHours = 12;
+  bool bench = false;
+  std::vector<long> ranges;   // x0,y0,x1,y1 per query
+  std::vector<long> nearests; // x,y,kind per query
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--load") && i + 1 < argc) loadPath = argv[++i];
+    else if (!strcmp(argv[i], "--save") && i + 1 < argc) savePath = argv[++i];
+    else if (!strcmp(argv[i], "--output") && i + 1 < argc) outputPath = argv[++i];
+    else if (!strcmp(argv[i], "--observations") && i + 1 < argc) observationPaths.push_back(argv[++i]);
+    else if (!strcmp(argv[i], "--survey") && i + 1 < argc) surveyPaths.push_back(argv[++i]);
+    else if (!strcmp(argv[i], "--time") && i + 1 < argc) surveyTime = (uint32_t)strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "--random") && i + 1 < argc) randomCount = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--cell") && i + 1 < argc) cellSize = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--days") && i + 1 < argc) days = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--dry") && i + 1 < argc) dry = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--horizon") && i + 1 < argc) horizonHours = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--bench")) bench = true;
+    else if (!strcmp(argv[i], "--range") && i + 1 < argc) {
+      long x0, y0, x1, y1;
+      if (sscanf(argv[++i], "%ld,%ld,%ld,%ld", &x0, &y0, &x1, &y1) != 4) {
+        printUsage();
+        return 1;
+      }
+      ranges.insert(ranges.end(), { x0, y0, x1, y1 });
+    } else if (!strcmp(argv[i], "--nearest") && i + 1 < argc) {
+      long x, y;
+      char kindName[32] = "health";
+      int fields = sscanf(argv[++i], "%ld,%ld,%31s", &x, &y, kindName);
+      int kind = parseObservationKind(kindName);
+      if (fields < 2 || kind < 0) {
+        printUsage();
+        return 1;
+      }
+      nearests.insert(nearests.end(), { x, y, (long)kind });
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (cellSize < 1) {
+    printUsage();
+    return 1;
+  }
+
+  std::string error;
+  SpatialStore store;
+  Clock::time_point start = Clock::now();
+  if (loadPath) {
+    if (!store.load(loadPath, error)) {
+      fprintf(stderr, "ERROR: %s\n", error.c_str());
+      return 1;
+    }
+    printf("Loaded %zu observations from %s in %.1f ms\n", store.size(), loadPath, millisSince(start));
+  }
+
+  std::vector<Observation> added;
+  long skipped = 0;
+  for (size_t i = 0; i < observationPaths.size(); i++) {
+    if (!loadObservations(observationPaths[i], added, skipped)) {
+      fprintf(stderr, "ERROR: cannot read %s\n", observationPaths[i]);
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < surveyPaths.size(); i++) {
+    if (!loadSurvey(surveyPaths[i], surveyTime, added, skipped)) {
+      fprintf(stderr, "ERROR: cannot read %s\n", surveyPaths[i]);
+      return 1;
+    }
+  }
+  if (randomCount > 0) randomObservations(randomCount, (uint32_t)time(NULL), added);
+
+  if (!added.empty() || !loadPath) {
+    start = Clock::now();
+    std::vector<Observation> observations;
+    store.exportObservations(observations);
+    observations.insert(observations.end(), added.begin(), added.end());
+    store.build(observations, loadPath ? store.cellSize() : cellSize);
+    printf("Indexed %zu observations (%zu new, %ld lines skipped) in %.1f ms\n", store.size(), added.size(),
+           skipped, millisSince(start));
+  }
+  printf("Grid: %d x %d cells of %ld steps\n", store.columns(), store.rows(), store.cellSize());
+
+  if (savePath) {
+    start = Clock::now();
+    if (!store.save(savePath, error)) {
+      fprintf(stderr, "ERROR: %s\n", error.c_str());
+      return 1;
+    }
+    printf("Saved %s in %.1f ms\n", savePath, millisSince(start));
+  }
+
+  uint32_t since = 0;
+  if (days > 0) {
+    uint32_t newest = newestTime(store);
+    long window = (long)(days * 86400);
+    since = newest > window ? newest - (uint32_t)window : 1;
+  }
+
+  for (size_t i = 0; i < ranges.size(); i += 4) {
+    printRange(store, ranges[i], ranges[i + 1], ranges[i + 2], ranges[i + 3], since);
+  }
+  for (size_t i = 0; i < nearests.size(); i += 3) {
+    printNearest(store, nearests[i], nearests[i + 1], (int)nearests[i + 2], since);
+  }
+
+  if (outputPath) {
+    start = Clock::now();
+    std::vector<CellDecision> decisions;
+    decideBed(store, since, dry, horizonHours, decisions);
+    double decideMs = millisSince(start);
+    long irrigate = 0;
+    for (size_t i = 0; i < decisions.size(); i++) irrigate += decisions[i].irrigate;
+    if (!writeDecisions(outputPath, store, decisions)) {
+      fprintf(stderr, "ERROR: cannot write %s\n", outputPath);
+      return 1;
+    }
+    printf("%ld of %zu cells need water (decided in %.2f ms), report written to %s\n", irrigate, decisions.size(),
+           decideMs, outputPath);
+  }
+
+  if (bench) runBenchmark(store, since, dry, horizonHours);
+  return 0;
+}
@@ -0,0 +1,438 @@
+/**
+ * bed_mosaic.cpp
+ *
+ * Scores a whole bed: survey frames are stitched into one mosaic by the
+ * gantry position they were taken at, and the lettuce classifier runs on
+ * overlapping tiles of the mosaic, giving a health heatmap.
+ *
+ * Usage:
+ *   bed_mosaic <model.lcnn> <image dir | list.txt> --footprint W[,H]
+ *              [--manifest positions.csv] [--resolution STEPS] [--stride PX]
+ *              [--min-coverage F] [--threads N] [--batch B] [--int8]
+ *              [--output heatmap.csv] [--pgm heatmap.pgm] [--mosaic mosaic.ppm]
+ *
+ * Positions are found like survey_classify (manifest or x<steps>/y<steps> in
+ * the file name) and give the centre of each frame; --footprint is the area
+ * one frame covers on the bed in steps (H defaults to W scaled by the frame's
+ * aspect ratio). Image columns run along +x and rows along +y. Overlapping
+ * frames are averaged.
+ *
+ * The mosaic has --resolution steps per pixel, by default footprint width /
+ * model input width, so a tile covers about one frame as in training. Tiles
+ * are the model input size (150 x 150) every --stride pixels (default half a
+ * tile), plus a last row and column flush with the mosaic edge. The mosaic is
+ * normalized to floats once, so overlapping tiles are plain row copies of
+ * shared pixels. Tiles less than --min-coverage (default 0.5) covered by
+ * frames are skipped.
+ *
+ * Outputs:
+ *   heatmap.csv   tile,x,y,score,label,confidence (same columns as
+ *                 survey_classify, x,y = tile centre in steps, so bed_map
+ *                 --survey can index it)
+ *   heatmap.pgm   one pixel per tile, 0 = skipped, 1-255 = healthy to non-healthy
+ *   mosaic.ppm    the stitched mosaic
+ */
+
+#include "CnnModel.h"
+#include "FrameList.h"
+#include "ImageKernels.h"
+#include "ImageLoader.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+#define MOSAIC_MAX_PIXELS (16L << 20)
+
+// A frame with a known position, decoded at mosaic resolution
+struct MosaicFrame {
+  std::string path;
+  long x, y;        // Centre in steps
+  long left, top;   // Placement in mosaic pixels
+  RgbImage image;
+  std::string error;
+};
+
+struct Mosaic {
+  int width, height;
+  long originX, originY;  // Bed position of pixel (0, 0) in steps
+  double resolution;      // Steps per pixel
+  std::vector<uint8_t> pixels;    // RGB
+  std::vector<uint8_t> covered;   // 1 where at least one frame contributes
+  std::vector<float> normalized;  // pixels / 255, the model input
+};
+
+// One tile of the model input size at a mosaic offset
+struct Tile {
+  int column, row;
+  int left, top;
+  float coverage;
+  float score;  // -1 = skipped
+};
+
+static double millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Run work(first, last) on contiguous ranges of [0, count) across threads
+ */
+template <typename Work> static void parallelFor(int threads, long count, Work work) {
+  std::vector<std::thread> workers;
+  long chunk = (count + threads - 1) / threads;
+  for (long first = 0; first < count; first += chunk) {
+    long last = std::min(count, first + chunk);
+    workers.emplace_back([=] { work(first, last); });
+  }
+  for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+/**
+ * Offsets of tiles along one axis: every stride, plus one flush with the end
+ */
+static std::vector<int> tileOffsets(int length, int tile, int stride) {
+  std::vector<int> offsets;
+  for (int offset = 0; offset + tile <= length; offset += stride) offsets.push_back(offset);
+  if (offsets.empty() || offsets.back() + tile < length) offsets.push_back(std::max(0, length - tile));
+  return offsets;
+}
+
+/**
+ * Average the frames into the mosaic; each thread owns a band of rows
+ */
+static void placeFrames(const std::vector<MosaicFrame> &frames, Mosaic &mosaic, int threads) {
+  size_t pixelCount = (size_t)mosaic.width * mosaic.height;
+  mosaic.pixels.assign(pixelCount * 3, 0);
+  mosaic.covered.assign(pixelCount, 0);
+  parallelFor(threads, mosaic.height, [&](long firstRow, long lastRow) {
+    std::vector<uint32_t> sums((size_t)mosaic.width * 3);
+    std::vector<uint16_t> counts(mosaic.width);
+    for (long row = firstRow; row < lastRow; row++) {
+      std::fill(sums.begin(), sums.end(), 0);
+      std::fill(counts.begin(), counts.end(), 0);
+      for (size_t f = 0; f < frames.size(); f++) {
+        const MosaicFrame &frame = frames[f];
+        long frameRow = row - frame.top;
+        if (frame.image.pixels.empty() || frameRow < 0 || frameRow >= frame.image.height) continue;
+        long first = std::max(0L, -frame.left);
+        long last = std::min((long)frame.image.width, mosaic.width - frame.left);
+        const uint8_t *source = &frame.image.pixels[(size_t)frameRow * frame.image.width * 3];
+        for (long column = first; column < last; column++) {
+          long at = frame.left + column;
+          sums[at * 3] += source[column * 3];
+          sums[at * 3 + 1] += source[column * 3 + 1];
+          sums[at * 3 + 2] += source[column * 3 + 2];
+          counts[at]++;
+        }
+      }
+      uint8_t *out = &mosaic.pixels[(size_t)row * mosaic.width * 3];
+      for (int column = 0; column < mosaic.width; column++) {
+        if (!counts[column]) continue;
+        for (int c = 0; c < 3; c++) out[column * 3 + c] = (uint8_t)((sums[column * 3 + c] + counts[column] / 2) / counts[column]);
+        mosaic.covered[(size_t)row * mosaic.width + column] = 1;
+      }
+    }
+  });
+}
+
+/**
+ * Fraction of each tile covered by frames, from a summed-area table
+ */
+static void measureCoverage(const Mosaic &mosaic, int tileSize, std::vector<Tile> &tiles) {
+  int stride = mosaic.width + 1;
+  std::vector<uint32_t> area((size_t)stride * (mosaic.height + 1), 0);
+  for (int row = 0; row < mosaic.height; row++) {
+    uint32_t rowSum = 0;
+    for (int column = 0; column < mosaic.width; column++) {
+      rowSum += mosaic.covered[(size_t)row * mosaic.width + column];
+      area[(size_t)(row + 1) * stride + column + 1] = area[(size_t)row * stride + column + 1] + rowSum;
+    }
+  }
+  for (size_t i = 0; i < tiles.size(); i++) {
+    Tile &tile = tiles[i];
+    int right = std::min(mosaic.width, tile.left + tileSize);
+    int bottom = std::min(mosaic.height, tile.top + tileSize);
+    uint32_t inside = area[(size_t)bottom * stride + right] - area[(size_t)tile.top * stride + right] -
+                      area[(size_t)bottom * stride + tile.left] + area[(size_t)tile.top * stride + tile.left];
+    tile.coverage = inside / (float)(tileSize * tileSize);
+  }
+}
+
+static bool writePpm(const char *path, const Mosaic &mosaic) {
+  FILE *file = fopen(path, "wb");
+  if (!file) return false;
+  fprintf(file, "P6\n%d %d\n255\n", mosaic.width, mosaic.height);
+  bool ok = fwrite(mosaic.pixels.data(), 1, mosaic.pixels.size(), file) == mosaic.pixels.size();
+  return fclose(file) == 0 && ok;
+}
+
+static bool writeHeatmapPgm(const char *path, const std::vector<Tile> &tiles, int columns, int rows) {
+  std::vector<uint8_t> pixels((size_t)columns * rows, 0);
+  for (size_t i = 0; i < tiles.size(); i++) {
+    if (tiles[i].score >= 0) pixels[(size_t)tiles[i].row * columns + tiles[i].column] = (uint8_t)(1 + lroundf(tiles[i].score * 254));
+  }
+  FILE *file = fopen(path, "wb");
+  if (!file) return false;
+  fprintf(file, "P5\n%d %d\n255\n", columns, rows);
+  bool ok = fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+  return fclose(file) == 0 && ok;
+}
+
+static void printUsage() {
+  printf("Usage: bed_mosaic <model.lcnn> <image dir | list.txt> --footprint W[,H]\n");
+  printf("                  [--manifest positions.csv] [--resolution STEPS] [--stride PX]\n");
+  printf("                  [--min-coverage F] [--threads N] [--batch B] [--int8]\n");
+  printf("                  [--output heatmap.csv] [--pgm heatmap.pgm] [--mosaic mosaic.ppm]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+
+  const char *modelPath = argv[1];
+  const char *source = argv[2];
+  const char *outputPath = "bed_heatmap.csv";
+  const char *pgmPath = NULL;
+  const char *mosaicPath = NULL;
+  const char *manifestPath = NULL;
+  double footprintWidth = 0;
+  double footprintHeight = 0;
+  double resolution = 0;
+  int stride = 0;
+  float minCoverage = 0.5f;
+  int threads = (int)std::thread::hardware_concurrency();
+  int batch = 8;
+  CnnPrecision precision = CNN_FP32;
+
+  for (int i = 3; i < argc; i++) {
+    if (!strcmp(argv[i], "--footprint") && i + 1 < argc) {
+      if (sscanf(argv[++i], "%lf,%lf", &footprintWidth, &footprintHeight) < 1) footprintWidth = 0;
+    }
+    else if (!strcmp(argv[i], "--manifest") && i + 1 < argc) manifestPath = argv[++i];
+    else if (!strcmp(argv[i], "--resolution") && i + 1 < argc) resolution = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--stride") && i + 1 < argc) stride = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--min-coverage") && i + 1 < argc) minCoverage = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--batch") && i + 1 < argc) batch = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--int8")) precision = CNN_INT8;
+    else if (!strcmp(argv[i], "--output") && i + 1 < argc) outputPath = argv[++i];
+    else if (!strcmp(argv[i], "--pgm") && i + 1 < argc) pgmPath = argv[++i];
+    else if (!strcmp(argv[i], "--mosaic") && i + 1 < argc) mosaicPath = argv[++i];
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (footprintWidth <= 0) {
+    printUsage();
+    return 1;
+  }
+  if (threads < 1) threads = 1;
+  if (batch < 1) batch = 1;
+
+  CnnModel model;
+  std::string error;
+  if (!loadCnnModel(modelPath, model, error)) {
+    fprintf(stderr, "ERROR: %s\n", error.c_str());
+    return 1;
+  }
+  if (precision == CNN_INT8 && !model.hasInt8) quantizeCnnModel(model);
+  if (precision == CNN_FP32 && !model.hasFp32) {
+    fprintf(stderr, "ERROR: model only has int8 weights, use --int8\n");
+    return 1;
+  }
+  const int tileSize = model.inputW;
+  if (model.inputH != tileSize || model.inputC != 3) {
+    fprintf(stderr, "ERROR: bed_mosaic needs a square RGB model input\n");
+    return 1;
+  }
+  if (resolution <= 0) resolution = footprintWidth / tileSize;
+  if (stride < 1) stride = std::max(1, tileSize / 2);
+
+  std::vector<std::string> paths;
+  if (!listFrames(source, paths)) {
+    fprintf(stderr, "ERROR: cannot read %s\n", source);
+    return 1;
+  }
+  std::map<std::string, std::string> manifest;
+  if (manifestPath && !loadManifest(manifestPath, manifest)) {
+    fprintf(stderr, "ERROR: cannot read manifest %s\n", manifestPath);
+    return 1;
+  }
+  std::vector<MosaicFrame> frames;
+  for (size_t i = 0; i < paths.size(); i++) {
+    MosaicFrame frame;
+    frame.path = paths[i];
+    if (sscanf(framePosition(manifest, paths[i]).c_str(), "%ld,%ld", &frame.x, &frame.y) != 2) {
+      fprintf(stderr, "WARNING: %s: no position, skipped\n", baseName(paths[i]).c_str());
+      continue;
+    }
+    frames.push_back(frame);
+  }
+  if (frames.empty()) {
+    fprintf(stderr, "ERROR: no frames with a position\n");
+    return 1;
+  }
+
+  // Stage 1: decode every frame at its size in the mosaic
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> nextFrame(0);
+  std::vector<std::thread> decoders;
+  for (int w = 0; w < threads; w++) {
+    decoders.emplace_back([&] {
+      RgbImage decoded;
+      size_t i;
+      while ((i = nextFrame++) < frames.size()) {
+        MosaicFrame &frame = frames[i];
+        int width = std::max(1, (int)lround(footprintWidth / resolution));
+        int height = footprintHeight > 0 ? std::max(1, (int)lround(footprintHeight / resolution)) : 0;
+        if (!decodeJpeg(frame.path.c_str(), decoded, frame.error, width, height)) continue;
+        if (height == 0) height = std::max(1, (int)lround((double)width * decoded.height / decoded.width));
+        resizeRgb(decoded, frame.image, width, height);
+      }
+    });
+  }
+  for (size_t i = 0; i < decoders.size(); i++) decoders[i].join();
+
+  // Mosaic extent from the frame footprints
+  long minX = 0, minY = 0, maxX = 0, maxY = 0;
+  bool any = false;
+  for (size_t i = 0; i < frames.size(); i++) {
+    MosaicFrame &frame = frames[i];
+    if (frame.image.pixels.empty()) {
+      fprintf(stderr, "WARNING: %s\n", frame.error.c_str());
+      continue;
+    }
+    long halfWidth = (long)(frame.image.width * resolution / 2);
+    long halfHeight = (long)(frame.image.height * resolution / 2);
+    if (!any || frame.x - halfWidth < minX) minX = frame.x - halfWidth;
+    if (!any || frame.y - halfHeight < minY) minY = frame.y - halfHeight;
+    if (!any || frame.x + halfWidth > maxX) maxX = frame.x + halfWidth;
+    if (!any || frame.y + halfHeight > maxY) maxY = frame.y + halfHeight;
+    any = true;
+  }
+  if (!any) {
+    fprintf(stderr, "ERROR: no frame could be decoded\n");
+    return 1;
+  }
+
+  Mosaic mosaic;
+  mosaic.resolution = resolution;
+  mosaic.originX = minX;
+  mosaic.originY = minY;
+  mosaic.width = std::max(tileSize, (int)ceil((maxX - minX) / resolution) + 1);
+  mosaic.height = std::max(tileSize, (int)ceil((maxY - minY) / resolution) + 1);
+  if ((long)mosaic.width * mosaic.height > MOSAIC_MAX_PIXELS) {
+    fprintf(stderr, "ERROR: mosaic of %d x %d pixels is too large, raise --resolution\n", mosaic.width, mosaic.height);
+    return 1;
+  }
+  for (size_t i = 0; i < frames.size(); i++) {
+    MosaicFrame &frame = frames[i];
+    frame.left = lround((frame.x - minX) / resolution - frame.image.width / 2.0);
+    frame.top = lround((frame.y - minY) / resolution - frame.image.height / 2.0);
+  }
+  placeFrames(frames, mosaic, threads);
+  frames = std::vector<MosaicFrame>();  // Release the decoded frames
+  double placeMs = millisSince(start);
+
+  // Stage 2: normalize once; every tile reads from here
+  start = std::chrono::steady_clock::now();
+  mosaic.normalized.resize(mosaic.pixels.size());
+  long rowBytes = (long)mosaic.width * 3;
+  parallelFor(threads, mosaic.height, [&](long first, long last) {
+    normalizeU8ToF32(&mosaic.pixels[first * rowBytes], &mosaic.normalized[first * rowBytes], (last - first) * rowBytes,
+                     1.0f / 255.0f);
+  });
+
+  std::vector<int> columnOffsets = tileOffsets(mosaic.width, tileSize, stride);
+  std::vector<int> rowOffsets = tileOffsets(mosaic.height, tileSize, stride);
+  std::vector<Tile> tiles;
+  for (size_t r = 0; r < rowOffsets.size(); r++) {
+    for (size_t c = 0; c < columnOffsets.size(); c++) {
+      Tile tile = { (int)c, (int)r, columnOffsets[c], rowOffsets[r], 0.0f, -1.0f };
+      tiles.push_back(tile);
+    }
+  }
+  measureCoverage(mosaic, tileSize, tiles);
+  std::vector<size_t> scored;
+  for (size_t i = 0; i < tiles.size(); i++) {
+    if (tiles[i].coverage >= minCoverage) scored.push_back(i);
+  }
+  double normalizeMs = millisSince(start);
+
+  // Stage 3: batched inference, one workspace per worker
+  printf("Mosaic %d x %d px at %.1f steps/px, %zu of %zu tiles covered, %d workers, batch %d (%s)\n",
+         mosaic.width, mosaic.height, resolution, scored.size(), tiles.size(), threads, batch,
+         precision == CNN_INT8 ? "int8" : "fp32");
+  start = std::chrono::steady_clock::now();
+  const long inputSize = cnnInputSize(model);
+  std::atomic<size_t> nextTile(0);
+  std::vector<std::thread> inferrers;
+  for (int w = 0; w < threads; w++) {
+    inferrers.emplace_back([&] {
+      CnnWorkspace workspace;
+      initCnnWorkspace(model, workspace, batch);
+      std::vector<float> images((size_t)inputSize * batch);
+      std::vector<float> scores(batch);
+      while (true) {
+        size_t first = nextTile.fetch_add(batch);
+        if (first >= scored.size()) break;
+        int count = (int)std::min((size_t)batch, scored.size() - first);
+        for (int b = 0; b < count; b++) {
+          const Tile &tile = tiles[scored[first + b]];
+          float *out = &images[(size_t)b * inputSize];
+          for (int row = 0; row < tileSize; row++) {
+            const float *in = &mosaic.normalized[((size_t)(tile.top + row) * mosaic.width + tile.left) * 3];
+            std::copy(in, in + tileSize * 3, out + (size_t)row * tileSize * 3);
+          }
+        }
+        runCnnBatch(model, workspace, images.data(), count, precision, scores.data());
+        for (int b = 0; b < count; b++) tiles[scored[first + b]].score = scores[b];
+      }
+    });
+  }
+  for (size_t i = 0; i < inferrers.size(); i++) inferrers[i].join();
+  double inferMs = millisSince(start);
+
+  FILE *output = fopen(outputPath, "w");
+  if (!output) {
+    fprintf(stderr, "ERROR: cannot create %s\n", outputPath);
+    return 1;
+  }
+  fprintf(output, "tile,x,y,score,label,confidence\n");
+  long unhealthy = 0;
+  for (size_t i = 0; i < scored.size(); i++) {
+    const Tile &tile = tiles[scored[i]];
+    long x = lround(mosaic.originX + (tile.left + tileSize / 2.0) * resolution);
+    long y = lround(mosaic.originY + (tile.top + tileSize / 2.0) * resolution);
+    bool sick = tile.score > 0.5f;
+    unhealthy += sick;
+    fprintf(output, "r%dc%d,%ld,%ld,%.6f,%s,%.2f\n", tile.row, tile.column, x, y, tile.score,
+            sick ? "Non-Healthy" : "Healthy", (sick ? tile.score : 1.0f - tile.score) * 100.0f);
+  }
+  fclose(output);
+  if (pgmPath && !writeHeatmapPgm(pgmPath, tiles, (int)columnOffsets.size(), (int)rowOffsets.size())) {
+    fprintf(stderr, "ERROR: cannot write %s\n", pgmPath);
+    return 1;
+  }
+  if (mosaicPath && !writePpm(mosaicPath, mosaic)) {
+    fprintf(stderr, "ERROR: cannot write %s\n", mosaicPath);
+    return 1;
+  }
+
+  printf("\n----- BED SUMMARY -----\n");
+  printf("Tiles scored: %zu, %ld Non-Healthy\n", scored.size(), unhealthy);
+  printf("Decode + stitch: %.1f ms, normalize + tiling: %.1f ms, inference: %.1f ms (%.1f tiles/s)\n",
+         placeMs, normalizeMs, inferMs, scored.size() / (inferMs / 1000.0));
+  printf("Heatmap written to %s\n", outputPath);
+  return 0;
+}
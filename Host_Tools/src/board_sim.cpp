@@ -0,0 +1,1349 @@
+/**
+ * board_sim.cpp
+ *
+ * Simulated X-axis controller boards on pseudo terminals, for running
+ * farmbotd and client scripts on a Linux PC without hardware.
+ *
+ * Usage:
+ *   board_sim [--boards N] [--link /tmp/farmbot-sim] [--axis STEPS] [--speed F]
+ *
+ * Prints one pty path per board (and creates <link>0, <link>1, ... symlinks
+ * when --link is given). Each board replies with the same text as the firmware
+ * in Farm-Bot/lib/Motors_X and takes as long as the real motion would:
+ *   - step timing follows moveSteps() (1/4 accelerate, 1/4 decelerate)
+ *   - moves are clamped to BACKOFF_STEPS from either limit like processRelativeMove()
+ *   - a physical axis of --axis steps with limit switches at both ends
+ *   - commands are only read between motions, like loop()
+ *   - the 64-byte receive buffer drops bytes when full (reported as overflows)
+ *   - T/TF/TD record and dump motion traces of X moves (homing is not traced);
+ *     the encoder follows the step position with a 1 ms lag
+ *   - A auto-tunes against a motor that stalls below SIM_STALL_STEP_DELAY or
+ *     above SIM_STALL_ACCEL_RATE; the profile is kept until the process exits
+ *   - realtime bytes are acted on as they arrive, like the HostSerial receive
+ *     interrupt: Ctrl-X stops an X move at the next step and latches the
+ *     emergency stop until C; ! holds an X move (decelerate, wait) and ~
+ *     resumes it. A stop during H or A ends it where it is, but the position
+ *     is left at the end of the command and traces are not cut short.
+ *   - D/DS/DR/DC/DI log synthetic moisture and TDS readings every DI seconds
+ *     (scaled by --speed) in the firmware's block format; a reset keeps only
+ *     the blocks that were spilled to EEPROM
+ * --speed 10 runs motions ten times faster than real time.
+ * SIGUSR1 resets every board (prints the banner again); SIGINT prints counters.
+ */
+
+#include "SerialPort.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Firmware constants from Farm-Bot/lib/Motors_X/Config.h
+#define MIN_STEP_DELAY 200
+#define MAX_STEP_DELAY 1000
+#define ACCEL_RATE 5
+#define DECEL_RATE 10
+#define BACKOFF_STEPS 1600
+#define MAX_TRAVEL 10000000
+#define COMMAND_MAX_LENGTH 32
+#define RX_BUFFER_BYTES 63  // HostSerial keeps one slot of its 64-byte ring free
+#define REALTIME_STOP 0x18
+#define REALTIME_HOLD '!'
+#define REALTIME_RESUME '~'
+#define AUTOTUNE_TEST_STEPS 6000
+#define AUTOTUNE_START_STEP_DELAY 500
+#define AUTOTUNE_FLOOR_STEP_DELAY 60
+#define AUTOTUNE_SPEED_STEP_PERCENT 10
+#define AUTOTUNE_MAX_ACCEL_RATE 100
+#define AUTOTUNE_SAFETY_MARGIN_PERCENT 20
+#define TRACE_BUFFER_SAMPLES 160
+#define TRACE_DEFAULT_DECIMATION 8
+#define TRACE_POST_TRIGGER_SAMPLES 48
+#define TRACE_TIME_UNIT_US 4
+#define ENCODER_LAG_MICROS 1000.0
+#define SIM_STALL_STEP_DELAY 130    // The simulated motor loses steps below this delay
+#define SIM_STALL_ACCEL_RATE 16     // ... or when accelerating faster than this
+#define SIM_COUNTS_PER_STEP_X256 384
+#define SENSOR_LOG_INTERVAL_S 10
+#define SENSOR_LOG_RAM_BLOCKS 16
+#define SENSOR_LOG_EEPROM_BLOCKS 63
+#define SENSOR_LOG_BLOCK_BYTES 64
+#define SENSOR_LOG_DATA_BYTES (SENSOR_LOG_BLOCK_BYTES - 9)
+#define SENSOR_CHANNELS 2
+#define SENSOR_BLOCK_BOOT 0x01
+#define SENSOR_LOG_VERSION 2
+#define SENSOR_LOG_CRC_SEED 0x5A
+
+// MotionTrace.h recorder states, trigger reasons and flags
+enum { TRACE_OFF, TRACE_ARMED, TRACE_RECORDING, TRACE_DONE };
+enum { TRACE_TRIGGER_NONE, TRACE_TRIGGER_COMMAND, TRACE_TRIGGER_LIMIT, TRACE_TRIGGER_ESTOP };
+#define MOTION_FLAG_MOVING 0x02
+#define TRACE_FLAG_FORWARD 0x04
+#define TRACE_FLAG_LIMIT 0x08
+#define TRACE_FLAG_PHASE_SHIFT 4
+#define TRACE_FLAG_MOVE_START 0x40
+#define TRACE_FLAG_REBASE 0x80
+
+typedef std::chrono::steady_clock::time_point SimTime;
+
+// Text the firmware will print at a given time
+struct TimedOutput {
+  SimTime at;
+  std::string text;
+};
+
+// Firmware SpeedProfile
+struct SimProfile {
+  long minStepDelay;
+  long maxStepDelay;
+  long accelRate;
+  long decelRate;
+};
+
+static const SimProfile DEFAULT_PROFILE = { MIN_STEP_DELAY, MAX_STEP_DELAY, ACCEL_RATE, DECEL_RATE };
+
+struct SimTraceSample {
+  unsigned dt;
+  long stepDelta;
+  long encoderDelta;
+  unsigned flags;
+};
+
+// Firmware MotionTrace.cpp state
+struct SimTrace {
+  int state;
+  bool faultMode;
+  int decimation;
+  int countdown;
+  std::deque<SimTraceSample> samples;
+  int trigger;
+  long recorded;
+  long triggerRecord;
+  int postRemaining;
+  long basePosition, baseEncoder;
+  long lastPosition, lastEncoder;
+  double lastMicros;
+  unsigned moveFlags;
+};
+
+// Firmware SensorLogBlock
+struct SimSensorBlock {
+  unsigned sequence;
+  unsigned long startTick;
+  unsigned flags;
+  std::string data;
+};
+
+// Firmware SensorLog.cpp state; the newest SENSOR_LOG_RAM_BLOCKS blocks are in "RAM"
+struct SimSensorLog {
+  std::deque<SimSensorBlock> blocks;
+  unsigned nextSequence, bootSequence;
+  bool bootBlock;
+  SimTime boot;
+  unsigned long lastLogTick;
+  unsigned long previousTick;
+  long previousValue[SENSOR_CHANNELS];
+  long intervalTicks;
+};
+
+// An X move whose steps are being issued (processRelativeMove() -> moveSteps())
+struct SimMove {
+  bool active;
+  SimTime start;
+  SimTime stepsEnd;   // Last step, or the limit switch
+  long totalSteps;    // Steps the profile is planned for
+  long steps;         // Steps before the move ends or hits a limit
+  int direction;
+  long startCounter, startPhysical, startMaxPosition;
+};
+
+struct SimBoard {
+  int master;
+  int slave;  // Held open so the pty survives clients reopening it
+  std::string path;
+
+  std::string rx;      // Firmware receive buffer
+  std::string output;  // Bytes waiting for the pty
+  std::deque<TimedOutput> scheduled;
+
+  long physical;  // Carriage position in steps from the home switch
+  long counter;   // Firmware currentPosition
+  long maxPosition;
+
+  SimProfile profile;
+  bool profileStored;  // Auto-tuned ("EEPROM") rather than Config.h
+  SimTrace trace;
+  SimSensorLog sensors;
+
+  char running;        // Letter of the command whose output is scheduled
+  bool estop;          // MOTION_FLAG_ESTOP, latched until C
+  SimMove move;
+  bool held;           // In a feed hold (decelerating or at rest)
+  long heldRemaining;
+  SimTime restAt;
+  double holdMicros;   // Step loop state when the hold byte was noticed
+  long holdSteps, holdDelay;
+
+  long commands;
+  long overflowBytes;
+};
+
+static volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t resetRequested = 0;
+
+static void handleStop(int) {
+  running = 0;
+}
+
+static void handleReset(int) {
+  resetRequested = 1;
+}
+
+static double speedFactor = 1.0;
+static long axisSteps = 40000;
+
+/**
+ * Follow runProfile() step by step up to the first interrupt check at or
+ * after a given time
+ *
+ * @param stopAt Microseconds into the move
+ * @param steps Receives the steps taken before that check
+ * @param delay Receives the delay the next step would use
+ * @return Microseconds into the move of that check, or the move's duration
+ *         if it finishes first
+ */
+static double walkMove(const SimProfile &profile, long totalSteps, double stopAt, long &steps, long &delay) {
+  long accelerationSteps = totalSteps / 4;
+  long decelerationSteps = totalSteps / 4;
+  long constantSteps = totalSteps - accelerationSteps - decelerationSteps;
+  if (accelerationSteps < 10) accelerationSteps = 10;
+  if (decelerationSteps < 10) decelerationSteps = 10;
+  if (accelerationSteps + decelerationSteps > totalSteps) {
+    accelerationSteps = totalSteps / 2;
+    decelerationSteps = totalSteps - accelerationSteps;
+    constantSteps = 0;
+  }
+
+  double micros = 0;
+  steps = 0;
+  delay = profile.maxStepDelay;
+  const long phaseSteps[3] = { accelerationSteps, constantSteps, decelerationSteps };
+  for (int phase = 0; phase < 3; phase++) {
+    for (long i = 0; i < phaseSteps[phase]; i++) {
+      if (micros >= stopAt) return micros;
+      micros += delay;
+      steps++;
+      if (phase == 0 && delay > profile.minStepDelay) {
+        delay -= profile.accelRate;
+        if (delay < profile.minStepDelay) delay = profile.minStepDelay;
+      } else if (phase == 2 && delay < profile.maxStepDelay) {
+        delay += profile.decelRate;
+        if (delay > profile.maxStepDelay) delay = profile.maxStepDelay;
+      }
+    }
+  }
+  return micros;
+}
+
+/**
+ * Duration of moveSteps() in microseconds for a given step count and profile
+ */
+static double moveMicros(const SimProfile &profile, long totalSteps) {
+  long steps, delay;
+  return walkMove(profile, totalSteps, HUGE_VAL, steps, delay);
+}
+
+static SimTime later(SimTime from, double micros) {
+  return from + std::chrono::microseconds((long)(micros / speedFactor));
+}
+
+/**
+ * Simulated firmware microseconds between two times
+ */
+static double microsBetween(SimTime from, SimTime to) {
+  return (double)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count() * speedFactor;
+}
+
+static void say(SimBoard &board, SimTime at, const std::string &text) {
+  TimedOutput line;
+  line.at = at;
+  line.text = text + "\r\n";
+  board.scheduled.push_back(line);
+}
+
+static int percentOf(const SimBoard &board) {
+  if (board.maxPosition <= 0) return 0;
+  long percent = (long)((long long)board.counter * 100 / board.maxPosition);
+  if (percent < 0) percent = 0;
+  if (percent > 100) percent = 100;
+  return (int)percent;
+}
+
+static void printBanner(SimBoard &board, SimTime now) {
+  say(board, now, "");
+  say(board, now, "----- FarmBot X-Axis Controller (Simple) -----");
+  say(board, now, "System Ready. Available commands:");
+  say(board, now, "  X#### or X-#### - Move relative steps (e.g., X1000)");
+  say(board, now, "  H - Run homing sequence");
+  say(board, now, "  R - Report current position");
+  say(board, now, "  A - Auto-tune speed profile (A, AP, AR)");
+  say(board, now, "  T - Motion trace (T, TF, TD, TO, TN#, TS)");
+  say(board, now, "  D - Sensor log (D, DS, DR, DC, DI#)");
+  say(board, now, "  C - Clear emergency stop");
+  say(board, now, "  Ctrl-X / ! / ~ - Stop / feed hold / resume, also during moves");
+  say(board, now, "  S - Stop movement immediately");
+  say(board, now, "-------------------------------------");
+  say(board, now, "IMPORTANT: Please run homing (H) after power-up to establish position reference.");
+}
+
+/**
+ * initializeSensorLog() after a reset: the blocks still in RAM are lost
+ */
+static void resetSensorLog(SimSensorLog &log, SimTime now) {
+  size_t lost = std::min(log.blocks.size(), (size_t)SENSOR_LOG_RAM_BLOCKS);
+  log.blocks.resize(log.blocks.size() - lost);
+  log.bootSequence = log.nextSequence;
+  log.bootBlock = true;
+  log.boot = now;
+  log.lastLogTick = 0;
+  log.intervalTicks = SENSOR_LOG_INTERVAL_S;
+}
+
+static void resetBoard(SimBoard &board, SimTime now) {
+  board.rx.clear();
+  board.scheduled.clear();
+  board.counter = 0;
+  board.maxPosition = MAX_TRAVEL;
+  board.running = 0;
+  board.estop = false;
+  board.move.active = false;
+  board.held = false;
+  resetSensorLog(board.sensors, now);
+  printBanner(board, later(now, 1500000));  // Bootloader delay
+}
+
+/**
+ * backOffFromLimit(): BACKOFF_STEPS at the slowest speed
+ */
+static SimTime backOff(SimBoard &board, SimTime at, int direction) {
+  say(board, at, "Backing off from limit...");
+  board.physical += direction * BACKOFF_STEPS;
+  board.counter += direction * BACKOFF_STEPS;
+  at = later(at, (double)BACKOFF_STEPS * MAX_STEP_DELAY);
+  say(board, at, "Backed off from limit");
+  return at;
+}
+
+// -------------------- MOTION TRACE --------------------
+
+/**
+ * traceRecord(): one sample of the step position and the lagging encoder
+ */
+static void traceRecord(SimTrace &trace, double micros, long position, long encoder, unsigned flags) {
+  if (trace.state != TRACE_RECORDING) {
+    trace.countdown = 0;
+    return;
+  }
+  long units = (long)((micros - trace.lastMicros) / TRACE_TIME_UNIT_US);
+  trace.lastMicros += units * TRACE_TIME_UNIT_US;
+  if (trace.samples.size() == TRACE_BUFFER_SAMPLES) {
+    trace.basePosition += trace.samples.front().stepDelta;
+    trace.baseEncoder += trace.samples.front().encoderDelta;
+    trace.samples.pop_front();
+  }
+  SimTraceSample sample;
+  sample.dt = units > 0xFFFF ? 0xFFFF : (unsigned)units;
+  sample.stepDelta = position - trace.lastPosition;
+  sample.encoderDelta = encoder - trace.lastEncoder;
+  sample.flags = MOTION_FLAG_MOVING | trace.moveFlags | flags;
+  trace.samples.push_back(sample);
+  trace.lastPosition = position;
+  trace.lastEncoder = encoder;
+  trace.recorded++;
+  trace.countdown = trace.decimation;
+  if (trace.postRemaining && --trace.postRemaining == 0) {
+    trace.state = TRACE_DONE;
+    trace.countdown = 0;
+  } else if (!trace.faultMode && trace.samples.size() == TRACE_BUFFER_SAMPLES) {
+    trace.state = TRACE_DONE;
+    trace.countdown = 0;
+  }
+}
+
+/**
+ * Trace a relative move the way moveSteps() and backOffFromLimit() step it
+ *
+ * @param steps Steps actually taken before the move ends or hits a limit
+ * @param limitHit TRUE if a limit switch stops the move after those steps
+ */
+static void traceMove(SimBoard &board, long totalSteps, long steps, int direction, bool limitHit) {
+  SimTrace &trace = board.trace;
+  const SimProfile &profile = board.profile;
+  unsigned pending = 0;  // Flags for the next sample
+  if (trace.state == TRACE_ARMED) {
+    trace.basePosition = trace.lastPosition = board.counter;
+    trace.baseEncoder = trace.lastEncoder = board.physical;
+    trace.state = TRACE_RECORDING;
+  } else if (trace.state != TRACE_RECORDING) {
+    return;
+  } else if (trace.lastPosition != board.counter) {
+    // Homing moved the axis without being traced
+    trace.lastPosition = board.counter;
+    trace.lastEncoder = board.physical;
+    pending = TRACE_FLAG_REBASE;
+  }
+
+  long accelerationSteps = totalSteps / 4;
+  long decelerationSteps = totalSteps / 4;
+  if (accelerationSteps < 10) accelerationSteps = 10;
+  if (decelerationSteps < 10) decelerationSteps = 10;
+  if (accelerationSteps + decelerationSteps > totalSteps) {
+    accelerationSteps = totalSteps / 2;
+    decelerationSteps = totalSteps - accelerationSteps;
+  }
+
+  // The encoder reads the carriage position ENCODER_LAG_MICROS ago
+  std::deque<std::pair<double, long> > history;
+  double micros = 0;
+  long position = board.counter;
+  long physical = board.physical;
+  long encoder = physical;
+  long delay = profile.maxStepDelay;
+  trace.lastMicros = 0;
+  trace.moveFlags = (direction > 0 ? TRACE_FLAG_FORWARD : 0) | (1 << TRACE_FLAG_PHASE_SHIFT);
+  traceRecord(trace, micros, position, encoder, TRACE_FLAG_MOVE_START | pending);
+  pending = 0;
+
+  long total = steps + (limitHit ? BACKOFF_STEPS : 0);
+  for (long i = 0; i < total; i++) {
+    bool backingOff = i >= steps;
+    int stepDirection = backingOff ? -direction : direction;
+    unsigned phase;
+    if (backingOff) {
+      if (i == steps) {
+        // checkLimitSwitch(): fault, then the home switch re-zeroes the counter
+        trace.trigger = TRACE_TRIGGER_LIMIT;
+        trace.triggerRecord = trace.recorded;
+        traceRecord(trace, micros, position, encoder, TRACE_FLAG_LIMIT);
+        if (trace.faultMode && trace.state == TRACE_RECORDING) trace.postRemaining = TRACE_POST_TRIGGER_SAMPLES;
+        if (direction < 0) {
+          position = 0;
+          trace.lastPosition = 0;
+          pending = TRACE_FLAG_REBASE;
+        }
+      }
+      delay = MAX_STEP_DELAY;  // backOffFromLimit() ignores the profile
+      phase = 0;
+    } else if (i < accelerationSteps) {
+      phase = 1;
+    } else if (i < totalSteps - decelerationSteps) {
+      phase = 2;
+    } else {
+      phase = 3;
+    }
+    trace.moveFlags = (stepDirection > 0 ? TRACE_FLAG_FORWARD : 0) | (phase << TRACE_FLAG_PHASE_SHIFT);
+
+    micros += delay;
+    position += stepDirection;
+    physical += stepDirection;
+    history.push_back(std::make_pair(micros, physical));
+    while (history.size() > 1 && history[1].first <= micros - ENCODER_LAG_MICROS) history.pop_front();
+    if (history.front().first <= micros - ENCODER_LAG_MICROS) encoder = history.front().second;
+    if (trace.countdown && --trace.countdown == 0) {
+      traceRecord(trace, micros, position, encoder, pending);
+      pending = 0;
+    }
+
+    if (phase == 1 && delay > profile.minStepDelay) {
+      delay -= profile.accelRate;
+      if (delay < profile.minStepDelay) delay = profile.minStepDelay;
+    } else if (phase == 3 && delay < profile.maxStepDelay) {
+      delay += profile.decelRate;
+      if (delay > profile.maxStepDelay) delay = profile.maxStepDelay;
+    }
+  }
+
+  // disableMotor() -> traceMoveEnd()
+  traceRecord(trace, micros, position, encoder, pending);
+  trace.countdown = 0;
+  if (!trace.faultMode) trace.state = TRACE_DONE;
+}
+
+static void putU16(std::string &out, unsigned value) {
+  out.push_back((char)(value & 0xFF));
+  out.push_back((char)((value >> 8) & 0xFF));
+}
+
+static void putU32(std::string &out, unsigned long value) {
+  putU16(out, value & 0xFFFF);
+  putU16(out, (value >> 16) & 0xFFFF);
+}
+
+static unsigned clampU16(long value) {
+  if (value > 32767) value = 32767;
+  if (value < -32768) value = -32768;
+  return (unsigned)(value & 0xFFFF);
+}
+
+/**
+ * dumpTrace(): header, samples and checksum as raw bytes
+ */
+static void dumpTrace(SimBoard &board, SimTime now) {
+  SimTrace &trace = board.trace;
+  std::string bytes = "MTRC";
+  bytes.push_back(1);
+  bytes.push_back(TRACE_TIME_UNIT_US);
+  putU16(bytes, trace.decimation);
+  putU16(bytes, trace.samples.size());
+  bytes.push_back((char)trace.trigger);
+  bytes.push_back(trace.faultMode ? 1 : 0);
+  long triggerIndex = trace.triggerRecord - (trace.recorded - (long)trace.samples.size());
+  bool triggered = trace.trigger == TRACE_TRIGGER_LIMIT || trace.trigger == TRACE_TRIGGER_ESTOP;
+  putU16(bytes, triggered && triggerIndex >= 0 && triggerIndex < (long)trace.samples.size() ? triggerIndex : 0xFFFF);
+  putU32(bytes, (unsigned long)trace.basePosition);
+  putU32(bytes, (unsigned long)trace.baseEncoder);
+  putU16(bytes, board.profile.minStepDelay);
+  putU16(bytes, board.profile.maxStepDelay);
+  putU16(bytes, board.profile.accelRate);
+  putU16(bytes, board.profile.decelRate);
+  for (size_t i = 0; i < trace.samples.size(); i++) {
+    const SimTraceSample &sample = trace.samples[i];
+    putU16(bytes, sample.dt);
+    putU16(bytes, clampU16(sample.stepDelta));
+    putU16(bytes, clampU16(sample.encoderDelta));
+    bytes.push_back((char)sample.flags);
+  }
+  unsigned sum = 0;
+  for (size_t i = 0; i < bytes.size(); i++) sum += (unsigned char)bytes[i];
+  putU16(bytes, sum & 0xFFFF);
+
+  say(board, now, "TRACE BEGIN " + std::to_string(bytes.size()));
+  TimedOutput raw;
+  raw.at = now;
+  raw.text = bytes + "\r\n";
+  board.scheduled.push_back(raw);
+  say(board, now, "TRACE END");
+}
+
+static void armTrace(SimTrace &trace, bool faultMode) {
+  trace.state = TRACE_ARMED;
+  trace.faultMode = faultMode;
+  trace.samples.clear();
+  trace.trigger = faultMode ? TRACE_TRIGGER_NONE : TRACE_TRIGGER_COMMAND;
+  trace.recorded = 0;
+  trace.triggerRecord = 0;
+  trace.postRemaining = 0;
+  trace.countdown = 0;
+}
+
+/**
+ * processTraceCommand()
+ */
+static void traceCommand(SimBoard &board, SimTime now, const std::string &args) {
+  SimTrace &trace = board.trace;
+  std::string armed = " (every " + std::to_string(trace.decimation) + " steps, " +
+                      std::to_string(TRACE_BUFFER_SAMPLES) + " samples)";
+  char option = args.empty() ? 0 : args[0];
+  if (option == 0) {
+    armTrace(trace, false);
+    say(board, now, "Trace armed for next move" + armed);
+  } else if (option == 'F') {
+    armTrace(trace, true);
+    say(board, now, "Trace armed for faults" + armed);
+  } else if (option == 'O') {
+    trace.state = TRACE_OFF;
+    say(board, now, "Trace off");
+  } else if (option == 'N') {
+    long steps = atol(args.c_str() + 1);
+    trace.decimation = (int)(steps < 1 ? 1 : steps > 1000 ? 1000 : steps);
+    say(board, now, "Trace decimation: " + std::to_string(trace.decimation));
+  } else if (option == 'S') {
+    static const char *STATES[] = { "off", "armed", "recording", "done" };
+    say(board, now, std::string("Trace state: ") + STATES[trace.state] + ", " +
+                    std::to_string(trace.samples.size()) + " samples");
+  } else if (option == 'D') {
+    if (trace.samples.empty()) say(board, now, "Trace empty");
+    else dumpTrace(board, now);
+  } else {
+    say(board, now, "Trace commands: T, TF, TO, TN<steps>, TS, TD");
+  }
+}
+
+static void putVarint(std::string &out, unsigned long value) {
+  while (value >= 0x80) {
+    out.push_back((char)((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+/**
+ * A slowly drying bed and a steady nutrient level, with ADC noise
+ */
+static long simSensorValue(int channel, unsigned long tick) {
+  long noise = rand() % 5 - 2;
+  if (channel == 0) return 420 + (long)((tick / 60) % 200) + noise;
+  return 310 + (long)(12 * sin(tick / 1800.0)) + noise;
+}
+
+/**
+ * logReading(): append to the newest block or open a keyframe block
+ */
+static void simLogReading(SimSensorLog &log, int channel, long value, unsigned long tick) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    std::string encoded;
+    long delta = value - log.previousValue[channel];
+    putVarint(encoded, ((tick - log.previousTick) << 2) | channel);
+    putVarint(encoded, ((unsigned long)delta << 1) ^ (unsigned long)(delta < 0 ? -1L : 0L));
+    if (attempt == 0 && !log.blocks.empty() &&
+        log.blocks.back().data.size() + encoded.size() <= SENSOR_LOG_DATA_BYTES) {
+      log.blocks.back().data += encoded;
+      break;
+    }
+    if (attempt == 1) {
+      log.blocks.back().data = encoded;
+      break;
+    }
+    if (log.blocks.size() == SENSOR_LOG_RAM_BLOCKS + SENSOR_LOG_EEPROM_BLOCKS) log.blocks.pop_front();
+    SimSensorBlock block;
+    block.sequence = log.nextSequence++ & 0xFFFF;
+    block.startTick = tick;
+    block.flags = log.bootBlock ? SENSOR_BLOCK_BOOT : 0;
+    log.bootBlock = false;
+    log.blocks.push_back(block);
+    log.previousTick = tick;
+    for (int i = 0; i < SENSOR_CHANNELS; i++) log.previousValue[i] = 0;
+  }
+  log.previousTick = tick;
+  log.previousValue[channel] = value;
+}
+
+/**
+ * pollSensorLog() for the time since the last command
+ */
+static unsigned long catchUpSensorLog(SimSensorLog &log, SimTime now) {
+  unsigned long tick = (unsigned long)(microsBetween(log.boot, now) / 1e6);
+  while (tick - log.lastLogTick >= (unsigned long)log.intervalTicks) {
+    log.lastLogTick += log.intervalTicks;
+    for (int channel = 0; channel < SENSOR_CHANNELS; channel++) {
+      simLogReading(log, channel, simSensorValue(channel, log.lastLogTick), log.lastLogTick);
+    }
+  }
+  return tick;
+}
+
+static unsigned char crc8Update(unsigned char crc, unsigned char data) {
+  crc ^= data;
+  for (int i = 0; i < 8; i++) crc = (crc & 0x80) ? (unsigned char)((crc << 1) ^ 0x07) : (unsigned char)(crc << 1);
+  return crc;
+}
+
+/**
+ * dumpSensorLog(): header, blocks and checksum as raw bytes
+ */
+static void dumpSensorLog(SimBoard &board, SimTime now, unsigned long tick) {
+  SimSensorLog &log = board.sensors;
+  std::string bytes = "SLOG";
+  bytes.push_back(SENSOR_LOG_VERSION);
+  bytes.push_back(SENSOR_CHANNELS);
+  putU16(bytes, 1000);
+  putU16(bytes, log.intervalTicks);
+  putU32(bytes, tick);
+  putU16(bytes, log.bootSequence & 0xFFFF);
+  putU16(bytes, SENSOR_LOG_BLOCK_BYTES);
+  putU16(bytes, log.blocks.size());
+  for (size_t i = 0; i < log.blocks.size(); i++) {
+    const SimSensorBlock &block = log.blocks[i];
+    std::string record;
+    putU16(record, block.sequence);
+    putU32(record, block.startTick);
+    record.push_back((char)block.flags);
+    record.push_back((char)block.data.size());
+    unsigned char crc = SENSOR_LOG_CRC_SEED;
+    for (size_t j = 0; j < record.size(); j++) crc = crc8Update(crc, (unsigned char)record[j]);
+    for (size_t j = 0; j < block.data.size(); j++) crc = crc8Update(crc, (unsigned char)block.data[j]);
+    record.push_back((char)crc);
+    record += block.data;
+    record.resize(SENSOR_LOG_BLOCK_BYTES, '\0');
+    bytes += record;
+  }
+  unsigned sum = 0;
+  for (size_t i = 0; i < bytes.size(); i++) sum += (unsigned char)bytes[i];
+  putU16(bytes, sum & 0xFFFF);
+
+  say(board, now, "LOG BEGIN " + std::to_string(bytes.size()));
+  TimedOutput raw;
+  raw.at = now;
+  raw.text = bytes + "\r\n";
+  board.scheduled.push_back(raw);
+  say(board, now, "LOG END");
+}
+
+/**
+ * processSensorLogCommand()
+ */
+static void sensorLogCommand(SimBoard &board, SimTime now, const std::string &args) {
+  SimSensorLog &log = board.sensors;
+  unsigned long tick = catchUpSensorLog(log, now);
+  char option = args.empty() ? 0 : args[0];
+  if (option == 0) {
+    dumpSensorLog(board, now, tick);
+  } else if (option == 'S') {
+    size_t ram = std::min(log.blocks.size(), (size_t)SENSOR_LOG_RAM_BLOCKS);
+    say(board, now, "Sensor log: " + std::to_string(log.blocks.size()) + " blocks (" + std::to_string(ram) +
+                    " in RAM, " + std::to_string(log.blocks.size() - ram) + " in EEPROM), every " +
+                    std::to_string(log.intervalTicks) + " s");
+  } else if (option == 'R') {
+    say(board, now, "Sensor reading: moisture " + std::to_string(simSensorValue(0, tick)) + ", TDS " +
+                    std::to_string(simSensorValue(1, tick)));
+  } else if (option == 'C') {
+    log.blocks.clear();
+    say(board, now, "Sensor log cleared");
+  } else if (option == 'I') {
+    long seconds = atol(args.c_str() + 1);
+    log.intervalTicks = seconds < 1 ? 1 : seconds > 3600 ? 3600 : seconds;
+    say(board, now, "Sensor log interval: " + std::to_string(log.intervalTicks) + " s");
+  } else {
+    say(board, now, "Sensor log commands: D, DS, DR, DC, DI<seconds>");
+  }
+}
+
+/**
+ * moveSteps() and the end of processRelativeMove() for a move starting at a
+ * given time (also the rest of a move resumed after a feed hold)
+ */
+static void startMove(SimBoard &board, SimTime now, long magnitude, int direction) {
+  // Steps until the carriage would reach a limit switch
+  long free = direction > 0 ? axisSteps - board.physical : board.physical;
+  SimMove &move = board.move;
+  move.active = true;
+  move.start = now;
+  move.totalSteps = magnitude;
+  move.steps = magnitude <= free ? magnitude : free;
+  move.direction = direction;
+  move.startCounter = board.counter;
+  move.startPhysical = board.physical;
+  move.startMaxPosition = board.maxPosition;
+
+  traceMove(board, magnitude, move.steps, direction, magnitude > free);
+  if (magnitude <= free) {
+    SimTime done = later(now, moveMicros(board.profile, magnitude));
+    move.stepsEnd = done;
+    board.physical += direction * magnitude;
+    board.counter += direction * magnitude;
+    say(board, done, "Move complete. Current position: " + std::to_string(board.counter));
+    say(board, done, "Distance from home: " + std::to_string(percentOf(board)) + "%");
+    return;
+  }
+
+  // Limit reached part way (the real time depends on the phase; use the full profile)
+  SimTime at = later(now, moveMicros(board.profile, magnitude) * free / magnitude);
+  move.stepsEnd = at;
+  board.physical += direction * free;
+  board.counter += direction * free;
+  say(board, at, "LIMIT SWITCH PRESSED!");
+  if (direction < 0) {
+    board.counter = 0;
+    say(board, at, "Home position (0) set");
+  } else {
+    board.maxPosition = board.counter;
+    say(board, at, "Maximum position updated to: " + std::to_string(board.maxPosition));
+  }
+  at = backOff(board, at, -direction);
+  say(board, at, "Move interrupted by limit switch or emergency stop");
+  say(board, at, "Current position after interruption: " + std::to_string(board.counter));
+}
+
+/**
+ * processRelativeMove()
+ */
+static void relativeMove(SimBoard &board, SimTime now, long steps) {
+  if (steps == 0) {
+    say(board, now, "Zero steps requested - no movement needed");
+    return;
+  }
+  say(board, now, "Relative move requested: " + std::to_string(steps));
+
+  long current = board.counter;
+  long target = current + steps;
+  if (target < BACKOFF_STEPS) {
+    say(board, now, "WARNING: Would move too close to home position limit!");
+    say(board, now, "Movement limited to safe distance (" + std::to_string(BACKOFF_STEPS) + " steps from home)");
+    target = BACKOFF_STEPS;
+    steps = target - current;
+  } else if (target > board.maxPosition - BACKOFF_STEPS) {
+    say(board, now, "WARNING: Would move too close to maximum position limit!");
+    say(board, now, "Movement limited to safe distance (" + std::to_string(BACKOFF_STEPS) + " steps from maximum)");
+    target = board.maxPosition - BACKOFF_STEPS;
+    steps = target - current;
+  }
+  if (steps == 0) {
+    say(board, now, "Already at safe limit - no movement possible");
+    return;
+  }
+
+  int direction = steps > 0 ? 1 : -1;
+  say(board, now, std::string("Direction: ") + (direction > 0 ? "CCW (forward)" : "CW (backward)"));
+  say(board, now, "Moving from position " + std::to_string(current) + " to position " + std::to_string(target));
+  startMove(board, now, labs(steps), direction);
+}
+
+/**
+ * runHoming()
+ */
+static void runHoming(SimBoard &board, SimTime now) {
+  say(board, now, "");
+  say(board, now, "===== STARTING ENHANCED HOMING SEQUENCE =====");
+  say(board, now, "STEP 1: Finding home position (minimum limit)...");
+  SimTime at = later(now, (double)board.physical * MAX_STEP_DELAY);
+  board.physical = 0;
+  board.counter = 0;
+  say(board, at, "Home limit switch found!");
+  at = backOff(board, at, 1);
+
+  say(board, at, "");
+  say(board, at, "STEP 2: Finding far position (maximum limit)...");
+  at = later(at, (double)(axisSteps - board.physical) * MAX_STEP_DELAY);
+  board.counter += axisSteps - board.physical;
+  board.physical = axisSteps;
+  say(board, at, "Far limit switch found!");
+  board.maxPosition = board.counter;
+  say(board, at, "Maximum travel distance: " + std::to_string(board.maxPosition) + " steps");
+  at = backOff(board, at, -1);
+
+  say(board, at, "");
+  say(board, at, "STEP 3: Moving to center position...");
+  long toCenter = board.maxPosition / 2 - board.counter;
+  if (toCenter != 0) {
+    at = later(at, moveMicros(board.profile, labs(toCenter)));
+    board.counter += toCenter;
+    board.physical += toCenter;
+  }
+  say(board, at, "");
+  say(board, at, "===== HOMING COMPLETE =====");
+  say(board, at, "Position counter has been zeroed at home position");
+  say(board, at, "Maximum travel distance has been measured");
+  say(board, at, "Total axis travel: " + std::to_string(board.maxPosition) + " steps");
+  say(board, at, "Axis is now positioned at center");
+}
+
+// -------------------- AUTO-TUNE --------------------
+
+static std::string profileText(const SimBoard &board) {
+  const SimProfile &profile = board.profile;
+  return std::to_string(profile.minStepDelay) + "," + std::to_string(profile.maxStepDelay) + "," +
+         std::to_string(profile.accelRate) + "," + std::to_string(profile.decelRate) +
+         (board.profileStored ? " (auto-tuned, EEPROM)" : " (Config.h defaults)");
+}
+
+/**
+ * testStage(): out and back from the start, or out only if steps are lost
+ */
+static SimTime autoTuneStage(SimBoard &board, SimTime at, const SimProfile &trial,
+                             const std::string &label, bool &lost) {
+  lost = trial.minStepDelay < SIM_STALL_STEP_DELAY || trial.accelRate > SIM_STALL_ACCEL_RATE;
+  at = later(at, moveMicros(trial, AUTOTUNE_TEST_STEPS) * (lost ? 1 : 2) + 40000);
+  say(board, at, label + (lost ? ": lost 37 steps" : ": ok"));
+  // moveToPosition(start) before the next stage
+  if (lost) at = later(at, (double)AUTOTUNE_TEST_STEPS * MAX_STEP_DELAY);
+  return at;
+}
+
+/**
+ * runAutoTune()
+ */
+static void runAutoTune(SimBoard &board, SimTime now) {
+  say(board, now, "");
+  say(board, now, "===== AUTO-TUNE =====");
+  if (board.maxPosition >= MAX_TRAVEL) {
+    say(board, now, "Auto-tune failed: run homing (H) first");
+    return;
+  }
+  if (board.maxPosition - 2 * BACKOFF_STEPS < AUTOTUNE_TEST_STEPS) {
+    say(board, now, "Auto-tune failed: axis shorter than AUTOTUNE_TEST_STEPS");
+    return;
+  }
+
+  long start = board.maxPosition / 2 - AUTOTUNE_TEST_STEPS / 2;
+  SimTime at = later(now, (double)labs(start - board.counter) * MAX_STEP_DELAY);
+  board.physical += start - board.counter;
+  board.counter = start;
+  say(board, at, "Measuring encoder counts per step...");
+  at = later(at, 2.0 * AUTOTUNE_TEST_STEPS * MAX_STEP_DELAY);
+  say(board, at, "Encoder counts per step: 1.50");
+
+  SimProfile trial = DEFAULT_PROFILE;
+  long bestDelay = 0;
+  bool lost;
+  for (long stepDelay = AUTOTUNE_START_STEP_DELAY; ; ) {
+    trial.minStepDelay = stepDelay;
+    at = autoTuneStage(board, at, trial, "Speed stage " + std::to_string(stepDelay) + " us", lost);
+    if (lost) break;
+    bestDelay = stepDelay;
+    if (stepDelay <= AUTOTUNE_FLOOR_STEP_DELAY) break;
+    long shorter = stepDelay * AUTOTUNE_SPEED_STEP_PERCENT / 100;
+    stepDelay -= shorter > 0 ? shorter : 1;
+    if (stepDelay < AUTOTUNE_FLOOR_STEP_DELAY) stepDelay = AUTOTUNE_FLOOR_STEP_DELAY;
+  }
+  if (bestDelay == 0) {
+    say(board, at, "Auto-tune failed: lost sync at the slowest test speed");
+    return;
+  }
+
+  trial.minStepDelay = bestDelay;
+  long bestAccel = ACCEL_RATE;
+  while (bestAccel < AUTOTUNE_MAX_ACCEL_RATE) {
+    long accel = bestAccel * 3 / 2 + 1;
+    if (accel > AUTOTUNE_MAX_ACCEL_RATE) accel = AUTOTUNE_MAX_ACCEL_RATE;
+    trial.accelRate = accel;
+    trial.decelRate = accel * DECEL_RATE / ACCEL_RATE;
+    at = autoTuneStage(board, at, trial,
+                       "Acceleration stage " + std::to_string(accel) + "/" + std::to_string(trial.decelRate), lost);
+    if (lost) break;
+    bestAccel = accel;
+  }
+
+  long bestDecel = bestAccel * DECEL_RATE / ACCEL_RATE;
+  board.profile.minStepDelay = std::min((long)MAX_STEP_DELAY, bestDelay * 100 / (100 - AUTOTUNE_SAFETY_MARGIN_PERCENT));
+  board.profile.maxStepDelay = MAX_STEP_DELAY;
+  board.profile.accelRate = std::max(1L, bestAccel - bestAccel * AUTOTUNE_SAFETY_MARGIN_PERCENT / 100);
+  board.profile.decelRate = std::max(1L, bestDecel - bestDecel * AUTOTUNE_SAFETY_MARGIN_PERCENT / 100);
+  board.profileStored = true;
+  say(board, at, "Fastest stage that kept sync: " + std::to_string(bestDelay) + " us, acceleration " +
+                 std::to_string(bestAccel));
+  say(board, at, "New speed profile: " + profileText(board));
+  say(board, at, "Auto-tune complete: profile saved to EEPROM");
+}
+
+/**
+ * processAutoTuneCommand()
+ */
+static void autoTuneCommand(SimBoard &board, SimTime now, const std::string &args) {
+  char option = args.empty() ? 0 : args[0];
+  if (option == 0) {
+    runAutoTune(board, now);
+  } else if (option == 'P') {
+    say(board, now, "Speed profile: " + profileText(board));
+  } else if (option == 'R') {
+    board.profile = DEFAULT_PROFILE;
+    board.profileStored = false;
+    say(board, now, "Speed profile reset: " + profileText(board));
+  } else {
+    say(board, now, "Auto-tune commands: A, AP, AR");
+  }
+}
+
+// -------------------- REALTIME CONTROL --------------------
+
+/**
+ * Drop output scheduled after a given time (the rest of an interrupted command)
+ */
+static void cancelScheduled(SimBoard &board, SimTime after) {
+  while (!board.scheduled.empty() && board.scheduled.back().at > after) board.scheduled.pop_back();
+}
+
+/**
+ * Time the output of the running command ends, or now if it has
+ */
+static SimTime replyEnd(const SimBoard &board, SimTime now) {
+  return board.scheduled.empty() ? now : std::max(now, board.scheduled.back().at);
+}
+
+static bool moveStepping(const SimBoard &board, SimTime now) {
+  return board.move.active && now < board.move.stepsEnd;
+}
+
+/**
+ * Step loop state of the current move when it notices a byte received at a
+ * given time (checkMoveInterrupts() runs before every step)
+ *
+ * @param elapsed Receives the microseconds from the start of the move to the byte
+ * @return Microseconds from the start of the move to the check
+ */
+static double moveCheckAt(const SimBoard &board, SimTime at, double &elapsed, long &steps, long &delay) {
+  const SimMove &move = board.move;
+  elapsed = microsBetween(move.start, at);
+  double check = walkMove(board.profile, move.totalSteps, elapsed, steps, delay);
+  if (steps > move.steps) steps = move.steps;
+  return check;
+}
+
+/**
+ * Put the carriage where the current move is after a number of steps
+ */
+static void setMoveProgress(SimBoard &board, long steps) {
+  const SimMove &move = board.move;
+  board.counter = move.startCounter + move.direction * steps;
+  board.physical = move.startPhysical + move.direction * steps;
+  board.maxPosition = move.startMaxPosition;
+}
+
+/**
+ * The step loop checks the stop flag before each pulse, so no pulse follows
+ * the stop byte and the latency to the last step is 0
+ */
+static void sayInterrupted(SimBoard &board, SimTime at) {
+  say(board, at, "EMERGENCY STOP TRIGGERED");
+  say(board, at, "Stop latency: 0 us from stop byte to last step");
+  say(board, at, "Move interrupted by limit switch or emergency stop");
+  say(board, at, "Current position after interruption: " + std::to_string(board.counter));
+}
+
+/**
+ * decelerateToHold(): ramp down at the profile's decelRate until at rest,
+ * out of steps, or at the first check at or after stopAt
+ *
+ * @return Microseconds into the move where stepping ends
+ */
+static double decelerateToHold(const SimProfile &profile, double micros, double stopAt,
+                               long &steps, long &remaining, long &delay) {
+  while (remaining > 0 && delay < profile.maxStepDelay && micros < stopAt) {
+    delay += profile.decelRate;
+    if (delay > profile.maxStepDelay) delay = profile.maxStepDelay;
+    micros += delay;
+    steps++;
+    remaining--;
+  }
+  return micros;
+}
+
+/**
+ * REALTIME_STOP: halt before the next step and latch the emergency stop
+ */
+static void realtimeStop(SimBoard &board, SimTime now) {
+  board.estop = true;
+
+  if (board.held) {
+    board.held = false;
+    if (now >= board.restAt) {
+      // waitForResume() notices it at once
+      sayInterrupted(board, replyEnd(board, now));
+      return;
+    }
+    // Still decelerating: stop at the next step
+    double elapsed = microsBetween(board.move.start, now);
+    long steps = board.holdSteps;
+    long remaining = board.move.totalSteps - steps;
+    long delay = board.holdDelay;
+    double check = decelerateToHold(board.profile, board.holdMicros, elapsed, steps, remaining, delay);
+    cancelScheduled(board, now);
+    setMoveProgress(board, steps);
+    sayInterrupted(board, later(now, check - elapsed));
+    return;
+  }
+
+  if (moveStepping(board, now)) {
+    double elapsed;
+    long steps, delay;
+    double check = moveCheckAt(board, now, elapsed, steps, delay);
+    cancelScheduled(board, now);
+    setMoveProgress(board, steps);
+    board.move.active = false;
+    sayInterrupted(board, later(now, check - elapsed));
+    return;
+  }
+
+  if ((board.running == 'H' || board.running == 'A') && replyEnd(board, now) > now) {
+    // Homing and auto-tune test moves step at most MAX_STEP_DELAY apart
+    cancelScheduled(board, now);
+    say(board, now, "EMERGENCY STOP TRIGGERED");
+    say(board, now, "Stop latency: 0 us from stop byte to last step");
+    say(board, now, board.running == 'H' ? "Homing aborted by emergency stop"
+                                         : "Auto-tune aborted: limit switch or emergency stop");
+    return;
+  }
+
+  // Not stepping: pollSerialCommands() reports it once the command is done
+  say(board, replyEnd(board, now), "EMERGENCY STOP TRIGGERED");
+}
+
+/**
+ * REALTIME_HOLD: decelerate an X move to rest and keep its remaining steps
+ */
+static void realtimeHold(SimBoard &board, SimTime now) {
+  if (board.held || board.estop || !moveStepping(board, now)) return;
+
+  double elapsed;
+  long steps, delay;
+  double check = moveCheckAt(board, now, elapsed, steps, delay);
+  SimMove &move = board.move;
+  board.holdMicros = check;
+  board.holdSteps = steps;
+  board.holdDelay = delay;
+  long remaining = move.totalSteps - steps;
+  double rest = decelerateToHold(board.profile, check, HUGE_VAL, steps, remaining, delay);
+  if (steps > move.steps) return;  // The limit switch comes first: keep the planned ending
+
+  cancelScheduled(board, now);
+  setMoveProgress(board, steps);
+  move.active = false;
+  SimTime at = later(move.start, rest);
+  if (remaining == 0) {
+    say(board, at, "Move complete. Current position: " + std::to_string(board.counter));
+    say(board, at, "Distance from home: " + std::to_string(percentOf(board)) + "%");
+    return;
+  }
+  board.held = true;
+  board.heldRemaining = remaining;
+  board.restAt = at;
+  // Measured to the last pulse of the ramp, one delay before it comes to rest
+  double lastPulse = rest - delay > elapsed ? rest - delay - elapsed : 0;
+  say(board, at, "Feed hold: at rest " + std::to_string((long)lastPulse) + " us after hold byte, position " +
+                 std::to_string(board.counter) + ", " + std::to_string(remaining) + " steps remaining");
+}
+
+/**
+ * REALTIME_RESUME: continue a held move with a new ramp
+ */
+static void realtimeResume(SimBoard &board, SimTime now) {
+  if (!board.held) return;
+  board.held = false;
+  SimTime at = replyEnd(board, now);
+  say(board, at, "Feed hold released: resuming " + std::to_string(board.heldRemaining) + " steps");
+  startMove(board, at, board.heldRemaining, board.move.direction);
+}
+
+/**
+ * realtimeByteReceived()
+ */
+static void realtimeByte(SimBoard &board, SimTime now, char byte) {
+  if (byte == REALTIME_STOP) realtimeStop(board, now);
+  else if (byte == REALTIME_HOLD) realtimeHold(board, now);
+  else realtimeResume(board, now);
+}
+
+/**
+ * motionBlocked()
+ */
+static bool motionBlocked(SimBoard &board, SimTime now) {
+  if (!board.estop) return false;
+  say(board, now, "ERROR: Emergency stop active, send C to clear");
+  return true;
+}
+
+/**
+ * processCommand()
+ */
+static void processCommand(SimBoard &board, SimTime now, std::string command) {
+  while (!command.empty() && isspace((unsigned char)command[command.size() - 1])) command.erase(command.size() - 1);
+  while (!command.empty() && isspace((unsigned char)command[0])) command.erase(0, 1);
+  if (command.empty()) return;
+  if (command.size() > COMMAND_MAX_LENGTH) {
+    say(board, now, "ERROR: Command longer than " + std::to_string(COMMAND_MAX_LENGTH) + " characters ignored");
+    return;
+  }
+  board.commands++;
+  board.running = command[0];
+  board.move.active = false;
+  say(board, now, "Command received: " + command);
+
+  if (command.compare(0, 1, "X") == 0) {
+    if (motionBlocked(board, now)) return;
+    relativeMove(board, now, atol(command.c_str() + 1));
+  } else if (command.compare(0, 1, "H") == 0) {
+    if (motionBlocked(board, now)) return;
+    runHoming(board, now);
+  } else if (command.compare(0, 1, "R") == 0) {
+    say(board, now, "");
+    say(board, now, "----- SYSTEM STATUS -----");
+    say(board, now, "Current position: " + std::to_string(board.counter));
+    say(board, now, "Maximum position: " + std::to_string(board.maxPosition));
+    say(board, now, "Position from home: " + std::to_string(percentOf(board)) + "%");
+    say(board, now, "Encoder position: " + std::to_string(board.counter));
+    say(board, now, "Encoder velocity: 0 counts/s (1/T)");
+    say(board, now, "Velocity tick: 0 cycles last, 0 worst of 640 budget (0 over)");
+    say(board, now, "Speed trim: off");
+    bool pressed = board.physical <= 0 || board.physical >= axisSteps;
+    say(board, now, std::string("Limit switch state: ") + (pressed ? "TRIGGERED" : "Not triggered"));
+    say(board, now, "Speed profile: " + profileText(board));
+    say(board, now, "Static RAM: 3441 of 8192 bytes");
+    say(board, now, "Stack high-water: 212 of 1024 bytes reserved");
+    say(board, now, "Never used RAM: 4539 bytes");
+    say(board, now, "------------------------");
+    say(board, now, "");
+  } else if (command.compare(0, 1, "S") == 0) {
+    board.estop = true;
+    say(board, now, "EMERGENCY STOP TRIGGERED");
+  } else if (command.compare(0, 1, "C") == 0) {
+    say(board, now, board.estop ? "Emergency stop cleared" : "Emergency stop not active");
+    board.estop = false;
+  } else if (command.compare(0, 1, "A") == 0) {
+    if (command.size() == 1 && motionBlocked(board, now)) return;
+    autoTuneCommand(board, now, command.substr(1));
+  } else if (command.compare(0, 1, "T") == 0) {
+    traceCommand(board, now, command.substr(1));
+  } else if (command.compare(0, 1, "D") == 0) {
+    sensorLogCommand(board, now, command.substr(1));
+  } else {
+    say(board, now, "Unknown command. Available commands:");
+    say(board, now, "  X#### or X-#### - Move relative steps");
+    say(board, now, "  H - Run homing sequence");
+    say(board, now, "  R - Report current position");
+    say(board, now, "  A - Auto-tune speed profile (A, AP, AR)");
+    say(board, now, "  T - Motion trace (T, TF, TD, TO, TN#, TS)");
+    say(board, now, "  D - Sensor log (D, DS, DR, DC, DI#)");
+    say(board, now, "  C - Clear emergency stop");
+    say(board, now, "  Ctrl-X / ! / ~ - Stop / feed hold / resume, also during moves");
+    say(board, now, "  S - Stop movement immediately");
+  }
+}
+
+static bool createBoard(SimBoard &board, std::string &error) {
+  board.master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (board.master < 0 || grantpt(board.master) != 0 || unlockpt(board.master) != 0) {
+    error = std::string("cannot create pty: ") + strerror(errno);
+    return false;
+  }
+  board.path = ptsname(board.master);
+  board.slave = open(board.path.c_str(), O_RDWR | O_NOCTTY);
+  if (board.slave < 0 || !makeRawTerminal(board.slave, 0)) {
+    error = board.path + ": " + strerror(errno);
+    return false;
+  }
+  fcntl(board.master, F_SETFL, fcntl(board.master, F_GETFL) | O_NONBLOCK);
+  board.physical = axisSteps / 3;
+  board.commands = 0;
+  board.overflowBytes = 0;
+  board.profile = DEFAULT_PROFILE;
+  board.profileStored = false;
+  board.trace.decimation = TRACE_DEFAULT_DECIMATION;
+  armTrace(board.trace, false);
+  board.trace.state = TRACE_OFF;
+  board.heldRemaining = 0;
+  board.sensors.nextSequence = 0;
+  return true;
+}
+
+static void printCounters(const std::vector<SimBoard> &boards) {
+  for (size_t i = 0; i < boards.size(); i++) {
+    fprintf(stderr, "%s: %ld commands, %ld bytes lost to receive buffer overflow\n",
+            boards[i].path.c_str(), boards[i].commands, boards[i].overflowBytes);
+  }
+}
+
+static void printUsage() {
+  printf("Usage: board_sim [--boards N] [--link /tmp/farmbot-sim] [--axis STEPS] [--speed F]\n");
+}
+
+int main(int argc, char **argv) {
+  int boardCount = 1;
+  const char *linkPrefix = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--boards") && i + 1 < argc) boardCount = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--link") && i + 1 < argc) linkPrefix = argv[++i];
+    else if (!strcmp(argv[i], "--axis") && i + 1 < argc) axisSteps = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--speed") && i + 1 < argc) speedFactor = atof(argv[++i]);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (boardCount < 1 || axisSteps < 4 * BACKOFF_STEPS || speedFactor <= 0) {
+    printUsage();
+    return 1;
+  }
+
+  signal(SIGINT, handleStop);
+  signal(SIGTERM, handleStop);
+  signal(SIGUSR1, handleReset);
+
+  SimTime now = std::chrono::steady_clock::now();
+  std::vector<SimBoard> boards(boardCount);
+  for (int i = 0; i < boardCount; i++) {
+    std::string error;
+    if (!createBoard(boards[i], error)) {
+      fprintf(stderr, "ERROR: %s\n", error.c_str());
+      return 1;
+    }
+    resetBoard(boards[i], now);
+    if (linkPrefix) {
+      std::string link = std::string(linkPrefix) + std::to_string(i);
+      unlink(link.c_str());
+      if (symlink(boards[i].path.c_str(), link.c_str()) != 0) {
+        fprintf(stderr, "WARNING: cannot create %s: %s\n", link.c_str(), strerror(errno));
+      }
+      printf("%s -> %s\n", link.c_str(), boards[i].path.c_str());
+    } else {
+      printf("%s\n", boards[i].path.c_str());
+    }
+  }
+  fflush(stdout);
+
+  std::vector<struct pollfd> polls(boardCount);
+  while (running) {
+    now = std::chrono::steady_clock::now();
+    if (resetRequested) {
+      resetRequested = 0;
+      for (int i = 0; i < boardCount; i++) resetBoard(boards[i], now);
+    }
+
+    // Release scheduled output and run the next command on idle boards
+    // (a held move keeps the firmware in waitForResume())
+    int timeoutMs = 100;
+    for (int i = 0; i < boardCount; i++) {
+      SimBoard &board = boards[i];
+      while (!board.scheduled.empty() && board.scheduled.front().at <= now) {
+        board.output += board.scheduled.front().text;
+        board.scheduled.pop_front();
+      }
+      if (board.scheduled.empty() && !board.held) {
+        size_t newline = board.rx.find('\n');
+        if (newline != std::string::npos) {
+          std::string command = board.rx.substr(0, newline);
+          board.rx.erase(0, newline + 1);
+          processCommand(board, now, command);
+          timeoutMs = 0;
+        }
+      } else {
+        long wait = (long)std::chrono::duration_cast<std::chrono::milliseconds>(
+          board.scheduled.front().at - now).count();
+        if (wait < timeoutMs) timeoutMs = wait < 0 ? 0 : (int)wait;
+      }
+      if (!board.output.empty()) {
+        ssize_t count = write(board.master, board.output.data(), board.output.size());
+        if (count > 0) board.output.erase(0, (size_t)count);
+      }
+      polls[i].fd = board.master;
+      polls[i].events = POLLIN | (board.output.empty() ? 0 : POLLOUT);
+      polls[i].revents = 0;
+    }
+
+    if (poll(polls.data(), polls.size(), timeoutMs) < 0 && errno != EINTR) break;
+
+    for (int i = 0; i < boardCount; i++) {
+      if (!(polls[i].revents & POLLIN)) continue;
+      SimBoard &board = boards[i];
+      char buffer[256];
+      ssize_t count = read(board.master, buffer, sizeof(buffer));
+      now = std::chrono::steady_clock::now();
+      for (ssize_t j = 0; j < count; j++) {
+        if (buffer[j] == REALTIME_STOP || buffer[j] == REALTIME_HOLD || buffer[j] == REALTIME_RESUME) {
+          realtimeByte(board, now, buffer[j]);
+        } else if (board.rx.size() < RX_BUFFER_BYTES) {
+          board.rx.push_back(buffer[j]);
+        } else {
+          board.overflowBytes++;
+        }
+      }
+    }
+  }
+
+  printCounters(boards);
+  for (int i = 0; i < boardCount; i++) {
+    if (linkPrefix) unlink((std::string(linkPrefix) + std::to_string(i)).c_str());
+  }
+  return 0;
+}
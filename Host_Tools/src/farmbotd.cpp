@@ -0,0 +1,510 @@
+/**
+ * farmbotd.cpp
+ *
+ * Controller daemon: owns the serial ports of one or more X-axis controller
+ * boards and lets any number of local clients send commands through a Unix
+ * socket, so scripts no longer open the ports themselves.
+ *
+ * Usage:
+ *   farmbotd --board bed1=/dev/ttyACM0 [--board bed2=/dev/ttyACM1 ...]
+ *            [--socket /tmp/farmbotd.sock] [--baud 115200] [--window 4]
+ *
+ * Everything runs on one epoll loop with non-blocking I/O. Each board has its
+ * own command pipeline (see BoardSession.h); replies are parsed as they arrive.
+ *
+ * Client protocol, one line per request:
+ *   <board> <command>   Queue a firmware command, e.g. "bed1 X1200"
+ *                       -> <board> <id> QUEUED
+ *                       -> <board> <id> > <reply line>          (every line)
+ *                       -> <board> <id> DATA <hex>              (raw dump bytes, 64 per line)
+ *                       -> <board> <id> DONE <status> <latency_us> [position]
+ *                       "S" jumps ahead of everything queued for the board
+ *                       and is preceded by the realtime stop byte.
+ *   <board> !STOP       Write a realtime byte at once, even during a move:
+ *   <board> !HOLD       stop (latched until the C command), feed hold, or
+ *   <board> !RESUME     resume a held move
+ *                       -> <board> SENT <request>
+ *   LIST                One BOARD line per board, then OK
+ *   STATUS <board>      One BOARD line
+ *   SUBSCRIBE           Receive lines printed outside commands as
+ *                       <board> EVENT <line>
+ * Malformed requests get "ERROR <message>".
+ *
+ * To try it without hardware, start board_sim and pass the pty paths it prints.
+ */
+
+#include "BoardSession.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#define MAX_COMMAND_LENGTH 32    // Longer lines would not fit the firmware's buffer
+#define MAX_CLIENT_BUFFER 65536  // Drop clients that stop reading
+#define REOPEN_INTERVAL_MS 2000
+#define DATA_BYTES_PER_LINE 64
+
+// Tags stored in epoll_event.data.u64: kind in the top byte, index below
+#define TAG_LISTEN (1ULL << 56)
+#define TAG_BOARD (2ULL << 56)
+#define TAG_CLIENT (3ULL << 56)
+#define TAG_MASK (0xFFULL << 56)
+
+struct Client {
+  int fd;
+  std::string input;
+  std::string output;
+  bool subscribed;
+  bool closing;
+};
+
+struct Board {
+  std::unique_ptr<BoardSession> session;
+  bool open;
+  bool writeArmed;  // EPOLLOUT registered
+  BoardTime lastOpenAttempt;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void handleSignal(int) {
+  running = 0;
+}
+
+class Daemon {
+public:
+  Daemon(long baud) : epoll_(-1), listen_(-1), baud_(baud), nextClient_(1), nextCommand_(1) {}
+
+  bool addBoard(const std::string &name, const std::string &path, int window) {
+    if (boardIndex_.count(name)) return false;
+    Board board;
+    board.session.reset(new BoardSession(name, path, window));
+    board.open = false;
+    board.writeArmed = false;
+    boardIndex_[name] = boards_.size();
+    boards_.push_back(std::move(board));
+    return true;
+  }
+
+  bool start(const char *socketPath) {
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_ < 0) return false;
+
+    listen_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_ < 0) return false;
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+    unlink(socketPath);
+    if (bind(listen_, (struct sockaddr *)&address, sizeof(address)) != 0) return false;
+    if (listen(listen_, 16) != 0) return false;
+    watch(listen_, EPOLLIN, TAG_LISTEN);
+
+    for (size_t i = 0; i < boards_.size(); i++) openBoard(i);
+    return true;
+  }
+
+  void run() {
+    struct epoll_event events[64];
+    while (running) {
+      int count = epoll_wait(epoll_, events, 64, nextTimeoutMillis());
+      if (count < 0) {
+        if (errno == EINTR) continue;
+        perror("epoll_wait");
+        return;
+      }
+      for (int i = 0; i < count; i++) {
+        uint64_t tag = events[i].data.u64;
+        uint64_t index = tag & ~TAG_MASK;
+        switch (tag & TAG_MASK) {
+          case TAG_LISTEN: acceptClients(); break;
+          case TAG_BOARD: serviceBoard(index, events[i].events); break;
+          case TAG_CLIENT: serviceClient(index, events[i].events); break;
+        }
+      }
+      pumpBoards();
+      reapClients();
+    }
+  }
+
+private:
+  void watch(int fd, uint32_t flags, uint64_t tag) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = flags;
+    event.data.u64 = tag;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  void rewatch(int fd, uint32_t flags, uint64_t tag) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = flags;
+    event.data.u64 = tag;
+    epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &event);
+  }
+
+  /**
+   * Poll often while a board is starting up or busy (timeouts, ready
+   * detection, reopening), otherwise sleep until something happens
+   */
+  int nextTimeoutMillis() {
+    for (size_t i = 0; i < boards_.size(); i++) {
+      const Board &board = boards_[i];
+      if (!board.open) return 250;
+      if (!board.session->ready() || board.session->inFlight() || board.session->queued()) return 100;
+    }
+    return 1000;
+  }
+
+  void openBoard(size_t index) {
+    Board &board = boards_[index];
+    board.lastOpenAttempt = std::chrono::steady_clock::now();
+    std::string error;
+    if (!board.session->open(baud_, error)) {
+      fprintf(stderr, "WARNING: %s: %s\n", board.session->name().c_str(), error.c_str());
+      return;
+    }
+    board.open = true;
+    board.writeArmed = false;
+    watch(board.session->fd(), EPOLLIN, TAG_BOARD | index);
+    printf("%s: opened %s\n", board.session->name().c_str(), board.session->path().c_str());
+    fflush(stdout);
+  }
+
+  void closeBoard(size_t index) {
+    Board &board = boards_[index];
+    fprintf(stderr, "WARNING: %s: port closed, reopening\n", board.session->name().c_str());
+    std::vector<BoardCompletion> completions;
+    board.session->failAll(REPLY_ERROR, completions);
+    deliver(board, completions);
+    epoll_ctl(epoll_, EPOLL_CTL_DEL, board.session->fd(), NULL);
+    // Recreate the session so its parser and counters start clean
+    std::string name = board.session->name();
+    std::string path = board.session->path();
+    int window = board.session->window();
+    board.session.reset(new BoardSession(name, path, window));
+    board.open = false;
+  }
+
+  void serviceBoard(size_t index, uint32_t flags) {
+    Board &board = boards_[index];
+    if (!board.open) return;
+    std::vector<BoardCompletion> completions;
+    std::vector<std::string> events;
+    bool alive = board.session->readAvailable(completions, events);
+    deliver(board, completions);
+    publish(board, events);
+    if (alive && (flags & EPOLLOUT)) alive = board.session->flush();
+    if (!alive || (flags & (EPOLLHUP | EPOLLERR) && !(flags & EPOLLIN))) closeBoard(index);
+  }
+
+  void pumpBoards() {
+    BoardTime now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < boards_.size(); i++) {
+      Board &board = boards_[i];
+      if (!board.open) {
+        if (now - board.lastOpenAttempt > std::chrono::milliseconds(REOPEN_INTERVAL_MS)) openBoard(i);
+        continue;
+      }
+      std::vector<BoardCompletion> completions;
+      board.session->pump(now, completions);
+      deliver(board, completions);
+      if (!board.session->flush()) {
+        closeBoard(i);
+        continue;
+      }
+      bool wantsWrite = board.session->wantsWrite();
+      if (wantsWrite != board.writeArmed) {
+        rewatch(board.session->fd(), EPOLLIN | (wantsWrite ? (uint32_t)EPOLLOUT : 0), TAG_BOARD | i);
+        board.writeArmed = wantsWrite;
+      }
+    }
+  }
+
+  void acceptClients() {
+    for (;;) {
+      int fd = accept4(listen_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) return;
+      long id = nextClient_++;
+      Client &client = clients_[id];
+      client.fd = fd;
+      client.subscribed = false;
+      client.closing = false;
+      watch(fd, EPOLLIN, TAG_CLIENT | (uint64_t)id);
+    }
+  }
+
+  void serviceClient(long id, uint32_t flags) {
+    std::map<long, Client>::iterator found = clients_.find(id);
+    if (found == clients_.end()) return;
+    Client &client = found->second;
+
+    if (flags & EPOLLIN) {
+      char buffer[4096];
+      for (;;) {
+        ssize_t count = read(client.fd, buffer, sizeof(buffer));
+        if (count > 0) {
+          client.input.append(buffer, (size_t)count);
+          continue;
+        }
+        if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) client.closing = true;
+        if (count < 0 && errno == EINTR) continue;
+        break;
+      }
+      size_t newline;
+      while ((newline = client.input.find('\n')) != std::string::npos) {
+        std::string line = client.input.substr(0, newline);
+        client.input.erase(0, newline + 1);
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (!line.empty()) handleRequest(id, client, line);
+      }
+    }
+    if (flags & (EPOLLHUP | EPOLLERR)) client.closing = true;
+    flushClient(id, client);
+  }
+
+  void handleRequest(long id, Client &client, const std::string &line) {
+    if (line == "LIST") {
+      for (size_t i = 0; i < boards_.size(); i++) client.output += describe(boards_[i]);
+      client.output += "OK\n";
+      return;
+    }
+    if (line == "SUBSCRIBE") {
+      client.subscribed = true;
+      client.output += "OK\n";
+      return;
+    }
+
+    size_t space = line.find(' ');
+    if (space == std::string::npos) {
+      client.output += "ERROR expected <board> <command>\n";
+      return;
+    }
+    std::string first = line.substr(0, space);
+    std::string rest = line.substr(space + 1);
+
+    if (first == "STATUS") {
+      std::map<std::string, size_t>::iterator board = boardIndex_.find(rest);
+      if (board == boardIndex_.end()) client.output += "ERROR unknown board " + rest + "\n";
+      else client.output += describe(boards_[board->second]);
+      return;
+    }
+
+    std::map<std::string, size_t>::iterator found = boardIndex_.find(first);
+    if (found == boardIndex_.end()) {
+      client.output += "ERROR unknown board " + first + "\n";
+      return;
+    }
+    if (rest.empty() || rest.size() > MAX_COMMAND_LENGTH) {
+      client.output += "ERROR command must be 1-" + std::to_string(MAX_COMMAND_LENGTH) + " characters\n";
+      return;
+    }
+    Board &board = boards_[found->second];
+    if (rest[0] == '!') {
+      handleRealtime(client, first, board, rest);
+      return;
+    }
+    for (size_t i = 0; i < rest.size(); i++) {
+      if ((unsigned char)rest[i] < 0x20) {
+        client.output += "ERROR control characters are not allowed\n";
+        return;
+      }
+      if (rest[i] == BOARD_REALTIME_HOLD || rest[i] == BOARD_REALTIME_RESUME) {
+        client.output += "ERROR ! and ~ are realtime bytes, use !HOLD or !RESUME\n";
+        return;
+      }
+    }
+    if (!board.open) {
+      client.output += first + " ERROR port is not open\n";
+      return;
+    }
+
+    // The stop byte halts a running move at once; the queued S confirms it
+    if (rest == "S") board.session->sendRealtime(BOARD_REALTIME_STOP);
+
+    BoardCommand command;
+    command.id = nextCommand_++;
+    command.client = (int)id;
+    command.text = rest;
+    command.queuedAt = std::chrono::steady_clock::now();
+    board.session->submit(command, rest == "S");
+    client.output += first + " " + std::to_string(command.id) + " QUEUED\n";
+  }
+
+  /**
+   * Write a realtime byte to the board without queueing
+   * Answered with "<board> SENT <request>"; the firmware's reaction arrives
+   * as the reply lines of the running command, or as events when idle.
+   */
+  void handleRealtime(Client &client, const std::string &name, Board &board, const std::string &request) {
+    char byte;
+    if (request == "!STOP") byte = BOARD_REALTIME_STOP;
+    else if (request == "!HOLD") byte = BOARD_REALTIME_HOLD;
+    else if (request == "!RESUME") byte = BOARD_REALTIME_RESUME;
+    else {
+      client.output += "ERROR unknown realtime request " + request + "\n";
+      return;
+    }
+    if (!board.open) {
+      client.output += name + " ERROR port is not open\n";
+      return;
+    }
+    board.session->sendRealtime(byte);
+    client.output += name + " SENT " + request + "\n";
+  }
+
+  std::string describe(const Board &board) {
+    const BoardSession &session = *board.session;
+    std::string state = !board.open ? "closed" : !session.ready() ? "starting" : (session.held() ? "held" : "ready");
+    std::string line = "BOARD " + session.name() + " " + session.path() + " " + state +
+                       " queued=" + std::to_string(session.queued()) +
+                       " inflight=" + std::to_string(session.inFlight()) +
+                       " completed=" + std::to_string(session.completedCount()) + " position=";
+    line += session.positionKnown() ? std::to_string(session.position()) : std::string("unknown");
+    return line + "\n";
+  }
+
+  void deliver(Board &board, const std::vector<BoardCompletion> &completions) {
+    for (size_t i = 0; i < completions.size(); i++) {
+      const BoardCompletion &done = completions[i];
+      std::map<long, Client>::iterator found = clients_.find(done.command.client);
+      if (found == clients_.end()) continue;  // Client left; the command still ran
+      Client &client = found->second;
+      std::string prefix = board.session->name() + " " + std::to_string(done.command.id);
+      for (size_t j = 0; j < done.reply.lines.size(); j++) {
+        client.output += prefix + " > " + done.reply.lines[j] + "\n";
+      }
+      appendData(client.output, prefix, done.reply.binary);
+      client.output += prefix + " DONE " + ReplyParser::statusName(done.reply.status) + " " +
+                       std::to_string(done.latencyMicros);
+      if (done.reply.hasPosition) client.output += " " + std::to_string(done.reply.position);
+      client.output += "\n";
+      flushClient(found->first, client);
+    }
+  }
+
+  static void appendData(std::string &output, const std::string &prefix, const std::string &data) {
+    static const char HEX[] = "0123456789abcdef";
+    for (size_t start = 0; start < data.size(); start += DATA_BYTES_PER_LINE) {
+      size_t end = std::min(data.size(), start + DATA_BYTES_PER_LINE);
+      output += prefix + " DATA ";
+      for (size_t k = start; k < end; k++) {
+        unsigned char byte = (unsigned char)data[k];
+        output.push_back(HEX[byte >> 4]);
+        output.push_back(HEX[byte & 15]);
+      }
+      output += "\n";
+    }
+  }
+
+  void publish(Board &board, const std::vector<std::string> &events) {
+    if (events.empty()) return;
+    for (std::map<long, Client>::iterator it = clients_.begin(); it != clients_.end(); ++it) {
+      if (!it->second.subscribed) continue;
+      for (size_t i = 0; i < events.size(); i++) {
+        it->second.output += board.session->name() + " EVENT " + events[i] + "\n";
+      }
+      flushClient(it->first, it->second);
+    }
+  }
+
+  void flushClient(long id, Client &client) {
+    while (!client.output.empty()) {
+      ssize_t count = write(client.fd, client.output.data(), client.output.size());
+      if (count < 0) {
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) client.closing = true;
+        break;
+      }
+      client.output.erase(0, (size_t)count);
+    }
+    if (client.output.size() > MAX_CLIENT_BUFFER) client.closing = true;
+    rewatch(client.fd, EPOLLIN | (client.output.empty() ? 0 : (uint32_t)EPOLLOUT), TAG_CLIENT | (uint64_t)id);
+  }
+
+  void reapClients() {
+    for (std::map<long, Client>::iterator it = clients_.begin(); it != clients_.end();) {
+      if (it->second.closing) {
+        close(it->second.fd);
+        it = clients_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  int epoll_;
+  int listen_;
+  long baud_;
+  long nextClient_;
+  long nextCommand_;
+  std::vector<Board> boards_;
+  std::map<std::string, size_t> boardIndex_;
+  std::map<long, Client> clients_;
+};
+
+static void printUsage() {
+  printf("Usage: farmbotd --board name=/dev/ttyACM0 [--board ...] [--socket /tmp/farmbotd.sock]\n");
+  printf("                [--baud 115200] [--window 4]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *socketPath = "/tmp/farmbotd.sock";
+  long baud = 115200;
+  int window = 4;
+  std::vector<std::string> boardSpecs;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--board") && i + 1 < argc) boardSpecs.push_back(argv[++i]);
+    else if (!strcmp(argv[i], "--socket") && i + 1 < argc) socketPath = argv[++i];
+    else if (!strcmp(argv[i], "--baud") && i + 1 < argc) baud = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--window") && i + 1 < argc) window = atoi(argv[++i]);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (boardSpecs.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  Daemon daemon(baud);
+  for (size_t i = 0; i < boardSpecs.size(); i++) {
+    size_t equals = boardSpecs[i].find('=');
+    if (equals == std::string::npos || equals == 0) {
+      fprintf(stderr, "ERROR: expected name=device, got %s\n", boardSpecs[i].c_str());
+      return 1;
+    }
+    if (!daemon.addBoard(boardSpecs[i].substr(0, equals), boardSpecs[i].substr(equals + 1), window)) {
+      fprintf(stderr, "ERROR: duplicate board name in %s\n", boardSpecs[i].c_str());
+      return 1;
+    }
+  }
+
+  signal(SIGINT, handleSignal);
+  signal(SIGTERM, handleSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  if (!daemon.start(socketPath)) {
+    fprintf(stderr, "ERROR: cannot listen on %s: %s\n", socketPath, strerror(errno));
+    return 1;
+  }
+  printf("Listening on %s with %zu board(s), window %d\n", socketPath, boardSpecs.size(), window);
+  fflush(stdout);
+  daemon.run();
+  unlink(socketPath);
+  return 0;
+}
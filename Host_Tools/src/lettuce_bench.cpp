@@ -0,0 +1,224 @@
+/**
+ * lettuce_bench.cpp
+ *
+ * Benchmark and Keras parity check for the C++ lettuce health classifier.
+ *
+ * Usage:
+ *   lettuce_bench <model.lcnn> [--iterations N] [--batch B]
+ *                 [--parity reference.lref] [--tolerance T] [--int8-tolerance T]
+ *                 [--save-int8 out.lcnn]
+ *
+ * Without --parity the tool times fp32 and int8 inference on synthetic images
+ * and prints latency per image and images per second. With --parity it runs the
+ * images stored by export_lettuce_model.py --reference through both paths and
+ * compares the scores to the Keras predictions; the exit code is non-zero if
+ * the fp32 path differs by more than --tolerance or any fp32 label flips, if
+ * the int8 path differs by more than --int8-tolerance, or if the model has
+ * neither path. int8 label flips are reported but allowed: scores within the
+ * quantization error of 0.5 can land on either side.
+ */
+
+#include "CnnModel.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#define DEFAULT_INT8_TOLERANCE 0.02f  // Score units; ~3x the error of the exported model
+
+struct ParityReference {
+  int count;
+  int height, width, channels;
+  std::vector<float> images;
+  std::vector<float> scores;
+};
+
+/**
+ * Load a reference file written by export_lettuce_model.py --reference
+ */
+static bool loadReference(const char *path, ParityReference &ref) {
+  FILE *file = fopen(path, "rb");
+  if (!file) return false;
+
+  char magic[4];
+  uint32_t header[4];
+  bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "LREF", 4) == 0 &&
+            fread(header, sizeof(uint32_t), 4, file) == 4;
+  if (ok) {
+    ref.count = header[0];
+    ref.height = header[1];
+    ref.width = header[2];
+    ref.channels = header[3];
+    long imageSize = (long)ref.height * ref.width * ref.channels;
+    ref.images.resize(imageSize * ref.count);
+    ref.scores.resize(ref.count);
+    for (int i = 0; i < ref.count && ok; i++) {
+      ok = fread(&ref.images[imageSize * i], sizeof(float), imageSize, file) == (size_t)imageSize &&
+           fread(&ref.scores[i], sizeof(float), 1, file) == 1;
+    }
+  }
+  fclose(file);
+  return ok;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Time one precision on synthetic images and print the results
+ */
+static void benchmark(const CnnModel &model, CnnPrecision precision, int batch, int iterations) {
+  const long inputSize = cnnInputSize(model);
+  std::vector<float> images(inputSize * batch);
+  std::vector<float> scores(batch);
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+  for (size_t i = 0; i < images.size(); i++) images[i] = pixel(rng);
+
+  CnnWorkspace workspace;
+  initCnnWorkspace(model, workspace, batch);
+
+  // Warm-up pass to fault in weights and buffers
+  runCnnBatch(model, workspace, images.data(), batch, precision, scores.data());
+
+  std::vector<double> latencies;
+  auto total = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    runCnnBatch(model, workspace, images.data(), batch, precision, scores.data());
+    latencies.push_back(secondsSince(start));
+  }
+  double elapsed = secondsSince(total);
+
+  std::sort(latencies.begin(), latencies.end());
+  double median = latencies[latencies.size() / 2];
+  double worst = latencies.back();
+
+  printf("%-5s batch %-3d  median %8.2f ms/batch  %8.2f ms/image  worst %8.2f ms  %8.1f images/s\n",
+         precision == CNN_INT8 ? "int8" : "fp32", batch, median * 1e3, median * 1e3 / batch,
+         worst * 1e3, (double)iterations * batch / elapsed);
+}
+
+/**
+ * Compare one precision against the Keras reference
+ *
+ * @return Largest absolute score difference
+ */
+static float checkParity(const CnnModel &model, const ParityReference &ref, CnnPrecision precision, int &flips) {
+  std::vector<float> scores(ref.count);
+  CnnWorkspace workspace;
+  initCnnWorkspace(model, workspace, 8);
+  runCnnBatch(model, workspace, ref.images.data(), ref.count, precision, scores.data());
+
+  float maxDiff = 0.0f;
+  double sumDiff = 0.0;
+  flips = 0;
+  for (int i = 0; i < ref.count; i++) {
+    float diff = fabsf(scores[i] - ref.scores[i]);
+    if (diff > maxDiff) maxDiff = diff;
+    sumDiff += diff;
+    if ((scores[i] > 0.5f) != (ref.scores[i] > 0.5f)) flips++;
+  }
+
+  printf("%-5s vs Keras: max |diff| %.6f  mean |diff| %.6f  label agreement %d/%d\n",
+         precision == CNN_INT8 ? "int8" : "fp32", maxDiff, sumDiff / ref.count,
+         ref.count - flips, ref.count);
+  return maxDiff;
+}
+
+static void printUsage() {
+  printf("Usage: lettuce_bench <model.lcnn> [--iterations N] [--batch B]\n");
+  printf("                     [--parity reference.lref] [--tolerance T] [--int8-tolerance T]\n");
+  printf("                     [--save-int8 out.lcnn]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printUsage();
+    return 1;
+  }
+
+  const char *modelPath = argv[1];
+  const char *parityPath = NULL;
+  const char *int8Path = NULL;
+  int iterations = 20;
+  int batch = 1;
+  float tolerance = 1e-4f;
+  float int8Tolerance = DEFAULT_INT8_TOLERANCE;
+
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) iterations = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--batch") && i + 1 < argc) batch = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--parity") && i + 1 < argc) parityPath = argv[++i];
+    else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) tolerance = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--int8-tolerance") && i + 1 < argc) int8Tolerance = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--save-int8") && i + 1 < argc) int8Path = argv[++i];
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (iterations < 1) iterations = 1;
+  if (batch < 1) batch = 1;
+
+  CnnModel model;
+  std::string error;
+  if (!loadCnnModel(modelPath, model, error)) {
+    fprintf(stderr, "ERROR: %s\n", error.c_str());
+    return 1;
+  }
+  if (model.hasFp32 && !model.hasInt8) quantizeCnnModel(model);
+
+  printf("Model %s: %dx%dx%d input, %zu layers\n", modelPath, model.inputH, model.inputW,
+         model.inputC, model.layers.size());
+
+  if (int8Path) {
+    if (!saveCnnModel(int8Path, model, CNN_INT8, error)) {
+      fprintf(stderr, "ERROR: %s\n", error.c_str());
+      return 1;
+    }
+    printf("Saved int8 model to %s\n", int8Path);
+  }
+
+  if (parityPath) {
+    ParityReference ref;
+    if (!loadReference(parityPath, ref)) {
+      fprintf(stderr, "ERROR: cannot read reference file %s\n", parityPath);
+      return 1;
+    }
+    if (ref.height != model.inputH || ref.width != model.inputW || ref.channels != model.inputC) {
+      fprintf(stderr, "ERROR: reference images do not match the model input shape\n");
+      return 1;
+    }
+
+    bool passed = true;
+    int checked = 0;
+    int flips = 0;
+    if (model.hasFp32) {
+      float maxDiff = checkParity(model, ref, CNN_FP32, flips);
+      passed = maxDiff <= tolerance && flips == 0;
+      checked++;
+    }
+    if (model.hasInt8) {
+      float maxDiff = checkParity(model, ref, CNN_INT8, flips);
+      passed = passed && maxDiff <= int8Tolerance;
+      checked++;
+    }
+    if (checked == 0) {
+      printf("No fp32 or int8 weights to compare\n");
+      passed = false;
+    }
+    printf("Parity %s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 2;
+  }
+
+  if (model.hasFp32) benchmark(model, CNN_FP32, batch, iterations);
+  benchmark(model, CNN_INT8, batch, iterations);
+  return 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * pack_dataset.cpp
+ *
+ * Decodes and resizes the lettuce disease dataset once into a packed,
+ * memory-mappable file (see PackedDataset.h), replacing the train/validation/test
+ * copies and per-epoch JPEG decoding of farmbot_cv.py.
+ *
+ * Usage:
+ *   pack_dataset <Lettuce_disease_datasets dir> <out.lpack> [--size 150] [--seed 42] [--threads N]
+ *
+ * Each sub-directory of the source is one disease class; "Healthy" is labelled 0,
+ * every other class 1. Images of each class are shuffled and split 80/10/10 into
+ * train/validation/test exactly like the notebook, but only the split index is stored.
+ */
+
+#include "ImageLoader.h"
+#include "PackedDataset.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define HEALTHY_CLASS "Healthy"
+
+struct PackEntry {
+  std::string path;   // Full path of the source image
+  std::string name;   // Class/file, stored in the name table
+  uint8_t label;
+  uint8_t split;
+};
+
+static bool isImageFile(const char *name) {
+  const char *dot = strrchr(name, '.');
+  if (!dot) return false;
+  std::string ext(dot + 1);
+  for (size_t i = 0; i < ext.size(); i++) ext[i] = tolower(ext[i]);
+  return ext == "jpg" || ext == "jpeg";
+}
+
+static std::vector<std::string> listDirectory(const std::string &path, bool wantDirectories) {
+  std::vector<std::string> names;
+  DIR *dir = opendir(path.c_str());
+  if (!dir) return names;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') continue;
+    struct stat info;
+    std::string full = path + "/" + entry->d_name;
+    if (stat(full.c_str(), &info) != 0) continue;
+    bool isDirectory = S_ISDIR(info.st_mode);
+    if (isDirectory == wantDirectories && (isDirectory || isImageFile(entry->d_name))) {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+/**
+ * Build the list of images with labels and splits
+ */
+static void collectEntries(const std::string &source, unsigned int seed, std::vector<PackEntry> &entries) {
+  std::mt19937 rng(seed);
+  std::vector<std::string> classes = listDirectory(source, true);
+
+  for (size_t c = 0; c < classes.size(); c++) {
+    std::vector<std::string> images = listDirectory(source + "/" + classes[c], false);
+    std::shuffle(images.begin(), images.end(), rng);
+
+    size_t trainSplit = (size_t)(0.8 * images.size());
+    size_t validationSplit = (size_t)(0.9 * images.size());
+    uint8_t label = classes[c] == HEALTHY_CLASS ? 0 : 1;
+
+    for (size_t i = 0; i < images.size(); i++) {
+      PackEntry entry;
+      entry.path = source + "/" + classes[c] + "/" + images[i];
+      entry.name = classes[c] + "/" + images[i];
+      entry.label = label;
+      entry.split = i < trainSplit ? PACKED_TRAIN : (i < validationSplit ? PACKED_VALIDATION : PACKED_TEST);
+      entries.push_back(entry);
+    }
+    printf("  %-40s %5zu images -> %s\n", classes[c].c_str(), images.size(), label ? "non_healthy" : "healthy");
+  }
+}
+
+static bool writeAt(int fd, const void *data, size_t bytes, uint64_t offset) {
+  const uint8_t *cursor = (const uint8_t *)data;
+  while (bytes > 0) {
+    ssize_t written = pwrite(fd, cursor, bytes, offset);
+    if (written <= 0) return false;
+    cursor += written;
+    bytes -= written;
+    offset += written;
+  }
+  return true;
+}
+
+static void printUsage() {
+  printf("Usage: pack_dataset <source dir> <out.lpack> [--size 150] [--seed 42] [--threads N]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+
+  const char *source = argv[1];
+  const char *outputPath = argv[2];
+  int size = 150;
+  unsigned int seed = 42;
+  int threads = (int)std::thread::hardware_concurrency();
+
+  for (int i = 3; i < argc; i++) {
+    if (!strcmp(argv[i], "--size") && i + 1 < argc) size = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (threads < 1) threads = 1;
+  if (size < 1) size = 150;
+
+  printf("Scanning %s\n", source);
+  std::vector<PackEntry> entries;
+  collectEntries(source, seed, entries);
+  if (entries.empty()) {
+    fprintf(stderr, "ERROR: no images found under %s\n", source);
+    return 1;
+  }
+
+  PackedHeader header;
+  memset(&header, 0, sizeof(header));
+  header.count = entries.size();
+  header.height = size;
+  header.width = size;
+  header.channels = 3;
+  for (size_t i = 0; i < entries.size(); i++) header.nameBytes += entries[i].name.size() + 1;
+  uint64_t fileSize = layoutPackedDataset(header);
+
+  int fd = open(outputPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, fileSize) != 0) {
+    fprintf(stderr, "ERROR: cannot create %s\n", outputPath);
+    if (fd >= 0) close(fd);
+    return 1;
+  }
+
+  // Decode in parallel; every worker writes its images straight to their final offset
+  const size_t imageBytes = (size_t)size * size * 3;
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> done(0);
+  std::atomic<bool> writeFailed(false);
+  std::vector<uint8_t> splits(entries.size());
+  std::vector<std::thread> workers;
+
+  for (int w = 0; w < threads; w++) {
+    workers.emplace_back([&] {
+      RgbImage decoded, resized;
+      std::string error;
+      for (size_t i = next++; i < entries.size(); i = next++) {
+        splits[i] = entries[i].split;
+        if (!decodeJpeg(entries[i].path.c_str(), decoded, error, size, size)) {
+          fprintf(stderr, "WARNING: skipping %s\n", error.c_str());
+          splits[i] = PACKED_SKIPPED;
+          continue;
+        }
+        resizeRgb(decoded, resized, size, size);
+        if (!writeAt(fd, resized.pixels.data(), imageBytes, header.tensorOffset + i * imageBytes)) {
+          writeFailed = true;
+        }
+        size_t count = ++done;
+        if (count % 500 == 0) printf("  packed %zu / %zu\n", count, entries.size());
+      }
+    });
+  }
+  for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+
+  std::vector<uint8_t> labels(entries.size());
+  std::string names;
+  for (size_t i = 0; i < entries.size(); i++) {
+    labels[i] = entries[i].label;
+    names.append(entries[i].name);
+    names.push_back('\0');
+  }
+
+  bool ok = !writeFailed && writeAt(fd, &header, sizeof(header), 0) &&
+            writeAt(fd, labels.data(), labels.size(), header.labelOffset) &&
+            writeAt(fd, splits.data(), splits.size(), header.splitOffset) &&
+            writeAt(fd, names.data(), names.size(), header.nameOffset);
+  if (close(fd) != 0) ok = false;
+  if (!ok) {
+    fprintf(stderr, "ERROR: failed writing %s\n", outputPath);
+    return 1;
+  }
+
+  long perSplit[3] = {0, 0, 0};
+  for (size_t i = 0; i < splits.size(); i++) {
+    if (splits[i] <= PACKED_TEST) perSplit[splits[i]]++;
+  }
+  printf("Packed %zu images (%ld train, %ld validation, %ld test) into %s, %.1f MB\n",
+         (size_t)done, perSplit[PACKED_TRAIN], perSplit[PACKED_VALIDATION], perSplit[PACKED_TEST],
+         outputPath, fileSize / 1048576.0);
+  return 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * plan_visits.cpp
+ *
+ * Orders a list of plant positions to minimize predicted job time.
+ *
+ * Usage:
+ *   plan_visits <waypoints.csv | --random N> [--config Config.h | --profile min,max,accel,decel]
+ *               [--start x,y] [--return] [--dwell seconds] [--candidates K]
+ *               [--sequential-axes] [--output route.csv] [--check-model]
+ *
+ * Waypoints are "name,x[,y]" lines in steps (a header line is skipped). The move
+ * time model uses Config.h by default (../Farm-Bot/lib/Motors_X/Config.h), or
+ * the four timing values of the live profile with --profile (as printed by
+ * the controller's AP command after auto-tuning). The route is written
+ * as order,name,x,y,hop_s,arrival_s and the predicted job times of the input
+ * order, the greedy route and the final route are printed.
+ *
+ * Hops assume X and Y move at the same time (the slower axis sets the time);
+ * --sequential-axes costs them as one axis move after the other instead.
+ *
+ * --random N plans N random waypoints on a 40000 x 40000 step bed, for timing
+ * the planner. --check-model compares the closed-form move time with a step by
+ * step evaluation of moveSteps().
+ */
+
+#include "MoveTimeModel.h"
+#include "VisitPlanner.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+
+#define DEFAULT_CONFIG "../Farm-Bot/lib/Motors_X/Config.h"
+
+/**
+ * Read name,x[,y] lines; lines whose x is not a number are skipped
+ */
+static bool loadWaypoints(const char *path, std::vector<Waypoint> &waypoints) {
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+  char line[1024];
+  while (fgets(line, sizeof(line), file)) {
+    char *comma = strchr(line, ',');
+    if (!comma) continue;
+    *comma = '\0';
+    char *end;
+    long x = strtol(comma + 1, &end, 10);
+    if (end == comma + 1) continue;
+    long y = 0;
+    if (*end == ',') y = strtol(end + 1, NULL, 10);
+
+    Waypoint waypoint;
+    waypoint.name = line;
+    waypoint.x = x;
+    waypoint.y = y;
+    waypoints.push_back(waypoint);
+  }
+  fclose(file);
+  return true;
+}
+
+static void randomWaypoints(int count, std::vector<Waypoint> &waypoints) {
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<long> coordinate(1600, 38400);
+  for (int i = 0; i < count; i++) {
+    Waypoint waypoint;
+    waypoint.name = "p" + std::to_string(i);
+    waypoint.x = coordinate(random);
+    waypoint.y = coordinate(random);
+    waypoints.push_back(waypoint);
+  }
+}
+
+/**
+ * Largest difference between the closed form and the step by step model
+ */
+static void checkModel(const MotionProfile &profile) {
+  long long worst = 0;
+  long worstSteps = 0;
+  for (long steps = 0; steps <= 200000; steps += steps < 2000 ? 1 : 997) {
+    long long closed = moveMicros(profile, steps);
+    long long reference = moveMicrosReference(profile, steps);
+    long long difference = llabs(closed - reference);
+    if (difference > worst) {
+      worst = difference;
+      worstSteps = steps;
+    }
+  }
+  printf("Model check: max difference %lld us", worst);
+  if (worst) printf(" at %ld steps", worstSteps);
+  printf("\n");
+}
+
+static void printUsage() {
+  printf("Usage: plan_visits <waypoints.csv | --random N> [--config Config.h | --profile min,max,accel,decel]\n");
+  printf("                   [--start x,y] [--return] [--dwell seconds] [--candidates K]\n");
+  printf("                   [--sequential-axes] [--output route.csv] [--check-model]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printUsage();
+    return 1;
+  }
+
+  const char *waypointPath = NULL;
+  const char *configPath = NULL;
+  const char *profileText = NULL;
+  const char *outputPath = "route.csv";
+  int randomCount = 0;
+  bool check = false;
+  PlanOptions options = defaultPlanOptions();
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--random") && i + 1 < argc) randomCount = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--config") && i + 1 < argc) configPath = argv[++i];
+    else if (!strcmp(argv[i], "--profile") && i + 1 < argc) profileText = argv[++i];
+    else if (!strcmp(argv[i], "--start") && i + 1 < argc) {
+      if (sscanf(argv[++i], "%ld,%ld", &options.startX, &options.startY) < 1) {
+        printUsage();
+        return 1;
+      }
+    }
+    else if (!strcmp(argv[i], "--return")) options.returnToStart = true;
+    else if (!strcmp(argv[i], "--dwell") && i + 1 < argc) options.dwellMicros = (long)(atof(argv[++i]) * 1e6);
+    else if (!strcmp(argv[i], "--candidates") && i + 1 < argc) options.candidates = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--sequential-axes")) options.sequentialAxes = true;
+    else if (!strcmp(argv[i], "--output") && i + 1 < argc) outputPath = argv[++i];
+    else if (!strcmp(argv[i], "--check-model")) check = true;
+    else if (argv[i][0] != '-' && !waypointPath) waypointPath = argv[i];
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  MotionProfile profile = defaultMotionProfile();
+  std::string error;
+  if (profileText) {
+    if (!parseProfile(profileText, profile)) {
+      fprintf(stderr, "ERROR: --profile expects min,max,accel,decel\n");
+      return 1;
+    }
+  } else if (configPath) {
+    if (!loadProfileFromConfig(configPath, profile, error)) {
+      fprintf(stderr, "ERROR: %s\n", error.c_str());
+      return 1;
+    }
+  } else if (!loadProfileFromConfig(DEFAULT_CONFIG, profile, error)) {
+    fprintf(stderr, "WARNING: %s, using built-in profile\n", error.c_str());
+  }
+  printf("Profile: delay %ld-%ld us, accel %ld, decel %ld\n", profile.minStepDelay,
+         profile.maxStepDelay, profile.accelRate, profile.decelRate);
+  if (check) checkModel(profile);
+
+  std::vector<Waypoint> waypoints;
+  if (randomCount > 0) {
+    randomWaypoints(randomCount, waypoints);
+  } else if (waypointPath) {
+    if (!loadWaypoints(waypointPath, waypoints)) {
+      fprintf(stderr, "ERROR: cannot read %s\n", waypointPath);
+      return 1;
+    }
+  } else {
+    return check ? 0 : (printUsage(), 1);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PlanResult result;
+  planVisits(profile, waypoints, options, result);
+  double planMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  FILE *output = fopen(outputPath, "w");
+  if (!output) {
+    fprintf(stderr, "ERROR: cannot create %s\n", outputPath);
+    return 1;
+  }
+  fprintf(output, "order,name,x,y,hop_s,arrival_s\n");
+  long x = options.startX;
+  long y = options.startY;
+  long long elapsed = 0;
+  for (size_t i = 0; i < result.order.size(); i++) {
+    const Waypoint &waypoint = waypoints[result.order[i]];
+    long long hop = hopMicros(profile, x, y, waypoint.x, waypoint.y, options.sequentialAxes);
+    elapsed += hop;
+    fprintf(output, "%zu,%s,%ld,%ld,%.3f,%.3f\n", i + 1, waypoint.name.c_str(), waypoint.x, waypoint.y,
+            hop / 1e6, elapsed / 1e6);
+    elapsed += options.dwellMicros;
+    x = waypoint.x;
+    y = waypoint.y;
+  }
+  fclose(output);
+
+  printf("Waypoints: %zu\n", waypoints.size());
+  printf("Input order:      %10.1f s\n", result.inputMicros / 1e6);
+  printf("Nearest neighbour: %9.1f s\n", result.nearestMicros / 1e6);
+  printf("Planned:          %10.1f s (%ld 2-opt, %ld Or-opt moves)\n", result.plannedMicros / 1e6,
+         result.twoOptMoves, result.orOptMoves);
+  printf("Planning took %.1f ms, route written to %s\n", planMs, outputPath);
+  return 0;
+}
@@ -0,0 +1,153 @@
+/**
+ * sensor_log.cpp
+ *
+ * Converts the sensor history of the X-axis controller (moisture and TDS
+ * readings logged on the board, see SensorLog.h) into CSV.
+ *
+ * Usage:
+ *   sensor_log <capture.bin> [--output sensors.csv]
+ *   sensor_log --board bed1 [--socket /tmp/farmbotd.sock] [--save dump.bin]
+ *              [--output sensors.csv]
+ *
+ * The first form reads a file holding a D dump (a raw serial capture works;
+ * the dump is found by its magic). The second form asks farmbotd to run D on
+ * a board.
+ *
+ * Columns:
+ *   boot      time base, 0 = oldest reset in the dump
+ *   tick_s    seconds since that reset
+ *   age_s     seconds before the dump, empty for readings from before the
+ *             last reset
+ *   channel   moisture or tds
+ *   raw       ADC value as logged
+ *   value     moisture 0-255 (255 = wet) or TDS in ppm, as the sensor sketches
+ * A summary (readings, damaged blocks, bytes per reading) goes to stderr.
+ */
+
+#include "DaemonClient.h"
+#include "SensorLogFormat.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool readFile(const char *path, std::string &data) {
+  FILE *file = fopen(path, "rb");
+  if (!file) return false;
+  char buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) data.append(buffer, count);
+  fclose(file);
+  return true;
+}
+
+static bool writeFile(const char *path, const std::string &data) {
+  FILE *file = fopen(path, "wb");
+  if (!file) return false;
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  return fclose(file) == 0 && ok;
+}
+
+/**
+ * Ask farmbotd to dump the sensor log of a board
+ */
+static bool fetchLog(const char *socketPath, const char *board, std::string &data,
+                     std::string &error) {
+  DaemonClient client;
+  if (!client.connect(socketPath, error)) return false;
+  DaemonReply reply;
+  if (!client.run(board, "D", reply, error)) return false;
+  if (reply.status != "ok") {
+    error = "D finished with status " + reply.status;
+    return false;
+  }
+  if (reply.binary.empty()) {
+    error = reply.lines.empty() ? "no sensor log data" : reply.lines.back();
+    return false;
+  }
+  data = reply.binary;
+  return true;
+}
+
+static void writeCsv(FILE *out, const SensorLog &log) {
+  fprintf(out, "boot,tick_s,age_s,channel,raw,value\n");
+  double seconds = log.tickMillis / 1000.0;
+  for (size_t i = 0; i < log.readings.size(); i++) {
+    const SensorReading &reading = log.readings[i];
+    fprintf(out, "%d,%.0f,", reading.boot, reading.tick * seconds);
+    if (reading.ageTicks >= 0) fprintf(out, "%.0f", reading.ageTicks * seconds);
+    fprintf(out, ",%s,%ld,%.1f\n", sensorChannelName(reading.channel), reading.raw,
+            sensorValue(reading.channel, reading.raw));
+  }
+
+  fprintf(stderr, "%zu readings in %d blocks (%d damaged), %.2f bytes per reading, every %.0f s",
+          log.readings.size(), log.blocks, log.damagedBlocks,
+          log.readings.empty() ? 0.0 : (double)log.dataBytes / log.readings.size(),
+          log.intervalTicks * seconds);
+  long oldestAge = -1;
+  for (size_t i = 0; i < log.readings.size() && oldestAge < 0; i++) oldestAge = log.readings[i].ageTicks;
+  if (oldestAge >= 0) fprintf(stderr, ", %.1f h since the last reset", oldestAge * seconds / 3600);
+  fprintf(stderr, "\n");
+}
+
+static void printUsage() {
+  printf("Usage: sensor_log <capture.bin> [--output sensors.csv]\n");
+  printf("       sensor_log --board NAME [--socket PATH] [--save dump.bin] [--output sensors.csv]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *inputPath = NULL;
+  const char *board = NULL;
+  const char *socketPath = DEFAULT_DAEMON_SOCKET;
+  const char *savePath = NULL;
+  const char *outputPath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--board") && i + 1 < argc) board = argv[++i];
+    else if (!strcmp(argv[i], "--socket") && i + 1 < argc) socketPath = argv[++i];
+    else if (!strcmp(argv[i], "--save") && i + 1 < argc) savePath = argv[++i];
+    else if (!strcmp(argv[i], "--output") && i + 1 < argc) outputPath = argv[++i];
+    else if (argv[i][0] != '-' && !inputPath) inputPath = argv[i];
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if ((inputPath == NULL) == (board == NULL)) {
+    printUsage();
+    return 1;
+  }
+
+  std::string data;
+  std::string error;
+  if (inputPath) {
+    if (!readFile(inputPath, data)) {
+      fprintf(stderr, "ERROR: cannot read %s\n", inputPath);
+      return 1;
+    }
+  } else if (!fetchLog(socketPath, board, data, error)) {
+    fprintf(stderr, "ERROR: %s: %s\n", board, error.c_str());
+    return 1;
+  }
+  if (savePath && !writeFile(savePath, data)) {
+    fprintf(stderr, "ERROR: cannot write %s\n", savePath);
+    return 1;
+  }
+
+  SensorLog log;
+  if (!findSensorLog(data, log, error)) {
+    fprintf(stderr, "ERROR: %s\n", error.c_str());
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (outputPath) {
+    out = fopen(outputPath, "w");
+    if (!out) {
+      fprintf(stderr, "ERROR: cannot write %s\n", outputPath);
+      return 1;
+    }
+  }
+  writeCsv(out, log);
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -0,0 +1,766 @@
+/**
+ * serial_replay.cpp
+ *
+ * Records the serial traffic between the Pi and an X-axis controller and
+ * replays it against a board, to compare firmware versions on real command
+ * streams.
+ *
+ * Usage:
+ *   serial_replay record --port /dev/ttyACM0 --link /tmp/farmbot-rec --output session.rec
+ *                 [--baud 115200]
+ *   serial_replay replay session.rec --port PATH [--fast] [--speed F] [--window 4]
+ *                 [--baud 115200] [--mask-numbers] [--diffs 10] [--csv replay.csv] [--strict]
+ *
+ * record opens the board's port and a pseudo terminal linked at --link; point
+ * farmbotd (or any client) at the link instead of the board. Everything that
+ * passes in either direction is forwarded and written to the recording with
+ * its time, until Ctrl-C.
+ *
+ * replay takes the commands and realtime bytes out of a recording and sends
+ * them to --port (a real board, a board_sim link, or any pty) through a
+ * BoardSession, the same pipeline farmbotd uses:
+ *   - by default at the recorded pacing, divided by --speed, with up to
+ *     --window commands in flight like farmbotd;
+ *   - with --fast, each command as soon as the previous one finished, and
+ *     realtime bytes at their recorded offset from the start of the command
+ *     they interrupted (the oldest unanswered one, which the board was
+ *     executing), before the commands that were queued behind it.
+ * The replies in the recording are the reference. The report gives, per
+ * command (letter plus sub-command, e.g. X, TD, DI), the service time
+ * percentiles, recorded and replayed: from when the board could start on the
+ * command (its line was sent and the previous reply had finished) to its last
+ * reply line. Time spent queued behind earlier commands depends on pacing and
+ * the window, so it is reported separately. Then the replies that differ in status or text (--mask-numbers compares
+ * lines with digits masked, for positions and timings that always change);
+ * and the commands and reply bytes per second. --csv writes one row per
+ * command. With --strict the exit status is 1 if any reply differs.
+ *
+ * Recording format, one chunk per line after '#' comment lines:
+ *   <microseconds since start> <'>' to board | '<' from board> <hex bytes>
+ */
+
+#include "BoardSession.h"
+#include "ReplyParser.h"
+#include "SerialPort.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#define RECORD_MAGIC "# serial_replay recording 1"
+#define MAX_PENDING_OUTPUT 65536  // Per direction, while the other side is not reading
+#define NO_COMMAND ((size_t)-1)
+
+// Last banner line after a reset, as in BoardSession.cpp
+#define BANNER_LAST_LINE "IMPORTANT: Please run homing"
+
+static volatile sig_atomic_t running = 1;
+
+static void handleStop(int) {
+  running = 0;
+}
+
+static long long microsSince(BoardTime start, BoardTime now) {
+  return (long long)std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+}
+
+static bool isRealtimeByte(char c) {
+  return c == BOARD_REALTIME_STOP || c == BOARD_REALTIME_HOLD || c == BOARD_REALTIME_RESUME;
+}
+
+// -------------------- RECORDING FILE --------------------
+
+/**
+ * Bytes that passed in one direction at one time
+ */
+struct Chunk {
+  long long micros;
+  bool toBoard;
+  std::string bytes;
+};
+
+static void writeChunk(FILE *file, long long micros, bool toBoard, const char *data, size_t length) {
+  static const char HEX[] = "0123456789abcdef";
+  fprintf(file, "%lld %c ", micros, toBoard ? '>' : '<');
+  for (size_t i = 0; i < length; i++) {
+    fputc(HEX[(uint8_t)data[i] >> 4], file);
+    fputc(HEX[(uint8_t)data[i] & 15], file);
+  }
+  fputc('\n', file);
+}
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool readRecording(const char *path, std::vector<Chunk> &chunks, std::string &error) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    error = std::string("cannot read ") + path;
+    return false;
+  }
+  char line[65536];
+  long lineNumber = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file)) {
+    lineNumber++;
+    if (line[0] == '#' || line[0] == '\n') continue;
+    Chunk chunk;
+    char direction;
+    int offset = 0;
+    if (sscanf(line, "%lld %c %n", &chunk.micros, &direction, &offset) < 2 ||
+        (direction != '>' && direction != '<')) {
+      ok = false;
+      break;
+    }
+    chunk.toBoard = direction == '>';
+    for (const char *p = line + offset; hexDigit(p[0]) >= 0; p += 2) {
+      if (hexDigit(p[1]) < 0) {
+        ok = false;
+        break;
+      }
+      chunk.bytes.push_back((char)(hexDigit(p[0]) << 4 | hexDigit(p[1])));
+    }
+    chunks.push_back(chunk);
+  }
+  fclose(file);
+  if (!ok) error = std::string(path) + ":" + std::to_string(lineNumber) + ": not a recording line";
+  return ok;
+}
+
+// -------------------- RECORD --------------------
+
+/**
+ * Write what one side produced to the other, keeping what it does not accept
+ */
+static void forward(int fd, std::string &pending, const char *data, size_t length) {
+  pending.append(data, length);
+  if (pending.size() > MAX_PENDING_OUTPUT) pending.erase(0, pending.size() - MAX_PENDING_OUTPUT);
+  while (!pending.empty()) {
+    ssize_t count = write(fd, pending.data(), pending.size());
+    if (count <= 0) break;
+    pending.erase(0, (size_t)count);
+  }
+}
+
+static int record(const char *portPath, const char *linkPath, const char *outputPath, long baud) {
+  std::string error;
+  int board = openSerialPort(portPath, baud, error);
+  if (board < 0) {
+    fprintf(stderr, "ERROR: %s\n", error.c_str());
+    return 1;
+  }
+
+  // The client side; our own slave descriptor keeps the pty usable while
+  // no client has it open
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    fprintf(stderr, "ERROR: cannot create pty: %s\n", strerror(errno));
+    return 1;
+  }
+  std::string ptyPath = ptsname(master);
+  int slave = open(ptyPath.c_str(), O_RDWR | O_NOCTTY);
+  if (slave < 0 || !makeRawTerminal(slave, 0)) {
+    fprintf(stderr, "ERROR: %s: %s\n", ptyPath.c_str(), strerror(errno));
+    return 1;
+  }
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  unlink(linkPath);
+  if (symlink(ptyPath.c_str(), linkPath) != 0) {
+    fprintf(stderr, "ERROR: cannot create %s: %s\n", linkPath, strerror(errno));
+    return 1;
+  }
+
+  FILE *out = fopen(outputPath, "w");
+  if (!out) {
+    fprintf(stderr, "ERROR: cannot write %s\n", outputPath);
+    unlink(linkPath);
+    return 1;
+  }
+  time_t wallStart = time(NULL);
+  char started[32];
+  strftime(started, sizeof(started), "%Y-%m-%dT%H:%M:%S", localtime(&wallStart));
+  fprintf(out, "%s\n# port %s, %ld baud, started %s\n", RECORD_MAGIC, portPath, baud, started);
+
+  printf("Recording %s via %s -> %s into %s, Ctrl-C to stop\n", portPath, linkPath,
+         ptyPath.c_str(), outputPath);
+  fflush(stdout);
+  signal(SIGINT, handleStop);
+  signal(SIGTERM, handleStop);
+
+  BoardTime start = std::chrono::steady_clock::now();
+  std::string toBoard, toClient;
+  long long bytesToBoard = 0, bytesFromBoard = 0;
+  int status = 0;
+  while (running) {
+    struct pollfd polls[2];
+    polls[0].fd = board;
+    polls[0].events = POLLIN | (toBoard.empty() ? 0 : POLLOUT);
+    polls[1].fd = master;
+    polls[1].events = POLLIN | (toClient.empty() ? 0 : POLLOUT);
+    polls[0].revents = polls[1].revents = 0;
+    if (poll(polls, 2, 200) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+
+    char buffer[4096];
+    if (polls[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      ssize_t count = read(board, buffer, sizeof(buffer));
+      if (count > 0) {
+        writeChunk(out, microsSince(start, std::chrono::steady_clock::now()), false, buffer, count);
+        forward(master, toClient, buffer, (size_t)count);
+        bytesFromBoard += count;
+      } else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+        fprintf(stderr, "ERROR: %s closed\n", portPath);
+        status = 1;
+        break;
+      }
+    }
+    if (polls[1].revents & POLLIN) {
+      ssize_t count = read(master, buffer, sizeof(buffer));
+      if (count > 0) {
+        writeChunk(out, microsSince(start, std::chrono::steady_clock::now()), true, buffer, count);
+        forward(board, toBoard, buffer, (size_t)count);
+        bytesToBoard += count;
+      }
+    }
+    if (polls[0].revents & POLLOUT) forward(board, toBoard, NULL, 0);
+    if (polls[1].revents & POLLOUT) forward(master, toClient, NULL, 0);
+  }
+
+  fclose(out);
+  unlink(linkPath);
+  close(slave);
+  close(master);
+  close(board);
+  fprintf(stderr, "%lld bytes to the board, %lld bytes from it in %.1f s\n", bytesToBoard,
+          bytesFromBoard, microsSince(start, std::chrono::steady_clock::now()) / 1e6);
+  return status;
+}
+
+// -------------------- SESSION FROM A RECORDING --------------------
+
+/**
+ * A command line of the recording with its reference reply
+ */
+struct SessionCommand {
+  std::string text;
+  long long sentMicros;      // Newline written, recording time
+  long long startedMicros;   // Previous reply finished, so the board started on it
+  bool answered;
+  long long serviceMicros;   // From started to the last reply line
+  long long queueMicros;     // From sent to started
+  CommandReply reply;
+};
+
+/**
+ * Something to send: a command or a realtime byte
+ */
+struct SessionEvent {
+  long long micros;
+  size_t command;   // Index into commands, or the command a realtime byte interrupted
+  bool realtime;
+  char byte;
+};
+
+struct Session {
+  std::vector<SessionCommand> commands;
+  std::vector<SessionEvent> events;
+  long long firstMicros;
+  long long lastMicros;
+};
+
+/**
+ * Split the host side into commands and realtime bytes and pair the board
+ * side replies with the commands, oldest first (as BoardSession does)
+ */
+static void buildSession(const std::vector<Chunk> &chunks, Session &session) {
+  ReplyParser parser;
+  std::string line;
+  std::vector<size_t> pending;
+  size_t lastCommand = NO_COMMAND;
+  session.firstMicros = chunks.empty() ? 0 : -1;
+  session.lastMicros = 0;
+
+  for (size_t i = 0; i < chunks.size(); i++) {
+    const Chunk &chunk = chunks[i];
+    if (chunk.toBoard) {
+      for (size_t j = 0; j < chunk.bytes.size(); j++) {
+        char c = chunk.bytes[j];
+        SessionEvent event;
+        event.micros = chunk.micros;
+        event.realtime = false;
+        event.byte = 0;
+        if (isRealtimeByte(c)) {
+          event.realtime = true;
+          event.byte = c;
+          // The board acts on it during the command it is executing, not
+          // the last one sent
+          event.command = pending.empty() ? lastCommand : pending.front();
+        } else if (c == '\n' || c == '\r') {
+          if (line.empty()) continue;
+          SessionCommand command;
+          command.text = line;
+          command.sentMicros = chunk.micros;
+          command.startedMicros = chunk.micros;
+          command.answered = false;
+          command.serviceMicros = 0;
+          command.queueMicros = 0;
+          line.clear();
+          lastCommand = event.command = session.commands.size();
+          pending.push_back(lastCommand);
+          session.commands.push_back(command);
+        } else {
+          line += c;
+          continue;
+        }
+        if (session.firstMicros < 0) session.firstMicros = chunk.micros;
+        session.events.push_back(event);
+      }
+    } else {
+      std::vector<CommandReply> replies;
+      std::vector<std::string> lines;
+      parser.feed(chunk.bytes.data(), chunk.bytes.size(), replies, lines);
+      for (size_t j = 0; j < replies.size() && !pending.empty(); j++) {
+        SessionCommand &command = session.commands[pending.front()];
+        pending.erase(pending.begin());
+        command.answered = true;
+        command.serviceMicros = chunk.micros - command.startedMicros;
+        command.queueMicros = command.startedMicros - command.sentMicros;
+        command.reply = replies[j];
+        if (!pending.empty()) session.commands[pending.front()].startedMicros = chunk.micros;
+      }
+      for (size_t j = 0; j < lines.size(); j++) {
+        // The board restarted: commands in flight were lost
+        if (lines[j].compare(0, strlen(BANNER_LAST_LINE), BANNER_LAST_LINE) == 0) pending.clear();
+      }
+    }
+    session.lastMicros = chunk.micros;
+  }
+  if (session.firstMicros < 0) session.firstMicros = 0;
+}
+
+// -------------------- REPLAY --------------------
+
+struct ReplayResult {
+  bool answered;
+  long long serviceMicros;  // As SessionCommand
+  long long queueMicros;
+  CommandReply reply;
+};
+
+/**
+ * Order for --fast: each command followed by the realtime bytes that
+ * interrupted it, so they are not held back behind the commands queued after it
+ */
+static bool fastOrder(const SessionEvent &a, const SessionEvent &b) {
+  long keyA = a.command == NO_COMMAND ? -1 : (long)a.command * 2 + (a.realtime ? 1 : 0);
+  long keyB = b.command == NO_COMMAND ? -1 : (long)b.command * 2 + (b.realtime ? 1 : 0);
+  return keyA < keyB;
+}
+
+/**
+ * Replay the session through a BoardSession
+ *
+ * @return FALSE if the port could not be opened or failed
+ */
+static bool replay(const Session &session, const char *portPath, long baud, int window, bool fast,
+                   double speed, std::vector<ReplayResult> &results, long long &durationMicros) {
+  BoardSession board("replay", portPath, fast ? 1 : window);
+  std::string error;
+  if (!board.open(baud, error)) {
+    fprintf(stderr, "ERROR: %s\n", error.c_str());
+    return false;
+  }
+
+  std::vector<SessionEvent> order = session.events;
+  if (fast) std::stable_sort(order.begin(), order.end(), fastOrder);
+
+  results.assign(session.commands.size(), ReplayResult());
+  std::vector<BoardTime> submitted(session.commands.size());
+  std::vector<bool> wasSubmitted(session.commands.size(), false);
+  size_t nextEvent = 0;
+  long completed = 0;
+  bool started = false;
+  BoardTime start = std::chrono::steady_clock::now();
+  BoardTime lastReply = start;
+  bool ok = true;
+
+  signal(SIGINT, handleStop);
+  signal(SIGTERM, handleStop);
+  while (running && (nextEvent < order.size() || completed < (long)session.commands.size())) {
+    BoardTime now = std::chrono::steady_clock::now();
+    if (!started && board.ready()) {
+      started = true;
+      start = now;
+    }
+
+    // Send everything that is due
+    long long waitMicros = 10000;
+    while (started && nextEvent < order.size()) {
+      const SessionEvent &event = order[nextEvent];
+      long long dueMicros;
+      bool due;
+      if (!fast) {
+        dueMicros = (long long)((event.micros - session.firstMicros) / speed);
+        due = microsSince(start, now) >= dueMicros;
+      } else if (!event.realtime) {
+        due = completed == (long)event.command && board.inFlight() == 0 && board.queued() == 0;
+        dueMicros = microsSince(start, now) + (due ? 0 : 1000);
+      } else if (event.command == NO_COMMAND || completed > (long)event.command) {
+        // Nothing was running, or the command already finished here
+        dueMicros = 0;
+        due = true;
+      } else if (!wasSubmitted[event.command]) {
+        break;
+      } else {
+        // Commands run one at a time, so the command started when it was sent
+        long long offset = event.micros - session.commands[event.command].startedMicros;
+        dueMicros = microsSince(start, submitted[event.command]) + (long long)(offset / speed);
+        due = microsSince(start, now) >= dueMicros;
+      }
+      if (!due) {
+        long long wait = dueMicros - microsSince(start, now);
+        if (wait < waitMicros) waitMicros = wait < 0 ? 0 : wait;
+        break;
+      }
+
+      if (event.realtime) {
+        board.sendRealtime(event.byte);
+      } else {
+        BoardCommand command;
+        command.id = (long)event.command;
+        command.client = 0;
+        command.text = session.commands[event.command].text;
+        command.urgent = false;
+        command.queuedAt = now;
+        board.submit(command, false);
+        submitted[event.command] = now;
+        wasSubmitted[event.command] = true;
+      }
+      nextEvent++;
+    }
+
+    std::vector<BoardCompletion> completions;
+    std::vector<std::string> events;
+    board.pump(now, completions);
+    if (!board.flush()) {
+      fprintf(stderr, "ERROR: write to %s failed\n", portPath);
+      ok = false;
+      break;
+    }
+
+    struct pollfd poller;
+    poller.fd = board.fd();
+    poller.events = POLLIN | (board.wantsWrite() ? POLLOUT : 0);
+    poller.revents = 0;
+    if (poll(&poller, 1, (int)(waitMicros / 1000)) < 0 && errno != EINTR) break;
+    if ((poller.revents & (POLLIN | POLLHUP | POLLERR)) && !board.readAvailable(completions, events)) {
+      fprintf(stderr, "ERROR: %s closed\n", portPath);
+      board.failAll(REPLY_ERROR, completions);
+      ok = false;
+    }
+
+    for (size_t i = 0; i < completions.size(); i++) {
+      // BoardSession times from the send; the board starts on the command
+      // once the reply before it has finished
+      const BoardCompletion &done = completions[i];
+      ReplayResult &result = results[done.command.id];
+      BoardTime replied = done.command.sentAt + std::chrono::microseconds(done.latencyMicros);
+      result.answered = done.reply.status != REPLY_TIMEOUT;
+      result.queueMicros = std::max(0LL, microsSince(done.command.sentAt, lastReply));
+      result.serviceMicros = done.latencyMicros - result.queueMicros;
+      result.reply = done.reply;
+      lastReply = replied;
+      completed++;
+    }
+    if (!ok) break;
+  }
+  durationMicros = microsSince(start, std::chrono::steady_clock::now());
+  return ok;
+}
+
+// -------------------- REPORT --------------------
+
+/**
+ * Command name for grouping: the letter plus an upper-case sub-command letter
+ */
+static std::string commandKey(const std::string &text) {
+  std::string key = text.substr(0, 1);
+  if (text.size() > 1 && text[1] >= 'A' && text[1] <= 'Z') key += text[1];
+  return key;
+}
+
+static std::string maskNumbers(const std::string &line) {
+  std::string masked;
+  for (size_t i = 0; i < line.size(); i++) {
+    bool digit = line[i] >= '0' && line[i] <= '9';
+    if (!digit) masked += line[i];
+    else if (masked.empty() || masked.back() != '#') masked += '#';
+  }
+  return masked;
+}
+
+static double percentileMillis(std::vector<long long> &values, double fraction) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t index = (size_t)(fraction * (values.size() - 1) + 0.5);
+  return values[index] / 1000.0;
+}
+
+static size_t replyBytes(const CommandReply &reply) {
+  size_t bytes = reply.binary.size();
+  for (size_t i = 0; i < reply.lines.size(); i++) bytes += reply.lines[i].size() + 1;
+  return bytes;
+}
+
+/**
+ * Line diff of two replies (longest common subsequence)
+ */
+static void printLineDiff(const std::vector<std::string> &expected, const std::vector<std::string> &got,
+                          bool mask) {
+  size_t n = expected.size(), m = got.size();
+  std::vector<std::vector<int>> common(n + 1, std::vector<int>(m + 1, 0));
+  for (size_t i = n; i-- > 0;) {
+    for (size_t j = m; j-- > 0;) {
+      bool same = mask ? maskNumbers(expected[i]) == maskNumbers(got[j]) : expected[i] == got[j];
+      common[i][j] = same ? common[i + 1][j + 1] + 1 : std::max(common[i + 1][j], common[i][j + 1]);
+    }
+  }
+  size_t i = 0, j = 0;
+  while (i < n || j < m) {
+    bool same = i < n && j < m &&
+                (mask ? maskNumbers(expected[i]) == maskNumbers(got[j]) : expected[i] == got[j]);
+    if (same) {
+      i++;
+      j++;
+    } else if (i < n && (j == m || common[i + 1][j] >= common[i][j + 1])) {
+      printf("    - %s\n", expected[i++].c_str());
+    } else {
+      printf("    + %s\n", got[j++].c_str());
+    }
+  }
+}
+
+static bool repliesDiffer(const CommandReply &expected, const CommandReply &got, bool mask) {
+  if (expected.status != got.status || expected.lines.size() != got.lines.size()) return true;
+  for (size_t i = 0; i < expected.lines.size(); i++) {
+    if (mask ? maskNumbers(expected.lines[i]) != maskNumbers(got.lines[i])
+             : expected.lines[i] != got.lines[i]) return true;
+  }
+  return mask ? expected.binary.size() != got.binary.size() : expected.binary != got.binary;
+}
+
+/**
+ * Print the latency table, throughput and reply diffs
+ *
+ * @return Number of replies that differ
+ */
+static long printReport(const Session &session, const std::vector<ReplayResult> &results,
+                        long long replayMicros, bool mask, int maxDiffs) {
+  std::map<std::string, std::vector<long long> > recorded, replayed;
+  std::vector<std::string> order;
+  std::vector<long long> recordedQueue, replayedQueue;
+  for (size_t i = 0; i < session.commands.size(); i++) {
+    std::string key = commandKey(session.commands[i].text);
+    if (!recorded.count(key)) order.push_back(key);
+    std::vector<long long> &r = recorded[key];
+    std::vector<long long> &p = replayed[key];
+    if (session.commands[i].answered) {
+      r.push_back(session.commands[i].serviceMicros);
+      recordedQueue.push_back(session.commands[i].queueMicros);
+    }
+    if (results[i].answered) {
+      p.push_back(results[i].serviceMicros);
+      replayedQueue.push_back(results[i].queueMicros);
+    }
+  }
+
+  printf("\nService time in ms, from when the board could start on the command to its last reply line\n");
+  printf("%-7s %6s | %8s %8s %8s %8s | %6s %8s %8s %8s %8s | %7s\n", "command", "count", "p50",
+         "p90", "p99", "max", "count", "p50", "p90", "p99", "max", "p50");
+  printf("%-7s %6s | %35s | %42s | %7s\n", "", "", "recorded", "replayed", "change");
+  for (size_t k = 0; k < order.size(); k++) {
+    std::vector<long long> &r = recorded[order[k]];
+    std::vector<long long> &p = replayed[order[k]];
+    double r50 = percentileMillis(r, 0.5), p50 = percentileMillis(p, 0.5);
+    printf("%-7s %6zu | %8.1f %8.1f %8.1f %8.1f | %6zu %8.1f %8.1f %8.1f %8.1f | ", order[k].c_str(),
+           r.size(), r50, percentileMillis(r, 0.9), percentileMillis(r, 0.99), percentileMillis(r, 1),
+           p.size(), p50, percentileMillis(p, 0.9), percentileMillis(p, 0.99), percentileMillis(p, 1));
+    if (r.empty() || p.empty() || r50 <= 0) printf("%7s\n", "-");
+    else printf("%+6.0f%%\n", (p50 - r50) * 100 / r50);
+  }
+  printf("Queued behind earlier commands in ms: recorded p50 %.1f max %.1f, replayed p50 %.1f max %.1f\n",
+         percentileMillis(recordedQueue, 0.5), percentileMillis(recordedQueue, 1),
+         percentileMillis(replayedQueue, 0.5), percentileMillis(replayedQueue, 1));
+
+  size_t recordedBytes = 0, replayedBytes = 0;
+  for (size_t i = 0; i < session.commands.size(); i++) {
+    recordedBytes += replyBytes(session.commands[i].reply);
+    replayedBytes += replyBytes(results[i].reply);
+  }
+  double recordedSeconds = (session.lastMicros - session.firstMicros) / 1e6;
+  double replaySeconds = replayMicros / 1e6;
+  printf("\nThroughput: recorded %zu commands in %.1f s (%.2f/s, %.0f reply bytes/s), "
+         "replayed in %.1f s (%.2f/s, %.0f reply bytes/s)\n",
+         session.commands.size(), recordedSeconds,
+         recordedSeconds > 0 ? session.commands.size() / recordedSeconds : 0.0,
+         recordedSeconds > 0 ? recordedBytes / recordedSeconds : 0.0, replaySeconds,
+         replaySeconds > 0 ? session.commands.size() / replaySeconds : 0.0,
+         replaySeconds > 0 ? replayedBytes / replaySeconds : 0.0);
+
+  long differing = 0, statusChanges = 0, unanswered = 0;
+  for (size_t i = 0; i < session.commands.size(); i++) {
+    const SessionCommand &command = session.commands[i];
+    const ReplayResult &result = results[i];
+    if (!command.answered) continue;  // No reference
+    if (!result.answered) unanswered++;
+    if (!repliesDiffer(command.reply, result.reply, mask)) continue;
+    differing++;
+    if (command.reply.status != result.reply.status) statusChanges++;
+    if (differing > maxDiffs) continue;
+    printf("\n#%zu %s: %s", i + 1, command.text.c_str(), ReplyParser::statusName(command.reply.status));
+    if (command.reply.status != result.reply.status) {
+      printf(" -> %s", ReplyParser::statusName(result.reply.status));
+    }
+    printf("\n");
+    printLineDiff(command.reply.lines, result.reply.lines, mask);
+    if (command.reply.binary.size() != result.reply.binary.size() ||
+        (!mask && command.reply.binary != result.reply.binary)) {
+      printf("    binary data differs (%zu -> %zu bytes)\n", command.reply.binary.size(),
+             result.reply.binary.size());
+    }
+  }
+  printf("\nReplies: %ld of %zu differ (%ld in status, %ld without reply)%s\n", differing,
+         session.commands.size(), statusChanges, unanswered,
+         differing > maxDiffs ? ", first ones shown" : "");
+  return differing;
+}
+
+static bool writeCsv(const char *path, const Session &session, const std::vector<ReplayResult> &results,
+                     bool mask) {
+  FILE *out = fopen(path, "w");
+  if (!out) return false;
+  fprintf(out, "index,command,recorded_us,replayed_us,recorded_queue_us,replayed_queue_us,"
+               "recorded_status,replayed_status,differs\n");
+  for (size_t i = 0; i < session.commands.size(); i++) {
+    const SessionCommand &command = session.commands[i];
+    const ReplayResult &result = results[i];
+    fprintf(out, "%zu,%s,", i + 1, command.text.c_str());
+    if (command.answered) fprintf(out, "%lld", command.serviceMicros);
+    fprintf(out, ",");
+    if (result.answered) fprintf(out, "%lld", result.serviceMicros);
+    fprintf(out, ",");
+    if (command.answered) fprintf(out, "%lld", command.queueMicros);
+    fprintf(out, ",");
+    if (result.answered) fprintf(out, "%lld", result.queueMicros);
+    fprintf(out, ",%s,%s,%d\n", command.answered ? ReplyParser::statusName(command.reply.status) : "",
+            ReplyParser::statusName(result.reply.status),
+            command.answered && repliesDiffer(command.reply, result.reply, mask) ? 1 : 0);
+  }
+  return fclose(out) == 0;
+}
+
+static void printUsage() {
+  printf("Usage: serial_replay record --port PATH --link PATH --output FILE [--baud 115200]\n");
+  printf("       serial_replay replay FILE --port PATH [--fast] [--speed F] [--window 4] [--baud 115200]\n");
+  printf("                     [--mask-numbers] [--diffs 10] [--csv FILE] [--strict]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printUsage();
+    return 1;
+  }
+  bool recordMode = !strcmp(argv[1], "record");
+  if (!recordMode && strcmp(argv[1], "replay")) {
+    printUsage();
+    return 1;
+  }
+
+  const char *recordingPath = NULL;
+  const char *portPath = NULL;
+  const char *linkPath = NULL;
+  const char *outputPath = NULL;
+  const char *csvPath = NULL;
+  long baud = 115200;
+  int window = 4;
+  bool fast = false;
+  double speed = 1;
+  bool mask = false;
+  int maxDiffs = 10;
+  bool strict = false;
+
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--port") && i + 1 < argc) portPath = argv[++i];
+    else if (!strcmp(argv[i], "--link") && i + 1 < argc) linkPath = argv[++i];
+    else if (!strcmp(argv[i], "--output") && i + 1 < argc) outputPath = argv[++i];
+    else if (!strcmp(argv[i], "--baud") && i + 1 < argc) baud = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--window") && i + 1 < argc) window = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--speed") && i + 1 < argc) speed = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--diffs") && i + 1 < argc) maxDiffs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--csv") && i + 1 < argc) csvPath = argv[++i];
+    else if (!strcmp(argv[i], "--fast")) fast = true;
+    else if (!strcmp(argv[i], "--mask-numbers")) mask = true;
+    else if (!strcmp(argv[i], "--strict")) strict = true;
+    else if (argv[i][0] != '-' && !recordingPath && !recordMode) recordingPath = argv[i];
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (recordMode) {
+    if (!portPath || !linkPath || !outputPath) {
+      printUsage();
+      return 1;
+    }
+    return record(portPath, linkPath, outputPath, baud);
+  }
+
+  if (!recordingPath || !portPath || speed <= 0 || window < 1) {
+    printUsage();
+    return 1;
+  }
+  std::vector<Chunk> chunks;
+  std::string error;
+  if (!readRecording(recordingPath, chunks, error)) {
+    fprintf(stderr, "ERROR: %s\n", error.c_str());
+    return 1;
+  }
+  Session session;
+  buildSession(chunks, session);
+  if (session.commands.empty()) {
+    fprintf(stderr, "ERROR: no commands in %s\n", recordingPath);
+    return 1;
+  }
+  printf("Replaying %zu commands and %zu realtime bytes from %s to %s (%s)\n",
+         session.commands.size(), session.events.size() - session.commands.size(), recordingPath,
+         portPath, fast ? "as fast as possible" : "recorded pacing");
+  fflush(stdout);
+
+  std::vector<ReplayResult> results;
+  long long replayMicros = 0;
+  bool ok = replay(session, portPath, baud, window, fast, speed, results, replayMicros);
+  long differing = printReport(session, results, replayMicros, mask, maxDiffs);
+  if (csvPath && !writeCsv(csvPath, session, results, mask)) {
+    fprintf(stderr, "ERROR: cannot write %s\n", csvPath);
+    return 1;
+  }
+  if (!ok || !running) return 1;
+  return strict && differing > 0 ? 1 : 0;
+}
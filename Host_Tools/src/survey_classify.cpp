@@ -0,0 +1,271 @@
+/**
+ * survey_classify.cpp
+ *
+ * Multi-threaded batch classifier for full-bed survey frames.
+ *
+ * Usage:
+ *   survey_classify <model.lcnn> <image dir | list.txt> [--output results.csv]
+ *                   [--manifest positions.csv] [--threads N] [--batch B] [--int8]
+ *
+ * Stages, connected by bounded queues:
+ *   list files -> decode + resize + normalize (N workers)
+ *              -> batched inference (M workers, one workspace each) -> CSV writer
+ *
+ * Results are keyed by filename and, when known, gantry position. Positions come
+ * from a manifest (filename,x,y per line) or from x<steps>/y<steps> tokens in the
+ * file name, e.g. bed1_x12000_y3400.jpg. Per-stage throughput is printed every second.
+ */
+
+#include "BoundedQueue.h"
+#include "CnnModel.h"
+#include "FrameList.h"
+#include "ImageLoader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+// One frame travelling through the pipeline
+struct SurveyFrame {
+  long index;
+  std::string path;
+  std::string position;       // "x,y" or empty
+  std::vector<float> pixels;  // Model input, empty if decoding failed
+  std::string error;
+  float score;
+};
+
+// Counters shared by all stages
+struct StageCounters {
+  std::atomic<long> decoded{0};
+  std::atomic<long> decodeFailed{0};
+  std::atomic<long> classified{0};
+  std::atomic<long> batches{0};
+  std::atomic<long> written{0};
+  std::atomic<long> decodeMicros{0};  // Busy time summed over workers
+  std::atomic<long> inferMicros{0};
+};
+
+static long microsSince(std::chrono::steady_clock::time_point start) {
+  return (long)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+static void printUsage() {
+  printf("Usage: survey_classify <model.lcnn> <image dir | list.txt> [--output results.csv]\n");
+  printf("                       [--manifest positions.csv] [--threads N] [--batch B] [--int8]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+
+  const char *modelPath = argv[1];
+  const char *source = argv[2];
+  const char *outputPath = "survey_results.csv";
+  const char *manifestPath = NULL;
+  int threads = (int)std::thread::hardware_concurrency();
+  int batch = 8;
+  CnnPrecision precision = CNN_FP32;
+
+  for (int i = 3; i < argc; i++) {
+    if (!strcmp(argv[i], "--output") && i + 1 < argc) outputPath = argv[++i];
+    else if (!strcmp(argv[i], "--manifest") && i + 1 < argc) manifestPath = argv[++i];
+    else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--batch") && i + 1 < argc) batch = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--int8")) precision = CNN_INT8;
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (threads < 1) threads = 1;
+  if (batch < 1) batch = 1;
+
+  CnnModel model;
+  std::string error;
+  if (!loadCnnModel(modelPath, model, error)) {
+    fprintf(stderr, "ERROR: %s\n", error.c_str());
+    return 1;
+  }
+  if (precision == CNN_INT8 && !model.hasInt8) quantizeCnnModel(model);
+  if (precision == CNN_FP32 && !model.hasFp32) {
+    fprintf(stderr, "ERROR: model only has int8 weights, use --int8\n");
+    return 1;
+  }
+
+  std::vector<std::string> paths;
+  if (!listFrames(source, paths)) {
+    fprintf(stderr, "ERROR: cannot read %s\n", source);
+    return 1;
+  }
+  std::map<std::string, std::string> manifest;
+  if (manifestPath && !loadManifest(manifestPath, manifest)) {
+    fprintf(stderr, "ERROR: cannot read manifest %s\n", manifestPath);
+    return 1;
+  }
+
+  FILE *output = fopen(outputPath, "w");
+  if (!output) {
+    fprintf(stderr, "ERROR: cannot create %s\n", outputPath);
+    return 1;
+  }
+
+  // Inference is roughly an order of magnitude heavier than decoding
+  const int decodeWorkers = std::max(1, threads / 4);
+  const int inferWorkers = std::max(1, threads - decodeWorkers);
+  printf("Classifying %zu frames with %d decode + %d inference workers, batch %d (%s)\n",
+         paths.size(), decodeWorkers, inferWorkers, batch, precision == CNN_INT8 ? "int8" : "fp32");
+
+  BoundedQueue<SurveyFrame> pending(4 * threads);
+  BoundedQueue<SurveyFrame> prepared(2 * batch * inferWorkers);
+  BoundedQueue<SurveyFrame> finished(2 * batch * inferWorkers);
+  StageCounters counters;
+  const long inputSize = cnnInputSize(model);
+  auto start = std::chrono::steady_clock::now();
+
+  // Stage 1: enumerate frames
+  std::thread lister([&] {
+    for (size_t i = 0; i < paths.size(); i++) {
+      SurveyFrame frame;
+      frame.index = i;
+      frame.path = paths[i];
+      frame.position = framePosition(manifest, paths[i]);
+      frame.score = -1.0f;
+      if (!pending.push(std::move(frame))) break;
+    }
+    pending.close();
+  });
+
+  // Stage 2: decode, resize, normalize
+  std::vector<std::thread> decoders;
+  std::atomic<int> decodersLeft(decodeWorkers);
+  for (int w = 0; w < decodeWorkers; w++) {
+    decoders.emplace_back([&] {
+      SurveyFrame frame;
+      while (pending.pop(frame)) {
+        auto busy = std::chrono::steady_clock::now();
+        frame.pixels.resize(inputSize);
+        if (loadModelInput(frame.path.c_str(), model.inputW, model.inputH, frame.pixels.data(), frame.error)) {
+          counters.decoded++;
+        } else {
+          frame.pixels.clear();
+          counters.decodeFailed++;
+        }
+        counters.decodeMicros += microsSince(busy);
+        prepared.push(std::move(frame));
+      }
+      if (--decodersLeft == 0) prepared.close();
+    });
+  }
+
+  // Stage 3: batched inference
+  std::vector<std::thread> inferrers;
+  std::atomic<int> inferrersLeft(inferWorkers);
+  for (int w = 0; w < inferWorkers; w++) {
+    inferrers.emplace_back([&] {
+      CnnWorkspace workspace;
+      initCnnWorkspace(model, workspace, batch);
+      std::vector<float> images((size_t)inputSize * batch);
+      std::vector<float> scores(batch);
+      std::vector<SurveyFrame> group;
+      SurveyFrame frame;
+
+      // Block for the first frame of a batch, then take whatever else is ready
+      while (prepared.pop(frame)) {
+        group.clear();
+        group.push_back(std::move(frame));
+        while ((int)group.size() < batch && prepared.tryPop(frame)) group.push_back(std::move(frame));
+
+        auto busy = std::chrono::steady_clock::now();
+        int count = 0;
+        for (size_t i = 0; i < group.size(); i++) {
+          if (group[i].pixels.empty()) continue;
+          std::copy(group[i].pixels.begin(), group[i].pixels.end(), images.begin() + (size_t)count * inputSize);
+          count++;
+        }
+        if (count > 0) runCnnBatch(model, workspace, images.data(), count, precision, scores.data());
+        counters.inferMicros += microsSince(busy);
+        counters.batches++;
+
+        count = 0;
+        for (size_t i = 0; i < group.size(); i++) {
+          if (!group[i].pixels.empty()) {
+            group[i].score = scores[count++];
+            group[i].pixels = std::vector<float>();  // Release before queueing
+            counters.classified++;
+          }
+          finished.push(std::move(group[i]));
+        }
+      }
+      if (--inferrersLeft == 0) finished.close();
+    });
+  }
+
+  // Stage 4: result writer
+  std::thread writer([&] {
+    fprintf(output, "filename,x,y,score,label,confidence\n");
+    SurveyFrame frame;
+    while (finished.pop(frame)) {
+      std::string position = frame.position.empty() ? "," : frame.position;
+      if (frame.score < 0.0f) {
+        fprintf(output, "%s,%s,,ERROR,\n", baseName(frame.path).c_str(), position.c_str());
+        fprintf(stderr, "WARNING: %s\n", frame.error.c_str());
+      } else {
+        bool unhealthy = frame.score > 0.5f;
+        float confidence = (unhealthy ? frame.score : 1.0f - frame.score) * 100.0f;
+        fprintf(output, "%s,%s,%.6f,%s,%.2f\n", baseName(frame.path).c_str(), position.c_str(),
+                frame.score, unhealthy ? "Non-Healthy" : "Healthy", confidence);
+      }
+      counters.written++;
+    }
+  });
+
+  // Progress monitor: per-stage rates over the last second and queue depths
+  std::atomic<bool> done(false);
+  std::thread monitor([&] {
+    long lastDecoded = 0, lastClassified = 0, lastWritten = 0;
+    while (!done) {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      long decoded = counters.decoded + counters.decodeFailed;
+      long classified = counters.classified;
+      long written = counters.written;
+      printf("decode %6ld/s | infer %6ld/s | write %6ld/s | queued %zu/%zu/%zu | %ld/%zu done\n",
+             decoded - lastDecoded, classified - lastClassified, written - lastWritten,
+             pending.size(), prepared.size(), finished.size(), written, paths.size());
+      fflush(stdout);
+      lastDecoded = decoded;
+      lastClassified = classified;
+      lastWritten = written;
+    }
+  });
+
+  lister.join();
+  for (size_t i = 0; i < decoders.size(); i++) decoders[i].join();
+  for (size_t i = 0; i < inferrers.size(); i++) inferrers[i].join();
+  writer.join();
+  done = true;
+  monitor.join();
+  fclose(output);
+
+  double elapsed = microsSince(start) / 1e6;
+  long classified = counters.classified;
+  printf("\n----- SURVEY SUMMARY -----\n");
+  printf("Frames classified: %ld (%ld failed to decode)\n", classified, (long)counters.decodeFailed);
+  printf("Wall time: %.2f s, %.1f images/s\n", elapsed, classified / elapsed);
+  printf("Decode: %.2f ms/image per worker\n",
+         counters.decoded ? counters.decodeMicros / 1e3 / counters.decoded : 0.0);
+  printf("Inference: %.2f ms/image per worker, average batch %.1f\n",
+         classified ? counters.inferMicros / 1e3 / classified : 0.0,
+         counters.batches ? (double)classified / counters.batches : 0.0);
+  printf("Results written to %s\n", outputPath);
+  return 0;
+}
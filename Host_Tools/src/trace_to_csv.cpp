@@ -0,0 +1,175 @@
+/**
+ * trace_to_csv.cpp
+ *
+ * Converts a motion trace of the X-axis controller into CSV for plotting,
+ * with derived velocity and following error, to tune the speed profile.
+ *
+ * Usage:
+ *   trace_to_csv <capture.bin> [--output trace.csv] [--counts-per-step F]
+ *   trace_to_csv --board bed1 [--socket /tmp/farmbotd.sock] [--save dump.bin]
+ *                [--output trace.csv] [--counts-per-step F]
+ *
+ * The first form reads a file holding a TD dump (a raw serial capture works;
+ * the dump is found by its magic). The second form asks farmbotd to run TD on
+ * a board. Arm the recorder first with "T" (next move) or "TF" (faults).
+ *
+ * Columns:
+ *   time_ms, dt_us, position, encoder,
+ *   velocity      commanded steps/s over the sample interval
+ *   enc_velocity  encoder velocity converted to steps/s
+ *   following     encoder minus commanded position in steps, relative to the
+ *                 first sample (positive = encoder ahead)
+ *   phase, flags  profile phase and the raw flag byte
+ * A summary (trigger, peak velocity, worst following error) goes to stderr.
+ */
+
+#include "DaemonClient.h"
+#include "TraceFormat.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool readFile(const char *path, std::string &data) {
+  FILE *file = fopen(path, "rb");
+  if (!file) return false;
+  char buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) data.append(buffer, count);
+  fclose(file);
+  return true;
+}
+
+static bool writeFile(const char *path, const std::string &data) {
+  FILE *file = fopen(path, "wb");
+  if (!file) return false;
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  return fclose(file) == 0 && ok;
+}
+
+/**
+ * Ask farmbotd to dump the trace of a board
+ */
+static bool fetchTrace(const char *socketPath, const char *board, std::string &data,
+                       std::string &error) {
+  DaemonClient client;
+  if (!client.connect(socketPath, error)) return false;
+  DaemonReply reply;
+  if (!client.run(board, "TD", reply, error)) return false;
+  if (reply.status != "ok") {
+    error = "TD finished with status " + reply.status;
+    return false;
+  }
+  if (reply.binary.empty()) {
+    error = reply.lines.empty() ? "no trace data" : reply.lines.back();
+    return false;
+  }
+  data = reply.binary;
+  return true;
+}
+
+static void writeCsv(FILE *out, const MotionTrace &trace, double countsPerStep) {
+  fprintf(out, "time_ms,dt_us,position,encoder,velocity,enc_velocity,following,phase,flags\n");
+  const std::vector<TracePoint> &points = trace.points;
+  if (points.empty()) return;
+
+  double peakVelocity = 0;
+  double worstFollowing = 0;
+  double worstFollowingTime = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    const TracePoint &point = points[i];
+    double velocity = 0;
+    double encoderVelocity = 0;
+    // Velocity over the interval that ends at this sample; none across move starts
+    if (i > 0 && point.dtMicros > 0 && !(point.flags & TRACE_FLAG_MOVE_START)) {
+      velocity = (point.position - points[i - 1].position) * 1e6 / point.dtMicros;
+      encoderVelocity = (point.encoder - points[i - 1].encoder) / countsPerStep * 1e6 / point.dtMicros;
+    }
+    double following = (point.encoder - points[0].encoder) / countsPerStep -
+                       (point.position - points[0].position);
+    if (fabs(velocity) > fabs(peakVelocity)) peakVelocity = velocity;
+    if (fabs(following) > fabs(worstFollowing)) {
+      worstFollowing = following;
+      worstFollowingTime = point.timeMicros;
+    }
+    fprintf(out, "%.3f,%.0f,%ld,%ld,%.1f,%.1f,%.2f,%s,0x%02x\n", point.timeMicros / 1000.0,
+            point.dtMicros, point.position, point.encoder, velocity, encoderVelocity, following,
+            tracePhaseName(point.flags), point.flags);
+  }
+
+  fprintf(stderr, "%zu samples every %d steps over %.1f ms, trigger %s", points.size(),
+          trace.decimation, points.back().timeMicros / 1000.0, traceTriggerName(trace.trigger));
+  if (trace.triggerIndex >= 0) {
+    fprintf(stderr, " at %.1f ms", points[trace.triggerIndex].timeMicros / 1000.0);
+  }
+  fprintf(stderr, "\nProfile %d,%d,%d,%d: peak %.0f steps/s, worst following error %.2f steps at %.1f ms\n",
+          trace.minStepDelay, trace.maxStepDelay, trace.accelRate, trace.decelRate, peakVelocity,
+          worstFollowing, worstFollowingTime / 1000.0);
+}
+
+static void printUsage() {
+  printf("Usage: trace_to_csv <capture.bin> [--output trace.csv] [--counts-per-step F]\n");
+  printf("       trace_to_csv --board NAME [--socket PATH] [--save dump.bin] [--output trace.csv]\n");
+  printf("                    [--counts-per-step F]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *inputPath = NULL;
+  const char *board = NULL;
+  const char *socketPath = DEFAULT_DAEMON_SOCKET;
+  const char *savePath = NULL;
+  const char *outputPath = NULL;
+  double countsPerStep = 1.0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--board") && i + 1 < argc) board = argv[++i];
+    else if (!strcmp(argv[i], "--socket") && i + 1 < argc) socketPath = argv[++i];
+    else if (!strcmp(argv[i], "--save") && i + 1 < argc) savePath = argv[++i];
+    else if (!strcmp(argv[i], "--output") && i + 1 < argc) outputPath = argv[++i];
+    else if (!strcmp(argv[i], "--counts-per-step") && i + 1 < argc) countsPerStep = atof(argv[++i]);
+    else if (argv[i][0] != '-' && !inputPath) inputPath = argv[i];
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if ((inputPath == NULL) == (board == NULL) || countsPerStep <= 0) {
+    printUsage();
+    return 1;
+  }
+
+  std::string data;
+  std::string error;
+  if (inputPath) {
+    if (!readFile(inputPath, data)) {
+      fprintf(stderr, "ERROR: cannot read %s\n", inputPath);
+      return 1;
+    }
+  } else if (!fetchTrace(socketPath, board, data, error)) {
+    fprintf(stderr, "ERROR: %s: %s\n", board, error.c_str());
+    return 1;
+  }
+  if (savePath && !writeFile(savePath, data)) {
+    fprintf(stderr, "ERROR: cannot write %s\n", savePath);
+    return 1;
+  }
+
+  MotionTrace trace;
+  if (!findTrace(data, trace, error)) {
+    fprintf(stderr, "ERROR: %s\n", error.c_str());
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (outputPath) {
+    out = fopen(outputPath, "w");
+    if (!out) {
+      fprintf(stderr, "ERROR: cannot write %s\n", outputPath);
+      return 1;
+    }
+  }
+  writeCsv(out, trace, countsPerStep);
+  if (out != stdout) fclose(out);
+  return 0;
+}